@@ -56,13 +56,19 @@ bool cEvent::Wait(unsigned a_TimeoutMSec)
 			
 			case std::cv_status::timeout:
 			{
-				// The wait timed out, return failure:
-				return false;
+				// The wait timed out, the event may still have been set in the meantime, checked below
+				break;
 			}
 		}  // switch (wait_until())
+		break;
 	}  // while (m_ShouldWait && not timeout)
 
-	// The wait timed out in the while condition:
+	// The event may have been set before the wait started, or right when it timed out:
+	if (!m_ShouldWait)
+	{
+		m_ShouldWait = true;
+		return true;
+	}
 	return false;
 }
 
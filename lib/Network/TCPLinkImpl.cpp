@@ -193,15 +193,34 @@ void cTCPLinkImpl::EnableNoDelay(bool a_EnableNoDelay)
 void cTCPLinkImpl::ReadCallback(bufferevent * a_BufferEvent, void * a_Self)
 {
 	ASSERT(a_Self != nullptr);
-	cTCPLinkImpl * Self = static_cast<cTCPLinkImpl *>(a_Self);
-	ASSERT(Self->m_Callbacks != nullptr);
+	ASSERT(static_cast<cTCPLinkImpl *>(a_Self)->m_Callbacks != nullptr);
+
+	// Keep the link alive even if the callbacks close it:
+	cTCPLinkImplPtr Self = static_cast<cTCPLinkImpl *>(a_Self)->m_Self;
+	if (Self == nullptr)
+	{
+		// The link has already been closed
+		return;
+	}
 
-	// Read all the incoming data, in 1024-byte chunks:
-	char data[1024];
-	size_t length;
-	while ((length = bufferevent_read(a_BufferEvent, data, sizeof(data))) > 0)
+	// Pass all the incoming data to the callbacks directly from the input buffer's memory, without copying it:
+	evbuffer * Input = bufferevent_get_input(a_BufferEvent);
+	evbuffer_iovec Vecs[8];
+	for (;;)
 	{
-		Self->m_Callbacks->OnReceivedData(data, length);
+		int NumVecs = evbuffer_peek(Input, -1, nullptr, Vecs, ARRAYCOUNT(Vecs));
+		if (NumVecs <= 0)
+		{
+			break;
+		}
+		NumVecs = std::min(NumVecs, static_cast<int>(ARRAYCOUNT(Vecs)));  // evbuffer_peek() returns the number of vectors needed, which may be more than provided
+		size_t NumBytes = 0;
+		for (int i = 0; i < NumVecs; i++)
+		{
+			Self->m_Callbacks->OnReceivedData(static_cast<const char *>(Vecs[i].iov_base), Vecs[i].iov_len);
+			NumBytes += Vecs[i].iov_len;
+		}
+		evbuffer_drain(Input, NumBytes);
 	}
 }
 
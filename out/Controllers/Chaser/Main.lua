@@ -0,0 +1,134 @@
+
+-- Main.lua
+
+-- Implements the Chaser controller: each bot chases the nearest enemy bot
+-- The same logic is implemented natively by the Chaser plugin in src/Plugins/Chaser, the "plugin" benchmark compares the two.
+
+
+
+
+
+local atan2, deg, floor, abs, min, max = math.atan2, math.deg, math.floor, math.abs, math.min, math.max
+
+
+
+
+
+--- Returns the enemy bot nearest to the specified bot, nil if there's none
+local function findNearestEnemy(a_AllBots, a_Bot)
+	local res, minDist
+	local x, y = a_Bot.x, a_Bot.y
+	for _, other in pairs(a_AllBots) do
+		if (other.isEnemy) then
+			local dx = other.x - x
+			local dy = other.y - y
+			local dist = dx * dx + dy * dy
+			if (not(res) or (dist < minDist)) then
+				res = other
+				minDist = dist
+			end
+		end
+	end
+	return res
+end
+
+
+
+
+
+--- Returns the max steering angle at the speed level nearest to the specified speed
+local function getMaxAngle(a_SpeedLevels, a_Speed)
+	local level = a_SpeedLevels[1]
+	if not(level) then
+		return 0
+	end
+	local minDiff = abs(level.linearSpeed - a_Speed)
+	for i = 2, #a_SpeedLevels do
+		local diff = abs(a_SpeedLevels[i].linearSpeed - a_Speed)
+		if (diff < minDiff) then
+			level = a_SpeedLevels[i]
+			minDiff = diff
+		end
+	end
+	return level.maxAngularSpeed
+end
+
+
+
+
+
+--- Returns the angle in the range (-180, 180]
+local function normalizeAngle(a_Angle)
+	local res = a_Angle % 360
+	if (res > 180) then
+		return res - 360
+	end
+	return res
+end
+
+
+
+
+
+function onGameStarted(a_Game)
+	-- Nothing needed
+end
+
+
+
+
+
+function onGameUpdate(a_Game)
+	local allBots = a_Game.allBots
+	for id, bot in pairs(allBots) do
+		if not(bot.isEnemy) then
+			local enemy = findNearestEnemy(allBots, bot)
+			if (enemy) then
+				-- Steer towards the enemy, as much as the bot's speed level allows; once heading at it, speed up:
+				local relAngle = normalizeAngle(deg(atan2(enemy.y - bot.y, enemy.x - bot.x)) - bot.angle)
+				if (abs(relAngle) < 1) then
+					setCommand(id, CMD_ACCELERATE)
+				else
+					local maxAngle = getMaxAngle(a_Game.speedLevels, bot.speed)
+					setCommand(id, CMD_STEER, max(-maxAngle, min(maxAngle, relAngle)))
+				end
+			end
+		end
+	end
+end
+
+
+
+
+
+function onSendingCommands(a_Game)
+	-- Nothing needed, the commands have been set in onGameUpdate
+end
+
+
+
+
+
+function onGameFinished(a_Game)
+	-- Nothing needed
+end
+
+
+
+
+
+function onBotDied(a_Game, a_BotID)
+	-- Nothing needed, the bot is removed from allBots right after this call
+end
+
+
+
+
+
+function onCommandsSent(a_Game)
+	-- Nothing needed
+end
+
+
+
+
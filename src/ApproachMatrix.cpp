@@ -0,0 +1,287 @@
+
+// ApproachMatrix.cpp
+
+// Implements the ApproachMatrix class that computes the time to the closest approach and the minimum distance for all pairs of bots
+
+#include "Globals.h"
+#include "ApproachMatrix.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define HAS_X86_SIMD
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		// MSVC allows the intrinsics in any function; the caller checks the CPU support at runtime
+		#include <intrin.h>
+		#define TARGET_SSE2
+		#define TARGET_AVX
+	#else
+		// Compile the individual kernels for their instruction sets, the rest of the code stays generic:
+		#define TARGET_SSE2 __attribute__((target("sse2")))
+		#define TARGET_AVX __attribute__((target("avx")))
+	#endif
+#endif
+
+
+
+
+
+/** The number of bots processed at once by the widest kernel; the arrays are padded to a multiple of this. */
+static const size_t SIMD_WIDTH = 4;
+
+
+
+
+
+/** The parameters shared by all the kernels: the input arrays and the output matrices. */
+struct KernelParams
+{
+	const double * m_X;
+	const double * m_Y;
+	const double * m_VX;
+	const double * m_VY;
+	size_t m_Stride;
+	double * m_TimeToClosest;
+	double * m_MinDistance;
+};
+
+
+
+
+
+/** Computes a single row of the matrices, one pair at a time. Also serves as the reference for the SIMD kernels. */
+static void computeRowScalar(const KernelParams & a_Params, size_t a_Row)
+{
+	double x = a_Params.m_X[a_Row];
+	double y = a_Params.m_Y[a_Row];
+	double vx = a_Params.m_VX[a_Row];
+	double vy = a_Params.m_VY[a_Row];
+	double * ttcRow = a_Params.m_TimeToClosest + a_Row * a_Params.m_Stride;
+	double * distRow = a_Params.m_MinDistance + a_Row * a_Params.m_Stride;
+	for (size_t i = 0; i < a_Params.m_Stride; i++)
+	{
+		double dx = a_Params.m_X[i] - x;
+		double dy = a_Params.m_Y[i] - y;
+		double dvx = a_Params.m_VX[i] - vx;
+		double dvy = a_Params.m_VY[i] - vy;
+		double dvSq = dvx * dvx + dvy * dvy;
+		double t = (dvSq > 0) ? (0 - (dx * dvx + dy * dvy)) / dvSq : 0;
+		t = (t > 0) ? t : 0;
+		double cx = dx + dvx * t;
+		double cy = dy + dvy * t;
+		ttcRow[i] = t;
+		distRow[i] = sqrt(cx * cx + cy * cy);
+	}
+}
+
+
+
+
+
+#ifdef HAS_X86_SIMD
+
+/** Computes a single row of the matrices, two pairs at a time. */
+TARGET_SSE2 static void computeRowSSE2(const KernelParams & a_Params, size_t a_Row)
+{
+	__m128d x = _mm_set1_pd(a_Params.m_X[a_Row]);
+	__m128d y = _mm_set1_pd(a_Params.m_Y[a_Row]);
+	__m128d vx = _mm_set1_pd(a_Params.m_VX[a_Row]);
+	__m128d vy = _mm_set1_pd(a_Params.m_VY[a_Row]);
+	__m128d zero = _mm_setzero_pd();
+	double * ttcRow = a_Params.m_TimeToClosest + a_Row * a_Params.m_Stride;
+	double * distRow = a_Params.m_MinDistance + a_Row * a_Params.m_Stride;
+	for (size_t i = 0; i < a_Params.m_Stride; i += 2)
+	{
+		__m128d dx = _mm_sub_pd(_mm_loadu_pd(a_Params.m_X + i), x);
+		__m128d dy = _mm_sub_pd(_mm_loadu_pd(a_Params.m_Y + i), y);
+		__m128d dvx = _mm_sub_pd(_mm_loadu_pd(a_Params.m_VX + i), vx);
+		__m128d dvy = _mm_sub_pd(_mm_loadu_pd(a_Params.m_VY + i), vy);
+		__m128d dvSq = _mm_add_pd(_mm_mul_pd(dvx, dvx), _mm_mul_pd(dvy, dvy));
+		__m128d dot = _mm_add_pd(_mm_mul_pd(dx, dvx), _mm_mul_pd(dy, dvy));
+
+		// Zero relative velocity gives 0 / 0, the mask replaces the NaN with zero time:
+		__m128d t = _mm_and_pd(_mm_div_pd(_mm_sub_pd(zero, dot), dvSq), _mm_cmpgt_pd(dvSq, zero));
+		t = _mm_max_pd(t, zero);
+		__m128d cx = _mm_add_pd(dx, _mm_mul_pd(dvx, t));
+		__m128d cy = _mm_add_pd(dy, _mm_mul_pd(dvy, t));
+		_mm_storeu_pd(ttcRow + i, t);
+		_mm_storeu_pd(distRow + i, _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(cx, cx), _mm_mul_pd(cy, cy))));
+	}
+}
+
+
+
+
+
+/** Computes a single row of the matrices, four pairs at a time. */
+TARGET_AVX static void computeRowAVX(const KernelParams & a_Params, size_t a_Row)
+{
+	__m256d x = _mm256_set1_pd(a_Params.m_X[a_Row]);
+	__m256d y = _mm256_set1_pd(a_Params.m_Y[a_Row]);
+	__m256d vx = _mm256_set1_pd(a_Params.m_VX[a_Row]);
+	__m256d vy = _mm256_set1_pd(a_Params.m_VY[a_Row]);
+	__m256d zero = _mm256_setzero_pd();
+	double * ttcRow = a_Params.m_TimeToClosest + a_Row * a_Params.m_Stride;
+	double * distRow = a_Params.m_MinDistance + a_Row * a_Params.m_Stride;
+	for (size_t i = 0; i < a_Params.m_Stride; i += 4)
+	{
+		__m256d dx = _mm256_sub_pd(_mm256_loadu_pd(a_Params.m_X + i), x);
+		__m256d dy = _mm256_sub_pd(_mm256_loadu_pd(a_Params.m_Y + i), y);
+		__m256d dvx = _mm256_sub_pd(_mm256_loadu_pd(a_Params.m_VX + i), vx);
+		__m256d dvy = _mm256_sub_pd(_mm256_loadu_pd(a_Params.m_VY + i), vy);
+		__m256d dvSq = _mm256_add_pd(_mm256_mul_pd(dvx, dvx), _mm256_mul_pd(dvy, dvy));
+		__m256d dot = _mm256_add_pd(_mm256_mul_pd(dx, dvx), _mm256_mul_pd(dy, dvy));
+
+		// Zero relative velocity gives 0 / 0, the mask replaces the NaN with zero time:
+		__m256d t = _mm256_and_pd(_mm256_div_pd(_mm256_sub_pd(zero, dot), dvSq), _mm256_cmp_pd(dvSq, zero, _CMP_GT_OQ));
+		t = _mm256_max_pd(t, zero);
+		__m256d cx = _mm256_add_pd(dx, _mm256_mul_pd(dvx, t));
+		__m256d cy = _mm256_add_pd(dy, _mm256_mul_pd(dvy, t));
+		_mm256_storeu_pd(ttcRow + i, t);
+		_mm256_storeu_pd(distRow + i, _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(cx, cx), _mm256_mul_pd(cy, cy))));
+	}
+}
+
+#endif  // HAS_X86_SIMD
+
+
+
+
+
+ApproachMatrix::ApproachMatrix(void):
+	m_Stride(0)
+{
+}
+
+
+
+
+
+void ApproachMatrix::setBots(const Bots & a_Bots)
+{
+	size_t count = a_Bots.size();
+	m_Stride = (count + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+
+	// Convert the bots into the padded arrays, keeping their capacity:
+	m_IDs.clear();
+	m_IndexByID.clear();
+	m_X.assign(m_Stride, 0);
+	m_Y.assign(m_Stride, 0);
+	m_VX.assign(m_Stride, 0);
+	m_VY.assign(m_Stride, 0);
+	for (size_t i = 0; i < count; i++)
+	{
+		auto & bot = a_Bots[i];
+		double rad = bot.m_Angle * M_PI / 180;
+		m_IDs.push_back(bot.m_ID);
+		m_IndexByID.emplace_back(bot.m_ID, static_cast<int>(i));
+		m_X[i] = bot.m_X;
+		m_Y[i] = bot.m_Y;
+		m_VX[i] = bot.m_Speed * cos(rad);
+		m_VY[i] = bot.m_Speed * sin(rad);
+	}
+	std::sort(m_IndexByID.begin(), m_IndexByID.end());
+	m_TimeToClosest.resize(m_Stride * m_Stride);
+	m_MinDistance.resize(m_Stride * m_Stride);
+}
+
+
+
+
+
+void ApproachMatrix::compute(Kernel a_Kernel)
+{
+	ASSERT(isKernelSupported(a_Kernel));
+
+	KernelParams params = {m_X.data(), m_Y.data(), m_VX.data(), m_VY.data(), m_Stride, m_TimeToClosest.data(), m_MinDistance.data()};
+	void (* computeRow)(const KernelParams &, size_t) = &computeRowScalar;
+	#ifdef HAS_X86_SIMD
+		switch (a_Kernel)
+		{
+			case kScalar: break;
+			case kSSE2:   computeRow = &computeRowSSE2; break;
+			case kAVX:    computeRow = &computeRowAVX;  break;
+		}
+	#endif
+	for (size_t row = 0, count = m_IDs.size(); row < count; row++)
+	{
+		computeRow(params, row);
+	}
+}
+
+
+
+
+
+int ApproachMatrix::findIndex(int a_ID) const
+{
+	auto itr = std::lower_bound(m_IndexByID.begin(), m_IndexByID.end(), std::make_pair(a_ID, -1));
+	if ((itr == m_IndexByID.end()) || (itr->first != a_ID))
+	{
+		return -1;
+	}
+	return itr->second;
+}
+
+
+
+
+
+bool ApproachMatrix::isKernelSupported(Kernel a_Kernel)
+{
+	switch (a_Kernel)
+	{
+		case kScalar: return true;
+		#if defined(HAS_X86_SIMD) && defined(_MSC_VER)
+			case kSSE2:
+			{
+				int info[4];
+				__cpuid(info, 1);
+				return ((info[3] & (1 << 26)) != 0);
+			}
+			case kAVX:
+			{
+				// Both the CPU and the OS (saving the YMM registers) need to support AVX:
+				int info[4];
+				__cpuid(info, 1);
+				bool isCpuAvx = ((info[2] & (1 << 28)) != 0) && ((info[2] & (1 << 27)) != 0);
+				return isCpuAvx && ((_xgetbv(0) & 6) == 6);
+			}
+		#elif defined(HAS_X86_SIMD)
+			case kSSE2: return (__builtin_cpu_supports("sse2") != 0);
+			case kAVX:  return (__builtin_cpu_supports("avx") != 0);
+		#else
+			case kSSE2: return false;
+			case kAVX:  return false;
+		#endif
+	}
+	return false;
+}
+
+
+
+
+
+ApproachMatrix::Kernel ApproachMatrix::getBestKernel(void)
+{
+	static const Kernel bestKernel = isKernelSupported(kAVX) ? kAVX : (isKernelSupported(kSSE2) ? kSSE2 : kScalar);
+	return bestKernel;
+}
+
+
+
+
+
+const char * ApproachMatrix::getKernelName(Kernel a_Kernel)
+{
+	switch (a_Kernel)
+	{
+		case kScalar: return "scalar";
+		case kSSE2:   return "SSE2";
+		case kAVX:    return "AVX";
+	}
+	return "unknown";
+}
+
+
+
+
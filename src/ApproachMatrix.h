@@ -0,0 +1,95 @@
+
+// ApproachMatrix.h
+
+// Declares the ApproachMatrix class that computes the time to the closest approach and the minimum distance for all pairs of bots
+
+
+
+
+
+#pragma once
+
+#include "Bot.h"
+
+
+
+
+
+/** Computes, for every pair of bots, the time until they get closest to each other and their distance at that time,
+assuming that both keep their current velocity (derived from their speed and angle).
+If the bots are moving apart (the closest approach is in the past), the time is zero and the distance is the current one.
+The results are stored in full (symmetrical) matrices indexed by the bots' order in the input.
+The computation has a scalar implementation and SSE2 and AVX ones, the fastest one supported by the CPU is selected at runtime.
+Not thread-safe, the owner is expected to provide the locking. */
+class ApproachMatrix
+{
+public:
+	/** The implementations of the computation. */
+	enum Kernel
+	{
+		kScalar,
+		kSSE2,
+		kAVX,
+	};
+
+
+	ApproachMatrix(void);
+
+	/** Loads the bots' positions and velocities. */
+	void setBots(const Bots & a_Bots);
+
+	/** Computes the matrices for the loaded bots, using the fastest kernel supported by the CPU. */
+	void compute(void) { compute(getBestKernel()); }
+
+	/** Computes the matrices for the loaded bots, using the specified kernel.
+	The kernel must be supported by the CPU (isKernelSupported()). */
+	void compute(Kernel a_Kernel);
+
+	/** Returns the number of the loaded bots. */
+	size_t size(void) const { return m_IDs.size(); }
+
+	/** Returns the ID of the bot at the specified index. */
+	int getID(size_t a_Idx) const { return m_IDs[a_Idx]; }
+
+	/** Returns the index of the bot with the specified ID, or -1 if not loaded. */
+	int findIndex(int a_ID) const;
+
+	/** Returns the time until the bots at the specified indices are closest to each other, in seconds. */
+	double getTimeToClosest(size_t a_Idx1, size_t a_Idx2) const { return m_TimeToClosest[a_Idx1 * m_Stride + a_Idx2]; }
+
+	/** Returns the distance of the bots' centers at their closest approach. */
+	double getMinDistance(size_t a_Idx1, size_t a_Idx2) const { return m_MinDistance[a_Idx1 * m_Stride + a_Idx2]; }
+
+	/** Returns true if the CPU supports the specified kernel. */
+	static bool isKernelSupported(Kernel a_Kernel);
+
+	/** Returns the fastest kernel supported by the CPU. */
+	static Kernel getBestKernel(void);
+
+	/** Returns the name of the kernel, for the reports. */
+	static const char * getKernelName(Kernel a_Kernel);
+
+protected:
+	/** The bots' IDs, in the input order. */
+	std::vector<int> m_IDs;
+
+	/** The (ID, index) pairs sorted by the ID, for findIndex(). */
+	std::vector<std::pair<int, int>> m_IndexByID;
+
+	/** The number of bots rounded up to the SIMD width, the row length of the matrices. */
+	size_t m_Stride;
+
+	/** The bots' positions and velocities, padded with zeroes up to m_Stride. */
+	std::vector<double> m_X;
+	std::vector<double> m_Y;
+	std::vector<double> m_VX;
+	std::vector<double> m_VY;
+
+	/** The resulting matrices, m_Stride x m_Stride, only the first size() rows and columns are valid. */
+	std::vector<double> m_TimeToClosest;
+	std::vector<double> m_MinDistance;
+};
+
+
+
+
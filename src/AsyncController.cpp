@@ -0,0 +1,364 @@
+
+// AsyncController.cpp
+
+// Implements the AsyncController class that runs another controller in its own worker thread, decoupled from the network and the command sender threads
+
+#include "Globals.h"
+#include "AsyncController.h"
+#include "BotWarzApp.h"
+
+
+
+
+
+AsyncController::AsyncController(BotWarzApp & a_App, SharedPtr<Controller> a_Controller):
+	Super(a_App),
+	m_Controller(a_Controller),
+	m_ShouldTerminate(false),
+	m_PublishedCommands(0),
+	m_WorkerCommands(1),
+	m_SenderCommands(2),
+	m_NumUpdatesQueued(0),
+	m_NumUpdatesCoalesced(0),
+	m_NumUpdatesProcessed(0),
+	m_NumCommandSetsPublished(0),
+	m_NumCommandSetsReplaced(0)
+{
+	m_WorkerThread = std::thread(&AsyncController::workerThread, this);
+}
+
+
+
+
+
+AsyncController::~AsyncController()
+{
+	m_ShouldTerminate = true;
+	m_evtQueued.Set();
+	if (m_WorkerThread.joinable())
+	{
+		m_WorkerThread.join();
+	}
+}
+
+
+
+
+
+void AsyncController::onGameStarted(Board & a_Board)
+{
+	queueEvent(Event(Event::evGameStarted, &a_Board));
+}
+
+
+
+
+
+void AsyncController::onGameUpdate(void)
+{
+	queueEvent(Event(Event::evGameUpdate));
+}
+
+
+
+
+
+void AsyncController::onGameFinished(void)
+{
+	queueEvent(Event(Event::evGameFinished));
+
+	// Wait for the worker to finish the game, the board is to be re-initialized for the next game after this returns:
+	m_evtGameFinished.Wait();
+}
+
+
+
+
+
+void AsyncController::onRetired(void)
+{
+	queueEvent(Event(Event::evRetired));
+
+	// Wait for the worker to report the game so far, the wrapped controller is released after this returns:
+	m_evtGameFinished.Wait();
+}
+
+
+
+
+
+void AsyncController::onBotDied(const Bot & a_Bot)
+{
+	Event evt(Event::evBotDied);
+	evt.m_Bot = a_Bot;
+	queueEvent(std::move(evt));
+}
+
+
+
+
+
+AString AsyncController::saveState(void)
+{
+	queueEvent(Event(Event::evSaveState));
+
+	// Wait for the worker to process the notifications queued so far and save the state:
+	m_evtStateSaved.Wait();
+	AString res;
+	std::swap(res, m_SavedState);
+	return res;
+}
+
+
+
+
+
+void AsyncController::restoreState(const AString & a_State)
+{
+	Event evt(Event::evRestoreState);
+	evt.m_State = a_State;
+	queueEvent(std::move(evt));
+}
+
+
+
+
+
+void AsyncController::onGameResumed(Board & a_Board)
+{
+	queueEvent(Event(Event::evGameResumed, &a_Board));
+}
+
+
+
+
+
+void AsyncController::getBotCommands(BotCommands & a_Commands)
+{
+	a_Commands.clear();
+
+	// If no new commands have been published since the last call, there's nothing to send:
+	if ((m_PublishedCommands.load() & FRESH_COMMANDS_FLAG) == 0)
+	{
+		return;
+	}
+
+	// Take the published buffer, giving the previously taken one back to the worker.
+	// The worker may still be reading the buffer while carrying its commands over, so the commands are copied, never moved:
+	m_SenderCommands = m_PublishedCommands.exchange(m_SenderCommands) & ~FRESH_COMMANDS_FLAG;
+	a_Commands = m_CommandBuffers[m_SenderCommands];
+}
+
+
+
+
+
+void AsyncController::queueEvent(Event && a_Event)
+{
+	{
+		cCSLock Lock(m_CSEvents);
+		if ((a_Event.m_Kind == Event::evGameStarted) || (a_Event.m_Kind == Event::evGameResumed))
+		{
+			m_NumUpdatesQueued = 0;
+			m_NumUpdatesCoalesced = 0;
+		}
+		else if (a_Event.m_Kind == Event::evGameUpdate)
+		{
+			// The controller reads the latest board snapshot, so a single update waiting in the queue is enough;
+			// move it to the end, after any bot deaths reported by the new update:
+			m_NumUpdatesQueued += 1;
+			for (auto itr = m_Events.begin(); itr != m_Events.end(); ++itr)
+			{
+				if (itr->m_Kind == Event::evGameUpdate)
+				{
+					m_Events.erase(itr);
+					m_NumUpdatesCoalesced += 1;
+					break;
+				}
+			}
+		}
+		m_Events.push_back(std::move(a_Event));
+	}
+	m_evtQueued.Set();
+}
+
+
+
+
+
+void AsyncController::workerThread(void)
+{
+	std::deque<Event> events;
+	while (!m_ShouldTerminate)
+	{
+		// Wait for the notifications:
+		m_evtQueued.Wait();
+
+		// Process all the notifications queued so far; those queued meanwhile wait for the next round, so that the updates are coalesced:
+		{
+			cCSLock Lock(m_CSEvents);
+			std::swap(events, m_Events);
+		}
+		for (const auto & evt: events)
+		{
+			processEvent(evt);
+		}
+		events.clear();
+	}  // while (!m_ShouldTerminate)
+}
+
+
+
+
+
+void AsyncController::processEvent(const Event & a_Event)
+{
+	switch (a_Event.m_Kind)
+	{
+		case Event::evGameStarted:
+		case Event::evGameResumed:
+		{
+			m_NumUpdatesProcessed = 0;
+			m_NumCommandSetsPublished = 0;
+			m_NumCommandSetsReplaced = 0;
+			if (a_Event.m_Kind == Event::evGameStarted)
+			{
+				m_Controller->onGameStarted(*a_Event.m_Board);
+			}
+			else
+			{
+				m_Controller->onGameResumed(*a_Event.m_Board);
+			}
+			return;
+		}
+
+		case Event::evGameUpdate:
+		{
+			m_Controller->onGameUpdate();
+			publishCommands();
+			m_NumUpdatesProcessed += 1;
+			m_App.getTickLatency().mark(TickLatency::stControllerUpdated);
+
+			// The slack until the next update:
+			m_Controller->onCommandsSent();
+			return;
+		}
+
+		case Event::evBotDied:
+		{
+			m_Controller->onBotDied(a_Event.m_Bot);
+			return;
+		}
+
+		case Event::evGameFinished:
+		case Event::evRetired:
+		{
+			// When retired, the commands not yet sent are dropped, the new version of the controller sends its own:
+			if (a_Event.m_Kind == Event::evGameFinished)
+			{
+				m_Controller->onGameFinished();
+			}
+			else
+			{
+				m_Controller->onRetired();
+			}
+			discardCommands();
+
+			// Report the statistics:
+			int numUpdatesQueued, numUpdatesCoalesced;
+			{
+				cCSLock Lock(m_CSEvents);
+				numUpdatesQueued = m_NumUpdatesQueued;
+				numUpdatesCoalesced = m_NumUpdatesCoalesced;
+			}
+			auto stats = Printf("Controller thread: %d updates received, %d processed, %d coalesced while busy; %d command sets published, %d replaced before being sent",
+				numUpdatesQueued, m_NumUpdatesProcessed, numUpdatesCoalesced, m_NumCommandSetsPublished, m_NumCommandSetsReplaced
+			);
+			LOG("%s: %s", m_App.getLoginNick().c_str(), stats.c_str());
+			m_App.commentLog(stats);
+
+			m_evtGameFinished.Set();
+			return;
+		}
+
+		case Event::evSaveState:
+		{
+			m_SavedState = m_Controller->saveState();
+			m_evtStateSaved.Set();
+			return;
+		}
+
+		case Event::evRestoreState:
+		{
+			m_Controller->restoreState(a_Event.m_State);
+			return;
+		}
+	}
+}
+
+
+
+
+
+void AsyncController::publishCommands(void)
+{
+	auto & commands = m_CommandBuffers[m_WorkerCommands];
+	m_Controller->getBotCommands(commands);
+	auto numNewCommands = commands.size();
+
+	auto published = m_PublishedCommands.load();
+	for (;;)
+	{
+		if ((published & FRESH_COMMANDS_FLAG) != 0)
+		{
+			// The sender hasn't taken the previous commands yet, carry over those for the bots that have no new command.
+			// The sender may be taking (and reading) them meanwhile, but nobody writes them:
+			for (const auto & cmd: m_CommandBuffers[published & ~FRESH_COMMANDS_FLAG])
+			{
+				auto end = commands.begin() + static_cast<ptrdiff_t>(numNewCommands);
+				auto itr = std::find_if(commands.begin(), end, [&cmd](const BotCommand & a_Cmd) { return (a_Cmd.m_BotID == cmd.m_BotID); });
+				if (itr == end)
+				{
+					commands.push_back(cmd);
+				}
+			}
+		}
+
+		// Publish, unless the sender has taken the previous commands meanwhile:
+		if (m_PublishedCommands.compare_exchange_strong(published, m_WorkerCommands | FRESH_COMMANDS_FLAG))
+		{
+			break;
+		}
+
+		// The sender has taken the previous commands, so they must not be sent again. Publish the new commands alone:
+		commands.erase(commands.begin() + static_cast<ptrdiff_t>(numNewCommands), commands.end());
+	}
+
+	// The previously published buffer is now the worker's to fill:
+	m_NumCommandSetsPublished += 1;
+	if ((published & FRESH_COMMANDS_FLAG) != 0)
+	{
+		m_NumCommandSetsReplaced += 1;
+	}
+	m_WorkerCommands = published & ~FRESH_COMMANDS_FLAG;
+}
+
+
+
+
+
+void AsyncController::discardCommands(void)
+{
+	auto published = m_PublishedCommands.load();
+	while (
+		((published & FRESH_COMMANDS_FLAG) != 0) &&
+		!m_PublishedCommands.compare_exchange_weak(published, published & ~FRESH_COMMANDS_FLAG)
+	)
+	{
+		// The sender has taken the commands meanwhile, or the CAS failed spuriously; re-check
+	}
+}
+
+
+
+
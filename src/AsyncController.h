@@ -0,0 +1,173 @@
+
+// AsyncController.h
+
+// Declares the AsyncController class that runs another controller in its own worker thread, decoupled from the network and the command sender threads
+
+
+
+
+
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include "lib/Network/CriticalSection.h"
+#include "lib/Network/Event.h"
+#include "Controller.h"
+#include "Bot.h"
+
+
+
+
+
+/** Wraps another controller and runs all of its callbacks in a dedicated worker thread, so that neither the network thread
+nor the command sender thread ever waits for the controller (and, for the Lua controller, never executes Lua).
+The notifications from the app are queued and processed by the worker thread in order. The game updates are coalesced:
+the board publishes a snapshot on each update, so if the worker is still busy when more updates arrive, only the latest one
+is processed. After each processed update, the worker retrieves the wrapped controller's commands and publishes them
+into a lock-free slot (a triple buffer), from which getBotCommands() copies them without waiting; if the sender hasn't taken
+the previous set yet, its commands for the bots that have no new command are carried over into the new set.
+The wrapped controller's onCommandsSent() is called in the worker thread right after the commands are published,
+so its slack work (such as the Lua garbage collection) is done before the next update as well.
+onGameFinished() waits for the worker to process all the queued notifications, so that the board isn't re-initialized
+for the next game while the controller is still reading it; saveState() waits the same way, so that the state is saved
+after all the notifications have been processed, and so does onRetired(). */
+class AsyncController :
+	public Controller
+{
+	typedef Controller Super;
+
+public:
+	/** Creates the wrapper and starts its worker thread. a_Controller is the controller whose callbacks are run in the thread. */
+	AsyncController(BotWarzApp & a_App, SharedPtr<Controller> a_Controller);
+
+	/** Stops the worker thread. */
+	virtual ~AsyncController() override;
+
+	// Controller overrides:
+	virtual bool isValid(void) const override { return m_Controller->isValid(); }
+	virtual bool isAsync(void) const override { return true; }
+	virtual void onGameStarted(Board & a_Board) override;
+	virtual void onGameUpdate(void) override;
+	virtual void onGameFinished(void) override;
+	virtual void onBotDied(const Bot & a_Bot) override;
+	virtual void getBotCommands(BotCommands & a_Commands) override;
+	virtual void onCommandsSent(void) override {}  // The wrapped controller is notified in the worker thread
+	virtual AString saveState(void) override;
+	virtual void restoreState(const AString & a_State) override;
+	virtual void onGameResumed(Board & a_Board) override;
+	virtual void onRetired(void) override;
+
+protected:
+	/** A single notification queued for the worker thread. */
+	struct Event
+	{
+		enum Kind
+		{
+			evGameStarted,
+			evGameUpdate,
+			evBotDied,
+			evGameFinished,
+			evSaveState,
+			evRestoreState,
+			evGameResumed,
+			evRetired,
+		};
+
+		Kind m_Kind;
+
+		/** The board of the game, for evGameStarted and evGameResumed. */
+		Board * m_Board;
+
+		/** The bot that has died, for evBotDied. */
+		Bot m_Bot;
+
+		/** The state to restore, for evRestoreState. */
+		AString m_State;
+
+
+		Event(Kind a_Kind, Board * a_Board = nullptr):
+			m_Kind(a_Kind),
+			m_Board(a_Board),
+			m_Bot(0, false, 0, 0, 0, 0)
+		{
+		}
+	};
+
+
+	/** The number of the command buffers: the one published, the one being filled by the worker and the one read by the sender. */
+	static const int NUM_COMMAND_BUFFERS = 3;
+
+	/** The flag in m_PublishedCommands signalling that the published buffer hasn't been taken by the sender yet. */
+	static const int FRESH_COMMANDS_FLAG = 0x100;
+
+
+	/** The controller whose callbacks are run in the worker thread. */
+	SharedPtr<Controller> m_Controller;
+
+	/** Protects m_Events against multithreaded access. */
+	cCriticalSection m_CSEvents;
+
+	/** The notifications waiting for the worker thread. Protected by m_CSEvents. */
+	std::deque<Event> m_Events;
+
+	/** Set when a notification is queued, or the worker thread should terminate. */
+	cEvent m_evtQueued;
+
+	/** Set by the worker thread when it has processed the game finish, or the retirement of the wrapped controller. */
+	cEvent m_evtGameFinished;
+
+	/** Set by the worker thread when it has saved the wrapped controller's state into m_SavedState. */
+	cEvent m_evtStateSaved;
+
+	/** The state saved by the wrapped controller, for saveState(). Written by the worker thread before m_evtStateSaved is set. */
+	AString m_SavedState;
+
+	/** Set to true when the worker thread should terminate. */
+	std::atomic<bool> m_ShouldTerminate;
+
+	/** The buffers of the command sets passed from the worker thread to the command sender. */
+	BotCommands m_CommandBuffers[NUM_COMMAND_BUFFERS];
+
+	/** The index of the buffer with the latest published commands, ORed with FRESH_COMMANDS_FLAG if the sender hasn't taken them yet. */
+	std::atomic<int> m_PublishedCommands;
+
+	/** The index of the buffer being filled by the worker thread. Only accessed from the worker thread. */
+	int m_WorkerCommands;
+
+	/** The index of the buffer last taken by the command sender. Only accessed from getBotCommands(). */
+	int m_SenderCommands;
+
+	// Statistics since the game start; the counts of the updates and commands are only written from the worker thread:
+	int m_NumUpdatesQueued;  // Protected by m_CSEvents
+	int m_NumUpdatesCoalesced;  // Protected by m_CSEvents
+	int m_NumUpdatesProcessed;
+	int m_NumCommandSetsPublished;
+	int m_NumCommandSetsReplaced;
+
+	/** The worker thread running the wrapped controller. */
+	std::thread m_WorkerThread;
+
+
+	/** Adds the notification to the queue and wakes up the worker thread.
+	A game update replaces the one already waiting in the queue, if any. */
+	void queueEvent(Event && a_Event);
+
+	/** The body of the worker thread: processes the queued notifications until terminated. */
+	void workerThread(void);
+
+	/** Processes a single notification in the worker thread. */
+	void processEvent(const Event & a_Event);
+
+	/** Retrieves the commands from the wrapped controller and publishes them for the command sender.
+	Called in the worker thread after each processed update. */
+	void publishCommands(void);
+
+	/** Marks the published commands as taken, so that they aren't sent after the game has finished.
+	Called in the worker thread. */
+	void discardCommands(void);
+};
+
+
+
+
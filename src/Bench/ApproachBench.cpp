@@ -0,0 +1,228 @@
+
+// ApproachBench.cpp
+
+// Implements the benchmark comparing the ApproachMatrix kernels and checking them against a straightforward scalar reference
+
+#include "Globals.h"
+#include "Benchmarks.h"
+#include <random>
+#include "ApproachMatrix.h"
+#include "Simulator/SimGame.h"
+
+
+
+
+
+/** The maximum number of bots; the two matrices take 16 bytes per pair of bots. */
+static const int MAX_BOTS = 4096;
+
+
+
+
+
+/** Computes the time to the closest approach and the minimum distance of a single pair of bots, directly from their values.
+Serves as the reference that the kernels are checked against. */
+static void referenceApproach(const Bot & a_Bot1, const Bot & a_Bot2, double & a_Time, double & a_Distance)
+{
+	// Relative position and velocity of the second bot, as seen from the first one:
+	double rad1 = a_Bot1.m_Angle * M_PI / 180;
+	double rad2 = a_Bot2.m_Angle * M_PI / 180;
+	double relX = a_Bot2.m_X - a_Bot1.m_X;
+	double relY = a_Bot2.m_Y - a_Bot1.m_Y;
+	double relVX = a_Bot2.m_Speed * cos(rad2) - a_Bot1.m_Speed * cos(rad1);
+	double relVY = a_Bot2.m_Speed * sin(rad2) - a_Bot1.m_Speed * sin(rad1);
+
+	// The squared distance is a quadratic function of time, its minimum is where the derivative is zero:
+	double relSpeedSq = relVX * relVX + relVY * relVY;
+	a_Time = 0;
+	if (relSpeedSq > 0)
+	{
+		a_Time = std::max(-(relX * relVX + relY * relVY) / relSpeedSq, 0.0);
+	}
+	a_Distance = sqrt((relX + relVX * a_Time) * (relX + relVX * a_Time) + (relY + relVY * a_Time) * (relY + relVY * a_Time));
+}
+
+
+
+
+
+/** Returns true if the two values are equal within the tolerance of the rounding differences. */
+static bool isClose(double a_Value1, double a_Value2)
+{
+	return (std::abs(a_Value1 - a_Value2) <= 1e-9 * std::max(1.0, std::max(std::abs(a_Value1), std::abs(a_Value2))));
+}
+
+
+
+
+
+/** Generates the bots at random positions with random velocities.
+Includes the degenerate cases: stationary bots, bots moving in parallel with the same velocity and bots at the same position. */
+static void generateBots(std::mt19937 & a_Random, int a_NumBots, const SimGame::Settings & a_Settings, Bots & a_Bots)
+{
+	std::uniform_real_distribution<double> coordX(0, a_Settings.m_Width);
+	std::uniform_real_distribution<double> coordY(0, a_Settings.m_Height);
+	std::uniform_real_distribution<double> angle(-180, 180);
+	std::uniform_real_distribution<double> speed(0, 100);
+	std::uniform_int_distribution<int> percent(0, 99);
+	a_Bots.clear();
+	for (int id = 1; id <= a_NumBots; id++)
+	{
+		Bot bot(id, (id > a_NumBots / 2), coordX(a_Random), coordY(a_Random), speed(a_Random), angle(a_Random));
+		if (!a_Bots.empty())
+		{
+			switch (percent(a_Random) / 5)
+			{
+				case 0: bot.m_Speed = 0; break;  // Stationary
+				case 1:
+				{
+					// Same velocity as the previous bot:
+					bot.m_Speed = a_Bots.back().m_Speed;
+					bot.m_Angle = a_Bots.back().m_Angle;
+					break;
+				}
+				case 2:
+				{
+					// Same position as the previous bot:
+					bot.m_X = a_Bots.back().m_X;
+					bot.m_Y = a_Bots.back().m_Y;
+					break;
+				}
+			}
+		}
+		a_Bots.push_back(bot);
+	}
+}
+
+
+
+
+
+/** Checks the results computed by the specified kernel against the reference.
+Returns true if all the pairs match. */
+static bool checkKernel(const Bots & a_Bots, ApproachMatrix & a_Matrix, ApproachMatrix::Kernel a_Kernel)
+{
+	a_Matrix.setBots(a_Bots);
+	a_Matrix.compute(a_Kernel);
+	for (size_t i = 0; i < a_Bots.size(); i++)
+	{
+		for (size_t j = 0; j < a_Bots.size(); j++)
+		{
+			double time, distance;
+			referenceApproach(a_Bots[i], a_Bots[j], time, distance);
+			if (!isClose(time, a_Matrix.getTimeToClosest(i, j)) || !isClose(distance, a_Matrix.getMinDistance(i, j)))
+			{
+				LOGERROR("The %s kernel differs from the reference for bots %d and %d: time %.17g vs %.17g, distance %.17g vs %.17g",
+					ApproachMatrix::getKernelName(a_Kernel), a_Bots[i].m_ID, a_Bots[j].m_ID,
+					a_Matrix.getTimeToClosest(i, j), time, a_Matrix.getMinDistance(i, j), distance
+				);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+
+
+
+
+int benchApproach(const AStringVector & a_Args)
+{
+	int maxBots = 1000;
+	int numRounds = 1000;
+	for (auto & arg: a_Args)
+	{
+		if (
+			!parseIntArg(arg, "/maxbots=", maxBots) &&
+			!parseIntArg(arg, "/rounds=", numRounds)
+		)
+		{
+			LOGERROR("Unknown parameter: %s", arg.c_str());
+			return 2;
+		}
+	}
+	if ((maxBots < 2) || (numRounds <= 0))
+	{
+		LOGERROR("At least two bots and one round are needed.");
+		return 2;
+	}
+	if (maxBots > MAX_BOTS)
+	{
+		LOGERROR("The number of bots cannot exceed %d.", MAX_BOTS);
+		return 2;
+	}
+
+	// Collect the kernels supported by this CPU:
+	std::vector<ApproachMatrix::Kernel> kernels;
+	for (auto kernel: {ApproachMatrix::kScalar, ApproachMatrix::kSSE2, ApproachMatrix::kAVX})
+	{
+		if (ApproachMatrix::isKernelSupported(kernel))
+		{
+			kernels.push_back(kernel);
+		}
+	}
+	LOG("Computing the closest approaches of all pairs of bots; the number of ticks decreases with the bot count. Best kernel: %s",
+		ApproachMatrix::getKernelName(ApproachMatrix::getBestKernel())
+	);
+
+	SimGame::Settings settings;
+	std::mt19937 random(0);
+	ApproachMatrix matrix;
+	Bots bots;
+	for (auto numBots: getBotCounts(10, 10, maxBots))
+	{
+		int numTicks = std::max(static_cast<int>(static_cast<Int64>(numRounds) * 10000 / (static_cast<Int64>(numBots) * numBots)), 1);
+		generateBots(random, numBots, settings, bots);
+
+		// Check all the kernels, including the odd counts not filling the whole SIMD registers:
+		for (auto kernel: kernels)
+		{
+			if (!checkKernel(bots, matrix, kernel))
+			{
+				return 1;
+			}
+			Bots oddBots(bots.begin(), bots.begin() + (numBots - 1));
+			if (!checkKernel(oddBots, matrix, kernel))
+			{
+				return 1;
+			}
+		}
+
+		// Measure each kernel, including the loading of the bots:
+		AString report;
+		double scalarNSec = 0;
+		for (auto kernel: kernels)
+		{
+			double checksum = 0;
+			auto startTime = std::chrono::high_resolution_clock::now();
+			for (int tick = 0; tick < numTicks; tick++)
+			{
+				matrix.setBots(bots);
+				matrix.compute(kernel);
+				checksum += matrix.getMinDistance(0, static_cast<size_t>(numBots - 1));
+			}
+			double nsec = nsecSince(startTime);
+			if (kernel == ApproachMatrix::kScalar)
+			{
+				scalarNSec = nsec;
+			}
+			AppendPrintf(report, ", %s: %10.1f ns per tick (%.1f x)",
+				ApproachMatrix::getKernelName(kernel), nsec / numTicks, scalarNSec / nsec
+			);
+			if (!std::isfinite(checksum))
+			{
+				LOGERROR("The %s kernel produced non-finite distances.", ApproachMatrix::getKernelName(kernel));
+				return 1;
+			}
+		}
+
+		// Report:
+		LOG("  %5d bots, %6d ticks%s", numBots, numTicks, report.c_str());
+	}
+	return 0;
+}
+
+
+
+
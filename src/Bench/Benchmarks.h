@@ -0,0 +1,104 @@
+
+// Benchmarks.h
+
+// Declares the individual benchmarks and the helper functions shared among them
+
+
+
+
+
+#pragma once
+
+
+
+
+
+/** Signature of a single benchmark's entrypoint.
+a_Args are the command-line parameters following the benchmark name.
+Returns the value that the process should return upon exit (nonzero if the benchmark's self-check failed). */
+typedef int (* BenchmarkFn)(const AStringVector & a_Args);
+
+
+
+
+
+/** Measures the time to compute the pairwise closest approaches of the bots using each of the ApproachMatrix kernels,
+for increasing bot counts. Also checks all the kernels against a straightforward scalar reference. */
+int benchApproach(const AStringVector & a_Args);
+
+/** Measures the time to store the bots and detect their deaths, the original map-based way and using BotTable, for increasing bot counts.
+Also checks that both detect the same deaths. */
+int benchBots(const AStringVector & a_Args);
+
+/** Measures the time to serialize the bot commands, the generic jsoncpp way and using CommandSerializer.
+Also checks that both produce the same output, optionally on the commands recorded in an .ebwlog file. */
+int benchCommands(const AStringVector & a_Args);
+
+/** Measures the number of bytes copied and the time spent splitting the incoming data into lines, old and new way. */
+int benchFraming(const AStringVector & a_Args);
+
+/** Measures the time to load a Lua controller requiring a large module, compiled from the source on each load,
+and through LuaChunkCache with a cold and with a warm cache. Also checks that all the modes load the same code. */
+int benchLuaCache(const AStringVector & a_Args);
+
+/** Measures the latency percentiles of a garbage-producing Lua callback with the default allocator and garbage collector,
+with LuaMemory's pooled allocator, and with the collector run only in the slack after each callback.
+Also checks that all the modes compute the same results. */
+int benchLuaGC(const AStringVector & a_Args);
+
+/** Measures the time to parse a "play" message into the board, the generic jsoncpp way and using PlayParser. */
+int benchPlay(const AStringVector & a_Args);
+
+/** Measures the tick latency of the Chaser controller, implemented as a native plugin and as the equivalent Lua script,
+playing the same simulated games, for increasing bot counts. Also checks that both return the same commands. */
+int benchPlugin(const AStringVector & a_Args);
+
+/** Measures the time to update the bots in Lua and read them from a script, as tables rewritten on each update and as LuaBotProxies,
+for increasing bot counts. Also checks that both read the same values. */
+int benchProxies(const AStringVector & a_Args);
+
+/** Measures the time to find the nearest enemy for each of my bots from Lua, by scanning all the bots and using SpatialIndex,
+for increasing bot counts. Also checks that both find the same enemies. */
+int benchSpatial(const AStringVector & a_Args);
+
+
+
+
+
+// Helper functions:
+
+/** If a_Arg starts with a_Prefix, parses the rest as an integer into a_Value and returns true.
+Returns false if the prefix doesn't match. Logs an error and terminates if the number cannot be parsed. */
+template <typename T>
+bool parseIntArg(const AString & a_Arg, const char * a_Prefix, T & a_Value)
+{
+	size_t prefixLen = strlen(a_Prefix);
+	if (NoCaseCompare(a_Arg.substr(0, prefixLen), a_Prefix) != 0)
+	{
+		return false;
+	}
+	if (!StringToInteger(a_Arg.substr(prefixLen), a_Value))
+	{
+		LOGERROR("Invalid number in parameter %s", a_Arg.c_str());
+		exit(2);
+	}
+	return true;
+}
+
+/** Returns a stream of a_NumMessages realistic "play" messages (LF-terminated lines), as sent by the server.
+The messages are generated by simulating games using the server simulator's game logic. */
+AString generatePlayStream(int a_NumMessages, UInt32 a_Seed);
+
+/** Returns the number of nanoseconds elapsed since a_Start. */
+double nsecSince(std::chrono::high_resolution_clock::time_point a_Start);
+
+/** Returns the specified percentile of the (sorted) values. */
+double percentile(const std::vector<double> & a_Sorted, double a_Percentile);
+
+/** Returns the bot counts at which the scaling benchmarks measure: a_First, multiplied by a_Factor on each step,
+up to and always including a_Max (a_Max alone if a_First is not below it). */
+std::vector<int> getBotCounts(int a_First, int a_Factor, int a_Max);
+
+
+
+
@@ -0,0 +1,335 @@
+
+// BotTableBench.cpp
+
+// Implements the benchmark comparing the bot storage and death detection, the original map-based way and using BotTable
+
+#include "Globals.h"
+#include "Benchmarks.h"
+#include <random>
+#include "BotTable.h"
+
+
+
+
+
+/** A single bot's values, as reported by the server in a single game update. */
+struct BotReport
+{
+	int m_ID;
+	double m_X;
+	double m_Y;
+	double m_Speed;
+	double m_Angle;
+};
+
+
+
+
+
+/** A simulated game: the bots at the game start and the reports of the bots alive in each update. */
+struct Scenario
+{
+	/** The number of bots per player. The first player's bots are "mine", the second player's are the enemy's. */
+	int m_NumBotsPerPlayer;
+
+	/** The bots at the game start. */
+	std::vector<BotReport> m_StartBots;
+
+	/** The bots reported in all the updates, one update after another. */
+	std::vector<BotReport> m_Reports;
+
+	/** The index into m_Reports where each update starts; has one extra item at the end, marking the end of the last update. */
+	std::vector<size_t> m_UpdateStarts;
+};
+
+
+
+
+
+/** Replicates the former Bot class, allocated separately for each bot and shared among the containers. */
+struct LegacyBot
+{
+	int m_ID;
+	bool m_IsEnemy;
+	double m_X;
+	double m_Y;
+	double m_Speed;
+	double m_Angle;
+};
+
+typedef SharedPtr<LegacyBot> LegacyBotPtr;
+typedef std::vector<LegacyBotPtr> LegacyBotPtrs;
+
+
+
+
+
+/** Replicates the former Board's bot storage: the map of all bots plus the vectors of my and enemy bots,
+and the death detection by searching the list of reported IDs for each bot in each container. */
+class LegacyBoard
+{
+public:
+	void initialize(const Scenario & a_Scenario)
+	{
+		m_MyBots.clear();
+		m_EnemyBots.clear();
+		m_AllBots.clear();
+		for (size_t i = 0; i < a_Scenario.m_StartBots.size(); i++)
+		{
+			auto & rep = a_Scenario.m_StartBots[i];
+			bool isEnemy = (static_cast<int>(i) >= a_Scenario.m_NumBotsPerPlayer);
+			LegacyBotPtr bot(new LegacyBot{rep.m_ID, isEnemy, rep.m_X, rep.m_Y, rep.m_Speed, rep.m_Angle});
+			(isEnemy ? m_EnemyBots : m_MyBots).push_back(bot);
+			m_AllBots[rep.m_ID] = bot;
+		}
+	}
+
+	/** Applies a single update, returns the sum of the IDs of the bots that have died. */
+	Int64 update(const BotReport * a_Begin, const BotReport * a_End)
+	{
+		m_PresentIDs.clear();
+		for (auto rep = a_Begin; rep != a_End; ++rep)
+		{
+			auto itr = m_AllBots.find(rep->m_ID);
+			if (itr == m_AllBots.end())
+			{
+				continue;
+			}
+			auto & bot = *(itr->second);
+			bot.m_X = rep->m_X;
+			bot.m_Y = rep->m_Y;
+			bot.m_Speed = rep->m_Speed;
+			bot.m_Angle = rep->m_Angle;
+			m_PresentIDs.push_back(rep->m_ID);
+		}
+
+		// Remove the bots that haven't been reported:
+		Int64 diedIDs = 0;
+		for (auto itr = m_AllBots.begin(), end = m_AllBots.end(); itr != end;)
+		{
+			if (std::find(m_PresentIDs.begin(), m_PresentIDs.end(), itr->first) == m_PresentIDs.end())
+			{
+				diedIDs += itr->first;
+				itr = m_AllBots.erase(itr);
+			}
+			else
+			{
+				++itr;
+			}
+		}
+		removeMissing(m_MyBots);
+		removeMissing(m_EnemyBots);
+		return diedIDs;
+	}
+
+	/** Returns the copy of my bots, as the former Board::getMyBotsCopy() did. */
+	LegacyBotPtrs getMyBotsCopy(void) const
+	{
+		return m_MyBots;
+	}
+
+protected:
+	LegacyBotPtrs m_MyBots;
+	LegacyBotPtrs m_EnemyBots;
+	std::map<int, LegacyBotPtr> m_AllBots;
+	std::vector<int> m_PresentIDs;
+
+
+	void removeMissing(LegacyBotPtrs & a_Bots)
+	{
+		for (auto itr = a_Bots.begin(); itr != a_Bots.end();)
+		{
+			if (std::find(m_PresentIDs.begin(), m_PresentIDs.end(), (*itr)->m_ID) == m_PresentIDs.end())
+			{
+				itr = a_Bots.erase(itr);
+			}
+			else
+			{
+				++itr;
+			}
+		}
+	}
+};
+
+
+
+
+
+/** Generates a game with the specified number of bots per player and updates.
+Each bot dies at a random update, so that about half of them die before the game ends. */
+static void generateScenario(int a_NumBotsPerPlayer, int a_NumUpdates, Scenario & a_Scenario)
+{
+	std::mt19937 random(static_cast<UInt32>(a_NumBotsPerPlayer));
+	std::uniform_real_distribution<double> coord(0, 1000);
+	std::uniform_real_distribution<double> angle(-180, 180);
+	std::uniform_int_distribution<int> deathUpdate(1, 2 * a_NumUpdates);
+
+	a_Scenario.m_NumBotsPerPlayer = a_NumBotsPerPlayer;
+	a_Scenario.m_StartBots.clear();
+	std::vector<int> deathUpdates;
+	for (int i = 0; i < 2 * a_NumBotsPerPlayer; i++)
+	{
+		a_Scenario.m_StartBots.push_back({i + 1, coord(random), coord(random), 10, angle(random)});
+		deathUpdates.push_back(deathUpdate(random));
+	}
+
+	a_Scenario.m_Reports.clear();
+	a_Scenario.m_UpdateStarts.clear();
+	for (int upd = 0; upd < a_NumUpdates; upd++)
+	{
+		a_Scenario.m_UpdateStarts.push_back(a_Scenario.m_Reports.size());
+		for (size_t i = 0; i < deathUpdates.size(); i++)
+		{
+			if (deathUpdates[i] > upd)
+			{
+				auto rep = a_Scenario.m_StartBots[i];
+				rep.m_X = coord(random);
+				rep.m_Y = coord(random);
+				rep.m_Angle = angle(random);
+				a_Scenario.m_Reports.push_back(rep);
+			}
+		}
+	}
+	a_Scenario.m_UpdateStarts.push_back(a_Scenario.m_Reports.size());
+}
+
+
+
+
+
+/** Plays the scenario on the legacy board. Returns the checksum of the deaths: each update's died IDs sum, multiplied by the update number. */
+static Int64 playLegacy(const Scenario & a_Scenario, LegacyBoard & a_Board)
+{
+	a_Board.initialize(a_Scenario);
+	Int64 checksum = 0;
+	const BotReport * reports = a_Scenario.m_Reports.data();
+	for (size_t upd = 0; upd + 1 < a_Scenario.m_UpdateStarts.size(); upd++)
+	{
+		checksum += static_cast<Int64>(upd + 1) * a_Board.update(reports + a_Scenario.m_UpdateStarts[upd], reports + a_Scenario.m_UpdateStarts[upd + 1]);
+		checksum += static_cast<Int64>(a_Board.getMyBotsCopy().size());
+	}
+	return checksum;
+}
+
+
+
+
+
+/** Plays the scenario on the BotTable. Returns the checksum of the deaths, same as playLegacy(). */
+static Int64 playBotTable(const Scenario & a_Scenario, BotTable & a_Table, Bots & a_MyBots)
+{
+	a_Table.clear();
+	for (size_t i = 0; i < a_Scenario.m_StartBots.size(); i++)
+	{
+		auto & rep = a_Scenario.m_StartBots[i];
+		a_Table.add(rep.m_ID, (static_cast<int>(i) >= a_Scenario.m_NumBotsPerPlayer), rep.m_X, rep.m_Y, rep.m_Speed, rep.m_Angle);
+	}
+	Int64 checksum = 0;
+	const BotReport * reports = a_Scenario.m_Reports.data();
+	for (size_t upd = 0; upd + 1 < a_Scenario.m_UpdateStarts.size(); upd++)
+	{
+		a_Table.beginUpdate();
+		for (auto rep = reports + a_Scenario.m_UpdateStarts[upd], end = reports + a_Scenario.m_UpdateStarts[upd + 1]; rep != end; ++rep)
+		{
+			a_Table.update(rep->m_ID, rep->m_X, rep->m_Y, rep->m_Speed, rep->m_Angle);
+		}
+		Int64 diedIDs = 0;
+		a_Table.removeUnreported([&diedIDs](const Bot & a_Bot)
+			{
+				diedIDs += a_Bot.m_ID;
+			}
+		);
+		checksum += static_cast<Int64>(upd + 1) * diedIDs;
+		a_MyBots.clear();
+		a_Table.appendAliveBots(a_MyBots, false);
+		checksum += static_cast<Int64>(a_MyBots.size());
+	}
+	return checksum;
+}
+
+
+
+
+
+int benchBots(const AStringVector & a_Args)
+{
+	int maxBots = 10000;
+	int numUpdates = 50;
+	int numRounds = 2000;
+	for (auto & arg: a_Args)
+	{
+		if (
+			!parseIntArg(arg, "/maxbots=", maxBots) &&
+			!parseIntArg(arg, "/updates=", numUpdates) &&
+			!parseIntArg(arg, "/rounds=", numRounds)
+		)
+		{
+			LOGERROR("Unknown parameter: %s", arg.c_str());
+			return 2;
+		}
+	}
+	if ((maxBots <= 0) || (numUpdates <= 0) || (numRounds <= 0))
+	{
+		LOGERROR("All the parameters need to be positive.");
+		return 2;
+	}
+	if (maxBots > BotTable::MAX_ID_RANGE / 2)
+	{
+		LOGERROR("The number of bots cannot exceed %d.", BotTable::MAX_ID_RANGE / 2);
+		return 2;
+	}
+
+	// Measure each bot count, from the competition's 5 per player up to the maximum, in multiples of 10:
+	LOG("Storing the bots and detecting their deaths, %d updates per game; the number of games decreases with the bot count", numUpdates);
+	LegacyBoard legacyBoard;
+	BotTable table;
+	Bots myBots;
+	Scenario scenario;
+	for (auto numBots: getBotCounts(10, 10, maxBots))
+	{
+		int numBotsPerPlayer = std::max(numBots / 2, 1);
+		int numGames = std::max(static_cast<int>(static_cast<Int64>(numRounds) * 10 / numBots), 1);
+		generateScenario(numBotsPerPlayer, numUpdates, scenario);
+
+		// Check that both ways detect the same deaths:
+		Int64 legacyChecksum = playLegacy(scenario, legacyBoard);
+		if (playBotTable(scenario, table, myBots) != legacyChecksum)
+		{
+			LOGERROR("The bots' deaths differ for %d bots.", numBotsPerPlayer * 2);
+			return 1;
+		}
+
+		// The original way, map, shared pointers and searching the reported IDs:
+		Int64 checksum = 0;
+		auto startTime = std::chrono::high_resolution_clock::now();
+		for (int game = 0; game < numGames; game++)
+		{
+			checksum += playLegacy(scenario, legacyBoard);
+		}
+		double legacyNSec = nsecSince(startTime);
+
+		// The BotTable way:
+		startTime = std::chrono::high_resolution_clock::now();
+		for (int game = 0; game < numGames; game++)
+		{
+			checksum -= playBotTable(scenario, table, myBots);
+		}
+		double tableNSec = nsecSince(startTime);
+		if (checksum != 0)
+		{
+			LOGERROR("The bots' deaths differ for %d bots.", numBotsPerPlayer * 2);
+			return 1;
+		}
+
+		// Report:
+		double totalUpdates = static_cast<double>(numGames) * numUpdates;
+		LOG("  %6d bots, %6d games: map + find: %12.1f ns per update, BotTable: %10.1f ns per update (%.1f x faster)",
+			numBotsPerPlayer * 2, numGames, legacyNSec / totalUpdates, tableNSec / totalUpdates, legacyNSec / tableNSec
+		);
+	}
+	return 0;
+}
+
+
+
+
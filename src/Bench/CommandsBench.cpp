@@ -0,0 +1,281 @@
+
+// CommandsBench.cpp
+
+// Implements the benchmark comparing the serialization of the bot commands using jsoncpp and using CommandSerializer
+
+#include "Globals.h"
+#include "Benchmarks.h"
+#include <random>
+#include <fstream>
+#include "json/json.h"
+#include "CommandSerializer.h"
+
+
+
+
+
+/** Serializes the commands the original way, replicating the former Comm::sendCommands() and Comm::send(). */
+static AString serializeLegacy(int a_CmdId, const BotCommands & a_Commands)
+{
+	Json::Value bots(Json::arrayValue);
+	for (const auto & cmd: a_Commands)
+	{
+		Json::Value val;
+		val["cmd"] = cmd.m_Cmd;
+		if (cmd.m_HasAngle)
+		{
+			val["angle"] = cmd.m_Angle;
+		}
+		val["id"] = cmd.m_BotID;
+		bots.append(val);
+	}
+	Json::Value cmds;
+	cmds["cmdId"] = a_CmdId;
+	cmds["bots"] = bots;
+	Json::StreamWriterBuilder wr;
+	wr.settings_["indentation"] = "";
+	wr.settings_["commentStyle"] = "None";
+	return Json::writeString(wr, cmds) + "\n";
+}
+
+
+
+
+
+/** Generates a random batch of commands for the specified number of bots.
+Mostly the usual commands and angles, with an occasional unusual value to exercise the special cases. */
+static void generateCommands(std::mt19937 & a_Random, int a_NumBots, BotCommands & a_Commands)
+{
+	static const char * unusualCmds[] =
+	{
+		"",
+		"say \"hi\"",
+		"back\\slash",
+		"tab\there",
+		"new\nline",
+		"\x01\x1f",
+		"del\x7f",
+		"\xc3\xbc\xc5\x88\xc3\xad",  // UTF-8
+		"\xff\xfe",  // Invalid UTF-8
+		"slash/",
+	};
+	static const double unusualAngles[] =
+	{
+		0,
+		-0.0,
+		1e-300,
+		-1e300,
+		1e21,
+		123456789012345678.0,
+		5e-324,
+		std::numeric_limits<double>::quiet_NaN(),
+		std::numeric_limits<double>::infinity(),
+		-std::numeric_limits<double>::infinity(),
+	};
+	static const char * usualCmds[] = { "accelerate", "brake", "steer" };
+
+	a_Commands.clear();
+	std::uniform_int_distribution<int> percent(0, 99);
+	std::uniform_real_distribution<double> angle(-180, 180);
+	for (int id = 1; id <= a_NumBots; id++)
+	{
+		// Some bots don't get a command at all:
+		if (percent(a_Random) < 20)
+		{
+			continue;
+		}
+		a_Commands.emplace_back(id);
+		auto & cmd = a_Commands.back();
+		bool isUnusual = (percent(a_Random) < 2);
+		cmd.m_Cmd = isUnusual ? unusualCmds[a_Random() % ARRAYCOUNT(unusualCmds)] : usualCmds[a_Random() % ARRAYCOUNT(usualCmds)];
+		if ((cmd.m_Cmd == "steer") || isUnusual)
+		{
+			cmd.m_HasAngle = true;
+			switch (percent(a_Random) / 25)
+			{
+				case 0:  cmd.m_Angle = static_cast<int>(angle(a_Random)); break;  // Whole degrees
+				case 1:  cmd.m_Angle = static_cast<int>(angle(a_Random) * 4) / 4.0; break;  // Quarter degrees
+				case 2:  cmd.m_Angle = unusualAngles[a_Random() % ARRAYCOUNT(unusualAngles)]; break;
+				default: cmd.m_Angle = angle(a_Random); break;
+			}
+		}
+	}
+}
+
+
+
+
+
+/** Checks the serializer against the commands recorded in the specified .ebwlog file.
+Returns the number of messages checked, or -1 on failure. */
+static int checkRecordedCommands(const AString & a_FileName)
+{
+	std::ifstream f(a_FileName.c_str(), std::ios::binary);
+	char header[8];
+	if (!f.read(header, sizeof(header)) || (memcmp(header, "EBWLog\x00\x02", sizeof(header)) != 0))
+	{
+		LOGERROR("Cannot read the log file %s, or it is not an .ebwlog file", a_FileName.c_str());
+		return -1;
+	}
+
+	// Read all the records, check each outgoing commands message:
+	CommandSerializer serializer;
+	BotCommands commands;
+	int numChecked = 0;
+	while (true)
+	{
+		Byte recordHeader[13];  // 8-byte timestamp, 1-byte kind, 4-byte length
+		if (!f.read(reinterpret_cast<char *>(recordHeader), sizeof(recordHeader)))
+		{
+			break;
+		}
+		UInt32 len = (static_cast<UInt32>(recordHeader[9]) << 24) | (recordHeader[10] << 16) | (recordHeader[11] << 8) | recordHeader[12];
+		AString data(len, '\0');
+		if (!f.read(&data[0], len))
+		{
+			break;
+		}
+		if (recordHeader[8] != 5)  // Only outgoing data is interesting
+		{
+			continue;
+		}
+
+		// Parse the recorded message into the commands:
+		Json::Value root;
+		Json::Reader reader;
+		if (!reader.parse(data, root, false) || !root.isMember("bots"))
+		{
+			continue;
+		}
+		commands.clear();
+		for (const auto & bot: root["bots"])
+		{
+			commands.emplace_back(bot["id"].asInt());
+			auto & cmd = commands.back();
+			cmd.m_Cmd = bot["cmd"].asString();
+			cmd.m_HasAngle = bot.isMember("angle");
+			cmd.m_Angle = cmd.m_HasAngle ? bot["angle"].asDouble() : 0;
+		}
+
+		// Serialize back and compare with the original:
+		auto & serialized = serializer.serialize(root["cmdId"].asInt(), commands);
+		if (serialized != data)
+		{
+			LOGERROR("The serialized commands differ from the recorded ones.\n  Recorded:   %s  Serialized: %s", data.c_str(), serialized.c_str());
+			return -1;
+		}
+		numChecked += 1;
+	}
+	return numChecked;
+}
+
+
+
+
+
+int benchCommands(const AStringVector & a_Args)
+{
+	int numMessages = 1000;
+	int numBots = 5;
+	int numRounds = 100;
+	AString logFileName;
+	for (auto & arg: a_Args)
+	{
+		if (NoCaseCompare(arg.substr(0, 5), "/log=") == 0)
+		{
+			logFileName = arg.substr(5);
+			continue;
+		}
+		if (
+			!parseIntArg(arg, "/messages=", numMessages) &&
+			!parseIntArg(arg, "/bots=", numBots) &&
+			!parseIntArg(arg, "/rounds=", numRounds)
+		)
+		{
+			LOGERROR("Unknown parameter: %s", arg.c_str());
+			return 2;
+		}
+	}
+	if ((numMessages <= 0) || (numBots <= 0) || (numRounds <= 0))
+	{
+		LOGERROR("All the parameters need to be positive.");
+		return 2;
+	}
+
+	// Check against the recorded traffic, if requested:
+	if (!logFileName.empty())
+	{
+		int numChecked = checkRecordedCommands(logFileName);
+		if (numChecked < 0)
+		{
+			return 1;
+		}
+		LOG("%d recorded commands messages serialized identically", numChecked);
+	}
+
+	// Generate the commands:
+	std::mt19937 random(0);
+	std::vector<BotCommands> messages(static_cast<size_t>(numMessages));
+	for (auto & msg: messages)
+	{
+		generateCommands(random, numBots, msg);
+	}
+	LOG("Serializing %d commands messages, %d bots, %d rounds", numMessages, numBots, numRounds);
+
+	// Check that both ways produce the same output:
+	CommandSerializer serializer;
+	size_t totalSize = 0;
+	for (size_t i = 0; i < messages.size(); i++)
+	{
+		int cmdId = static_cast<int>(i) * 7919 - 1000;  // Include negative cmdIds, too
+		auto legacy = serializeLegacy(cmdId, messages[i]);
+		auto & serialized = serializer.serialize(cmdId, messages[i]);
+		if (serialized != legacy)
+		{
+			LOGERROR("The serialized commands differ.\n  jsoncpp:           %s  CommandSerializer: %s", legacy.c_str(), serialized.c_str());
+			return 1;
+		}
+		totalSize += legacy.size();
+	}
+
+	// The original way, Json DOM and StreamWriter:
+	size_t checksum = 0;
+	auto startTime = std::chrono::high_resolution_clock::now();
+	for (int round = 0; round < numRounds; round++)
+	{
+		int cmdId = 0;
+		for (auto & msg: messages)
+		{
+			checksum += serializeLegacy(++cmdId, msg).size();
+		}
+	}
+	double legacyNSec = nsecSince(startTime);
+
+	// The CommandSerializer way:
+	startTime = std::chrono::high_resolution_clock::now();
+	for (int round = 0; round < numRounds; round++)
+	{
+		int cmdId = 0;
+		for (auto & msg: messages)
+		{
+			checksum -= serializer.serialize(++cmdId, msg).size();
+		}
+	}
+	double serializerNSec = nsecSince(startTime);
+	if (checksum != 0)
+	{
+		LOGERROR("The serialized sizes differ");
+		return 1;
+	}
+
+	// Report:
+	double totalMessages = static_cast<double>(numMessages) * numRounds;
+	LOG("  Average message size: %.1f bytes", static_cast<double>(totalSize) / numMessages);
+	LOG("  Json::Value + StreamWriter: %8.1f ns per message", legacyNSec / totalMessages);
+	LOG("  CommandSerializer:          %8.1f ns per message (%.1f x faster)", serializerNSec / totalMessages, legacyNSec / serializerNSec);
+	return 0;
+}
+
+
+
+
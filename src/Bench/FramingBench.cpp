@@ -0,0 +1,199 @@
+
+// FramingBench.cpp
+
+// Implements the benchmark comparing the original line framing of the incoming data with the LineFramer class
+
+#include "Globals.h"
+#include "Benchmarks.h"
+#include "LineFramer.h"
+
+
+
+
+
+/** Accumulates a cheap checksum of the framed lines, so that both framing methods can be compared for equality
+and the compiler cannot optimize the framing away. */
+struct LineChecksum
+{
+	UInt64 m_NumLines;
+	UInt64 m_Sum;
+
+	LineChecksum(void):
+		m_NumLines(0),
+		m_Sum(0)
+	{
+	}
+
+	void add(const char * a_Line, size_t a_Length)
+	{
+		m_NumLines += 1;
+		m_Sum = m_Sum * 31 + a_Length;
+		if (a_Length > 0)
+		{
+			m_Sum += static_cast<Byte>(a_Line[0]) + static_cast<Byte>(a_Line[a_Length - 1]);
+		}
+	}
+};
+
+
+
+
+
+/** Replicates the original data path from the socket to Comm::processLine(), counting all the bytes copied on the way:
+cTCPLinkImpl::ReadCallback() read into a 1024-byte stack buffer, Callbacks::OnReceivedData() constructed an AString,
+Comm::onIncomingData() appended it to the queue, then took a substr() of each line and erase()-d the processed lines. */
+class LegacyFramer
+{
+public:
+	LegacyFramer(void):
+		m_NumBytesCopied(0)
+	{
+	}
+
+	/** Processes one read of the network data. */
+	void readCallback(const char * a_Data, size_t a_Length, LineChecksum & a_Checksum)
+	{
+		// cTCPLinkImpl::ReadCallback():
+		char data[1024];
+		for (size_t ofs = 0; ofs < a_Length; ofs += sizeof(data))
+		{
+			size_t len = std::min(sizeof(data), a_Length - ofs);
+			memcpy(data, a_Data + ofs, len);
+			m_NumBytesCopied += len;
+
+			// Callbacks::OnReceivedData():
+			AString str(data, len);
+			m_NumBytesCopied += len;
+			onIncomingData(str, a_Checksum);
+		}
+	}
+
+	UInt64 getNumBytesCopied(void) const { return m_NumBytesCopied; }
+
+protected:
+	AString m_QueuedData;
+	UInt64 m_NumBytesCopied;
+
+
+	/** Comm::onIncomingData(), as it was originally. */
+	void onIncomingData(const AString & a_Data, LineChecksum & a_Checksum)
+	{
+		auto queuedEnd = m_QueuedData.size();
+		m_QueuedData.append(a_Data);
+		m_NumBytesCopied += a_Data.size();
+		auto dataLen = m_QueuedData.size();
+		size_t lineStart = 0;
+		for (auto i = queuedEnd; i < dataLen; i++)
+		{
+			if (m_QueuedData[i] == '\n')
+			{
+				AString line = m_QueuedData.substr(lineStart, i - lineStart);
+				m_NumBytesCopied += line.size();
+				a_Checksum.add(line.data(), line.size());
+				lineStart = i + 1;
+			}
+		}  // for i - m_QueuedData[]
+		if (lineStart > 0)
+		{
+			m_QueuedData.erase(0, lineStart);
+			m_NumBytesCopied += m_QueuedData.size();
+		}
+	}
+};
+
+
+
+
+
+int benchFraming(const AStringVector & a_Args)
+{
+	int numMessages = 10000;
+	size_t chunkSize = 4096;
+	int numRounds = 10;
+	for (auto & arg: a_Args)
+	{
+		if (
+			!parseIntArg(arg, "/messages=", numMessages) &&
+			!parseIntArg(arg, "/chunk=", chunkSize) &&
+			!parseIntArg(arg, "/rounds=", numRounds)
+		)
+		{
+			LOGERROR("Unknown parameter: %s", arg.c_str());
+			return 2;
+		}
+	}
+	if ((numMessages <= 0) || (chunkSize == 0) || (numRounds <= 0))
+	{
+		LOGERROR("All the parameters need to be positive.");
+		return 2;
+	}
+
+	// The stream is cut into chunks of the specified size, as if each was one contiguous segment of the libevent's input buffer:
+	AString stream = generatePlayStream(numMessages, 0);
+	LOG("Framing %d \"play\" messages, %.1f bytes per message on average, in network reads of " SIZE_T_FMT " bytes, %d rounds",
+		numMessages, static_cast<double>(stream.size()) / numMessages, chunkSize, numRounds
+	);
+
+	// The original way:
+	LineChecksum legacyChecksum;
+	UInt64 legacyBytesCopied = 0;
+	auto startTime = std::chrono::high_resolution_clock::now();
+	for (int round = 0; round < numRounds; round++)
+	{
+		LegacyFramer framer;
+		for (size_t ofs = 0; ofs < stream.size(); ofs += chunkSize)
+		{
+			framer.readCallback(stream.data() + ofs, std::min(chunkSize, stream.size() - ofs), legacyChecksum);
+		}
+		legacyBytesCopied += framer.getNumBytesCopied();
+	}
+	double legacyNSec = nsecSince(startTime);
+
+	// The LineFramer way:
+	LineChecksum framerChecksum;
+	UInt64 framerBytesCopied = 0;
+	startTime = std::chrono::high_resolution_clock::now();
+	for (int round = 0; round < numRounds; round++)
+	{
+		LineFramer framer;
+		for (size_t ofs = 0; ofs < stream.size(); ofs += chunkSize)
+		{
+			framer.process(stream.data() + ofs, std::min(chunkSize, stream.size() - ofs), [&framerChecksum](const char * a_Line, size_t a_Length)
+				{
+					framerChecksum.add(a_Line, a_Length);
+					return true;
+				}
+			);
+		}
+		framerBytesCopied += framer.getNumBytesCopied();
+	}
+	double framerNSec = nsecSince(startTime);
+
+	// Report:
+	double totalMessages = static_cast<double>(numMessages) * numRounds;
+	double totalBytes = static_cast<double>(stream.size()) * numRounds;
+	LOG("  original:    %9.1f bytes copied per message (%.2f x the message size), %8.1f ns per message",
+		legacyBytesCopied / totalMessages, legacyBytesCopied / totalBytes, legacyNSec / totalMessages
+	);
+	LOG("  LineFramer:  %9.1f bytes copied per message (%.2f x the message size), %8.1f ns per message",
+		framerBytesCopied / totalMessages, framerBytesCopied / totalBytes, framerNSec / totalMessages
+	);
+
+	// Check that both ways produced the same lines:
+	if (
+		(legacyChecksum.m_NumLines != framerChecksum.m_NumLines) ||
+		(legacyChecksum.m_Sum != framerChecksum.m_Sum) ||
+		(legacyChecksum.m_NumLines != static_cast<UInt64>(totalMessages))
+	)
+	{
+		LOGERROR("The framed lines differ! Original: %llu lines, LineFramer: %llu lines",
+			legacyChecksum.m_NumLines, framerChecksum.m_NumLines
+		);
+		return 1;
+	}
+	return 0;
+}
+
+
+
+
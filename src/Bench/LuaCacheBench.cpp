@@ -0,0 +1,242 @@
+
+// LuaCacheBench.cpp
+
+// Implements the benchmark comparing the Lua controller load times without the chunk cache, and with a cold and a warm LuaChunkCache
+
+#include "Globals.h"
+#include "Benchmarks.h"
+#include "LuaChunkCache.h"
+
+#ifndef _WIN32
+	#include <unistd.h>
+#endif
+
+
+
+
+
+/** The folder into which the benchmark's scripts are generated. */
+static const char g_ScriptFolder[] = "LuaCacheBench";
+
+/** The folder of the chunk cache used by the benchmark. */
+static const char g_CacheFolder[] = "LuaCacheBench/cache";
+
+
+
+
+
+/** Writes a_Contents into the specified file. Returns true on success. */
+static bool writeFile(const AString & a_FileName, const AString & a_Contents)
+{
+	FILE * f = fopen(a_FileName.c_str(), "wb");
+	if (f == nullptr)
+	{
+		LOGERROR("Cannot write file %s", a_FileName.c_str());
+		return false;
+	}
+	bool res = (fwrite(a_Contents.data(), 1, a_Contents.size(), f) == a_Contents.size());
+	res = (fclose(f) == 0) && res;
+	if (!res)
+	{
+		LOGERROR("Cannot write file %s", a_FileName.c_str());
+	}
+	return res;
+}
+
+
+
+
+
+/** Removes the specified (empty) folder. */
+static void removeFolder(const AString & a_Folder)
+{
+	#ifdef _WIN32
+		RemoveDirectoryA(a_Folder.c_str());
+	#else
+		rmdir(a_Folder.c_str());
+	#endif
+}
+
+
+
+
+
+/** Loads the controller script, which requires the module, into a new Lua state, through a_ChunkCache if given.
+a_LoadNSec receives the time taken to load (and run) the script, a_Checksum receives the result of its checksum() function,
+for checking that all the modes load the same code.
+Returns false on a Lua error. */
+static bool loadController(const AString & a_MainFileName, LuaChunkCache * a_ChunkCache, double & a_LoadNSec, double & a_Checksum)
+{
+	LuaState state("LuaCacheBench");
+	state.create();
+	AString packagePath = Printf("package.path = \"%s/?.lua\"", g_ScriptFolder);
+	state.execCode(packagePath.c_str());
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+	if (a_ChunkCache != nullptr)
+	{
+		a_ChunkCache->installLoader(state);
+	}
+	if (!state.loadFile(a_MainFileName, a_ChunkCache))
+	{
+		return false;
+	}
+	a_LoadNSec = nsecSince(startTime);
+
+	lua_getfield(state, LUA_GLOBALSINDEX, "checksum");
+	if (lua_pcall(state, 0, 1, 0) != 0)
+	{
+		LOGERROR("Lua error in the checksum function: %s", lua_tostring(state, -1));
+		return false;
+	}
+	a_Checksum = lua_tonumber(state, -1);
+	lua_pop(state, 1);
+	return true;
+}
+
+
+
+
+
+/** Measures the load times without the cache, with the cold cache and with the warm cache, and checks that all of them load the same code.
+Returns true on success, false on a Lua error or if the results differ. */
+static bool measureLoads(const AString & a_MainFileName, LuaChunkCache & a_Cache, int a_NumRepeats)
+{
+	// The original: compiled from the source on each load:
+	double noCacheNSec = 0, noCacheChecksum = 0;
+	for (int i = 0; i < a_NumRepeats; i++)
+	{
+		double loadNSec;
+		if (!loadController(a_MainFileName, nullptr, loadNSec, noCacheChecksum))
+		{
+			return false;
+		}
+		noCacheNSec += loadNSec;
+	}
+
+	// The cold start: compiled from the source and stored into the cache:
+	double coldNSec = 0, coldChecksum = 0;
+	a_Cache.clearStats();
+	if (!loadController(a_MainFileName, &a_Cache, coldNSec, coldChecksum))
+	{
+		return false;
+	}
+	LOG("  cold start: %s", a_Cache.getStatsString().c_str());
+
+	// The warm starts: loaded from the cache:
+	double warmNSec = 0, warmChecksum = 0;
+	a_Cache.clearStats();
+	for (int i = 0; i < a_NumRepeats; i++)
+	{
+		double loadNSec;
+		if (!loadController(a_MainFileName, &a_Cache, loadNSec, warmChecksum))
+		{
+			return false;
+		}
+		warmNSec += loadNSec;
+	}
+	LOG("  warm starts: %s", a_Cache.getStatsString().c_str());
+
+	LOG("  %-28s %10.2f msec per load", "no cache:", noCacheNSec / a_NumRepeats / 1e6);
+	LOG("  %-28s %10.2f msec", "cold cache (compile + store):", coldNSec / 1e6);
+	LOG("  %-28s %10.2f msec per load", "warm cache:", warmNSec / a_NumRepeats / 1e6);
+
+	if ((a_Cache.getNumMisses() != 0) || (a_Cache.getNumHits() != 2 * a_NumRepeats))
+	{
+		LOGERROR("The warm starts weren't served from the cache: %d hits, %d misses", a_Cache.getNumHits(), a_Cache.getNumMisses());
+		return false;
+	}
+	if ((noCacheChecksum != coldChecksum) || (noCacheChecksum != warmChecksum))
+	{
+		LOGERROR("The loaded code differs between the modes: %f, %f, %f", noCacheChecksum, coldChecksum, warmChecksum);
+		return false;
+	}
+	return true;
+}
+
+
+
+
+
+int benchLuaCache(const AStringVector & a_Args)
+{
+	int numFunctions = 5000;
+	int numRepeats = 10;
+	for (auto & arg: a_Args)
+	{
+		if (
+			!parseIntArg(arg, "/functions=", numFunctions) &&
+			!parseIntArg(arg, "/repeat=", numRepeats)
+		)
+		{
+			LOGERROR("Unknown parameter: %s", arg.c_str());
+			return 2;
+		}
+	}
+	if ((numFunctions <= 0) || (numRepeats <= 0))
+	{
+		LOGERROR("All the parameters need to be positive.");
+		return 2;
+	}
+
+	// Generate the scripts: a controller that requires a large module.
+	// The run marker makes the sources unique to this run, so that the cold start is really cold:
+	auto runMarker = std::chrono::system_clock::now().time_since_epoch().count();
+	AString module = Printf("-- LuaCacheBench module, run %lld\nlocal M = {}\n\n", static_cast<long long>(runMarker));
+	for (int i = 1; i <= numFunctions; i++)
+	{
+		AppendPrintf(module,
+			"function M.f%d(a_X)\n"
+			"	local res = {x = a_X * %d, y = math.floor(a_X / %d)}\n"
+			"	return res.x + res.y + %d\n"
+			"end\n\n",
+			i, i, i, i
+		);
+	}
+	module.append("return M\n");
+	AString main = Printf(
+		"-- LuaCacheBench controller, run %lld\n"
+		"local big = require(\"big\")\n"
+		"\n"
+		"function checksum()\n"
+		"	local sum = 0\n"
+		"	for i = 1, %d do\n"
+		"		sum = sum + big[\"f\" .. i](i)\n"
+		"	end\n"
+		"	return sum\n"
+		"end\n",
+		static_cast<long long>(runMarker), numFunctions
+	);
+	#ifdef _WIN32
+		CreateDirectoryA(g_ScriptFolder, nullptr);
+	#else
+		mkdir(g_ScriptFolder, S_IRWXU | S_IRWXG | S_IRWXO);
+	#endif
+	AString mainFileName = Printf("%s/main.lua", g_ScriptFolder);
+	AString moduleFileName = Printf("%s/big.lua", g_ScriptFolder);
+	if (!writeFile(mainFileName, main) || !writeFile(moduleFileName, module))
+	{
+		return 1;
+	}
+
+	LOG("Loading a controller that requires a module of %d functions (%d KiB of source), %d times",
+		numFunctions, static_cast<int>((main.size() + module.size()) / 1024), numRepeats
+	);
+
+	LuaChunkCache cache;
+	cache.setFolder(g_CacheFolder);
+	int res = measureLoads(mainFileName, cache, numRepeats) ? 0 : 1;
+
+	// Clean up:
+	remove(cache.getCacheFileName(mainFileName, main).c_str());
+	remove(cache.getCacheFileName(moduleFileName, module).c_str());
+	remove(mainFileName.c_str());
+	remove(moduleFileName.c_str());
+	removeFolder(g_CacheFolder);
+	removeFolder(g_ScriptFolder);
+	return res;
+}
+
+
+
+
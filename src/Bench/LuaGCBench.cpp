@@ -0,0 +1,172 @@
+
+// LuaGCBench.cpp
+
+// Implements the benchmark comparing the Lua callback latencies with the default allocator and GC, and with LuaMemory
+
+#include "Globals.h"
+#include "Benchmarks.h"
+#include "LuaMemory.h"
+
+
+
+
+
+/** The Lua code of the benchmarked callback, producing garbage the way a typical controller does:
+a new command table for each bot, some temporary vectors and a formatted log string. Returns a checksum of the work done. */
+static const char g_LuaCode[] =
+	"keep = {}\n"
+	"for i = 1, 20000 do keep[i] = {i, tostring(i)} end\n"
+	"\n"
+	"function onTick(tick, numBots)\n"
+	"	local commands = {}\n"
+	"	local sum = 0\n"
+	"	for id = 1, numBots do\n"
+	"		local dir = {x = math.cos(id + tick), y = math.sin(id + tick)}\n"
+	"		local target = {x = dir.x * 100 + id, y = dir.y * 100 + tick}\n"
+	"		commands[id] = {cmd = \"steer\", angle = (target.x + target.y) % 90}\n"
+	"		sum = sum + commands[id].angle\n"
+	"	end\n"
+	"	local msg = string.format(\"tick %d: %d commands, sum %.3f\", tick, numBots, sum)\n"
+	"	return sum + #msg\n"
+	"end\n";
+
+
+
+
+
+/** Runs the callback for a_NumTicks ticks in the specified state, and reports its latencies.
+If a_Memory is given, its collector is stopped and stepped in the slack of a_SlackMSec after each tick.
+a_Checksum receives the sum of the callback's results, for checking that all the modes do the same work.
+Returns false on a Lua error. */
+static bool runTicks(
+	const char * a_ModeName, lua_State * a_LuaState, LuaMemory * a_Memory, int a_SlackMSec,
+	int a_NumTicks, int a_NumBots, double & a_Checksum
+)
+{
+	if (a_Memory != nullptr)
+	{
+		lua_gc(a_LuaState, LUA_GCCOLLECT, 0);
+		a_Memory->stopCollector(a_LuaState);
+	}
+
+	std::vector<double> latencies;
+	latencies.reserve(static_cast<size_t>(a_NumTicks));
+	double slackNSec = 0;
+	int peakKiB = 0;
+	a_Checksum = 0;
+	for (int tick = 0; tick < a_NumTicks; tick++)
+	{
+		// The latency-critical callback:
+		auto startTime = std::chrono::high_resolution_clock::now();
+		lua_getfield(a_LuaState, LUA_GLOBALSINDEX, "onTick");
+		lua_pushnumber(a_LuaState, tick);
+		lua_pushnumber(a_LuaState, a_NumBots);
+		if (lua_pcall(a_LuaState, 2, 1, 0) != 0)
+		{
+			LOGERROR("Lua error in %s mode: %s", a_ModeName, lua_tostring(a_LuaState, -1));
+			return false;
+		}
+		a_Checksum += lua_tonumber(a_LuaState, -1);
+		lua_pop(a_LuaState, 1);
+		latencies.push_back(nsecSince(startTime) / 1000);
+
+		// The slack after the commands are sent:
+		if (a_Memory != nullptr)
+		{
+			startTime = std::chrono::high_resolution_clock::now();
+			a_Memory->collectInSlack(a_LuaState, std::chrono::milliseconds(a_SlackMSec));
+			slackNSec += nsecSince(startTime);
+		}
+		peakKiB = std::max(peakKiB, lua_gc(a_LuaState, LUA_GCCOUNT, 0));
+	}
+
+	std::sort(latencies.begin(), latencies.end());
+	LOG("  %-26s callback p50 %8.1f us, p90 %8.1f us, p99 %8.1f us, max %8.1f us; slack GC avg %8.1f us; peak memory %6d KiB",
+		a_ModeName,
+		percentile(latencies, 50), percentile(latencies, 90), percentile(latencies, 99), latencies.back(),
+		slackNSec / a_NumTicks / 1000, peakKiB
+	);
+	return true;
+}
+
+
+
+
+
+int benchLuaGC(const AStringVector & a_Args)
+{
+	int numTicks = 2000;
+	int numBots = 500;
+	int slackMSec = 2;
+	for (auto & arg: a_Args)
+	{
+		if (
+			!parseIntArg(arg, "/ticks=", numTicks) &&
+			!parseIntArg(arg, "/bots=", numBots) &&
+			!parseIntArg(arg, "/slack=", slackMSec)
+		)
+		{
+			LOGERROR("Unknown parameter: %s", arg.c_str());
+			return 2;
+		}
+	}
+	if ((numTicks <= 0) || (numBots <= 0) || (slackMSec <= 0))
+	{
+		LOGERROR("All the parameters need to be positive.");
+		return 2;
+	}
+
+	LOG("Running a garbage-producing callback for %d bots in %d ticks, with the GC in the slack limited to %d msec per tick",
+		numBots, numTicks, slackMSec
+	);
+
+	// The original: the default allocator, the GC runs whenever it wants, possibly within the callback:
+	double defaultChecksum;
+	{
+		LuaState state("LuaGCBench default");
+		state.create();
+		state.execCode(g_LuaCode);
+		if (!runTicks("default alloc, auto GC:", state, nullptr, 0, numTicks, numBots, defaultChecksum))
+		{
+			return 1;
+		}
+	}
+
+	// The pooled allocator alone:
+	double pooledChecksum;
+	{
+		LuaMemory memory;
+		LuaState state("LuaGCBench pooled");
+		state.create(&LuaMemory::alloc, &memory);
+		state.execCode(g_LuaCode);
+		if (!runTicks("pooled alloc, auto GC:", state, nullptr, 0, numTicks, numBots, pooledChecksum))
+		{
+			return 1;
+		}
+	}
+
+	// The pooled allocator with the GC only in the slack:
+	double slackChecksum;
+	{
+		LuaMemory memory;
+		LuaState state("LuaGCBench slack");
+		state.create(&LuaMemory::alloc, &memory);
+		state.execCode(g_LuaCode);
+		if (!runTicks("pooled alloc, slack GC:", state, &memory, slackMSec, numTicks, numBots, slackChecksum))
+		{
+			return 1;
+		}
+		LOG("  %s", memory.getStatsString().c_str());
+	}
+
+	if ((defaultChecksum != pooledChecksum) || (defaultChecksum != slackChecksum))
+	{
+		LOGERROR("The callback results differ between the modes: %f, %f, %f", defaultChecksum, pooledChecksum, slackChecksum);
+		return 1;
+	}
+	return 0;
+}
+
+
+
+
@@ -0,0 +1,142 @@
+
+// Main.cpp
+
+// Implements the main entrypoint of the benchmarks tool, and the helper functions shared by the benchmarks
+
+#include "Globals.h"  // NOTE: MSVC stupidness requires this to be the same across all modules
+
+#include "json/json.h"
+#include "Benchmarks.h"
+#include "Simulator/SimGame.h"
+
+
+
+
+
+/** All the benchmarks that can be run, by name. */
+static const struct
+{
+	const char * m_Name;
+	BenchmarkFn m_Fn;
+	const char * m_Description;
+} g_Benchmarks[] =
+{
+	{"approach", &benchApproach, "Pairwise time to the closest approach and minimum distance, scalar vs SIMD kernels, scaled up to many bots (/maxbots=N /rounds=N)"},
+	{"bots",     &benchBots,     "Storing the bots and detecting their deaths, map vs BotTable, scaled up to many bots (/maxbots=N /updates=N /rounds=N)"},
+	{"commands", &benchCommands, "Serializing the bot commands, jsoncpp vs CommandSerializer (/messages=N /bots=N /rounds=N /log=file.ebwlog)"},
+	{"framing",  &benchFraming,  "Splitting the incoming data into lines, bytes copied per message (/messages=N /chunk=N /rounds=N)"},
+	{"luacache", &benchLuaCache, "Lua controller load time, compiled from the source vs loaded through a cold and a warm LuaChunkCache (/functions=N /repeat=N)"},
+	{"luagc",    &benchLuaGC,    "Lua callback latency percentiles, default allocator and GC vs LuaMemory with the GC in the slack (/ticks=N /bots=N /slack=N)"},
+	{"play",     &benchPlay,     "Parse-to-board latency of the \"play\" messages, jsoncpp vs PlayParser (/messages=N /bots=N /rounds=N)"},
+	{"plugin",   &benchPlugin,   "Tick latency of the Chaser controller, native plugin vs the equivalent Lua script, scaled up to many bots (/maxbots=N /ticks=N /plugin=file /lua=file)"},
+	{"proxies",  &benchProxies,  "Updating and reading the bots in Lua, tables vs LuaBotProxies, scaled up to many bots (/maxbots=N /rounds=N)"},
+	{"spatial",  &benchSpatial,  "Finding the nearest enemy for each of my bots, Lua scan vs SpatialIndex, scaled up to many bots (/maxbots=N /rounds=N)"},
+};
+
+
+
+
+
+AString generatePlayStream(int a_NumMessages, UInt32 a_Seed)
+{
+	SimGame::Settings settings;
+	Json::StreamWriterBuilder wr;
+	wr.settings_["indentation"] = "";
+	wr.settings_["commentStyle"] = "None";
+	UniquePtr<SimGame> game(new SimGame(settings, "BenchPlayer", a_Seed));
+	AString res;
+	for (int i = 0; i < a_NumMessages; i++)
+	{
+		// Start a new game if the previous one has finished:
+		if (game->isFinished())
+		{
+			a_Seed += 1;
+			game.reset(new SimGame(settings, "BenchPlayer", a_Seed));
+		}
+		game->tick(100);
+		Json::Value msg;
+		msg["play"] = game->getPlayJson(i);
+		res.append(Json::writeString(wr, msg));
+		res.push_back('\n');
+	}
+	return res;
+}
+
+
+
+
+
+double nsecSince(std::chrono::high_resolution_clock::time_point a_Start)
+{
+	auto elapsed = std::chrono::high_resolution_clock::now() - a_Start;
+	return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
+
+
+
+
+
+double percentile(const std::vector<double> & a_Sorted, double a_Percentile)
+{
+	auto idx = static_cast<size_t>(a_Percentile / 100 * static_cast<double>(a_Sorted.size() - 1) + 0.5);
+	return a_Sorted[idx];
+}
+
+
+
+
+
+std::vector<int> getBotCounts(int a_First, int a_Factor, int a_Max)
+{
+	ASSERT(a_First > 0);
+	ASSERT(a_Factor > 1);
+	std::vector<int> res;
+	for (Int64 numBots = a_First; numBots < a_Max; numBots *= a_Factor)
+	{
+		res.push_back(static_cast<int>(numBots));
+	}
+	res.push_back(a_Max);
+	return res;
+}
+
+
+
+
+
+static void printUsage(const char * a_ProgramName)
+{
+	LOG("Usage: %s <benchmark> [options]", a_ProgramName);
+	LOG("Available benchmarks:");
+	for (auto & bench: g_Benchmarks)
+	{
+		LOG("  %s - %s", bench.m_Name, bench.m_Description);
+	}
+}
+
+
+
+
+
+int main(int argc, char ** argv)
+{
+	if (argc < 2)
+	{
+		printUsage(argv[0]);
+		return 2;
+	}
+	AStringVector args(argv + 2, argv + argc);
+	for (auto & bench: g_Benchmarks)
+	{
+		if (NoCaseCompare(argv[1], bench.m_Name) == 0)
+		{
+			return bench.m_Fn(args);
+		}
+	}
+	LOGERROR("Unknown benchmark: %s", argv[1]);
+	printUsage(argv[0]);
+	return 2;
+}
+
+
+
+
@@ -0,0 +1,160 @@
+
+// PlayBench.cpp
+
+// Implements the benchmark comparing the parse-to-board latency of the "play" messages, generic jsoncpp vs PlayParser
+
+#include "Globals.h"
+#include "Benchmarks.h"
+#include "json/json.h"
+#include "BotWarzApp.h"
+#include "Simulator/SimGame.h"
+
+
+
+
+
+/** Returns true if both boards contain the same bots with exactly the same values. */
+static bool areBoardsEqual(const Board & a_Board1, const Board & a_Board2)
+{
+	if (a_Board1.getServerTime() != a_Board2.getServerTime())
+	{
+		return false;
+	}
+	auto snapshot1 = a_Board1.getSnapshot();
+	auto snapshot2 = a_Board2.getSnapshot();
+	auto & bots1 = snapshot1->m_AllBots;
+	auto & bots2 = snapshot2->m_AllBots;
+	if (bots1.size() != bots2.size())
+	{
+		return false;
+	}
+	for (auto itr1 = bots1.begin(), itr2 = bots2.begin(), end = bots1.end(); itr1 != end; ++itr1, ++itr2)
+	{
+		auto & bot1 = *itr1;
+		auto & bot2 = *itr2;
+		if (
+			(bot1.m_ID != bot2.m_ID) ||
+			(bot1.m_X != bot2.m_X) ||
+			(bot1.m_Y != bot2.m_Y) ||
+			(bot1.m_Speed != bot2.m_Speed) ||
+			(bot1.m_Angle != bot2.m_Angle)
+		)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+
+
+
+int benchPlay(const AStringVector & a_Args)
+{
+	int numMessages = 1000;
+	int numBots = 5;
+	int numRounds = 20;
+	for (auto & arg: a_Args)
+	{
+		if (
+			!parseIntArg(arg, "/messages=", numMessages) &&
+			!parseIntArg(arg, "/bots=", numBots) &&
+			!parseIntArg(arg, "/rounds=", numRounds)
+		)
+		{
+			LOGERROR("Unknown parameter: %s", arg.c_str());
+			return 2;
+		}
+	}
+	if ((numMessages <= 0) || (numBots <= 0) || (numRounds <= 0))
+	{
+		LOGERROR("All the parameters need to be positive.");
+		return 2;
+	}
+
+	// Record a single long game; the bots have zero radius so that they don't die and the board stays fully populated:
+	SimGame::Settings settings;
+	settings.m_NumBotsPerPlayer = numBots;
+	settings.m_BotRadius = 0;
+	settings.m_GameLengthMSec = std::numeric_limits<int>::max();
+	SimGame game(settings, "BenchPlayer", 0);
+	Json::Value gameData = game.getGameJson();
+	Json::StreamWriterBuilder wr;
+	wr.settings_["indentation"] = "";
+	wr.settings_["commentStyle"] = "None";
+	AStringVector messages;
+	size_t totalSize = 0;
+	for (int i = 0; i < numMessages; i++)
+	{
+		game.tick(100);
+		Json::Value msg;
+		msg["play"] = game.getPlayJson(i);
+		messages.push_back(Json::writeString(wr, msg));
+		totalSize += messages.back().size();
+	}
+	LOG("Parsing %d \"play\" messages into the board, %d bots per player, %.1f bytes per message on average, %d rounds",
+		numMessages, numBots, static_cast<double>(totalSize) / numMessages, numRounds
+	);
+
+	// Check that both ways produce the same board, after each message:
+	BotWarzApp jsonApp("", "BenchPlayer", nullptr);
+	BotWarzApp parserApp("", "BenchPlayer", nullptr);
+	jsonApp.startGame(gameData);
+	parserApp.startGame(gameData);
+	for (auto & msg: messages)
+	{
+		Json::Value root;
+		Json::Reader reader;
+		reader.parse(msg, root, false);
+		jsonApp.updateBoard(root["play"]);
+		int lastCmdId;
+		if (
+			!parserApp.updateBoardFromPlayMessage(msg.data(), msg.size(), lastCmdId) ||
+			(lastCmdId != root["play"]["lastCmdId"].asInt()) ||
+			!areBoardsEqual(jsonApp.getBoard(), parserApp.getBoard())
+		)
+		{
+			LOGERROR("The boards differ after message %s", msg.c_str());
+			return 1;
+		}
+	}
+
+	// The generic way, Json DOM:
+	auto startTime = std::chrono::high_resolution_clock::now();
+	for (int round = 0; round < numRounds; round++)
+	{
+		jsonApp.startGame(gameData);
+		for (auto & msg: messages)
+		{
+			Json::Value root;
+			Json::Reader reader;
+			reader.parse(msg.data(), msg.data() + msg.size(), root, false);
+			jsonApp.updateBoard(root["play"]);
+		}
+	}
+	double jsonNSec = nsecSince(startTime);
+
+	// The PlayParser way:
+	startTime = std::chrono::high_resolution_clock::now();
+	for (int round = 0; round < numRounds; round++)
+	{
+		parserApp.startGame(gameData);
+		for (auto & msg: messages)
+		{
+			int lastCmdId;
+			parserApp.updateBoardFromPlayMessage(msg.data(), msg.size(), lastCmdId);
+		}
+	}
+	double parserNSec = nsecSince(startTime);
+
+	// Report:
+	double totalMessages = static_cast<double>(numMessages) * numRounds;
+	LOG("  jsoncpp + Board::updateFromJson():  %8.1f ns per message", jsonNSec / totalMessages);
+	LOG("  Board::updateFromPlayMessage():     %8.1f ns per message (%.1f x faster)", parserNSec / totalMessages, jsonNSec / parserNSec);
+	return 0;
+}
+
+
+
+
@@ -0,0 +1,243 @@
+
+// PluginBench.cpp
+
+// Implements the benchmark comparing the tick latency of a native controller plugin and of the equivalent Lua controller
+
+#include "Globals.h"
+#include <functional>
+#include "json/json.h"
+#include "Benchmarks.h"
+#include "BotWarzApp.h"
+#include "Controller.h"
+#include "LuaController.h"
+#include "PluginController.h"
+#include "Simulator/SimGame.h"
+
+
+
+
+
+/** The default location of the Chaser controller's Lua script, relative to the $/out folder. */
+static const char g_DefaultLuaFileName[] = "Controllers/Chaser/Main.lua";
+
+/** The default location of the Chaser plugin, relative to the $/out folder. */
+#ifdef _WIN32
+	static const char g_DefaultPluginFileName[] = "Controllers/Chaser/Chaser.dll";
+#else
+	static const char g_DefaultPluginFileName[] = "Controllers/Chaser/Chaser.so";
+#endif
+
+/** The nick under which the controllers play the simulated games. */
+static const char g_PlayerNick[] = "BenchPlayer";
+
+
+
+
+
+/** Creates the controller to be benchmarked, for the specified app. */
+typedef std::function<SharedPtr<Controller>(BotWarzApp &)> ControllerFactory;
+
+
+
+
+
+/** Plays a_NumTicks ticks of the simulated games with a_NumBots bots per player, driven by the controller created by a_Factory,
+feeding its commands back into the games, and reports the controller's tick latency (onGameUpdate() and getBotCommands()).
+a_AllCommands receives all the commands returned by the controller, for comparing the controllers;
+a_AvgNSec receives the average tick latency. Returns false if the controller cannot be created. */
+static bool playGames(
+	const char * a_ModeName, ControllerFactory a_Factory, int a_NumBots, int a_NumTicks,
+	BotCommands & a_AllCommands, double & a_AvgNSec
+)
+{
+	BotWarzApp app("", g_PlayerNick, nullptr);
+	auto controller = a_Factory(app);
+	if ((controller == nullptr) || !controller->isValid())
+	{
+		LOGERROR("Cannot create the %s controller.", a_ModeName);
+		return false;
+	}
+	app.setController(controller);  // The bots' deaths on the board are reported to the controller through the app
+
+	// Start the first game; the games are repeatable, so both controllers play the same games as long as they send the same commands:
+	SimGame::Settings settings;
+	settings.m_NumBotsPerPlayer = a_NumBots;
+	UInt32 seed = 0;
+	UniquePtr<SimGame> game(new SimGame(settings, g_PlayerNick, seed));
+	Board board(app);
+	board.initialize(game->getGameJson());
+	controller->onGameStarted(board);
+
+	std::vector<double> latencies;
+	latencies.reserve(static_cast<size_t>(a_NumTicks));
+	BotCommands commands;
+	a_AllCommands.clear();
+	for (int tick = 0; tick < a_NumTicks; tick++)
+	{
+		// Start a new game if the previous one has finished:
+		if (game->isFinished())
+		{
+			controller->onGameFinished();
+			seed += 1;
+			game.reset(new SimGame(settings, g_PlayerNick, seed));
+			board.initialize(game->getGameJson());
+			controller->onGameStarted(board);
+		}
+
+		// Update the board (not measured):
+		game->tick(100);
+		board.updateFromJson(game->getPlayJson(tick));
+
+		// The latency-critical path of the controller:
+		auto startTime = std::chrono::high_resolution_clock::now();
+		controller->onGameUpdate();
+		controller->getBotCommands(commands);
+		latencies.push_back(nsecSince(startTime) / 1000);
+		controller->onCommandsSent();
+
+		// Send the commands to the game:
+		Json::Value bots(Json::arrayValue);
+		for (auto & cmd: commands)
+		{
+			Json::Value c;
+			c["id"] = cmd.m_BotID;
+			c["cmd"] = cmd.m_Cmd;
+			if (cmd.m_HasAngle)
+			{
+				c["angle"] = cmd.m_Angle;
+			}
+			bots.append(c);
+		}
+		game->queueCommands(bots);
+		a_AllCommands.insert(a_AllCommands.end(), commands.begin(), commands.end());
+	}  // for tick
+	controller->onGameFinished();
+
+	a_AvgNSec = 0;
+	for (auto latency: latencies)
+	{
+		a_AvgNSec += latency * 1000;
+	}
+	a_AvgNSec /= a_NumTicks;
+	std::sort(latencies.begin(), latencies.end());
+	LOG("    %-7s tick avg %8.2f us, p50 %8.2f us, p99 %8.2f us, max %8.2f us; %8d commands",
+		a_ModeName, a_AvgNSec / 1000, percentile(latencies, 50), percentile(latencies, 99), latencies.back(),
+		static_cast<int>(a_AllCommands.size())
+	);
+	return true;
+}
+
+
+
+
+
+/** Returns true if both controllers have returned the same commands, logs the first difference otherwise. */
+static bool areCommandsEqual(const BotCommands & a_Commands1, const BotCommands & a_Commands2)
+{
+	if (a_Commands1.size() != a_Commands2.size())
+	{
+		LOGERROR("The controllers have returned a different number of commands: %d vs %d",
+			static_cast<int>(a_Commands1.size()), static_cast<int>(a_Commands2.size())
+		);
+		return false;
+	}
+	for (size_t i = 0; i < a_Commands1.size(); i++)
+	{
+		auto & cmd1 = a_Commands1[i];
+		auto & cmd2 = a_Commands2[i];
+		if (
+			(cmd1.m_BotID != cmd2.m_BotID) ||
+			(cmd1.m_Cmd != cmd2.m_Cmd) ||
+			(cmd1.m_HasAngle != cmd2.m_HasAngle) ||
+			(cmd1.m_HasAngle && (cmd1.m_Angle != cmd2.m_Angle))
+		)
+		{
+			LOGERROR("Command #%d differs: bot %d %s %f vs bot %d %s %f",
+				static_cast<int>(i),
+				cmd1.m_BotID, cmd1.m_Cmd.c_str(), cmd1.m_Angle,
+				cmd2.m_BotID, cmd2.m_Cmd.c_str(), cmd2.m_Angle
+			);
+			return false;
+		}
+	}
+	return true;
+}
+
+
+
+
+
+int benchPlugin(const AStringVector & a_Args)
+{
+	int maxBots = 80;
+	int numTicks = 2000;
+	AString luaFileName = g_DefaultLuaFileName;
+	AString pluginFileName = g_DefaultPluginFileName;
+	for (auto & arg: a_Args)
+	{
+		if (NoCaseCompare(arg.substr(0, 5), "/lua=") == 0)
+		{
+			luaFileName = arg.substr(5);
+			continue;
+		}
+		if (NoCaseCompare(arg.substr(0, 8), "/plugin=") == 0)
+		{
+			pluginFileName = arg.substr(8);
+			continue;
+		}
+		if (
+			!parseIntArg(arg, "/maxbots=", maxBots) &&
+			!parseIntArg(arg, "/ticks=", numTicks)
+		)
+		{
+			LOGERROR("Unknown parameter: %s", arg.c_str());
+			return 2;
+		}
+	}
+	if ((maxBots < 1) || (numTicks <= 0))
+	{
+		LOGERROR("At least one bot and one tick are needed.");
+		return 2;
+	}
+
+	// The Lua controller runs the same way as in the app, but synchronously and without touching the chunk cache:
+	LuaControllerSettings luaSettings;
+	luaSettings.m_ShouldRunAsync = false;
+	luaSettings.m_ChunkCacheFolder.clear();
+	ControllerFactory luaFactory = [&luaFileName, &luaSettings](BotWarzApp & a_App)
+	{
+		return createLuaController(a_App, luaFileName, false, luaSettings);
+	};
+	ControllerFactory pluginFactory = [&pluginFileName](BotWarzApp & a_App)
+	{
+		return createPluginController(a_App, pluginFileName, false);
+	};
+
+	// Measure each bot count, from the competition's 5 per player up to the maximum, doubling:
+	LOG("Playing %d ticks of the simulated games with the Chaser controller, Lua %s vs plugin %s",
+		numTicks, luaFileName.c_str(), pluginFileName.c_str()
+	);
+	for (auto numBots: getBotCounts(5, 2, maxBots))
+	{
+		LOG("  %d bots per player:", numBots);
+		BotCommands luaCommands, pluginCommands;
+		double luaNSec, pluginNSec;
+		if (
+			!playGames("Lua:", luaFactory, numBots, numTicks, luaCommands, luaNSec) ||
+			!playGames("plugin:", pluginFactory, numBots, numTicks, pluginCommands, pluginNSec)
+		)
+		{
+			return 1;
+		}
+		if (!areCommandsEqual(luaCommands, pluginCommands))
+		{
+			return 1;
+		}
+		LOG("    The plugin is %.1f x faster on average, both have returned the same commands.", luaNSec / pluginNSec);
+	}
+	return 0;
+}
+
+
+
+
@@ -0,0 +1,219 @@
+
+// ProxiesBench.cpp
+
+// Implements the benchmark comparing the bots exposed to Lua as tables rewritten on each update and as LuaBotProxies
+
+#include "Globals.h"
+#include "Benchmarks.h"
+#include <random>
+#include "LuaBotProxies.h"
+#include "Simulator/SimGame.h"
+
+
+
+
+
+/** The Lua code reading the bots, the same for both the tables and the proxies:
+readFew() reads a couple of bots, as a script reacting to a single bot would; readAll() reads all of my bots. */
+static const char g_LuaCode[] =
+	"function readFew(allBots, id1, id2)\n"
+	"	local bot1, bot2 = allBots[id1], allBots[id2]\n"
+	"	return bot1.x + bot1.y + bot2.x + bot2.y\n"
+	"end\n"
+	"\n"
+	"function readAll(allBots)\n"
+	"	local sum = 0\n"
+	"	for id, bot in pairs(allBots) do\n"
+	"		if not(bot.isEnemy) then\n"
+	"			sum = sum + bot.x + bot.y + bot.angle + bot.speed\n"
+	"		end\n"
+	"	end\n"
+	"	return sum\n"
+	"end\n";
+
+
+
+
+
+/** Creates the allBots table of the specified bots, as tables (same as LuaController does) or as proxies,
+and leaves it on the top of the stack. */
+static void createAllBots(lua_State * a_LuaState, const Bots & a_Bots, LuaBotProxies * a_Proxies)
+{
+	lua_newtable(a_LuaState);                                 // Stack: [allBots]
+	for (size_t i = 0; i < a_Bots.size(); i++)
+	{
+		auto & b = a_Bots[i];
+		if (a_Proxies != nullptr)
+		{
+			a_Proxies->pushProxy(a_LuaState, b, i);           // Stack: [allBots] [proxy]
+		}
+		else
+		{
+			lua_newtable(a_LuaState);                         // Stack: [allBots] [bot]
+			lua_pushboolean(a_LuaState, b.m_IsEnemy);         // Stack: [allBots] [bot] [isEnemy]
+			lua_setfield(a_LuaState, -2, "isEnemy");          // Stack: [allBots] [bot]
+		}
+		lua_rawseti(a_LuaState, -2, b.m_ID);                  // Stack: [allBots]
+	}
+}
+
+
+
+
+
+/** Writes the bots' state into the allBots tables at the top of the stack, the same way LuaController::onGameUpdate() does. */
+static void updateTables(lua_State * a_LuaState, const Bots & a_Bots)
+{
+	for (auto & b: a_Bots)
+	{
+		lua_rawgeti(a_LuaState, -1, b.m_ID);                  // Stack: [allBots] [bot]
+		lua_pushnumber(a_LuaState, b.m_X);
+		lua_setfield(a_LuaState, -2, "x");
+		lua_pushnumber(a_LuaState, b.m_Y);
+		lua_setfield(a_LuaState, -2, "y");
+		lua_pushnumber(a_LuaState, b.m_Angle);
+		lua_setfield(a_LuaState, -2, "angle");
+		lua_pushnumber(a_LuaState, b.m_Speed);
+		lua_setfield(a_LuaState, -2, "speed");
+		lua_pushnumber(a_LuaState, b.m_AngularVelocity);
+		lua_setfield(a_LuaState, -2, "angularVelocity");
+		lua_pushnumber(a_LuaState, b.m_Acceleration);
+		lua_setfield(a_LuaState, -2, "acceleration");
+		lua_pop(a_LuaState, 1);                               // Stack: [allBots]
+	}
+}
+
+
+
+
+
+/** Calls the specified Lua function with the allBots table at the top of the stack, plus the two bot IDs for readFew().
+Returns the function's result. */
+static double callRead(LuaState & a_LuaState, const char * a_FnName, int a_ID1, int a_ID2)
+{
+	lua_getfield(a_LuaState, LUA_GLOBALSINDEX, a_FnName);
+	lua_pushvalue(a_LuaState, -2);
+	lua_pushnumber(a_LuaState, a_ID1);
+	lua_pushnumber(a_LuaState, a_ID2);
+	if (lua_pcall(a_LuaState, 3, 1, 0) != 0)
+	{
+		LOGERROR("Lua error in %s: %s", a_FnName, lua_tostring(a_LuaState, -1));
+		exit(1);
+	}
+	double res = lua_tonumber(a_LuaState, -1);
+	lua_pop(a_LuaState, 1);
+	return res;
+}
+
+
+
+
+
+int benchProxies(const AStringVector & a_Args)
+{
+	int maxBots = 10000;
+	int numRounds = 1000;
+	for (auto & arg: a_Args)
+	{
+		if (
+			!parseIntArg(arg, "/maxbots=", maxBots) &&
+			!parseIntArg(arg, "/rounds=", numRounds)
+		)
+		{
+			LOGERROR("Unknown parameter: %s", arg.c_str());
+			return 2;
+		}
+	}
+	if ((maxBots < 2) || (numRounds <= 0))
+	{
+		LOGERROR("At least two bots and one round are needed.");
+		return 2;
+	}
+
+	// Prepare the Lua states, one for each mode, so that the garbage of one doesn't affect the other:
+	LuaState tablesState("ProxiesBench tables");
+	tablesState.create();
+	tablesState.execCode(g_LuaCode);
+	LuaBotProxies proxies;
+	LuaState proxiesState("ProxiesBench proxies");
+	proxiesState.create();
+	proxiesState.execCode(g_LuaCode);
+	proxies.registerMetatable(proxiesState);
+
+	SimGame::Settings settings;
+	LOG("Updating the bots in Lua and reading two of them / all of mine; the number of ticks decreases with the bot count");
+	std::mt19937 random(0);
+	std::uniform_real_distribution<double> coordX(0, settings.m_Width);
+	std::uniform_real_distribution<double> coordY(0, settings.m_Height);
+	std::uniform_real_distribution<double> angle(-180, 180);
+	Bots bots;
+	for (auto numBots: getBotCounts(10, 10, maxBots))
+	{
+		int numTicks = std::max(static_cast<int>(static_cast<Int64>(numRounds) * 100 / numBots), 1);
+
+		// Create the bots, in both Lua states:
+		bots.clear();
+		for (int id = 1; id <= numBots; id++)
+		{
+			bots.emplace_back(id, (id > numBots / 2), coordX(random), coordY(random), 50, angle(random));
+		}
+		createAllBots(tablesState, bots, nullptr);   // Stack: [allBots]
+		createAllBots(proxiesState, bots, &proxies);  // Stack: [allBots]
+
+		double tablesFewNSec = 0, tablesAllNSec = 0;
+		double proxiesFewNSec = 0, proxiesAllNSec = 0;
+		std::uniform_int_distribution<int> randomID(1, numBots);
+		for (int tick = 0; tick < numTicks; tick++)
+		{
+			// Move the bots (not measured):
+			for (auto & b: bots)
+			{
+				b.m_X = coordX(random);
+				b.m_Y = coordY(random);
+				b.m_Angle = angle(random);
+			}
+			int id1 = randomID(random);
+			int id2 = randomID(random);
+
+			// The tables, rewritten on each update; the update is measured with the lighter of the reads:
+			auto startTime = std::chrono::high_resolution_clock::now();
+			updateTables(tablesState, bots);
+			double tablesFew = callRead(tablesState, "readFew", id1, id2);
+			tablesFewNSec += nsecSince(startTime);
+			startTime = std::chrono::high_resolution_clock::now();
+			double tablesAll = callRead(tablesState, "readAll", 0, 0);
+			tablesAllNSec += nsecSince(startTime);
+
+			// The proxies, bound to the bots for the duration of the calls:
+			startTime = std::chrono::high_resolution_clock::now();
+			LuaBotProxies::Binding binding(proxies, bots);
+			double proxiesFew = callRead(proxiesState, "readFew", id1, id2);
+			proxiesFewNSec += nsecSince(startTime);
+			startTime = std::chrono::high_resolution_clock::now();
+			double proxiesAll = callRead(proxiesState, "readAll", 0, 0);
+			proxiesAllNSec += nsecSince(startTime);
+
+			if ((tablesFew != proxiesFew) || (std::abs(tablesAll - proxiesAll) > 1e-9 * std::abs(tablesAll)))
+			{
+				LOGERROR("The values read through the tables and the proxies differ for %d bots.", numBots);
+				return 1;
+			}
+		}
+		lua_pop(tablesState, 1);   // Stack: []
+		lua_pop(proxiesState, 1);  // Stack: []
+		lua_gc(tablesState, LUA_GCCOLLECT, 0);
+		lua_gc(proxiesState, LUA_GCCOLLECT, 0);
+
+		// Report; the update cost is included in the "few" numbers, the "all" numbers are the reads only:
+		LOG("  %6d bots, %6d ticks: update + read 2: tables %11.1f ns, proxies %9.1f ns (%.1f x faster); read all mine: tables %11.1f ns, proxies %11.1f ns (%.2f x)",
+			numBots, numTicks,
+			tablesFewNSec / numTicks, proxiesFewNSec / numTicks, tablesFewNSec / proxiesFewNSec,
+			tablesAllNSec / numTicks, proxiesAllNSec / numTicks, tablesAllNSec / proxiesAllNSec
+		);
+	}
+	return 0;
+}
+
+
+
+
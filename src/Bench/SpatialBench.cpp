@@ -0,0 +1,210 @@
+
+// SpatialBench.cpp
+
+// Implements the benchmark comparing the nearest-enemy search done in Lua by scanning all the bots and using SpatialIndex
+
+#include "Globals.h"
+#include "Benchmarks.h"
+#include <random>
+#include "BotTable.h"
+#include "SpatialIndex.h"
+#include "LuaState.h"
+#include "Simulator/SimGame.h"
+
+
+
+
+
+/** The Lua code performing the queries: for each of my bots, find the nearest enemy and sum up their IDs.
+The naive way is what the controllers do without the index, scanning all the bots; ties are broken by the lower ID,
+the same way SpatialIndex does it. */
+static const char g_LuaCode[] =
+	"function scanNaive(allBots)\n"
+	"	local sum = 0\n"
+	"	for id, bot in pairs(allBots) do\n"
+	"		if not(bot.isEnemy) then\n"
+	"			local bestID, bestDistSq = nil, math.huge\n"
+	"			for id2, enemy in pairs(allBots) do\n"
+	"				if (enemy.isEnemy) then\n"
+	"					local dx, dy = enemy.x - bot.x, enemy.y - bot.y\n"
+	"					local distSq = dx * dx + dy * dy\n"
+	"					if ((distSq < bestDistSq) or ((distSq == bestDistSq) and (id2 < bestID))) then\n"
+	"						bestID, bestDistSq = id2, distSq\n"
+	"					end\n"
+	"				end\n"
+	"			end\n"
+	"			sum = sum + bestID\n"
+	"		end\n"
+	"	end\n"
+	"	return sum\n"
+	"end\n"
+	"\n"
+	"function scanIndexed(allBots)\n"
+	"	local sum = 0\n"
+	"	for id, bot in pairs(allBots) do\n"
+	"		if not(bot.isEnemy) then\n"
+	"			sum = sum + findNearestEnemy(id)\n"
+	"		end\n"
+	"	end\n"
+	"	return sum\n"
+	"end\n";
+
+
+
+
+
+/** The findNearestEnemy() function for the benchmark's Lua state, same as the LuaController's one.
+The SpatialIndex is in the function's upvalue. */
+static int findNearestEnemy(lua_State * a_LuaState)
+{
+	auto index = reinterpret_cast<const SpatialIndex *>(lua_touserdata(a_LuaState, lua_upvalueindex(1)));
+	int botID = static_cast<int>(lua_tonumber(a_LuaState, 1));
+	double x, y;
+	bool isEnemy;
+	int nearestID = -1;
+	if (index->getBot(botID, x, y, isEnemy))
+	{
+		nearestID = index->findNearest(x, y, isEnemy ? SpatialIndex::fMine : SpatialIndex::fEnemies, botID);
+	}
+	lua_pushnumber(a_LuaState, nearestID);
+	return 1;
+}
+
+
+
+
+
+/** Calls the specified Lua function with the allBots table (at the top of the stack) and returns its result. */
+static double callScan(LuaState & a_LuaState, const char * a_FnName)
+{
+	lua_getfield(a_LuaState, LUA_GLOBALSINDEX, a_FnName);
+	lua_pushvalue(a_LuaState, -2);
+	if (lua_pcall(a_LuaState, 1, 1, 0) != 0)
+	{
+		LOGERROR("Lua error in %s: %s", a_FnName, lua_tostring(a_LuaState, -1));
+		exit(1);
+	}
+	double res = lua_tonumber(a_LuaState, -1);
+	lua_pop(a_LuaState, 1);
+	return res;
+}
+
+
+
+
+
+int benchSpatial(const AStringVector & a_Args)
+{
+	int maxBots = 10000;
+	int numRounds = 1000;
+	for (auto & arg: a_Args)
+	{
+		if (
+			!parseIntArg(arg, "/maxbots=", maxBots) &&
+			!parseIntArg(arg, "/rounds=", numRounds)
+		)
+		{
+			LOGERROR("Unknown parameter: %s", arg.c_str());
+			return 2;
+		}
+	}
+	if ((maxBots < 2) || (numRounds <= 0))
+	{
+		LOGERROR("At least two bots and one round are needed.");
+		return 2;
+	}
+	if (maxBots > BotTable::MAX_ID_RANGE)
+	{
+		LOGERROR("The number of bots cannot exceed %d.", BotTable::MAX_ID_RANGE);
+		return 2;
+	}
+
+	// Prepare the Lua state:
+	SpatialIndex index;
+	LuaState luaState("SpatialBench");
+	luaState.create();
+	luaState.execCode(g_LuaCode);
+	lua_pushlightuserdata(luaState, &index);
+	lua_pushcclosure(luaState, &findNearestEnemy, 1);
+	lua_setfield(luaState, LUA_GLOBALSINDEX, "findNearestEnemy");
+
+	SimGame::Settings settings;
+	LOG("Finding the nearest enemy for each of my bots in Lua, %.0f x %.0f world; the number of ticks decreases with the bot count",
+		settings.m_Width, settings.m_Height
+	);
+	std::mt19937 random(0);
+	std::uniform_real_distribution<double> coordX(0, settings.m_Width);
+	std::uniform_real_distribution<double> coordY(0, settings.m_Height);
+	std::uniform_real_distribution<double> step(-10, 10);
+	BotTable bots;
+	for (auto numBots: getBotCounts(10, 10, maxBots))
+	{
+		int numTicks = std::max(static_cast<int>(static_cast<Int64>(numRounds) * 10 / numBots), 1);
+
+		// Create the bots, both in the table and in the Lua allBots table:
+		bots.clear();
+		index.initialize(settings.m_Width, settings.m_Height, settings.m_BotRadius);
+		lua_newtable(luaState);  // Stack: [allBots]
+		for (int id = 1; id <= numBots; id++)
+		{
+			bool isEnemy = (id > numBots / 2);
+			double x = coordX(random);
+			double y = coordY(random);
+			bots.add(id, isEnemy, x, y, 0, 0);
+			lua_newtable(luaState);                 // Stack: [allBots] [bot]
+			lua_pushboolean(luaState, isEnemy);     // Stack: [allBots] [bot] [isEnemy]
+			lua_setfield(luaState, -2, "isEnemy");  // Stack: [allBots] [bot]
+			lua_rawseti(luaState, -2, id);          // Stack: [allBots]
+		}
+
+		double naiveNSec = 0;
+		double indexedNSec = 0;
+		for (int tick = 0; tick < numTicks; tick++)
+		{
+			// Move the bots (not measured):
+			bots.beginUpdate();
+			for (size_t slot = 0; slot < bots.getNumSlots(); slot++)
+			{
+				auto bot = bots.getBot(slot);
+				double x = std::min(std::max(bot.m_X + step(random), 0.0), settings.m_Width);
+				double y = std::min(std::max(bot.m_Y + step(random), 0.0), settings.m_Height);
+				bots.update(bot.m_ID, x, y, 0, 0);
+				lua_rawgeti(luaState, -1, bot.m_ID);  // Stack: [allBots] [bot]
+				lua_pushnumber(luaState, x);          // Stack: [allBots] [bot] [x]
+				lua_setfield(luaState, -2, "x");      // Stack: [allBots] [bot]
+				lua_pushnumber(luaState, y);          // Stack: [allBots] [bot] [y]
+				lua_setfield(luaState, -2, "y");      // Stack: [allBots] [bot]
+				lua_pop(luaState, 1);                 // Stack: [allBots]
+			}
+
+			// The naive way, scanning all the bots in Lua:
+			auto startTime = std::chrono::high_resolution_clock::now();
+			double naiveSum = callScan(luaState, "scanNaive");
+			naiveNSec += nsecSince(startTime);
+
+			// The indexed way, including the index update:
+			startTime = std::chrono::high_resolution_clock::now();
+			index.update(bots);
+			double indexedSum = callScan(luaState, "scanIndexed");
+			indexedNSec += nsecSince(startTime);
+
+			if (naiveSum != indexedSum)
+			{
+				LOGERROR("The nearest enemies differ for %d bots.", numBots);
+				return 1;
+			}
+		}
+		lua_pop(luaState, 1);  // Stack: []
+
+		// Report:
+		LOG("  %6d bots, %5d ticks: Lua scan: %12.1f ns per tick, SpatialIndex: %10.1f ns per tick (%.1f x faster), %u cell changes",
+			numBots, numTicks, naiveNSec / numTicks, indexedNSec / numTicks, naiveNSec / indexedNSec,
+			static_cast<unsigned>(index.getNumRelocations())
+		);
+	}
+	return 0;
+}
+
+
+
+
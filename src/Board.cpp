@@ -7,6 +7,7 @@
 #include "Board.h"
 #include "json/value.h"
 #include "BotWarzApp.h"
+#include "PlayParser.h"
 
 
 
@@ -39,9 +40,7 @@ void Board::initialize(const Json::Value & a_GameData)
 	}  // for itr - speedLevels[]
 
 	// Create the bots:
-	cCSLock Lock(m_CSBots);
-	m_MyBots.clear();
-	m_EnemyBots.clear();
+	m_Bots.clear();
 	auto & players = a_GameData["players"];
 	for (auto itrP = players.begin(), endP = players.end(); itrP != endP; ++itrP)
 	{
@@ -51,19 +50,23 @@ void Board::initialize(const Json::Value & a_GameData)
 		{
 			m_EnemyName = player["nickname"].asString();
 		}
-		auto & botArray = isEnemy ? m_EnemyBots : m_MyBots;
 		auto & bots = player["bots"];
 		for (auto itrB = bots.begin(), endB = bots.end(); itrB != endB; ++itrB)
 		{
 			auto & bot = *itrB;
-			auto botItem = std::make_shared<Bot>(*this, bot["id"].asInt(), isEnemy, bot);
-			botArray.push_back(botItem);
-			m_AllBots[botItem->m_ID] = botItem;
+			m_Bots.add(bot["id"].asInt(), isEnemy, bot["x"].asDouble(), bot["y"].asDouble(), bot["speed"].asDouble(), bot["angle"].asDouble());
 		}  // for itrB - bots[]
 	}  // for itrP - players[]
+	m_ServerTime = 0;
+	m_History.clear();
+	m_History.push(m_ServerTime, m_Bots);
+	m_SpatialIndex.initialize(m_Width, m_Height, m_BotRadius);
+	m_SpatialIndex.update(m_Bots);
+	m_Snapshots.resetStats();
+	publishSnapshot();
 
 	// Set the local game start time:
-	m_LocalGameStartTime = std::chrono::system_clock::now();
+	m_LocalGameStartTime = std::chrono::steady_clock::now();
 }
 
 
@@ -76,77 +79,103 @@ void Board::updateFromJson(const Json::Value & a_GameData)
 	m_ServerTime = a_GameData["time"].asInt();
 
 	// Update the bot arrays
-	cCSLock Lock(m_CSBots);
-	std::vector<int> presentIDs;
+	m_Bots.beginUpdate();
 	for (int i = 0; i < 2; i++)
 	{
 		auto & bots = a_GameData["players"][i]["bots"];
 		for (auto itrB = bots.begin(), endB = bots.end(); itrB != endB; ++itrB)
 		{
 			auto & bot = *itrB;
-			int id = bot["id"].asInt();
-			presentIDs.push_back(id);
-			m_AllBots[id]->updateFromJson(bot);
+			m_Bots.update(bot["id"].asInt(), bot["x"].asDouble(), bot["y"].asDouble(), bot["speed"].asDouble(), bot["angle"].asDouble());
 		}  // for itrB - bots[]
 	}  // for i - two players
+	finishUpdate();
+}
 
-	// Remove bots that haven't been reported:
-	for (auto itr = m_AllBots.begin(), end = m_AllBots.end(); itr != end;)
+
+
+
+
+bool Board::updateFromPlayMessage(const char * a_Data, size_t a_Length, int & a_LastCmdId)
+{
+	/** Writes the values reported by the parser directly into the bots on the board. */
+	class BoardUpdater:
+		public PlayParser::Callbacks
 	{
-		if (std::find(presentIDs.begin(), presentIDs.end(), itr->first) == presentIDs.end())
+	public:
+		BoardUpdater(Board & a_Board, int & a_LastCmdId):
+			m_Board(a_Board),
+			m_LastCmdId(a_LastCmdId)
 		{
-			m_App.botDied(*(itr->second));
-			itr = m_AllBots.erase(itr);
 		}
-		else
+
+		virtual void onTime(int a_Time) override
 		{
-			++itr;
+			m_Board.m_ServerTime = a_Time;
 		}
-	}  // for itr - m_AllBots[]
-	for (auto itr = m_MyBots.begin(); itr != m_MyBots.end();)
-	{
-		if (std::find(presentIDs.begin(), presentIDs.end(), (*itr)->m_ID) == presentIDs.end())
+
+		virtual void onLastCmdId(int a_LastCmdId) override
 		{
-			itr = m_MyBots.erase(itr);
+			m_LastCmdId = a_LastCmdId;
 		}
-		else
+
+		virtual void onBot(int a_ID, double a_X, double a_Y, double a_Speed, double a_Angle) override
 		{
-			++itr;
+			// Bots not present at the game start are ignored by the table:
+			m_Board.m_Bots.update(a_ID, a_X, a_Y, a_Speed, a_Angle);
 		}
-	}  // for itr - m_MyBots[]
-	for (auto itr = m_EnemyBots.begin(); itr != m_EnemyBots.end();)
+
+	protected:
+		Board & m_Board;
+		int & m_LastCmdId;
+	};
+
+	m_Bots.beginUpdate();
+	BoardUpdater updater(*this, a_LastCmdId);
+	if (!PlayParser::parse(a_Data, a_Length, updater))
 	{
-		if (std::find(presentIDs.begin(), presentIDs.end(), (*itr)->m_ID) == presentIDs.end())
-		{
-			itr = m_EnemyBots.erase(itr);
-		}
-		else
-		{
-			++itr;
-		}
-	}  // for itr - m_EnemyBots[]
+		return false;
+	}
+	m_App.getTickLatency().mark(TickLatency::stParsed);  // The parser has already written the bots' values, only the finishing is left
+	finishUpdate();
+	return true;
 }
 
 
 
 
 
-BotPtrs Board::getMyBotsCopy(void) const
+void Board::finishUpdate(void)
 {
-	cCSLock Lock(m_CSBots);
-	return m_MyBots;
+	// Remove bots that haven't been reported:
+	m_Bots.removeUnreported([this](const Bot & a_Bot)
+		{
+			m_App.botDied(a_Bot);
+		}
+	);
+
+	m_History.push(m_ServerTime, m_Bots);
+	m_SpatialIndex.update(m_Bots);
+	publishSnapshot();
 }
 
 
 
 
 
-BotIDMap Board::getAllBotsCopy(void) const
+void Board::publishSnapshot(void)
 {
-	cCSLock Lock(m_CSBots);
-	return m_AllBots;
+	auto & snapshot = m_Snapshots.beginWrite();
+	snapshot.m_ServerTime = m_ServerTime;
+	snapshot.m_PublishedTime = std::chrono::steady_clock::now();
+	snapshot.m_AllBots.clear();  // Keeps the capacity
+	m_Bots.appendAliveBots(snapshot.m_AllBots, true);
+	snapshot.m_MyBots.clear();
+	m_Bots.appendAliveBots(snapshot.m_MyBots, false);
+	m_Snapshots.publish(snapshot.m_AllBots.size() + snapshot.m_MyBots.size());
 }
 
 
 
 
+
@@ -9,8 +9,10 @@
 
 #pragma once
 
-#include "lib/Network/CriticalSection.h"
-#include "Bot.h"
+#include "BotTable.h"
+#include "BoardSnapshots.h"
+#include "BoardHistory.h"
+#include "SpatialIndex.h"
 
 
 
@@ -58,19 +60,32 @@ public:
 	a_Board is the contents of the "play" tag from the server's message. */
 	void updateFromJson(const Json::Value & a_Board);
 
+	/** Updates the board contents directly from the raw "play" message received from the server, without building a Json DOM.
+	a_Data is the entire server message, including the top-level object. a_LastCmdId receives the "lastCmdId" value.
+	Returns true on success. Returns false if the message cannot be parsed this way; the caller should then use updateFromJson(). */
+	bool updateFromPlayMessage(const char * a_Data, size_t a_Length, int & a_LastCmdId);
+
 	const SpeedLevels & getSpeedLevels(void) const { return m_SpeedLevels; }
 	double getWorldWidth(void) const { return m_Width; }
 	double getWorldHeight(void) const { return m_Height; }
 	double getBotRadius(void) const { return m_BotRadius; }
 
-	/** Returns a copy of the m_MyBots field, in a thread-safe way. */
-	BotPtrs getMyBotsCopy(void) const;
+	/** Returns the latest published snapshot of the bots on the board.
+	Lock-free, can be called from any thread; the snapshot stays unchanged while the returned handle is held.
+	Each thread should hold at most one snapshot at a time. */
+	BoardSnapshots::ReadRef getSnapshot(void) const { return m_Snapshots.read(); }
+
+	/** Returns the history of the bots' states over the last several updates. Can be read from any thread. */
+	const BoardHistory & getHistory(void) const { return m_History; }
 
-	/** Returns a copy of the m_AllBots field, in a thread-safe way. */
-	BotIDMap getAllBotsCopy(void) const;
+	/** Returns the spatial index over the bots' positions, for the proximity queries. Can be queried from any thread. */
+	const SpatialIndex & getSpatialIndex(void) const { return m_SpatialIndex; }
 
-	/** Returns the local timestamp of the game start. */
-	std::chrono::system_clock::time_point getLocalGameStartTime(void) const { return m_LocalGameStartTime; }
+	/** Returns a one-line summary of the snapshot statistics since the game start. */
+	AString getSnapshotStats(void) const { return m_Snapshots.getStatsString(); }
+
+	/** Returns the local timestamp of the game start, on the steady clock. */
+	std::chrono::steady_clock::time_point getLocalGameStartTime(void) const { return m_LocalGameStartTime; }
 
 	/** Returns the server time of the last update. */
 	int getServerTime(void) const { return m_ServerTime; }
@@ -91,26 +106,35 @@ protected:
 	/** The available speed levels. */
 	SpeedLevels m_SpeedLevels;
 
-	/** Vector of my bots currently present on the board. */
-	BotPtrs m_MyBots;
+	/** All the bots in the game, both mine and the enemy's.
+	Only accessed from the thread processing the server messages, the other threads read the published snapshots. */
+	BotTable m_Bots;
+
+	/** The snapshots of m_Bots, published after each update for the readers in other threads. */
+	BoardSnapshots m_Snapshots;
 
-	/** Vector of enemy bots currently present on the board. */
-	BotPtrs m_EnemyBots;
+	/** The states of m_Bots over the last several updates, used for estimating the bots' motion. */
+	BoardHistory m_History;
 
-	/** Map of Bot ID -> Bot ptr for all bots currently present on the board. */
-	BotIDMap m_AllBots;
+	/** The grid index over the positions of the bots in m_Bots. */
+	SpatialIndex m_SpatialIndex;
 
 	/** The nickname of the enemy. */
 	AString m_EnemyName;
 
-	/** The mutex protecting m_MyBots, m_EnemyBots and m_AllBots against multithreaded access. */
-	mutable cCriticalSection m_CSBots;
-
-	/** The local timestamp of the game start. */
-	std::chrono::system_clock::time_point m_LocalGameStartTime;
+	/** The local timestamp of the game start, on the steady clock so that it isn't affected by the system clock adjustments. */
+	std::chrono::steady_clock::time_point m_LocalGameStartTime;
 
 	/** The server time of the last update. */
 	int m_ServerTime;
+
+
+	/** Finishes an update of m_Bots: removes the bots not reported in the update, reporting their deaths to the app,
+	records the update into the history and the spatial index and publishes the new snapshot. */
+	void finishUpdate(void);
+
+	/** Publishes the current state of m_Bots as a new snapshot for the readers. */
+	void publishSnapshot(void);
 };
 
 
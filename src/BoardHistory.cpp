@@ -0,0 +1,210 @@
+
+// BoardHistory.cpp
+
+// Implements the BoardHistory class that keeps the last several states of the bots and estimates their motion from them
+
+#include "Globals.h"
+#include "BoardHistory.h"
+#include "BotTable.h"
+
+
+
+
+
+BoardHistory::BoardHistory(size_t a_Capacity):
+	m_Entries(std::max<size_t>(a_Capacity, 2)),
+	m_Latest(0),
+	m_Count(0)
+{
+}
+
+
+
+
+
+void BoardHistory::clear(void)
+{
+	cCSLock Lock(m_CS);
+	m_Count = 0;
+	m_SlotBots.clear();
+	m_SlotByID.clear();
+}
+
+
+
+
+
+void BoardHistory::push(int a_ServerTime, BotTable & a_Bots)
+{
+	cCSLock Lock(m_CS);
+	size_t numSlots = a_Bots.getNumSlots();
+
+	// Update the slot mapping, if the slots have changed (the bots are only added at the game start):
+	if (m_SlotBots.size() != numSlots)
+	{
+		m_SlotBots.clear();
+		m_SlotByID.clear();
+		for (size_t slot = 0; slot < numSlots; slot++)
+		{
+			auto bot = a_Bots.getBot(slot);
+			m_SlotBots.emplace_back(bot.m_ID, bot.m_IsEnemy);
+			m_SlotByID[bot.m_ID] = slot;
+		}
+	}
+
+	// Record the bots into the next entry:
+	m_Latest = (m_Latest + 1) % m_Entries.size();
+	m_Count = std::min(m_Count + 1, m_Entries.size());
+	auto & entry = m_Entries[m_Latest];
+	entry.m_ServerTime = a_ServerTime;
+	entry.m_Samples.resize(numSlots);  // Keeps the capacity
+	for (size_t slot = 0; slot < numSlots; slot++)
+	{
+		auto & sample = entry.m_Samples[slot];
+		sample.m_IsAlive = a_Bots.isAlive(slot);
+		if (!sample.m_IsAlive)
+		{
+			continue;
+		}
+		auto bot = a_Bots.getBot(slot);
+		sample.m_X = bot.m_X;
+		sample.m_Y = bot.m_Y;
+		sample.m_Speed = bot.m_Speed;
+		sample.m_Angle = bot.m_Angle;
+
+		// Estimate the motion:
+		double angularVelocity, acceleration;
+		estimateMotion(slot, angularVelocity, acceleration);
+		a_Bots.setMotion(slot, angularVelocity, acceleration);
+	}
+}
+
+
+
+
+
+size_t BoardHistory::getCount(void) const
+{
+	cCSLock Lock(m_CS);
+	return m_Count;
+}
+
+
+
+
+
+int BoardHistory::getUpdateInterval(void) const
+{
+	cCSLock Lock(m_CS);
+	if (m_Count < 2)
+	{
+		return 0;
+	}
+	return getEntry(0).m_ServerTime - getEntry(1).m_ServerTime;
+}
+
+
+
+
+
+bool BoardHistory::getSample(int a_BotID, size_t a_Age, int & a_ServerTime, Bot & a_Bot) const
+{
+	cCSLock Lock(m_CS);
+	if (a_Age >= m_Count)
+	{
+		return false;
+	}
+	auto itr = m_SlotByID.find(a_BotID);
+	if (itr == m_SlotByID.end())
+	{
+		return false;
+	}
+	auto & entry = getEntry(a_Age);
+	if ((itr->second >= entry.m_Samples.size()) || !entry.m_Samples[itr->second].m_IsAlive)
+	{
+		return false;
+	}
+	auto & sample = entry.m_Samples[itr->second];
+	a_ServerTime = entry.m_ServerTime;
+	a_Bot = Bot(a_BotID, m_SlotBots[itr->second].second, sample.m_X, sample.m_Y, sample.m_Speed, sample.m_Angle);
+	return true;
+}
+
+
+
+
+
+void BoardHistory::estimateMotion(size_t a_Slot, double & a_AngularVelocity, double & a_Acceleration) const
+{
+	ASSERT(m_CS.IsLockedByCurrentThread());
+	a_AngularVelocity = 0;
+	a_Acceleration = 0;
+
+	// Collect the latest samples of the bot, unwrapping the angle so that it is continuous:
+	double times[ESTIMATE_WINDOW];
+	double angles[ESTIMATE_WINDOW];
+	double speeds[ESTIMATE_WINDOW];
+	size_t num = 0;
+	const auto & latest = getEntry(0);
+	for (size_t age = 0; (age < m_Count) && (age < ESTIMATE_WINDOW); age++)
+	{
+		auto & entry = getEntry(age);
+		if ((a_Slot >= entry.m_Samples.size()) || !entry.m_Samples[a_Slot].m_IsAlive)
+		{
+			break;
+		}
+		auto & sample = entry.m_Samples[a_Slot];
+		times[num] = (entry.m_ServerTime - latest.m_ServerTime) / 1000.0;  // Server time is in msec
+		angles[num] = sample.m_Angle;
+		if (num > 0)
+		{
+			double diff = fmod(sample.m_Angle - angles[num - 1], 360.0);
+			if (diff >= 180)
+			{
+				diff -= 360;
+			}
+			else if (diff < -180)
+			{
+				diff += 360;
+			}
+			angles[num] = angles[num - 1] + diff;
+		}
+		speeds[num] = sample.m_Speed;
+		num += 1;
+	}
+	if (num < 2)
+	{
+		return;
+	}
+
+	// Least-squares slope of the angle and speed against the time:
+	double avgTime = 0, avgAngle = 0, avgSpeed = 0;
+	for (size_t i = 0; i < num; i++)
+	{
+		avgTime += times[i];
+		avgAngle += angles[i];
+		avgSpeed += speeds[i];
+	}
+	avgTime /= num;
+	avgAngle /= num;
+	avgSpeed /= num;
+	double sumTT = 0, sumTA = 0, sumTS = 0;
+	for (size_t i = 0; i < num; i++)
+	{
+		double dt = times[i] - avgTime;
+		sumTT += dt * dt;
+		sumTA += dt * (angles[i] - avgAngle);
+		sumTS += dt * (speeds[i] - avgSpeed);
+	}
+	if (sumTT <= 0)
+	{
+		// All the samples are from the same server time
+		return;
+	}
+	a_AngularVelocity = sumTA / sumTT;
+	a_Acceleration = sumTS / sumTT;
+}
+
+
+
+
@@ -0,0 +1,113 @@
+
+// BoardHistory.h
+
+// Declares the BoardHistory class that keeps the last several states of the bots and estimates their motion from them
+
+
+
+
+
+#pragma once
+
+#include "lib/Network/CriticalSection.h"
+#include "Bot.h"
+
+
+
+
+
+// fwd:
+class BotTable;
+
+
+
+
+
+/** Keeps the states of all the bots from the last several board updates, in a fixed-capacity ring buffer.
+The states are stored per BotTable slot, so recording an update doesn't allocate any memory once the buffer is filled.
+Upon each update, the bots' angular velocity and acceleration are estimated from the history and stored back into the table.
+The recording is done by the thread processing the server messages, the samples can be read from any thread. */
+class BoardHistory
+{
+public:
+	/** The default number of updates kept in the history. */
+	static const size_t DEFAULT_CAPACITY = 16;
+
+	/** The maximum number of the latest updates used for the motion estimates. */
+	static const size_t ESTIMATE_WINDOW = 4;
+
+
+	BoardHistory(size_t a_Capacity = DEFAULT_CAPACITY);
+
+	/** Removes all the recorded updates. Called when a new game starts. */
+	void clear(void);
+
+	/** Records the current state of all the bots in the table, made at the specified server time.
+	Then estimates the motion of each alive bot from the recorded history and stores it into the table. */
+	void push(int a_ServerTime, BotTable & a_Bots);
+
+	/** Returns the number of updates currently in the history. */
+	size_t getCount(void) const;
+
+	/** Returns the server time between the two latest updates, in msec, or 0 if there aren't two updates yet. */
+	int getUpdateInterval(void) const;
+
+	/** Retrieves the state of the specified bot in the specified past update, a_Age 0 being the latest one.
+	Returns false if there's no such update in the history, or the bot wasn't alive in it. */
+	bool getSample(int a_BotID, size_t a_Age, int & a_ServerTime, Bot & a_Bot) const;
+
+protected:
+	/** The state of a single bot in a single update. */
+	struct Sample
+	{
+		double m_X;
+		double m_Y;
+		double m_Speed;
+		double m_Angle;
+		bool m_IsAlive;
+	};
+
+	/** A single recorded update. */
+	struct Entry
+	{
+		int m_ServerTime;
+
+		/** The bots' states, indexed by their BotTable slot. */
+		std::vector<Sample> m_Samples;
+	};
+
+
+	/** Protects all the members against multithreaded access. */
+	mutable cCriticalSection m_CS;
+
+	/** The ring buffer of the recorded updates. */
+	std::vector<Entry> m_Entries;
+
+	/** The index into m_Entries of the latest update. */
+	size_t m_Latest;
+
+	/** The number of valid updates in m_Entries. */
+	size_t m_Count;
+
+	/** The bot's ID and enemy flag for each BotTable slot. */
+	std::vector<std::pair<int, bool>> m_SlotBots;
+
+	/** The BotTable slot for each bot ID. Rebuilt when the table's slots change (at the game start). */
+	std::map<int, size_t> m_SlotByID;
+
+
+	/** Returns the entry of the specified age, 0 being the latest one. Expects a_Age < m_Count. */
+	const Entry & getEntry(size_t a_Age) const
+	{
+		return m_Entries[(m_Latest + m_Entries.size() - a_Age) % m_Entries.size()];
+	}
+
+	/** Estimates the angular velocity and acceleration of the bot in the specified slot, from the latest updates.
+	Uses a least-squares fit of the angle (unwrapped across the +-180 degrees boundary) and the speed against the server time.
+	Sets both values to zero if there isn't enough history. */
+	void estimateMotion(size_t a_Slot, double & a_AngularVelocity, double & a_Acceleration) const;
+};
+
+
+
+
@@ -0,0 +1,152 @@
+
+// BoardSnapshots.cpp
+
+// Implements the BoardSnapshots class that publishes immutable snapshots of the board from the network thread to the readers without locking
+
+#include "Globals.h"
+#include "BoardSnapshots.h"
+#include <thread>
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// BoardSnapshots::ReadRef:
+
+BoardSnapshots::ReadRef::~ReadRef()
+{
+	if (m_Buffer != nullptr)
+	{
+		m_Buffer->m_NumReaders.fetch_sub(1, std::memory_order_release);
+	}
+}
+
+
+
+
+
+const BoardSnapshot & BoardSnapshots::ReadRef::operator *(void) const
+{
+	ASSERT(m_Buffer != nullptr);
+	return m_Buffer->m_Snapshot;
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// BoardSnapshots:
+
+BoardSnapshots::BoardSnapshots(void):
+	m_Current(&m_Buffers[0]),
+	m_Writing(nullptr)
+{
+	for (auto & buffer: m_Buffers)
+	{
+		buffer.m_NumReaders = 0;
+	}
+	resetStats();
+}
+
+
+
+
+
+BoardSnapshots::ReadRef BoardSnapshots::read(void) const
+{
+	m_NumReads.fetch_add(1, std::memory_order_relaxed);
+	while (true)
+	{
+		// Announce the reading first, then check that the buffer is still current.
+		// Both operations are sequentially consistent, pairing with publish() and beginWrite() in the writer:
+		// either the writer sees the reader count and won't reuse the buffer, or the reader sees the new current buffer and retries.
+		const Buffer * buffer = m_Current.load();
+		buffer->m_NumReaders.fetch_add(1);
+		if (m_Current.load() == buffer)
+		{
+			return ReadRef(buffer);
+		}
+		buffer->m_NumReaders.fetch_sub(1);
+		m_NumReadRetries.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+
+
+
+
+BoardSnapshot & BoardSnapshots::beginWrite(void)
+{
+	ASSERT(m_Writing == nullptr);
+
+	// Find a buffer that is neither current nor in use by any reader:
+	bool hasStalled = false;
+	while (true)
+	{
+		Buffer * current = m_Current.load();
+		for (auto & buffer: m_Buffers)
+		{
+			if ((&buffer != current) && (buffer.m_NumReaders.load() == 0))
+			{
+				m_Writing = &buffer;
+				return buffer.m_Snapshot;
+			}
+		}
+
+		// All buffers are in use; more readers than expected, wait for one of them to finish:
+		if (!hasStalled)
+		{
+			m_NumWriteStalls.fetch_add(1, std::memory_order_relaxed);
+			hasStalled = true;
+		}
+		std::this_thread::yield();
+	}
+}
+
+
+
+
+
+void BoardSnapshots::publish(size_t a_NumBotsCopied)
+{
+	ASSERT(m_Writing != nullptr);
+
+	m_Current.store(m_Writing);
+	m_Writing = nullptr;
+	m_NumPublished.fetch_add(1, std::memory_order_relaxed);
+	m_NumBotsCopied.fetch_add(a_NumBotsCopied, std::memory_order_relaxed);
+}
+
+
+
+
+
+void BoardSnapshots::resetStats(void)
+{
+	m_NumPublished = 0;
+	m_NumReads = 0;
+	m_NumReadRetries = 0;
+	m_NumWriteStalls = 0;
+	m_NumBotsCopied = 0;
+}
+
+
+
+
+
+AString BoardSnapshots::getStatsString(void) const
+{
+	return Printf("Board snapshots: %llu published (%llu bots copied), %llu read without copying (%llu retries), writer stalled %llu times",
+		static_cast<unsigned long long>(m_NumPublished.load()),
+		static_cast<unsigned long long>(m_NumBotsCopied.load()),
+		static_cast<unsigned long long>(m_NumReads.load()),
+		static_cast<unsigned long long>(m_NumReadRetries.load()),
+		static_cast<unsigned long long>(m_NumWriteStalls.load())
+	);
+}
+
+
+
+
@@ -0,0 +1,153 @@
+
+// BoardSnapshots.h
+
+// Declares the BoardSnapshots class that publishes immutable snapshots of the board from the network thread to the readers without locking
+
+
+
+
+
+#pragma once
+
+#include <atomic>
+#include "Bot.h"
+
+
+
+
+
+/** The state of the board's bots at a single moment, as published by the Board after each update.
+Never modified while visible to the readers. */
+struct BoardSnapshot
+{
+	/** The server time of the update from which the snapshot was made. */
+	int m_ServerTime;
+
+	/** The local time when the snapshot was published, used for extrapolating the bots to the current time. */
+	std::chrono::steady_clock::time_point m_PublishedTime;
+
+	/** All the bots alive on the board. */
+	Bots m_AllBots;
+
+	/** My bots alive on the board, in the order in which they were listed at the game start. */
+	Bots m_MyBots;
+
+
+	BoardSnapshot(void):
+		m_ServerTime(0)
+	{
+	}
+};
+
+
+
+
+
+/** Publishes BoardSnapshot instances from a single writer thread to any number of reader threads, without any locking.
+The snapshots live in a fixed pool of buffers, each with a count of the readers currently using it. The writer fills
+a buffer that is neither current nor in use, then atomically swaps the current-buffer pointer (RCU-style).
+A reader increments the current buffer's reader count and re-checks that the buffer is still current; if it isn't,
+the writer may already be reusing it, so the reader backs off and retries. Once acquired, the snapshot is read in place,
+nothing is copied.
+Each reader thread is expected to hold at most one snapshot at a time. */
+class BoardSnapshots
+{
+protected:
+	struct Buffer;
+
+public:
+	/** The number of buffers in the pool: the current one, the one being written and one for each of up to two reader threads
+	(the controller's update, in the network thread or in the controller's own thread, and the command sender). */
+	static const int NUM_BUFFERS = 4;
+
+
+	/** A reader's handle to a snapshot. The snapshot stays valid and unchanged until the handle is destroyed. */
+	class ReadRef
+	{
+	public:
+		ReadRef(ReadRef && a_Other):
+			m_Buffer(a_Other.m_Buffer)
+		{
+			a_Other.m_Buffer = nullptr;
+		}
+
+		~ReadRef();
+
+		const BoardSnapshot & operator *(void) const;
+		const BoardSnapshot * operator ->(void) const { return &(**this); }
+
+	protected:
+		friend class BoardSnapshots;
+
+		const Buffer * m_Buffer;
+
+		ReadRef(const Buffer * a_Buffer):
+			m_Buffer(a_Buffer)
+		{
+		}
+
+		ReadRef(const ReadRef &) = delete;
+		ReadRef & operator =(const ReadRef &) = delete;
+	};
+
+
+	BoardSnapshots(void);
+
+	/** Returns the handle to the latest published snapshot. Never blocks.
+	Can be called from any thread. */
+	ReadRef read(void) const;
+
+	/** Returns the snapshot that the writer should fill next. It is not visible to the readers until publish() is called.
+	The snapshot contains stale data from an earlier update, the writer needs to overwrite all of it.
+	Only to be called from the writer thread. */
+	BoardSnapshot & beginWrite(void);
+
+	/** Makes the snapshot returned by the last beginWrite() the current one.
+	a_NumBotsCopied is the number of bots that the writer has copied into the snapshot, for the statistics.
+	Only to be called from the writer thread. */
+	void publish(size_t a_NumBotsCopied);
+
+	/** Resets the statistics. Called when a new game starts. */
+	void resetStats(void);
+
+	/** Returns a one-line human-readable summary of the statistics. */
+	AString getStatsString(void) const;
+
+protected:
+	struct Buffer
+	{
+		BoardSnapshot m_Snapshot;
+
+		/** The number of readers currently holding this buffer, including the ones that are just checking whether it is still current. */
+		mutable std::atomic<int> m_NumReaders;
+	};
+
+
+	/** The pool of the snapshot buffers. */
+	Buffer m_Buffers[NUM_BUFFERS];
+
+	/** The buffer containing the latest published snapshot. */
+	std::atomic<Buffer *> m_Current;
+
+	/** The buffer being filled by the writer, returned from the last beginWrite(); nullptr if not writing. */
+	Buffer * m_Writing;
+
+	/** The number of snapshots published. */
+	std::atomic<UInt64> m_NumPublished;
+
+	/** The number of snapshots acquired by the readers. */
+	mutable std::atomic<UInt64> m_NumReads;
+
+	/** The number of times a reader has had to retry acquiring a snapshot, because the writer published a new one meanwhile. */
+	mutable std::atomic<UInt64> m_NumReadRetries;
+
+	/** The number of times the writer has found all the buffers in use and had to wait for a reader to release one. */
+	std::atomic<UInt64> m_NumWriteStalls;
+
+	/** The number of bots that the writer has copied into the snapshots. */
+	std::atomic<UInt64> m_NumBotsCopied;
+};
+
+
+
+
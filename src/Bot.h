@@ -13,21 +13,11 @@
 
 
 
-// fwd:
-class Board;
-namespace Json
-{
-	class Value;
-}
-
-
-
-
-
+/** A snapshot of a single bot's state. The bots themselves are stored in the Board's BotTable,
+this class is used for handing out the values of an individual bot. */
 class Bot
 {
 public:
-	Board & m_Board;
 	int m_ID;
 	bool m_IsEnemy;
 	double m_X;
@@ -35,19 +25,27 @@ public:
 	double m_Speed;
 	double m_Angle;
 
+	/** The estimated rate of change of m_Angle, in degrees per second, computed from the board history. */
+	double m_AngularVelocity;
+
+	/** The estimated rate of change of m_Speed, in speed units per second, computed from the board history. */
+	double m_Acceleration;
 
-	/** Creates a new bot instance tied to the specified board.
-	a_Values is the contents of the "bots" array item of the server response, it is used to initialize the coords and angle. */
-	Bot(Board & a_Board, int a_ID, bool a_IsEnemy, const Json::Value & a_Values);
 
-	/** Updates the bot data from the specified json value.
-	a_Value is the contents of the "bots" array item of the server response. */
-	void updateFromJson(const Json::Value & a_Value);
+	Bot(int a_ID, bool a_IsEnemy, double a_X, double a_Y, double a_Speed, double a_Angle, double a_AngularVelocity = 0, double a_Acceleration = 0):
+		m_ID(a_ID),
+		m_IsEnemy(a_IsEnemy),
+		m_X(a_X),
+		m_Y(a_Y),
+		m_Speed(a_Speed),
+		m_Angle(a_Angle),
+		m_AngularVelocity(a_AngularVelocity),
+		m_Acceleration(a_Acceleration)
+	{
+	}
 };
 
-typedef SharedPtr<Bot> BotPtr;
-typedef std::vector<BotPtr> BotPtrs;
-typedef std::map<int, BotPtr> BotIDMap;
+typedef std::vector<Bot> Bots;
 
 
 
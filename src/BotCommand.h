@@ -0,0 +1,44 @@
+
+// BotCommand.h
+
+// Declares the BotCommand struct representing a single command for a single bot, as sent to the server
+
+
+
+
+
+#pragma once
+
+
+
+
+
+/** A single command for a single bot, as provided by the controller and sent to the server. */
+struct BotCommand
+{
+	/** The ID of the bot to which the command applies. */
+	int m_BotID;
+
+	/** The command, as specified in the BotWarz protocol ("accelerate", "brake", "steer"). */
+	AString m_Cmd;
+
+	/** True if the command has the angle parameter (the "steer" command). */
+	bool m_HasAngle;
+
+	/** The angle parameter of the command. Only valid if m_HasAngle is true. */
+	double m_Angle;
+
+
+	BotCommand(int a_BotID):
+		m_BotID(a_BotID),
+		m_HasAngle(false),
+		m_Angle(0)
+	{
+	}
+};
+
+typedef std::vector<BotCommand> BotCommands;
+
+
+
+
@@ -0,0 +1,128 @@
+
+// BotPredictor.cpp
+
+// Implements the BotPredictor class that extrapolates the bots' positions to a future time (dead reckoning)
+
+#include "Globals.h"
+#include "BotPredictor.h"
+#include "Steering.h"
+
+
+
+
+
+/** The turn rate below which the bot is considered to move in a straight line, in radians per second. */
+static const double MIN_TURN_RATE = 1e-9;
+
+static const double DEG_TO_RAD = M_PI / 180;
+
+
+
+
+
+BotPredictor::BotPredictor(void):
+	m_MinX(0),
+	m_MaxX(0),
+	m_MinY(0),
+	m_MaxY(0)
+{
+}
+
+
+
+
+
+void BotPredictor::setBots(const Bots & a_Bots, const Board & a_Board, double a_UpdateIntervalMSec)
+{
+	double radius = a_Board.getBotRadius();
+	m_MinX = radius;
+	m_MaxX = a_Board.getWorldWidth() - radius;
+	m_MinY = radius;
+	m_MaxY = a_Board.getWorldHeight() - radius;
+
+	// Copy the bots into the arrays, keeping their capacity:
+	m_IDs.clear();
+	m_X.clear();
+	m_Y.clear();
+	m_Speed.clear();
+	m_Angle.clear();
+	m_TurnRate.clear();
+	auto & speedLevels = a_Board.getSpeedLevels();
+	for (auto & bot: a_Bots)
+	{
+		// Limit the turn rate by the speed level that is the closest to the bot's speed:
+		double turnRate = bot.m_AngularVelocity;
+		if ((a_UpdateIntervalMSec > 0) && !speedLevels.empty())
+		{
+			double maxTurnRate = Steering::getMaxSteerAngle(speedLevels, bot.m_Speed) * 1000 / a_UpdateIntervalMSec;
+			turnRate = std::min(std::max(turnRate, -maxTurnRate), maxTurnRate);
+		}
+
+		m_IDs.push_back(bot.m_ID);
+		m_X.push_back(bot.m_X);
+		m_Y.push_back(bot.m_Y);
+		m_Speed.push_back(bot.m_Speed);
+		m_Angle.push_back(bot.m_Angle * DEG_TO_RAD);
+		m_TurnRate.push_back(turnRate * DEG_TO_RAD);
+	}
+	m_PredX.resize(m_IDs.size());
+	m_PredY.resize(m_IDs.size());
+	m_PredAngle.resize(m_IDs.size());
+}
+
+
+
+
+
+void BotPredictor::predict(double a_DeltaSec)
+{
+	size_t count = m_IDs.size();
+	const double * x = m_X.data();
+	const double * y = m_Y.data();
+	const double * speed = m_Speed.data();
+	const double * angle = m_Angle.data();
+	const double * turnRate = m_TurnRate.data();
+	double * predX = m_PredX.data();
+	double * predY = m_PredY.data();
+	double * predAngle = m_PredAngle.data();
+
+	// Move along the arc (or a straight line for a negligible turn rate):
+	for (size_t i = 0; i < count; i++)
+	{
+		double endAngle = angle[i] + turnRate[i] * a_DeltaSec;
+		double sinStart = sin(angle[i]);
+		double cosStart = cos(angle[i]);
+		double sinEnd = sin(endAngle);
+		double cosEnd = cos(endAngle);
+		bool isStraight = (std::abs(turnRate[i]) < MIN_TURN_RATE);
+		double turnRadius = isStraight ? 0 : speed[i] / turnRate[i];
+		double dist = speed[i] * a_DeltaSec;
+		predX[i] = x[i] + (isStraight ? dist * cosStart : turnRadius * (sinEnd - sinStart));
+		predY[i] = y[i] + (isStraight ? dist * sinStart : turnRadius * (cosStart - cosEnd));
+		predAngle[i] = endAngle / DEG_TO_RAD;
+	}
+
+	// Stop at the world edges, mirroring the heading, then normalize the heading:
+	for (size_t i = 0; i < count; i++)
+	{
+		if ((predX[i] < m_MinX) || (predX[i] > m_MaxX))
+		{
+			predX[i] = std::min(std::max(predX[i], m_MinX), m_MaxX);
+			predAngle[i] = 180 - predAngle[i];
+		}
+		if ((predY[i] < m_MinY) || (predY[i] > m_MaxY))
+		{
+			predY[i] = std::min(std::max(predY[i], m_MinY), m_MaxY);
+			predAngle[i] = -predAngle[i];
+		}
+		predAngle[i] = fmod(predAngle[i], 360);
+		if (predAngle[i] < 0)
+		{
+			predAngle[i] += 360;
+		}
+	}
+}
+
+
+
+
@@ -0,0 +1,70 @@
+
+// BotPredictor.h
+
+// Declares the BotPredictor class that extrapolates the bots' positions to a future time (dead reckoning)
+
+
+
+
+
+#pragma once
+
+#include "Board.h"
+
+
+
+
+
+/** Extrapolates the poses of all the bots from a board snapshot to a time in the future.
+Each bot is assumed to keep its current speed and its estimated angular velocity (a constant turn rate and velocity
+model); the turn rate is limited by what the bot's speed level allows: at most maxAngularSpeed degrees per server update.
+Bots reaching the world edge are stopped at the edge and their heading is mirrored, the way the server does it.
+The bots are stored as a structure of arrays and extrapolated in a single pass, so that the loop is vectorizable.
+Not thread-safe, the owner is expected to provide the locking. */
+class BotPredictor
+{
+public:
+	BotPredictor(void);
+
+	/** Loads the bots to extrapolate from.
+	a_UpdateIntervalMSec is the server time between the updates, used to convert the speed levels' maximum angle per update
+	into the maximum turn rate; if not positive, the turn rate is not limited. */
+	void setBots(const Bots & a_Bots, const Board & a_Board, double a_UpdateIntervalMSec);
+
+	/** Extrapolates all the loaded bots a_DeltaSec seconds into the future. */
+	void predict(double a_DeltaSec);
+
+	/** Returns the number of the loaded bots. */
+	size_t size(void) const { return m_IDs.size(); }
+
+	/** Returns the ID of the bot at the specified index. */
+	int getID(size_t a_Idx) const { return m_IDs[a_Idx]; }
+
+	/** Returns the predicted values of the bot at the specified index. The angle is in degrees, in the range [0, 360). */
+	double getPredictedX(size_t a_Idx) const { return m_PredX[a_Idx]; }
+	double getPredictedY(size_t a_Idx) const { return m_PredY[a_Idx]; }
+	double getPredictedAngle(size_t a_Idx) const { return m_PredAngle[a_Idx]; }
+
+protected:
+	/** The world boundaries for the bots' centers. */
+	double m_MinX, m_MaxX, m_MinY, m_MaxY;
+
+	/** The bots' IDs. */
+	std::vector<int> m_IDs;
+
+	/** The bots' current state. The angles are in radians, the turn rates in radians per second. */
+	std::vector<double> m_X;
+	std::vector<double> m_Y;
+	std::vector<double> m_Speed;
+	std::vector<double> m_Angle;
+	std::vector<double> m_TurnRate;
+
+	/** The results of the last predict() call. */
+	std::vector<double> m_PredX;
+	std::vector<double> m_PredY;
+	std::vector<double> m_PredAngle;
+};
+
+
+
+
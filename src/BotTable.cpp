@@ -0,0 +1,116 @@
+
+// BotTable.cpp
+
+// Implements the BotTable class storing the state of all the bots in the game in a dense, ID-indexed table
+
+#include "Globals.h"
+#include "BotTable.h"
+
+
+
+
+
+BotTable::BotTable(void):
+	m_CurrentStamp(0),
+	m_NumAlive(0),
+	m_BaseID(0)
+{
+}
+
+
+
+
+
+void BotTable::clear(void)
+{
+	m_IDs.clear();
+	m_IsEnemy.clear();
+	m_IsAlive.clear();
+	m_X.clear();
+	m_Y.clear();
+	m_Speed.clear();
+	m_Angle.clear();
+	m_AngularVelocity.clear();
+	m_Acceleration.clear();
+	m_UpdateStamp.clear();
+	m_NumAlive = 0;
+	m_SlotByID.clear();
+}
+
+
+
+
+
+bool BotTable::add(int a_ID, bool a_IsEnemy, double a_X, double a_Y, double a_Speed, double a_Angle)
+{
+	// Extend the ID index to cover the new ID:
+	if (m_SlotByID.empty())
+	{
+		m_BaseID = a_ID;
+	}
+	Int64 lowestID = std::min<Int64>(m_BaseID, a_ID);
+	Int64 highestID = std::max<Int64>(m_BaseID + static_cast<Int64>(m_SlotByID.size()) - 1, a_ID);
+	if (highestID - lowestID >= MAX_ID_RANGE)
+	{
+		LOGWARNING("%s: Bot ID %d is too far from the other bots' IDs, ignoring the bot.", __FUNCTION__, a_ID);
+		return false;
+	}
+	if (a_ID < m_BaseID)
+	{
+		m_SlotByID.insert(m_SlotByID.begin(), static_cast<size_t>(m_BaseID - a_ID), -1);
+		m_BaseID = a_ID;
+	}
+	auto idx = static_cast<size_t>(a_ID - m_BaseID);
+	if (idx >= m_SlotByID.size())
+	{
+		m_SlotByID.resize(idx + 1, -1);
+	}
+	if (m_SlotByID[idx] >= 0)
+	{
+		LOGWARNING("%s: Duplicate bot ID %d, ignoring the bot.", __FUNCTION__, a_ID);
+		return false;
+	}
+
+	// Add the bot into a new slot:
+	m_SlotByID[idx] = static_cast<int>(m_IDs.size());
+	m_IDs.push_back(a_ID);
+	m_IsEnemy.push_back(a_IsEnemy ? 1 : 0);
+	m_IsAlive.push_back(1);
+	m_X.push_back(a_X);
+	m_Y.push_back(a_Y);
+	m_Speed.push_back(a_Speed);
+	m_Angle.push_back(a_Angle);
+	m_AngularVelocity.push_back(0);
+	m_Acceleration.push_back(0);
+	m_UpdateStamp.push_back(m_CurrentStamp);
+	m_NumAlive += 1;
+	return true;
+}
+
+
+
+
+
+void BotTable::beginUpdate(void)
+{
+	m_CurrentStamp += 1;
+}
+
+
+
+
+
+void BotTable::appendAliveBots(Bots & a_Bots, bool a_ShouldIncludeEnemies) const
+{
+	for (size_t i = 0, count = m_IDs.size(); i < count; i++)
+	{
+		if (m_IsAlive[i] && (a_ShouldIncludeEnemies || !m_IsEnemy[i]))
+		{
+			a_Bots.push_back(getBot(i));
+		}
+	}
+}
+
+
+
+
@@ -0,0 +1,145 @@
+
+// BotTable.h
+
+// Declares the BotTable class storing the state of all the bots in the game in a dense, ID-indexed table
+
+
+
+
+
+#pragma once
+
+#include "Bot.h"
+
+
+
+
+
+/** Stores the state of all the bots in a game, in a structure-of-arrays layout.
+Each bot occupies a slot, assigned in the order in which the bots are added at the game start; a slot is never reused
+within a game, dead bots are only marked as such. The slots are found by the bot ID using a dense index, so that the IDs
+need to be within a reasonably small range (MAX_ID_RANGE).
+The bots' deaths are detected using update stamps: each update bumps the current stamp and each reported bot is stamped
+with it, the bots with an older stamp have not been reported and are dead. This makes the detection linear in the number
+of bots.
+Not thread-safe, the owner is expected to provide the locking. */
+class BotTable
+{
+public:
+	/** The maximum difference between the lowest and the highest bot ID in the table. */
+	static const int MAX_ID_RANGE = 1 << 20;
+
+
+	BotTable(void);
+
+	/** Removes all the bots, keeping the allocated memory. */
+	void clear(void);
+
+	/** Adds a new bot to the table. Used when the game starts.
+	Returns false (and ignores the bot) if the ID is already present or out of the supported range. */
+	bool add(int a_ID, bool a_IsEnemy, double a_X, double a_Y, double a_Speed, double a_Angle);
+
+	/** Starts a new update. All the bots that are reported using update() until the next call to removeUnreported() are considered alive. */
+	void beginUpdate(void);
+
+	/** Updates the specified bot's values and marks it as reported in the current update.
+	Returns false (and ignores the values) if there's no such bot alive. */
+	bool update(int a_ID, double a_X, double a_Y, double a_Speed, double a_Angle)
+	{
+		int slot = findSlot(a_ID);
+		if ((slot < 0) || !m_IsAlive[static_cast<size_t>(slot)])
+		{
+			return false;
+		}
+		auto idx = static_cast<size_t>(slot);
+		m_X[idx] = a_X;
+		m_Y[idx] = a_Y;
+		m_Speed[idx] = a_Speed;
+		m_Angle[idx] = a_Angle;
+		m_UpdateStamp[idx] = m_CurrentStamp;
+		return true;
+	}
+
+	/** Marks all the alive bots that haven't been reported in the current update as dead.
+	Calls a_OnDied(const Bot & a_Bot) for each such bot, before it is marked dead. */
+	template <typename OnDied>
+	void removeUnreported(OnDied a_OnDied)
+	{
+		for (size_t i = 0, count = m_IDs.size(); i < count; i++)
+		{
+			if (m_IsAlive[i] && (m_UpdateStamp[i] != m_CurrentStamp))
+			{
+				a_OnDied(getBot(i));
+				m_IsAlive[i] = false;
+				m_NumAlive -= 1;
+			}
+		}
+	}
+
+	/** Appends all the alive bots to a_Bots, in the slot order.
+	If a_ShouldIncludeEnemies is false, only the player's own bots are appended. */
+	void appendAliveBots(Bots & a_Bots, bool a_ShouldIncludeEnemies) const;
+
+	/** Returns the number of bots that are alive. */
+	size_t getNumAlive(void) const { return m_NumAlive; }
+
+	/** Returns the number of slots, including the dead bots' ones. */
+	size_t getNumSlots(void) const { return m_IDs.size(); }
+
+	/** Returns true if the bot in the specified slot is alive. */
+	bool isAlive(size_t a_Slot) const { return (m_IsAlive[a_Slot] != 0); }
+
+	/** Sets the motion estimates of the bot in the specified slot, as computed by the BoardHistory. */
+	void setMotion(size_t a_Slot, double a_AngularVelocity, double a_Acceleration)
+	{
+		m_AngularVelocity[a_Slot] = a_AngularVelocity;
+		m_Acceleration[a_Slot] = a_Acceleration;
+	}
+
+	/** Returns the slot of the bot with the specified ID, or -1 if there's no such bot (alive or dead). */
+	int findSlot(int a_ID) const
+	{
+		auto idx = static_cast<size_t>(static_cast<Int64>(a_ID) - m_BaseID);  // Negative wraps around to huge
+		return (idx < m_SlotByID.size()) ? m_SlotByID[idx] : -1;
+	}
+
+	/** Returns the bot in the specified slot, as a standalone value. */
+	Bot getBot(size_t a_Slot) const
+	{
+		return Bot(
+			m_IDs[a_Slot], m_IsEnemy[a_Slot] != 0, m_X[a_Slot], m_Y[a_Slot], m_Speed[a_Slot], m_Angle[a_Slot],
+			m_AngularVelocity[a_Slot], m_Acceleration[a_Slot]
+		);
+	}
+
+protected:
+	/** The per-slot values of the bots. */
+	std::vector<int> m_IDs;
+	std::vector<char> m_IsEnemy;
+	std::vector<char> m_IsAlive;
+	std::vector<double> m_X;
+	std::vector<double> m_Y;
+	std::vector<double> m_Speed;
+	std::vector<double> m_Angle;
+	std::vector<double> m_AngularVelocity;
+	std::vector<double> m_Acceleration;
+
+	/** The stamp of the last update in which each bot has been reported. */
+	std::vector<UInt32> m_UpdateStamp;
+
+	/** The stamp of the current update. */
+	UInt32 m_CurrentStamp;
+
+	/** The number of bots that are alive. */
+	size_t m_NumAlive;
+
+	/** The lowest bot ID that can be stored in m_SlotByID. */
+	Int64 m_BaseID;
+
+	/** The index of the slots by the bot ID (minus m_BaseID), -1 for IDs not in the table. */
+	std::vector<int> m_SlotByID;
+};
+
+
+
+
@@ -8,19 +8,22 @@
 #include <fstream>
 #include <iostream>
 #include "Controller.h"
+#include "ControllerWatcher.h"
 #include "LuaController.h"
+#include "PluginController.h"
 #include "json/json.h"
 
 
 
 
 
-BotWarzApp::BotWarzApp(const AString a_LoginToken, const AString & a_LoginNick):
+BotWarzApp::BotWarzApp(const AString a_LoginToken, const AString & a_LoginNick, WorkerPool * a_WorkerPool):
 	m_Board(*this),
-	m_Comm(*this),
+	m_Comm(*this, a_WorkerPool),
 	m_LoginToken(a_LoginToken),
 	m_LoginNick(a_LoginNick),
-	m_NumGamesToPlay(-1)
+	m_NumGamesToPlay(-1),
+	m_IsInGame(false)
 {
 	LOG("Login nick: %s", a_LoginNick.c_str());
 }
@@ -29,39 +32,109 @@ BotWarzApp::BotWarzApp(const AString a_LoginToken, const AString & a_LoginNick):
 
 
 
-int BotWarzApp::run(bool a_ShouldLogComm, bool a_ShouldShowComm, const AString & a_ControllerFileName, bool a_ShouldDebugZBS, int a_NumGamesToPlay)
+BotWarzApp::~BotWarzApp()
+{
+	// Nothing explicit needed, the destructor is here so that ControllerWatcher needn't be a complete type in the header
+}
+
+
+
+
+
+int BotWarzApp::run(
+	bool a_ShouldLogComm, bool a_ShouldShowComm, const AString & a_ControllerFileName, bool a_ShouldDebugZBS, int a_NumGamesToPlay,
+	const AString & a_ServerHost, UInt16 a_ServerPort, const CommandScheduler::Settings & a_SchedulerSettings,
+	const LuaControllerSettings & a_LuaSettings
+)
+{
+	int res = start(
+		a_ShouldLogComm, a_ShouldShowComm, a_ControllerFileName, a_ShouldDebugZBS, a_NumGamesToPlay,
+		a_ServerHost, a_ServerPort, a_SchedulerSettings, a_LuaSettings
+	);
+	if (res == 0)
+	{
+		waitForTermination();
+	}
+	stop();
+	return res;
+}
+
+
+
+
+
+int BotWarzApp::start(
+	bool a_ShouldLogComm, bool a_ShouldShowComm, const AString & a_ControllerFileName, bool a_ShouldDebugZBS, int a_NumGamesToPlay,
+	const AString & a_ServerHost, UInt16 a_ServerPort, const CommandScheduler::Settings & a_SchedulerSettings,
+	const LuaControllerSettings & a_LuaSettings
+)
 {
 	m_NumGamesToPlay = a_NumGamesToPlay;
 
 	// Initialize the logging framework:
-	if (!m_Logger.init(a_ShouldLogComm, a_ShouldShowComm))
+	if (!m_Logger.init(a_ShouldLogComm, a_ShouldShowComm, m_LoginNick))
 	{
 		LOGERROR("Logger init failed, aborting.");
 		return 3;
 	}
 
-	// Initialize the Lua controller:
-	m_Controller = createLuaController(*this, a_ControllerFileName, a_ShouldDebugZBS);
+	// Initialize the controller, either a native plugin or a Lua script:
+	bool isPlugin = isPluginFileName(a_ControllerFileName);
+	if (isPlugin)
+	{
+		m_Controller = createPluginController(*this, a_ControllerFileName, a_LuaSettings.m_ShouldRunAsync);
+	}
+	else
+	{
+		m_Controller = createLuaController(*this, a_ControllerFileName, a_ShouldDebugZBS, a_LuaSettings);
+	}
 	if (!m_Controller->isValid())
 	{
 		LOGERROR("Controller init failed, aborting.");
 		return 2;
 	}
 
+	// Watch the controller's file, so that a fixed controller can take over without reconnecting.
+	// A plugin cannot be reloaded in place, the loaded library is shared with the other sessions and stays mapped until all release it:
+	if (!isPlugin && (a_LuaSettings.m_ReloadPollMSec > 0))
+	{
+		m_ControllerWatcher.reset(new ControllerWatcher(
+			a_ControllerFileName,
+			[this, a_ControllerFileName, a_ShouldDebugZBS, a_LuaSettings]()
+			{
+				return createLuaController(*this, a_ControllerFileName, a_ShouldDebugZBS, a_LuaSettings);
+			},
+			m_LoginNick, a_LuaSettings.m_ReloadPollMSec
+		));
+	}
+
 	// Initialize the server communication interface:
-	if (!m_Comm.init())
+	if (!m_Comm.init(a_ServerHost, a_ServerPort, a_SchedulerSettings))
 	{
 		LOGERROR("Comm::init() failed.");
 		return 1;
 	}
 
-	// Wait for the termination request:
+	return 0;
+}
+
+
+
+
+
+void BotWarzApp::waitForTermination(void)
+{
 	m_evtTerminate.Wait();
+}
 
-	// Stop everything:
-	m_Comm.stop();
 
-	return 0;
+
+
+
+void BotWarzApp::stop(void)
+{
+	m_ControllerWatcher.reset();
+	m_Comm.stop();
 }
 
 
@@ -79,7 +152,11 @@ void BotWarzApp::terminate(void)
 
 void BotWarzApp::startGame(const Json::Value & a_GameData)
 {
+	swapReloadedController();
+	m_TickLatency.clear();
+	m_ClockSync.clear();
 	m_Board.initialize(a_GameData);
+	m_IsInGame = true;
 
 	// Send the message to m_Controller, but take care of multithreading / reloading:
 	auto controller = m_Controller;
@@ -95,7 +172,9 @@ void BotWarzApp::startGame(const Json::Value & a_GameData)
 
 void BotWarzApp::updateBoard(const Json::Value & a_GameData)
 {
+	swapReloadedController();
 	m_Board.updateFromJson(a_GameData);
+	m_TickLatency.mark(TickLatency::stBoardUpdated);
 
 	// Send the message to m_Controller, but take care of multithreading / reloading:
 	auto controller = m_Controller;
@@ -103,6 +182,36 @@ void BotWarzApp::updateBoard(const Json::Value & a_GameData)
 	{
 		controller->onGameUpdate();
 	}
+	if ((controller == nullptr) || !controller->isAsync())
+	{
+		m_TickLatency.mark(TickLatency::stControllerUpdated);
+	}
+}
+
+
+
+
+
+bool BotWarzApp::updateBoardFromPlayMessage(const char * a_Data, size_t a_Length, int & a_LastCmdId)
+{
+	swapReloadedController();
+	if (!m_Board.updateFromPlayMessage(a_Data, a_Length, a_LastCmdId))
+	{
+		return false;
+	}
+	m_TickLatency.mark(TickLatency::stBoardUpdated);
+
+	// Send the message to m_Controller, but take care of multithreading / reloading:
+	auto controller = m_Controller;
+	if (controller != nullptr)
+	{
+		controller->onGameUpdate();
+	}
+	if ((controller == nullptr) || !controller->isAsync())
+	{
+		m_TickLatency.mark(TickLatency::stControllerUpdated);
+	}
+	return true;
 }
 
 
@@ -117,6 +226,20 @@ void BotWarzApp::finishGame(const Json::Value & a_ResultData)
 	{
 		controller->onGameFinished();
 	}
+	m_IsInGame = false;
+
+	// Report the tick latencies:
+	for (auto & line: m_TickLatency.getSummary())
+	{
+		LOG("%s: %s", m_LoginNick.c_str(), line.c_str());
+	}
+	m_Logger.latencyLog(m_TickLatency.getStatsJson());
+	auto snapshotStats = m_Board.getSnapshotStats();
+	LOG("%s: %s", m_LoginNick.c_str(), snapshotStats.c_str());
+	m_Logger.commentLog(snapshotStats);
+	auto clockStats = m_ClockSync.getStatsString();
+	LOG("%s: %s", m_LoginNick.c_str(), clockStats.c_str());
+	m_Logger.commentLog(clockStats);
 
 	// Check whether the number of games is limited:
 	if (m_NumGamesToPlay > 0)
@@ -147,9 +270,9 @@ void BotWarzApp::botDied(const Bot & a_Bot)
 
 
 
-void BotWarzApp::commLog(bool a_IsIncoming, const AString & a_Msg)
+void BotWarzApp::commLog(bool a_IsIncoming, const char * a_Data, size_t a_Length)
 {
-	m_Logger.commLog(a_IsIncoming, a_Msg);
+	m_Logger.commLog(a_IsIncoming, a_Data, a_Length);
 }
 
 
@@ -174,9 +297,77 @@ void BotWarzApp::commentLog(const AString & a_Msg)
 
 
 
-Json::Value BotWarzApp::getBotCommands(void)
+void BotWarzApp::getBotCommands(BotCommands & a_Commands)
+{
+	getController()->getBotCommands(a_Commands);
+}
+
+
+
+
+
+void BotWarzApp::commandsSent(void)
+{
+	getController()->onCommandsSent();
+}
+
+
+
+
+
+void BotWarzApp::setController(SharedPtr<Controller> a_Controller)
+{
+	cCSLock Lock(m_CSController);
+	m_Controller = a_Controller;
+}
+
+
+
+
+
+void BotWarzApp::swapReloadedController(void)
+{
+	if ((m_ControllerWatcher == nullptr) || !m_ControllerWatcher->hasReloaded())
+	{
+		return;
+	}
+	auto newController = m_ControllerWatcher->takeReloaded();
+	if (newController == nullptr)
+	{
+		return;
+	}
+
+	// Migrate the state and let the new version catch up with the game in progress, before it takes over:
+	auto oldController = m_Controller;
+	newController->restoreState(oldController->saveState());
+	if (m_IsInGame)
+	{
+		newController->onGameResumed(m_Board);
+	}
+	{
+		cCSLock Lock(m_CSController);
+		m_Controller = newController;
+	}
+
+	auto msg = Printf("The reloaded controller has taken over %s", m_IsInGame ? "in the middle of the game" : "between games");
+	LOG("%s: %s", m_LoginNick.c_str(), msg.c_str());
+	commentLog(msg);
+
+	// Let the old version report the statistics of the game so far, it won't see the game's finish:
+	if (m_IsInGame)
+	{
+		oldController->onRetired();
+	}
+}
+
+
+
+
+
+SharedPtr<Controller> BotWarzApp::getController(void)
 {
-	return m_Controller->getBotCommands();
+	cCSLock Lock(m_CSController);
+	return m_Controller;
 }
 
 
@@ -12,7 +12,11 @@
 #include "Comm.h"
 #include "Board.h"
 #include "Logger.h"
+#include "TickLatency.h"
+#include "ClockSync.h"
+#include "LuaController.h"
 #include "lib/Network/Event.h"
+#include "lib/Network/CriticalSection.h"
 
 
 
@@ -20,6 +24,8 @@
 
 // fwd:
 class Controller;
+class ControllerWatcher;
+class WorkerPool;
 
 
 
@@ -28,16 +34,45 @@ class Controller;
 class BotWarzApp
 {
 public:
-	BotWarzApp(const AString a_LoginToken, const AString & a_LoginNick);
+	/** Creates a new app instance (a session) for the specified login.
+	If a_WorkerPool is non-null, the server messages are processed (and a synchronous controller is called) on the pool's threads,
+	so that multiple sessions can share a single process; otherwise they are processed directly in the network thread. */
+	BotWarzApp(const AString a_LoginToken, const AString & a_LoginNick, WorkerPool * a_WorkerPool);
 
-	/** Runs the entire application.
+	~BotWarzApp();
+
+	/** Runs the entire application: start(), waitForTermination() and stop().
 	If a_ShouldLogComm is true, all the communication with the server is logged into a file.
 	If a_ShouldShowComm is true, all the communication with the server is output to stdout.
-	a_ControllerFileName is the name of the Lua file to use for the controller.
+	a_ControllerFileName is the name of the Lua file to use for the controller, or of the native plugin (see PluginController.h).
 	If a_ShouldDebugZBS is true, a ZBS debugger code is prepended to the Lua controller script, enabling debugging in ZeroBrane Studio.
 	If a_NumGamesToPlay is positive, the app will exit after playing that many games; no limit if the number is negative.
+	a_ServerHost and a_ServerPort specify the BotWarz server to connect to (the live server or a local simulator).
+	a_SchedulerSettings specifies how the commands sent to the server are timed.
+	a_LuaSettings specifies the limits of the Lua controller, and whether its file is watched for changes and reloaded;
+	of these, only the switch to run the controller in its own thread applies to a plugin.
 	Returns the value that the process should return to the OS upon its exit. */
-	int run(bool a_ShouldLogComm, bool a_ShouldShowComm, const AString & a_ControllerFileName, bool a_ShouldDebugZBS, int a_NumGamesToPlay);
+	int run(
+		bool a_ShouldLogComm, bool a_ShouldShowComm, const AString & a_ControllerFileName, bool a_ShouldDebugZBS, int a_NumGamesToPlay,
+		const AString & a_ServerHost, UInt16 a_ServerPort, const CommandScheduler::Settings & a_SchedulerSettings,
+		const LuaControllerSettings & a_LuaSettings
+	);
+
+	/** Starts the application - initializes the logging and the controller, connects to the server and logs in.
+	The parameters are the same as for run().
+	Returns zero on success, or the value that the process should return to the OS if the app cannot start.
+	stop() needs to be called even if the start fails. */
+	int start(
+		bool a_ShouldLogComm, bool a_ShouldShowComm, const AString & a_ControllerFileName, bool a_ShouldDebugZBS, int a_NumGamesToPlay,
+		const AString & a_ServerHost, UInt16 a_ServerPort, const CommandScheduler::Settings & a_SchedulerSettings,
+		const LuaControllerSettings & a_LuaSettings
+	);
+
+	/** Waits until the app is requested to terminate (the number of games has been played, or the connection failed). */
+	void waitForTermination(void);
+
+	/** Disconnects from the server and stops everything. */
+	void stop(void);
 
 	/** Notifies the app that it should terminate.
 	Wakes up the main thread to do the actual termination. */
@@ -51,6 +86,11 @@ public:
 	a_Board is the contents of the "play" tag in the game update message. */
 	void updateBoard(const Json::Value & a_Board);
 
+	/** Updates the board directly from the raw "play" message received from the server, bypassing the Json DOM.
+	a_LastCmdId receives the "lastCmdId" value from the message.
+	Returns false if the message cannot be parsed this way; the caller should then use updateBoard(), which overwrites any partial update. */
+	bool updateBoardFromPlayMessage(const char * a_Data, size_t a_Length, int & a_LastCmdId);
+
 	/** Called when the current game is finished.
 	a_ResultData is the contents of the "result" tag of the server message. */
 	void finishGame(const Json::Value & a_ResultData);
@@ -59,7 +99,7 @@ public:
 	void botDied(const Bot & a_Bot);
 
 	/** Outputs a message to the commlog / screen, if requested. Relayed to m_Logger. */
-	void commLog(bool a_IsIncoming, const AString & a_Msg);
+	void commLog(bool a_IsIncoming, const char * a_Data, size_t a_Length);
 
 	/** Outputs a message to the log, pertaining to a specific bot. Relayed to m_Logger. */
 	void aiLog(int a_BotID, const AString & a_Msg);
@@ -69,8 +109,20 @@ public:
 
 	const AString & getLoginToken(void) const { return m_LoginToken; }
 	const AString & getLoginNick(void) const { return m_LoginNick; }
+	const Logger & getLogger(void) const { return m_Logger; }
+	const Board & getBoard(void) const { return m_Board; }
+	TickLatency & getTickLatency(void) { return m_TickLatency; }
+	ClockSync & getClockSync(void) { return m_ClockSync; }
+
+	/** Fills a_Commands with the bot commands to be sent to the server, as provided by the controller. */
+	void getBotCommands(BotCommands & a_Commands);
 
-	Json::Value getBotCommands(void);
+	/** Notifies the controller that the commands have been sent to the server. */
+	void commandsSent(void);
+
+	/** Replaces the controller, without watching its file.
+	Used by the tools that drive the controller without a server, such as the benchmarks. */
+	void setController(SharedPtr<Controller> a_Controller);
 
 protected:
 	/** The representation of the game board. */
@@ -79,9 +131,21 @@ protected:
 	/** The logging framework. */
 	Logger m_Logger;
 
-	/** The AI controller to use for driving the bots. */
+	/** The latency measurements of the individual stages of processing the game ticks, reported at the end of each game. */
+	TickLatency m_TickLatency;
+
+	/** The estimate of the server's game time on the local clock, fed by m_Comm with the arrivals of the game updates.
+	Must be declared before m_Comm, whose scheduler uses it. */
+	ClockSync m_ClockSync;
+
+	/** The AI controller to use for driving the bots.
+	Replaced by its reloaded version only in the thread processing the server messages, which therefore reads it without locking;
+	the other threads need to lock m_CSController to make a copy. */
 	SharedPtr<Controller> m_Controller;
 
+	/** Protects m_Controller against being replaced while another thread is making its copy. */
+	cCriticalSection m_CSController;
+
 	/** The communication interface to the server. */
 	Comm m_Comm;
 
@@ -96,6 +160,22 @@ protected:
 
 	/** The number of games to play. If positive, each game decrements this on finish, when it reaches zero, the app will terminate. */
 	int m_NumGamesToPlay;
+
+	/** True while a game is being played (between startGame() and finishGame()). Only accessed from the thread processing the server messages. */
+	bool m_IsInGame;
+
+	/** Watches the controller's file and loads its new versions in the background; nullptr if the file isn't watched.
+	Declared last, so that it is stopped before the rest of the app is destroyed. */
+	UniquePtr<ControllerWatcher> m_ControllerWatcher;
+
+
+	/** If the watcher has loaded a new version of the controller, migrates the state into it from the current one
+	and makes it the current controller. If in the middle of a game, the new version resumes the game from the current board.
+	Called in the thread processing the server messages, between games and at the tick boundaries, before the board is updated. */
+	void swapReloadedController(void);
+
+	/** Returns a copy of the current controller. To be used by the threads other than the one processing the server messages. */
+	SharedPtr<Controller> getController(void);
 };
 
 
@@ -0,0 +1,216 @@
+
+// ClockSync.cpp
+
+// Implements the ClockSync class that estimates the relation between the server's game time and the local steady clock
+
+#include "Globals.h"
+#include "ClockSync.h"
+
+
+
+
+
+/** The number of the most recent samples used for the estimate. */
+static const size_t WINDOW_SIZE = 64;
+
+/** The number of blocks into which the window is divided; the least delayed sample of each block is used for the fit. */
+static const size_t NUM_BLOCKS = 8;
+
+/** The number of samples needed before the estimate is considered usable. */
+static const int MIN_SYNCED_SAMPLES = 4;
+
+/** The maximum relative drift between the clocks considered plausible; a larger fitted drift is clamped to it. */
+static const double MAX_DRIFT = 0.001;
+
+
+
+
+
+ClockSync::ClockSync(void)
+{
+	clear();
+}
+
+
+
+
+
+void ClockSync::clear(void)
+{
+	cCSLock Lock(m_CS);
+	m_Samples.clear();
+	m_Samples.reserve(WINDOW_SIZE);
+	m_NextSample = 0;
+	m_NumSamples = 0;
+	m_Offset = 0;
+	m_Rate = 1;
+	m_Uncertainty = 0;
+}
+
+
+
+
+
+void ClockSync::addSample(TimePoint a_ReceivedTime, int a_ServerTime)
+{
+	cCSLock Lock(m_CS);
+	if (m_NumSamples == 0)
+	{
+		m_BaseTime = a_ReceivedTime;
+	}
+	Sample sample;
+	sample.m_LocalMSec = std::chrono::duration_cast<std::chrono::microseconds>(a_ReceivedTime - m_BaseTime).count() / 1000.0;
+	sample.m_ServerTime = a_ServerTime;
+	if (m_Samples.size() < WINDOW_SIZE)
+	{
+		m_Samples.push_back(sample);
+	}
+	else
+	{
+		m_Samples[m_NextSample] = sample;
+		m_NextSample = (m_NextSample + 1) % WINDOW_SIZE;
+	}
+	m_NumSamples += 1;
+	recalculate();
+}
+
+
+
+
+
+bool ClockSync::isSynced(void) const
+{
+	cCSLock Lock(m_CS);
+	return (m_NumSamples >= MIN_SYNCED_SAMPLES);
+}
+
+
+
+
+
+double ClockSync::getServerTime(TimePoint a_LocalTime) const
+{
+	cCSLock Lock(m_CS);
+	if (m_NumSamples == 0)
+	{
+		return 0;
+	}
+	double localMSec = std::chrono::duration_cast<std::chrono::microseconds>(a_LocalTime - m_BaseTime).count() / 1000.0;
+	return (localMSec - m_Offset) / m_Rate;
+}
+
+
+
+
+
+ClockSync::TimePoint ClockSync::getArrivalTime(double a_ServerTime) const
+{
+	cCSLock Lock(m_CS);
+	if (m_NumSamples == 0)
+	{
+		return Clock::now();
+	}
+	return m_BaseTime + std::chrono::microseconds(static_cast<Int64>((m_Offset + m_Rate * a_ServerTime) * 1000));
+}
+
+
+
+
+
+double ClockSync::getUncertainty(void) const
+{
+	cCSLock Lock(m_CS);
+	return m_Uncertainty;
+}
+
+
+
+
+
+AString ClockSync::getStatsString(void) const
+{
+	cCSLock Lock(m_CS);
+	return Printf("Clock sync: %d samples; arrival offset %.1f msec, drift %.1f ppm, uncertainty %.1f msec",
+		m_NumSamples, m_Offset, (m_Rate - 1) * 1e6, m_Uncertainty
+	);
+}
+
+
+
+
+
+void ClockSync::recalculate(void)
+{
+	size_t count = m_Samples.size();
+	ASSERT(count > 0);
+
+	// Until there are at least two samples per block, the drift cannot be told from the jitter, assume none:
+	m_Rate = 1;
+	if (count >= 2 * NUM_BLOCKS)
+	{
+		// Pick the least delayed sample from each block:
+		size_t blockSize = count / NUM_BLOCKS;
+		Sample mins[NUM_BLOCKS];
+		double sumS = 0, sumL = 0;
+		for (size_t block = 0; block < NUM_BLOCKS; block++)
+		{
+			const Sample * best = nullptr;
+			for (size_t age = block * blockSize, end = age + blockSize; age < end; age++)
+			{
+				auto & sample = getSample(age);
+				if ((best == nullptr) || (sample.m_LocalMSec - sample.m_ServerTime < best->m_LocalMSec - best->m_ServerTime))
+				{
+					best = &sample;
+				}
+			}
+			mins[block] = *best;
+			sumS += best->m_ServerTime;
+			sumL += best->m_LocalMSec;
+		}
+
+		// Fit the line through the minima (least squares, centered for the numerical stability):
+		double meanS = sumS / NUM_BLOCKS;
+		double meanL = sumL / NUM_BLOCKS;
+		double sxx = 0, sxy = 0;
+		for (auto & sample: mins)
+		{
+			double ds = sample.m_ServerTime - meanS;
+			sxx += ds * ds;
+			sxy += ds * (sample.m_LocalMSec - meanL);
+		}
+		if (sxx > 0)
+		{
+			m_Rate = std::min(std::max(sxy / sxx, 1 - MAX_DRIFT), 1 + MAX_DRIFT);
+		}
+	}
+
+	// Shift the line to lie below all the samples in the window, and measure the delays above it:
+	double minDelay = std::numeric_limits<double>::max();
+	double sumDelay = 0;
+	for (auto & sample: m_Samples)
+	{
+		double delay = sample.m_LocalMSec - m_Rate * sample.m_ServerTime;
+		minDelay = std::min(minDelay, delay);
+		sumDelay += delay;
+	}
+	m_Offset = minDelay;
+	m_Uncertainty = sumDelay / count - minDelay;
+}
+
+
+
+
+
+const ClockSync::Sample & ClockSync::getSample(size_t a_Age) const
+{
+	ASSERT(a_Age < m_Samples.size());
+	if (m_Samples.size() < WINDOW_SIZE)
+	{
+		return m_Samples[m_Samples.size() - 1 - a_Age];
+	}
+	return m_Samples[(m_NextSample + WINDOW_SIZE - 1 - a_Age) % WINDOW_SIZE];
+}
+
+
+
+
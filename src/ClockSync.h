@@ -0,0 +1,103 @@
+
+// ClockSync.h
+
+// Declares the ClockSync class that estimates the relation between the server's game time and the local steady clock
+
+
+
+
+
+#pragma once
+
+#include "lib/Network/CriticalSection.h"
+
+
+
+
+
+/** Estimates the relation between the server's game time and the local steady clock, from the local arrival times
+of the game updates and the server times contained in them.
+The arrivals are modelled as a line, localTime = offset + rate * serverTime, plus the network delay, which is never negative.
+The line is fitted through the least delayed arrivals of the recent updates (the minimum in each of several blocks of the window),
+so that it follows both the offset and the drift between the clocks, and is then shifted to lie below all the arrivals in the window.
+The "server time" estimated for a local time is therefore the time of the server update that would arrive at that moment
+with the least delay seen; the one-way part of the delay cannot be observed from this side alone.
+All the local times are steady-clock times, so they aren't affected by the system clock adjustments.
+The object is thread-safe. */
+class ClockSync
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+	typedef Clock::time_point TimePoint;
+
+
+	ClockSync(void);
+
+	/** Removes all the samples, used when a new game starts. */
+	void clear(void);
+
+	/** Adds the sample of a single game update, a_ReceivedTime is the local time when its data arrived from the network. */
+	void addSample(TimePoint a_ReceivedTime, int a_ServerTime);
+
+	/** Returns true if there are enough samples for the estimate to be usable. */
+	bool isSynced(void) const;
+
+	/** Returns the estimated server time corresponding to the specified local time, in msec.
+	If there are no samples yet, returns zero. */
+	double getServerTime(TimePoint a_LocalTime) const;
+
+	/** Returns the estimated local time when the update with the specified server time arrives, with the least delay. */
+	TimePoint getArrivalTime(double a_ServerTime) const;
+
+	/** Returns the estimated uncertainty of the server time estimate, in msec: the average delay of the arrivals in the window
+	above the fitted line, i.e. the network jitter. */
+	double getUncertainty(void) const;
+
+	/** Returns a one-line human-readable summary of the current estimate. */
+	AString getStatsString(void) const;
+
+protected:
+	/** A single sample of an update's arrival. */
+	struct Sample
+	{
+		/** The local arrival time, in msec since m_BaseTime. */
+		double m_LocalMSec;
+
+		/** The server time contained in the update, in msec. */
+		double m_ServerTime;
+	};
+
+
+	/** Protects all the members against multithreaded access. */
+	mutable cCriticalSection m_CS;
+
+	/** The local arrival time of the first sample, all the local times in msec are relative to it. */
+	TimePoint m_BaseTime;
+
+	/** The recent samples, a ring buffer. */
+	std::vector<Sample> m_Samples;
+
+	/** The index into m_Samples where the next sample is written, once the buffer is full. */
+	size_t m_NextSample;
+
+	/** The total number of samples added since the last clear(). */
+	int m_NumSamples;
+
+	/** The fitted line: localMSec = m_Offset + m_Rate * serverTime. */
+	double m_Offset;
+	double m_Rate;
+
+	/** The current uncertainty estimate, in msec. */
+	double m_Uncertainty;
+
+
+	/** Recalculates the estimate from the samples in the window. */
+	void recalculate(void);
+
+	/** Returns the sample at the specified age, 0 being the latest one. */
+	const Sample & getSample(size_t a_Age) const;
+};
+
+
+
+
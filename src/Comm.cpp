@@ -11,6 +11,7 @@
 #include "json/json.h"
 #include "sha1.h"
 #include "BotWarzApp.h"
+#include "PlayParser.h"
 
 
 
@@ -43,26 +44,28 @@ protected:
 
 	virtual void OnReceivedData(const char * a_Data, size_t a_Length) override
 	{
-		m_Comm.onIncomingData(AString(a_Data, a_Length));
+		m_Comm.onIncomingData(a_Data, a_Length);
 	}
 
 	virtual void OnRemoteClosed(void) override
 	{
 		LOG("Server closed the connection, terminating.");
-		m_Comm.abortConnection();
+		m_Comm.abortConnectionAfterReceivedData();
 	}
 
 	virtual void OnConnected(cTCPLink & a_Link) override
 	{
 		// Nothing needed, server talks first
+		// Note that a fast server (such as a local simulator) may have already sent the handshake request, don't overwrite the status then
 		LOG("Connected to the server. Waiting for the handshake request.");
-		m_Comm.m_Status = Comm::csConnected;
+		auto expected = Comm::csConnecting;
+		m_Comm.m_Status.compare_exchange_strong(expected, Comm::csConnected);
 	}
 
 	virtual void OnError(int a_ErrorCode, const AString & a_ErrorMsg) override
 	{
 		LOGERROR("Error while connecting to the BotWarz server: %d (%s)", a_ErrorCode, a_ErrorMsg.c_str());
-		m_Comm.abortConnection();
+		m_Comm.abortConnectionAfterReceivedData();
 	}
 };
 
@@ -73,13 +76,14 @@ protected:
 ////////////////////////////////////////////////////////////////////////////////
 // Comm:
 
-Comm::Comm(BotWarzApp & a_App):
+Comm::Comm(BotWarzApp & a_App, WorkerPool * a_WorkerPool):
 	m_App(a_App),
+	m_ProcessingQueue((a_WorkerPool != nullptr) ? new WorkerPool::SerialQueue(*a_WorkerPool) : nullptr),
 	m_Status(csConnecting),
 	m_ShouldTerminate(false),
+	m_Scheduler(a_App.getClockSync()),
 	m_LastSentCmdId(1),
-	m_LastReceivedCmdId(1),
-	m_CommandSenderThread(&Comm::commandSenderThread, this)
+	m_LastReceivedCmdId(1)
 {
 }
 
@@ -87,14 +91,20 @@ Comm::Comm(BotWarzApp & a_App):
 
 
 
-bool Comm::init(void)
+bool Comm::init(const AString & a_ServerHost, UInt16 a_ServerPort, const CommandScheduler::Settings & a_SchedulerSettings)
 {
+	m_Scheduler.setSettings(a_SchedulerSettings);
+
+	// Start the thread that will be sending the commands once a game starts:
+	m_CommandSenderThread = std::thread(&Comm::commandSenderThread, this);
+
 	// Connect to the server:
+	LOG("Connecting to server %s:%u", a_ServerHost.c_str(), static_cast<unsigned>(a_ServerPort));
 	auto callbacks = std::make_shared<Callbacks>(*this);
-	if (!cNetwork::Connect("botwarz.eset.com", 8080, callbacks, callbacks))
+	if (!cNetwork::Connect(a_ServerHost, a_ServerPort, callbacks, callbacks))
 	{
 		m_Status = csError;
-		LOGERROR("Cannot connect to server");
+		LOGERROR("Cannot connect to server %s:%u", a_ServerHost.c_str(), static_cast<unsigned>(a_ServerPort));
 		return false;
 	}
 
@@ -123,11 +133,23 @@ void Comm::stop(void)
 		m_Link.reset();
 	}
 
+	// Wait for the network thread to finish processing any incoming data, including the lines queued in the worker pool:
+	{
+		cCSLock Lock(m_CSIncoming);
+	}
+	if (m_ProcessingQueue != nullptr)
+	{
+		m_ProcessingQueue->drain();
+	}
+
 	// Wake up the update sender thread and wait for it to terminate:
 	m_ShouldTerminate = true;
 	m_evtGameStart.Set();
-	m_evtCommandIdMatch.Set();
-	m_CommandSenderThread.join();
+	m_evtScheduleChange.Set();
+	if (m_CommandSenderThread.joinable())
+	{
+		m_CommandSenderThread.join();
+	}
 }
 
 
@@ -137,7 +159,7 @@ void Comm::stop(void)
 void Comm::send(const AString & a_Data)
 {
 	// Log to file, if requested:
-	m_App.commLog(false, a_Data);
+	m_App.commLog(false, a_Data.data(), a_Data.size());
 
 	m_Link->Send(a_Data);
 }
@@ -158,40 +180,67 @@ void Comm::send(const Json::Value & a_Data)
 
 
 
-void Comm::onIncomingData(const AString & a_Data)
+void Comm::onIncomingData(const char * a_Data, size_t a_Length)
 {
+	cCSLock Lock(m_CSIncoming);
+	auto receivedTime = CommandScheduler::Clock::now();
+
 	// Log to file / screen, if requested:
-	m_App.commLog(true, a_Data);
+	m_App.commLog(true, a_Data, a_Length);
 
-	// Process the data, linewise:
-	auto queuedEnd = m_QueuedData.size();
-	m_QueuedData.append(a_Data);
-	auto dataLen = m_QueuedData.size();
-	size_t lineStart = 0;
-	for (auto i = queuedEnd; i < dataLen; i++)
-	{
-		if (m_QueuedData[i] == '\n')
+	// Process the data, linewise, stop processing once the connection is aborted:
+	m_LineFramer.process(a_Data, a_Length, [this, receivedTime](const char * a_Line, size_t a_LineLength)
 		{
-			processLine(m_QueuedData.substr(lineStart, i - lineStart));
-			lineStart = i + 1;
+			// If there's a worker pool, process the line there, so that a slow controller doesn't hold up the other sessions:
+			if (m_ProcessingQueue != nullptr)
+			{
+				AString line(a_Line, a_LineLength);
+				m_ProcessingQueue->post([this, receivedTime, line]()
+					{
+						if (m_Status != csError)
+						{
+							m_ReceivedTime = receivedTime;
+							processLine(line.data(), line.size());
+						}
+					}
+				);
+				return true;
+			}
+
+			m_ReceivedTime = receivedTime;
+			processLine(a_Line, a_LineLength);
+			return (m_Status != csError);
 		}
-	}  // for i - m_QueuedData[]
-	if (lineStart > 0)
-	{
-		m_QueuedData.erase(0, lineStart);
-	}
+	);
 }
 
 
 
 
 
-void Comm::processLine(const AString & a_Line)
+void Comm::processLine(const char * a_Line, size_t a_Length)
 {
+	// The "play" messages are by far the most frequent ones, parse them directly into the board, without the Json DOM:
+	bool isInGame = (m_Status == csGame);
+	if (isInGame)
+	{
+		m_App.getTickLatency().mark(TickLatency::stReceived, m_ReceivedTime);
+	}
+	if (isInGame && PlayParser::isPlayMessage(a_Line, a_Length))
+	{
+		int lastCmdId = m_LastReceivedCmdId;
+		if (m_App.updateBoardFromPlayMessage(a_Line, a_Length, lastCmdId))
+		{
+			updateLastReceivedCmdId(lastCmdId);
+			return;
+		}
+		// The specialized parser failed, let the generic one process the message (and report any errors)
+	}
+
 	// Parse the line into Json:
 	Json::Value root;
 	Json::Reader reader;
-	if (!reader.parse(a_Line, root, false))
+	if (!reader.parse(a_Line, a_Line + a_Length, root, false))
 	{
 		LOGWARNING("%s: Cannot parse incoming Json: %s", __FUNCTION__, reader.getFormattedErrorMessages().c_str());
 		return;
@@ -242,7 +291,7 @@ void Comm::processLine(const AString & a_Line)
 		return;
 	}
 
-	LOGWARNING("%s: Received an unknown message: %s", __FUNCTION__, a_Line.c_str());
+	LOGWARNING("%s: Received an unknown message: %.*s", __FUNCTION__, static_cast<int>(a_Length), a_Line);
 }
 
 
@@ -292,7 +341,7 @@ void Comm::processLoginOK(const Json::Value & a_Response)
 	if (m_Status != csWaitingForHandshake)
 	{
 		LOGERROR("%s: login_ok status received while status not WaitingForHandshake (exp %d, got %d). Aborting",
-			__FUNCTION__, csWaitingForHandshake, m_Status
+			__FUNCTION__, csWaitingForHandshake, m_Status.load()
 		);
 		abortConnection();
 		return;
@@ -311,7 +360,7 @@ void Comm::processLoginFailed(const Json::Value & a_Response)
 	if (m_Status != csWaitingForHandshake)
 	{
 		LOGERROR("%s: login_failed status received while status not WaitingForHandshake (exp %d, got %d). Aborting",
-			__FUNCTION__, csWaitingForHandshake, m_Status
+			__FUNCTION__, csWaitingForHandshake, m_Status.load()
 		);
 		abortConnection();
 		return;
@@ -341,11 +390,12 @@ void Comm::processGame(const Json::Value & a_Response)
 {
 	if (m_Status != csIdle)
 	{
-		LOGERROR("%s: game started while not expecting it (status %d). Aborting.", __FUNCTION__, m_Status);
+		LOGERROR("%s: game started while not expecting it (status %d). Aborting.", __FUNCTION__, m_Status.load());
 		abortConnection();
 		return;
 	}
 
+	m_Scheduler.startGame();
 	m_Status = csGame;
 	LOG("Starting game: %s against %s",
 		a_Response["game"]["players"][0]["nickname"].asCString(),
@@ -364,21 +414,30 @@ void Comm::processPlay(const Json::Value & a_Response)
 	if (m_Status != csGame)
 	{
 		LOGERROR("%s: Received a \"play\" response while not in a game (status %d). Aborting.",
-			__FUNCTION__, m_Status
+			__FUNCTION__, m_Status.load()
 		);
 		abortConnection();
 		return;
 	}
 
+	m_App.getTickLatency().mark(TickLatency::stParsed);
 	m_App.updateBoard(a_Response["play"]);
+	updateLastReceivedCmdId(a_Response["play"]["lastCmdId"].asInt());
+}
 
-	// If the received lastCmdId starts matching our cmdId, wake up the command sender:
-	auto prevLastReceivedCmdId = m_LastReceivedCmdId;
-	m_LastReceivedCmdId = a_Response["play"]["lastCmdId"].asInt();
-	if ((m_LastReceivedCmdId == m_LastSentCmdId) && (m_LastReceivedCmdId != prevLastReceivedCmdId))
-	{
-		m_evtCommandIdMatch.Set();
-	}
+
+
+
+
+void Comm::updateLastReceivedCmdId(int a_LastCmdId)
+{
+	m_LastReceivedCmdId = a_LastCmdId;
+
+	// Let the clock estimate and the scheduler learn the server's ticks and the acknowledgement,
+	// then let the command sender re-check its schedule:
+	m_App.getClockSync().addSample(m_ReceivedTime, m_App.getBoard().getServerTime());
+	m_Scheduler.onGameUpdate(m_ReceivedTime, m_App.getBoard().getServerTime(), a_LastCmdId);
+	m_evtScheduleChange.Set();
 }
 
 
@@ -390,7 +449,7 @@ void Comm::processResult(const Json::Value & a_Response)
 	if (m_Status != csGame)
 	{
 		LOGERROR("%s: Received a \"result\" response while not in a game (status %d). Aborting.",
-			__FUNCTION__, m_Status
+			__FUNCTION__, m_Status.load()
 		);
 		abortConnection();
 		return;
@@ -404,14 +463,14 @@ void Comm::processResult(const Json::Value & a_Response)
 	{
 		LOG("Game finished. Draw.");
 	}
+	AString schedulerStats = m_Scheduler.getStatsString();
+	LOG("%s: %s", m_App.getLoginNick().c_str(), schedulerStats.c_str());
+	m_App.commentLog(schedulerStats);
 	m_App.finishGame(a_Response["result"]);
 	m_Status = csIdle;
 
 	// Wake up the command sender thread, if it was waiting to send a command:
-	if ((m_LastReceivedCmdId != m_LastSentCmdId))
-	{
-		m_evtCommandIdMatch.Set();
-	}
+	m_evtScheduleChange.Set();
 }
 
 
@@ -428,18 +487,40 @@ void Comm::abortConnection(void)
 		m_Link.reset();
 	}
 
-	// If we were waiting for a handshake, wake up the main thread:
-	if (m_Status == csWaitingForHandshake)
+	// Set the status to Error, so that the future operations fail:
+	auto oldStatus = m_Status.exchange(csError);
+	bool isHandshaking = ((oldStatus == csConnecting) || (oldStatus == csConnected) || (oldStatus == csWaitingForHandshake));
+
+	// Terminate the entire app:
+	m_App.terminate();
+
+	// If we were waiting for a handshake, wake up the main thread.
+	// This needs to be the last action, the main thread may destroy this object as soon as it wakes up.
+	if (isHandshaking)
 	{
-		m_Status = csError;
 		m_evtHandshake.Set();
 	}
+}
 
-	// Set the status to Error, so that the future operations fail:
-	m_Status = csError;
 
-	// Terminate the entire app:
-	m_App.terminate();
+
+
+
+void Comm::abortConnectionAfterReceivedData(void)
+{
+	if (m_ProcessingQueue == nullptr)
+	{
+		abortConnection();
+		return;
+	}
+
+	// Queue the abort after the lines already received, so that they (such as the final "result") are still processed:
+	cCSLock Lock(m_CSIncoming);
+	m_ProcessingQueue->post([this]()
+		{
+			abortConnection();
+		}
+	);
 }
 
 
@@ -458,11 +539,11 @@ void Comm::commandSenderThread(void)
 			// Send the commands:
 			sendCommands();
 
-			// Wait for the game update with the matching command ID:
-			m_evtCommandIdMatch.Wait();
-
-			// The command ID has just matched, wait for 200 msec before sending new commands:
-			std::this_thread::sleep_for(std::chrono::milliseconds(200));
+			// Wait until the scheduler decides that the next commands should be sent:
+			if (!waitForNextSendTime())
+			{
+				break;
+			}
 		}  // while (csGame)
 	}  // while (!m_ShouldTerminate)
 }
@@ -471,13 +552,39 @@ void Comm::commandSenderThread(void)
 
 
 
+bool Comm::waitForNextSendTime(void)
+{
+	while ((m_Status == csGame) && !m_ShouldTerminate)
+	{
+		auto now = CommandScheduler::Clock::now();
+		auto sendTime = m_Scheduler.getNextSendTime(now);
+		if (sendTime <= now)
+		{
+			return true;
+		}
+
+		// Wait until the send time, or until a game update changes the schedule (rounding up so that the loop doesn't spin):
+		auto waitUSec = std::chrono::duration_cast<std::chrono::microseconds>(sendTime - now).count();
+		m_evtScheduleChange.Wait(static_cast<unsigned>((waitUSec + 999) / 1000));
+	}
+	return false;
+}
+
+
+
+
 
 void Comm::sendCommands(void)
 {
-	Json::Value cmds;
-	cmds["cmdId"] = ++m_LastSentCmdId;
-	cmds["bots"] = m_App.getBotCommands();
-	send(cmds);
+	auto & tickLatency = m_App.getTickLatency();
+	tickLatency.mark(TickLatency::stSendStarted);
+	m_App.getBotCommands(m_BotCommands);
+	tickLatency.mark(TickLatency::stCommandsRetrieved);
+	m_LastSentCmdId += 1;
+	m_Scheduler.onCommandsSent(CommandScheduler::Clock::now(), m_LastSentCmdId);
+	send(m_CommandSerializer.serialize(m_LastSentCmdId, m_BotCommands));
+	tickLatency.mark(TickLatency::stSent);
+	m_App.commandsSent();
 }
 
 
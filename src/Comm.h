@@ -10,8 +10,14 @@
 #pragma once
 
 #include <thread>
+#include <atomic>
 #include "lib/Network/Network.h"
 #include "lib/Network/Event.h"
+#include "lib/Network/CriticalSection.h"
+#include "LineFramer.h"
+#include "CommandScheduler.h"
+#include "CommandSerializer.h"
+#include "WorkerPool.h"
 
 
 
@@ -31,11 +37,14 @@ namespace Json
 class Comm
 {
 public:
-	Comm(BotWarzApp & a_App);
+	/** Creates a new instance bound to the specified app.
+	If a_WorkerPool is non-null, the incoming messages are processed on its threads instead of the network thread. */
+	Comm(BotWarzApp & a_App, WorkerPool * a_WorkerPool);
 
-	/** Initializes the subsystem.
+	/** Initializes the subsystem, connecting to the server at the specified host and port.
+	a_SchedulerSettings specifies how the commands are timed.
 	Returns true if successful, logs the reason and returns false to indicate failure. */
-	bool init(void);
+	bool init(const AString & a_ServerHost, UInt16 a_ServerPort, const CommandScheduler::Settings & a_SchedulerSettings);
 
 	/** Called from the app to stop everything. */
 	void stop(void);
@@ -67,14 +76,23 @@ protected:
 	/** The TCP link to the server. */
 	cTCPLinkPtr m_Link;
 
-	/** Partial data that has been received from the server but not yet processed (incomplete line). */
-	AString m_QueuedData;
+	/** Splits the data received from the server into lines, keeping the incomplete line until more data arrives. */
+	LineFramer m_LineFramer;
+
+	/** The queue on the worker pool's threads in which the incoming lines are processed, in order.
+	nullptr if there's no worker pool, the lines are then processed directly in the network thread. */
+	UniquePtr<WorkerPool::SerialQueue> m_ProcessingQueue;
+
+	/** Held while processing the incoming data in the network thread.
+	stop() locks it (and drains m_ProcessingQueue) so that the object isn't destroyed while the data is still being processed. */
+	cCriticalSection m_CSIncoming;
 
 	/** Synchronization between the network thread and the main thread waiting for handshake completion. */
 	cEvent m_evtHandshake;
 
-	/** The current status of the connection. */
-	Status m_Status;
+	/** The current status of the connection.
+	Atomic, because it is accessed both from the network thread and from the thread processing the incoming lines. */
+	std::atomic<Status> m_Status;
 
 	/** Flag that tells everything that it should terminate as soon as possible. */
 	bool m_ShouldTerminate;
@@ -82,8 +100,15 @@ protected:
 	/** Event that is set when a game is started. */
 	cEvent m_evtGameStart;
 
-	/** Event that is set when a  game update is received that has the matching lastCmdId with our last sent cmdId. */
-	cEvent m_evtCommandIdMatch;
+	/** Event that is set whenever the command schedule may have changed - a game update is received, or the game ends. */
+	cEvent m_evtScheduleChange;
+
+	/** Decides when to send the next batch of commands. */
+	CommandScheduler m_Scheduler;
+
+	/** The local time when the data currently being processed has been received from the network.
+	Only accessed by the thread processing the incoming lines. */
+	CommandScheduler::TimePoint m_ReceivedTime;
 
 	/** The last cmdId sent to the server. */
 	volatile int m_LastSentCmdId;
@@ -94,16 +119,23 @@ protected:
 	/** The thread that queries the controller for new commands and sends them to the server, timed apart. */
 	std::thread m_CommandSenderThread;
 
+	/** The commands to be sent to the server. Reused for all the batches, only used by the command sender thread. */
+	BotCommands m_BotCommands;
+
+	/** Serializes the commands to be sent to the server. Only used by the command sender thread. */
+	CommandSerializer m_CommandSerializer;
+
 
 	/** Waits until the handshake is completed in the network thread. */
 	bool waitForHandshakeCompletion(void);
 
 	/** Called by the network callbacks when there's data incoming from the server.
-	Logs the data, if requested, and processes any full lines present. */
-	void onIncomingData(const AString & a_Data);
+	Logs the data, if requested, and processes any full lines present.
+	a_Data points directly into the network buffers, it is only valid for the duration of the call. */
+	void onIncomingData(const char * a_Data, size_t a_Length);
 
 	/** Processes one line of incoming data. */
-	void processLine(const AString & a_Line);
+	void processLine(const char * a_Line, size_t a_Length);
 
 	/** Processes the "status: socket_connected" response, sends the login info. */
 	void processSocketConnected(const Json::Value & a_Response);
@@ -120,15 +152,26 @@ protected:
 	/** Processes the "play" response, updating the game board. */
 	void processPlay(const Json::Value & a_Response);
 
+	/** Stores the lastCmdId received in a game update, updates the command scheduler and wakes up the command sender. */
+	void updateLastReceivedCmdId(int a_LastCmdId);
+
 	/** Processes the "result" response, terminating the game. */
 	void processResult(const Json::Value & a_Reponse);
 
 	/** Severs the connection to the server and shuts down the comm interface. */
 	void abortConnection(void);
 
-	/** Runs the thread that periodically sends commands to the server. */
+	/** Called by the network callbacks when the connection is closed or fails.
+	Aborts the connection once all the lines received so far have been processed (in m_ProcessingQueue, if used). */
+	void abortConnectionAfterReceivedData(void);
+
+	/** Runs the thread that sends commands to the server, timed by the command scheduler. */
 	void commandSenderThread(void);
 
+	/** Waits until the command scheduler says the next batch of commands should be sent.
+	Returns false if the game has ended in the meantime. */
+	bool waitForNextSendTime(void);
+
 	/** Sends the current commands to the server. */
 	void sendCommands(void);
 };
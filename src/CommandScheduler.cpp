@@ -0,0 +1,310 @@
+
+// CommandScheduler.cpp
+
+// Implements the CommandScheduler class that decides when to send the next batch of bot commands to the server
+
+#include "Globals.h"
+#include "CommandScheduler.h"
+
+
+
+
+
+/** The value of m_TargetServerTime for batches sent before the ticks could be predicted. */
+static const int NO_TARGET = std::numeric_limits<int>::max();
+
+/** The initial estimate of the round-trip time, used until the acknowledgements tune it, in msec. */
+static const double INITIAL_ROUND_TRIP_MSEC = 10;
+
+/** The amount by which the round-trip estimate is increased when a batch misses the targeted tick, in msec. */
+static const double MISS_ROUND_TRIP_INCREASE_MSEC = 5;
+
+/** The amount by which the round-trip estimate is decreased when a batch hits the targeted tick, in msec.
+Together with the increase on a miss, this makes the estimate settle at about 4 % of batches missing their tick. */
+static const double HIT_ROUND_TRIP_DECREASE_MSEC = 0.2;
+
+/** The amount by which the rate window estimate is increased over the rejected interval, in msec. */
+static const double REJECT_RATE_WINDOW_INCREASE_MSEC = 5;
+
+/** The number of ticks after the targeted one when an unacknowledged batch is considered rejected. */
+static const double ACK_TIMEOUT_TICKS = 2.5;
+
+/** The timeout for the acknowledgement before the tick length is known, in msec. */
+static const double ACK_TIMEOUT_UNKNOWN_TICK_MSEC = 1000;
+
+/** The weight of a new sample in the tick length estimate. */
+static const double TICK_LENGTH_WEIGHT = 0.1;
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CommandScheduler::Settings:
+
+CommandScheduler::Settings::Settings(void):
+	m_RateWindowMSec(200),
+	m_RateMarginMSec(10),
+	m_TickMarginMSec(5),
+	m_IsJustInTime(true)
+{
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CommandScheduler:
+
+CommandScheduler::CommandScheduler(const ClockSync & a_ClockSync):
+	m_ClockSync(a_ClockSync)
+{
+	startGame();
+}
+
+
+
+
+
+void CommandScheduler::setSettings(const Settings & a_Settings)
+{
+	cCSLock Lock(m_CS);
+	m_Settings = a_Settings;
+	m_RateWindowMSec = a_Settings.m_RateWindowMSec;
+}
+
+
+
+
+
+void CommandScheduler::startGame(void)
+{
+	cCSLock Lock(m_CS);
+	m_GameStartTime = Clock::now();
+	m_RateWindowMSec = m_Settings.m_RateWindowMSec;
+	m_NumUpdates = 0;
+	m_LastServerTime = 0;
+	m_TickLengthMSec = 0;
+	m_RoundTripMSec = INITIAL_ROUND_TRIP_MSEC;
+	m_IsAwaitingAck = false;
+	m_LastSentCmdId = 0;
+	m_TargetServerTime = 0;
+	m_HasAccepted = false;
+	m_NumSent = 0;
+	m_NumAcked = 0;
+	m_NumHits = 0;
+	m_NumMisses = 0;
+	m_NumRejected = 0;
+	m_SumAckMSec = 0;
+	m_MinAckMSec = 0;
+	m_MaxAckMSec = 0;
+}
+
+
+
+
+
+void CommandScheduler::onGameUpdate(TimePoint a_ReceivedTime, int a_ServerTime, int a_LastCmdId)
+{
+	cCSLock Lock(m_CS);
+
+	// Update the tick model (the arrival times are estimated by m_ClockSync):
+	if ((m_NumUpdates > 0) && (a_ServerTime > m_LastServerTime))
+	{
+		double tickLength = a_ServerTime - m_LastServerTime;
+		m_TickLengthMSec = (m_TickLengthMSec > 0) ? (m_TickLengthMSec + (tickLength - m_TickLengthMSec) * TICK_LENGTH_WEIGHT) : tickLength;
+	}
+	m_NumUpdates += 1;
+	m_LastServerTime = a_ServerTime;
+
+	// Check the acknowledgement:
+	if (!m_IsAwaitingAck || (a_LastCmdId != m_LastSentCmdId))
+	{
+		return;
+	}
+	m_IsAwaitingAck = false;
+	m_HasAccepted = true;
+	m_LastAcceptedSendTime = m_LastSentTime;
+	m_LastAckTime = a_ReceivedTime;
+	double ackMSec = std::chrono::duration_cast<std::chrono::microseconds>(a_ReceivedTime - m_LastSentTime).count() / 1000.0;
+	m_SumAckMSec += ackMSec;
+	m_MinAckMSec = ((m_NumAcked == 0) || (ackMSec < m_MinAckMSec)) ? ackMSec : m_MinAckMSec;
+	m_MaxAckMSec = std::max(m_MaxAckMSec, ackMSec);
+	m_NumAcked += 1;
+
+	// Adapt the round-trip estimate based on whether the batch made it into the targeted tick:
+	if (m_TargetServerTime == NO_TARGET)
+	{
+		// The batch was sent before the ticks could be predicted, there was no target to hit
+		return;
+	}
+	if (a_ServerTime <= m_TargetServerTime)
+	{
+		m_NumHits += 1;
+		m_RoundTripMSec = std::max(m_RoundTripMSec - HIT_ROUND_TRIP_DECREASE_MSEC, 0.0);
+	}
+	else
+	{
+		m_NumMisses += 1;
+		if (m_TickLengthMSec > 0)
+		{
+			m_RoundTripMSec = std::min(m_RoundTripMSec + MISS_ROUND_TRIP_INCREASE_MSEC, m_TickLengthMSec);
+		}
+	}
+}
+
+
+
+
+
+void CommandScheduler::onCommandsSent(TimePoint a_Now, int a_CmdId)
+{
+	cCSLock Lock(m_CS);
+
+	// Target the first tick that the batch can still make:
+	double nowMSec = toMSec(a_Now);
+	double ackTimeoutMSec = ACK_TIMEOUT_UNKNOWN_TICK_MSEC;
+	if (m_TickLengthMSec > 0)
+	{
+		m_TargetServerTime = getFirstReachableTick(nowMSec, m_RoundTripMSec + m_Settings.m_TickMarginMSec);
+		ackTimeoutMSec = getEstimatedArrivalMSec(m_TargetServerTime) + ACK_TIMEOUT_TICKS * m_TickLengthMSec - nowMSec;
+	}
+	else
+	{
+		// The tick length is not yet known, any tick will do:
+		m_TargetServerTime = NO_TARGET;
+	}
+
+	m_IsAwaitingAck = true;
+	m_LastSentCmdId = a_CmdId;
+	m_LastSentTime = a_Now;
+	m_AckDeadline = a_Now + std::chrono::microseconds(static_cast<Int64>(ackTimeoutMSec * 1000));
+	m_NumSent += 1;
+}
+
+
+
+
+
+CommandScheduler::TimePoint CommandScheduler::getNextSendTime(TimePoint a_Now)
+{
+	cCSLock Lock(m_CS);
+
+	// If the last batch hasn't been acknowledged yet, wait for the acknowledgement, or until it is considered rejected:
+	if (m_IsAwaitingAck)
+	{
+		if (a_Now < m_AckDeadline)
+		{
+			return m_AckDeadline;
+		}
+		onRejected();
+	}
+
+	// The original schedule: the rate window after the acknowledgement:
+	if (!m_Settings.m_IsJustInTime)
+	{
+		if (!m_HasAccepted)
+		{
+			return a_Now;
+		}
+		return m_LastAckTime + std::chrono::milliseconds(m_Settings.m_RateWindowMSec);
+	}
+
+	// The batch must not arrive at the server within the rate window after the last accepted batch:
+	if (!m_HasAccepted)
+	{
+		return a_Now;
+	}
+	double earliestMSec = toMSec(m_LastAcceptedSendTime) + m_RateWindowMSec + m_Settings.m_RateMarginMSec;
+	if (m_TickLengthMSec <= 0)
+	{
+		// The ticks cannot be predicted yet, send as soon as allowed:
+		return fromMSec(earliestMSec);
+	}
+
+	// Send as late as possible while still making the first tick allowed by the rate window.
+	// The target is not moved further when its deadline is missed, the batch is sent right away instead and may still make it;
+	// the target only moves once its update arrives.
+	double leadMSec = m_RoundTripMSec + m_Settings.m_TickMarginMSec;
+	int targetServerTime = getFirstReachableTick(earliestMSec, leadMSec);
+	return fromMSec(getEstimatedArrivalMSec(targetServerTime) - leadMSec);
+}
+
+
+
+
+
+AString CommandScheduler::getStatsString(void) const
+{
+	cCSLock Lock(m_CS);
+	int numTargeted = m_NumHits + m_NumMisses;
+	return Printf("Command scheduler (%s): %d batches sent; targeted tick hit: %d (%.1f %%), missed: %d, rejected: %d; "
+		"ack time avg %.1f / min %.1f / max %.1f msec; estimated tick %.1f msec, round trip %.1f msec, rate window %.1f msec",
+		m_Settings.m_IsJustInTime ? "just-in-time" : "original",
+		m_NumSent, m_NumHits, (numTargeted > 0) ? 100.0 * m_NumHits / numTargeted : 0.0, m_NumMisses, m_NumRejected,
+		(m_NumAcked > 0) ? m_SumAckMSec / m_NumAcked : 0.0, m_MinAckMSec, m_MaxAckMSec,
+		m_TickLengthMSec, m_RoundTripMSec, m_RateWindowMSec
+	);
+}
+
+
+
+
+
+double CommandScheduler::toMSec(TimePoint a_Time) const
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(a_Time - m_GameStartTime).count() / 1000.0;
+}
+
+
+
+
+
+CommandScheduler::TimePoint CommandScheduler::fromMSec(double a_MSec) const
+{
+	return m_GameStartTime + std::chrono::microseconds(static_cast<Int64>(a_MSec * 1000));
+}
+
+
+
+
+
+int CommandScheduler::getFirstReachableTick(double a_NotBeforeMSec, double a_LeadMSec) const
+{
+	ASSERT(m_TickLengthMSec > 0);
+
+	// Skip all the ticks whose deadline has already passed, in a single step:
+	double nextServerTime = m_LastServerTime + m_TickLengthMSec;
+	double deadline = getEstimatedArrivalMSec(static_cast<int>(nextServerTime)) - a_LeadMSec;
+	if (deadline < a_NotBeforeMSec)
+	{
+		nextServerTime += ceil((a_NotBeforeMSec - deadline) / m_TickLengthMSec) * m_TickLengthMSec;
+	}
+	return static_cast<int>(nextServerTime);
+}
+
+
+
+
+
+void CommandScheduler::onRejected(void)
+{
+	m_IsAwaitingAck = false;
+	m_NumRejected += 1;
+
+	// The server must be using a longer rate window than the interval from the last accepted batch:
+	if (m_HasAccepted)
+	{
+		double intervalMSec = std::chrono::duration_cast<std::chrono::microseconds>(m_LastSentTime - m_LastAcceptedSendTime).count() / 1000.0;
+		m_RateWindowMSec = std::max(m_RateWindowMSec, intervalMSec + REJECT_RATE_WINDOW_INCREASE_MSEC);
+	}
+	LOGWARNING("Command batch %d has not been acknowledged, the server has probably rejected it. Rate window estimate: %.1f msec",
+		m_LastSentCmdId, m_RateWindowMSec
+	);
+}
+
+
+
+
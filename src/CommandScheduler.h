@@ -0,0 +1,164 @@
+
+// CommandScheduler.h
+
+// Declares the CommandScheduler class that decides when to send the next batch of bot commands to the server
+
+
+
+
+
+#pragma once
+
+#include "lib/Network/CriticalSection.h"
+#include "ClockSync.h"
+
+
+
+
+
+/** Decides when the next batch of commands should be sent to the server.
+The server accepts a command only if it arrives at least the rate window after the previously accepted one, and it applies
+the commands in its next tick. The scheduler models the server ticks from the "time" values of the game updates and their
+local arrival times as estimated by ClockSync, and fires each batch as late as possible while it still makes it into a server tick and doesn't violate
+the rate window, so that the AI decides on the freshest board state.
+The lead time before the tick is adapted from the acknowledgements ("lastCmdId"): a batch acknowledged in a later tick
+than targeted increases it, a hit slowly decreases it. A batch that is never acknowledged is considered rejected and makes
+the scheduler assume a longer rate window.
+All the times are local steady-clock times. The object is thread-safe. */
+class CommandScheduler
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+	typedef Clock::time_point TimePoint;
+
+
+	/** The configurable parameters of the scheduler. */
+	struct Settings
+	{
+		/** The server's rate window, in msec, as documented. Increased at runtime if commands are rejected. */
+		int m_RateWindowMSec;
+
+		/** The safety margin added to the rate window, in msec. */
+		int m_RateMarginMSec;
+
+		/** The minimum time by which each batch is sent before the estimated arrival of the targeted tick's update, in msec.
+		The adaptive round-trip estimate is added on top of this. */
+		int m_TickMarginMSec;
+
+		/** If false, the original schedule is used instead - each batch is sent the rate window after the previous one has been acknowledged. */
+		bool m_IsJustInTime;
+
+		/** Creates the default settings. */
+		Settings(void);
+	};
+
+
+	/** Creates a new scheduler that uses the specified clock estimate for predicting the updates' arrivals.
+	The ClockSync is expected to receive each game update's sample before the scheduler's onGameUpdate() is called. */
+	CommandScheduler(const ClockSync & a_ClockSync);
+
+	/** Sets the settings to use. Should be called before the first game starts. */
+	void setSettings(const Settings & a_Settings);
+
+	/** Resets the per-game state and statistics. Called when a new game starts, before any game updates are received. */
+	void startGame(void);
+
+	/** Called when a game update ("play" message) is received.
+	a_ReceivedTime is the local time when the message data arrived, a_ServerTime and a_LastCmdId are the values from the message. */
+	void onGameUpdate(TimePoint a_ReceivedTime, int a_ServerTime, int a_LastCmdId);
+
+	/** Called right before a batch of commands is sent to the server. */
+	void onCommandsSent(TimePoint a_Now, int a_CmdId);
+
+	/** Returns the time when the next batch of commands should be sent.
+	If the returned time is not in the future, the batch should be sent right away. Otherwise the caller should wait until
+	that time, but call this function again whenever a game update is received, because the schedule may change. */
+	TimePoint getNextSendTime(TimePoint a_Now);
+
+	/** Returns a human-readable summary of the statistics gathered in the current game. */
+	AString getStatsString(void) const;
+
+protected:
+	/** The settings in use. */
+	Settings m_Settings;
+
+	/** The estimate of the server's clock, used for predicting the arrivals of the updates. */
+	const ClockSync & m_ClockSync;
+
+	/** Protects all the members against multithreaded access. */
+	mutable cCriticalSection m_CS;
+
+	/** The local time of the game start, all the times in msec are relative to it. */
+	TimePoint m_GameStartTime;
+
+	/** The current estimate of the server's rate window, in msec. */
+	double m_RateWindowMSec;
+
+	/** The number of game updates received in the current game. */
+	int m_NumUpdates;
+
+	/** The server time of the last game update. */
+	int m_LastServerTime;
+
+	/** The estimated length of a server tick, in msec. Zero if not yet known. */
+	double m_TickLengthMSec;
+
+	/** The estimated round-trip time between sending a batch and the server's tick, in msec. Adapted by hits and misses. */
+	double m_RoundTripMSec;
+
+	/** True if a batch has been sent and its acknowledgement hasn't been received yet. */
+	bool m_IsAwaitingAck;
+
+	/** The cmdId of the last batch sent. */
+	int m_LastSentCmdId;
+
+	/** The time when the last batch was sent. */
+	TimePoint m_LastSentTime;
+
+	/** The server time of the tick that the last batch was targeted at. */
+	int m_TargetServerTime;
+
+	/** The time after which the last batch is considered rejected if it hasn't been acknowledged. */
+	TimePoint m_AckDeadline;
+
+	/** True if at least one batch has been accepted in the current game. */
+	bool m_HasAccepted;
+
+	/** The time when the last accepted batch was sent. */
+	TimePoint m_LastAcceptedSendTime;
+
+	/** The time when the last acknowledgement was received, used by the original schedule. */
+	TimePoint m_LastAckTime;
+
+	/** Statistics: the number of batches sent, acknowledged, acknowledged in the targeted tick, acknowledged later, and never acknowledged. */
+	int m_NumSent;
+	int m_NumAcked;
+	int m_NumHits;
+	int m_NumMisses;
+	int m_NumRejected;
+
+	/** Statistics: the sum, minimum and maximum of the times between sending a batch and receiving its acknowledgement, in msec. */
+	double m_SumAckMSec;
+	double m_MinAckMSec;
+	double m_MaxAckMSec;
+
+
+	/** Converts the local time into msec since the game start. */
+	double toMSec(TimePoint a_Time) const;
+
+	/** Converts msec since the game start into the local time. */
+	TimePoint fromMSec(double a_MSec) const;
+
+	/** Returns the estimated local time (in msec since the game start) when the update for the specified server time arrives. */
+	double getEstimatedArrivalMSec(int a_ServerTime) const { return toMSec(m_ClockSync.getArrivalTime(a_ServerTime)); }
+
+	/** Returns the server time of the first tick whose sending deadline (with a_LeadMSec lead time) is not before a_NotBeforeMSec. */
+	int getFirstReachableTick(double a_NotBeforeMSec, double a_LeadMSec) const;
+
+	/** Updates the state after the last batch has been found rejected. */
+	void onRejected(void);
+};
+
+
+
+
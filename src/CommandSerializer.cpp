@@ -0,0 +1,143 @@
+
+// CommandSerializer.cpp
+
+// Implements the CommandSerializer class that serializes the bot commands into the message sent to the server
+
+#include "Globals.h"
+#include "CommandSerializer.h"
+#include "json/json.h"
+
+
+
+
+
+/** The initial size of the buffer, enough for the commands for several tens of bots. */
+static const size_t INITIAL_BUFFER_SIZE = 4096;
+
+
+
+
+
+/** Serializes the single value using jsoncpp, the same way the whole message was serialized originally.
+Used for the rare values that need special formatting. */
+static AString serializeUsingJsoncpp(const Json::Value & a_Value)
+{
+	Json::StreamWriterBuilder wr;
+	wr.settings_["indentation"] = "";
+	wr.settings_["commentStyle"] = "None";
+	return Json::writeString(wr, a_Value);
+}
+
+
+
+
+
+CommandSerializer::CommandSerializer(void)
+{
+	m_Buffer.reserve(INITIAL_BUFFER_SIZE);
+}
+
+
+
+
+
+const AString & CommandSerializer::serialize(int a_CmdId, const BotCommands & a_Commands)
+{
+	// The keys are output in alphabetical order, as jsoncpp does:
+	m_Buffer.clear();  // Keeps the capacity
+	m_Buffer.append("{\"bots\":[");
+	bool isFirst = true;
+	for (const auto & cmd: a_Commands)
+	{
+		if (!isFirst)
+		{
+			m_Buffer.push_back(',');
+		}
+		isFirst = false;
+		m_Buffer.push_back('{');
+		if (cmd.m_HasAngle)
+		{
+			m_Buffer.append("\"angle\":");
+			appendDouble(cmd.m_Angle);
+			m_Buffer.push_back(',');
+		}
+		m_Buffer.append("\"cmd\":");
+		appendString(cmd.m_Cmd);
+		m_Buffer.append(",\"id\":");
+		appendInt(cmd.m_BotID);
+		m_Buffer.push_back('}');
+	}
+	m_Buffer.append("],\"cmdId\":");
+	appendInt(a_CmdId);
+	m_Buffer.append("}\n");
+	return m_Buffer;
+}
+
+
+
+
+
+void CommandSerializer::appendInt(int a_Value)
+{
+	char buf[16];
+	int len = snprintf(buf, sizeof(buf), "%d", a_Value);
+	m_Buffer.append(buf, static_cast<size_t>(len));
+}
+
+
+
+
+
+void CommandSerializer::appendDouble(double a_Value)
+{
+	// Non-finite values are output as special values by jsoncpp, use it directly:
+	if (!std::isfinite(a_Value))
+	{
+		m_Buffer.append(serializeUsingJsoncpp(a_Value));
+		return;
+	}
+
+	// Format the same way as jsoncpp: 17 significant digits, locale-independent decimal point, always marked as a real number:
+	char buf[40];
+	int len = snprintf(buf, sizeof(buf), "%.17g", a_Value);
+	bool isReal = false;
+	for (int i = 0; i < len; i++)
+	{
+		switch (buf[i])
+		{
+			case ',': buf[i] = '.'; isReal = true; break;
+			case '.':
+			case 'e': isReal = true; break;
+		}
+	}
+	m_Buffer.append(buf, static_cast<size_t>(len));
+	if (!isReal)
+	{
+		m_Buffer.append(".0");
+	}
+}
+
+
+
+
+
+void CommandSerializer::appendString(const AString & a_Value)
+{
+	// If the string contains anything that jsoncpp would escape, let it do the escaping:
+	for (auto ch: a_Value)
+	{
+		if ((ch < 0x20) || (ch > 0x7e) || (ch == '"') || (ch == '\\'))
+		{
+			m_Buffer.append(serializeUsingJsoncpp(a_Value));
+			return;
+		}
+	}
+
+	m_Buffer.push_back('"');
+	m_Buffer.append(a_Value);
+	m_Buffer.push_back('"');
+}
+
+
+
+
@@ -0,0 +1,50 @@
+
+// CommandSerializer.h
+
+// Declares the CommandSerializer class that serializes the bot commands into the message sent to the server
+
+
+
+
+
+#pragma once
+
+#include "BotCommand.h"
+
+
+
+
+
+/** Serializes the bot commands into the message sent to the server, without any dynamic allocations.
+The message is written into an internal buffer that is reused for all the messages; it is pre-sized for the usual
+number of bots and only grows if a larger message is needed.
+The output is byte-for-byte the same as that of jsoncpp's StreamWriter with no indentation, which was used originally:
+the object keys are in alphabetical order, the numbers are formatted the same way. The rare values that need
+special handling (non-finite numbers, strings with characters that need escaping) are delegated to jsoncpp itself. */
+class CommandSerializer
+{
+public:
+	CommandSerializer(void);
+
+	/** Serializes the commands message with the specified cmdId and commands, including the terminating LF.
+	Returns the internal buffer containing the message; it is valid until the next call. */
+	const AString & serialize(int a_CmdId, const BotCommands & a_Commands);
+
+protected:
+	/** The buffer into which the messages are serialized, reused for all the messages. */
+	AString m_Buffer;
+
+
+	/** Appends the integer value to m_Buffer, formatted the jsoncpp way. */
+	void appendInt(int a_Value);
+
+	/** Appends the floating-point value to m_Buffer, formatted the jsoncpp way. */
+	void appendDouble(double a_Value);
+
+	/** Appends the quoted and escaped string value to m_Buffer, formatted the jsoncpp way. */
+	void appendString(const AString & a_Value);
+};
+
+
+
+
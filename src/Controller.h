@@ -9,6 +9,8 @@
 
 #pragma once
 
+#include "BotCommand.h"
+
 
 
 
@@ -34,9 +36,15 @@ public:
 	{
 	}
 
+	virtual ~Controller() {}
+
 	/** Called upon startup to query whether the controller has initialized properly; the app will terminate if not. */
 	virtual bool isValid(void) const { return true; }
 
+	/** Returns true if the controller processes the notifications asynchronously, in its own thread.
+	Such a controller marks the game update as processed in the app's TickLatency on its own, once it has actually processed it. */
+	virtual bool isAsync(void) const { return false; }
+
 	/** Called when the game has just started.
 	a_Board points to the game board that represents the game state.
 	The board needs to stay valid until the game is finished via the onGameFinished() call. */
@@ -53,9 +61,30 @@ public:
 	Called before the actual onGameUpdate() call is made. */
 	virtual void onBotDied(const Bot & a_Bot) = 0;
 
-	/** Returns the current set of commands for the bots that should be sent to the server.
+	/** Fills a_Commands with the current set of commands for the bots that should be sent to the server.
+	a_Commands is cleared first; the caller reuses the same container for all the calls, so that its memory is reused.
 	Also clears the commands, so that they aren't sent the next time this is called. */
-	virtual Json::Value getBotCommands(void) = 0;
+	virtual void getBotCommands(BotCommands & a_Commands) = 0;
+
+	/** Called after the commands returned by getBotCommands() have been sent to the server.
+	The time until the next game update is the controller's slack, usable for housekeeping. */
+	virtual void onCommandsSent(void) {}
+
+	/** Called when the controller is about to be replaced by its reloaded version.
+	Returns the controller's state to be migrated, passed to the new version's restoreState(). */
+	virtual AString saveState(void) { return AString(); }
+
+	/** Called on the reloaded version of the controller before it takes over, with the state saved by the version it replaces. */
+	virtual void restoreState(const AString & a_State) { UNUSED(a_State); }
+
+	/** Called instead of onGameStarted() on the reloaded version of the controller when it takes over in the middle of a game.
+	The parameters and the requirements are the same as for onGameStarted(). */
+	virtual void onGameResumed(Board & a_Board) { onGameStarted(a_Board); }
+
+	/** Called instead of onGameFinished() on the controller that has been replaced by its reloaded version in the middle of a game,
+	once the new version has taken over. The controller receives no more notifications; it should report the statistics
+	of the game so far, as at the game finish, but the game itself goes on. */
+	virtual void onRetired(void) {}
 
 protected:
 	BotWarzApp & m_App;
@@ -0,0 +1,143 @@
+
+// ControllerWatcher.cpp
+
+// Implements the ControllerWatcher class that watches the controller file and loads its new versions in the background
+
+#include "Globals.h"
+#include "ControllerWatcher.h"
+#include "Controller.h"
+#include "sha1.h"
+
+
+
+
+
+ControllerWatcher::ControllerWatcher(const AString & a_FileName, Factory a_Factory, const AString & a_LogPrefix, int a_PollMSec):
+	m_FileName(a_FileName),
+	m_Factory(a_Factory),
+	m_LogPrefix(a_LogPrefix),
+	m_PollMSec(static_cast<unsigned>(std::max(a_PollMSec, 1))),
+	m_HasReloaded(false),
+	m_ShouldTerminate(false)
+{
+	// The currently loaded version is the one present now:
+	getFileStamp(m_FileName, m_LoadedStamp);
+
+	m_WatcherThread = std::thread(&ControllerWatcher::watcherThread, this);
+}
+
+
+
+
+
+ControllerWatcher::~ControllerWatcher()
+{
+	m_ShouldTerminate = true;
+	m_evtTerminate.Set();
+	if (m_WatcherThread.joinable())
+	{
+		m_WatcherThread.join();
+	}
+}
+
+
+
+
+
+SharedPtr<Controller> ControllerWatcher::takeReloaded(void)
+{
+	cCSLock Lock(m_CSReloaded);
+	SharedPtr<Controller> res;
+	std::swap(res, m_Reloaded);
+	m_HasReloaded = false;
+	return res;
+}
+
+
+
+
+
+void ControllerWatcher::watcherThread(void)
+{
+	FileStamp lastStamp = m_LoadedStamp;
+	while (!m_ShouldTerminate)
+	{
+		m_evtTerminate.Wait(m_PollMSec);
+		if (m_ShouldTerminate)
+		{
+			break;
+		}
+
+		// Load the new version only if the file has been changed and then left alone for a whole poll interval:
+		FileStamp stamp;
+		if (!getFileStamp(m_FileName, stamp))
+		{
+			// The file is being replaced, or has been removed; keep the current version:
+			continue;
+		}
+		bool isStable = (stamp == lastStamp);
+		lastStamp = stamp;
+		if (!isStable || (stamp == m_LoadedStamp))
+		{
+			continue;
+		}
+		m_LoadedStamp = stamp;
+		reload();
+	}  // while (!m_ShouldTerminate)
+}
+
+
+
+
+
+void ControllerWatcher::reload(void)
+{
+	LOG("%s: Controller file %s has changed, loading the new version in the background.", m_LogPrefix.c_str(), m_FileName.c_str());
+	auto controller = m_Factory();
+	if ((controller == nullptr) || !controller->isValid())
+	{
+		LOGWARNING("%s: The new version of controller %s failed to load, keeping the current one.", m_LogPrefix.c_str(), m_FileName.c_str());
+		return;
+	}
+
+	// Store the new version; if the app hasn't taken the previous one yet, it is replaced (and released outside the lock):
+	{
+		cCSLock Lock(m_CSReloaded);
+		std::swap(controller, m_Reloaded);
+		m_HasReloaded = true;
+	}
+	LOG("%s: The new version of controller %s has been loaded, it will take over at the next game tick.", m_LogPrefix.c_str(), m_FileName.c_str());
+}
+
+
+
+
+
+bool ControllerWatcher::getFileStamp(const AString & a_FileName, FileStamp & a_Stamp)
+{
+	FILE * f = fopen(a_FileName.c_str(), "rb");
+	if (f == nullptr)
+	{
+		return false;
+	}
+	AString contents;
+	char buf[16384];
+	size_t numRead;
+	while ((numRead = fread(buf, 1, sizeof(buf), f)) > 0)
+	{
+		contents.append(buf, numRead);
+	}
+	bool res = (ferror(f) == 0);
+	fclose(f);
+	if (!res)
+	{
+		return false;
+	}
+	a_Stamp.m_Size = contents.size();
+	sha1(reinterpret_cast<const unsigned char *>(contents.data()), contents.size(), a_Stamp.m_Hash);
+	return true;
+}
+
+
+
+
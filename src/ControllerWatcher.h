@@ -0,0 +1,127 @@
+
+// ControllerWatcher.h
+
+// Declares the ControllerWatcher class that watches the controller file and loads its new versions in the background
+
+
+
+
+
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <functional>
+#include "lib/Network/CriticalSection.h"
+#include "lib/Network/Event.h"
+
+
+
+
+
+// fwd:
+class Controller;
+
+
+
+
+
+/** Watches the controller's file for changes in its own thread. When the file changes, a new controller is created from it
+in the background, using the factory function, and kept until the app takes it to replace the current controller.
+The file is polled for the SHA-1 hash of its contents (the modification time may have a resolution as coarse as a second,
+missing quick successive edits); a new version is only loaded once the contents stay the same for two consecutive polls,
+so that a file that is still being written isn't loaded.
+A new version that fails to load is reported and ignored, the current controller is kept until the file changes again. */
+class ControllerWatcher
+{
+public:
+	/** The function that creates a new controller from the watched file. Called in the watcher's thread. */
+	typedef std::function<SharedPtr<Controller>(void)> Factory;
+
+
+	/** Starts watching the specified file, polling it every a_PollMSec msec.
+	a_LogPrefix is prepended to the messages logged by the watcher. */
+	ControllerWatcher(const AString & a_FileName, Factory a_Factory, const AString & a_LogPrefix, int a_PollMSec);
+
+	/** Stops watching the file. Waits for a new version being loaded, if any. */
+	~ControllerWatcher();
+
+	/** Returns true if a new version of the controller has been loaded and is waiting to be taken. Lock-free. */
+	bool hasReloaded(void) const { return m_HasReloaded; }
+
+	/** Returns the new version of the controller that has been loaded, and forgets it.
+	Returns nullptr if no new version is waiting. */
+	SharedPtr<Controller> takeReloaded(void);
+
+protected:
+	/** The identification of a single version of the watched file, by its contents. */
+	struct FileStamp
+	{
+		size_t m_Size;
+		unsigned char m_Hash[20];
+
+		FileStamp(void):
+			m_Size(0)
+		{
+			memset(m_Hash, 0, sizeof(m_Hash));
+		}
+
+		bool operator == (const FileStamp & a_Other) const
+		{
+			return (m_Size == a_Other.m_Size) && (memcmp(m_Hash, a_Other.m_Hash, sizeof(m_Hash)) == 0);
+		}
+
+		bool operator != (const FileStamp & a_Other) const
+		{
+			return !(*this == a_Other);
+		}
+	};
+
+
+	/** The name of the watched file. */
+	AString m_FileName;
+
+	/** The function creating a new controller from the file. */
+	Factory m_Factory;
+
+	/** Prepended to the messages logged by the watcher. */
+	AString m_LogPrefix;
+
+	/** The interval between two polls of the file, in msec. */
+	unsigned m_PollMSec;
+
+	/** The stamp of the version that was last loaded (or failed to load). Only accessed from the watcher thread. */
+	FileStamp m_LoadedStamp;
+
+	/** Protects m_Reloaded against multithreaded access. */
+	cCriticalSection m_CSReloaded;
+
+	/** The new version of the controller, waiting to be taken. Protected by m_CSReloaded. */
+	SharedPtr<Controller> m_Reloaded;
+
+	/** Set when m_Reloaded holds a new version, so that the app can check it without locking. */
+	std::atomic<bool> m_HasReloaded;
+
+	/** Set to true when the watcher thread should terminate. */
+	std::atomic<bool> m_ShouldTerminate;
+
+	/** Set when the watcher thread should terminate, to wake it up from waiting for the next poll. */
+	cEvent m_evtTerminate;
+
+	/** The thread polling the file and loading its new versions. */
+	std::thread m_WatcherThread;
+
+
+	/** The body of the watcher thread: polls the file and loads its new versions until terminated. */
+	void watcherThread(void);
+
+	/** Loads the new version of the controller, and if successful, stores it for the app to take. */
+	void reload(void);
+
+	/** Reads the specified file and computes its stamp. Returns false if the file cannot be read. */
+	static bool getFileStamp(const AString & a_FileName, FileStamp & a_Stamp);
+};
+
+
+
+
@@ -0,0 +1,23 @@
+
+// LineFramer.cpp
+
+// Implements the LineFramer class that splits a stream of incoming data into LF-terminated lines without copying the data
+
+#include "Globals.h"
+#include "LineFramer.h"
+
+
+
+
+
+LineFramer::LineFramer(void):
+	m_NumLines(0),
+	m_NumBytesCopied(0)
+{
+	// Reserve enough space for a typical "play" message, so that the buffer doesn't need to grow in a game:
+	m_Pending.reserve(4096);
+}
+
+
+
+
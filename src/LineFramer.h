@@ -0,0 +1,104 @@
+
+// LineFramer.h
+
+// Declares the LineFramer class that splits a stream of incoming data into LF-terminated lines without copying the data
+
+
+
+
+
+#pragma once
+
+
+
+
+
+/** Splits the incoming data stream into lines.
+Complete lines are handed out as pointers directly into the data that was passed in, only the incomplete line at
+the end of each chunk of data is copied into an internal buffer, which is reused for the whole lifetime of the object.
+The line pointers are valid only for the duration of the callback. */
+class LineFramer
+{
+public:
+	LineFramer(void);
+
+	/** Processes the incoming data, calling a_OnLine(const char * a_Line, size_t a_Length) for each complete line.
+	The line passed to the callback doesn't include the terminating LF.
+	If the callback returns false, the processing is aborted and the rest of the data is dropped. */
+	template <typename OnLine>
+	void process(const char * a_Data, size_t a_Length, OnLine a_OnLine)
+	{
+		const char * start = a_Data;
+		const char * end = a_Data + a_Length;
+
+		// Finish the line left over from the previous data, if any:
+		if (!m_Pending.empty())
+		{
+			auto lineEnd = static_cast<const char *>(memchr(start, '\n', a_Length));
+			if (lineEnd == nullptr)
+			{
+				appendPending(start, a_Length);
+				return;
+			}
+			appendPending(start, static_cast<size_t>(lineEnd - start));
+			m_NumLines += 1;
+			bool shouldContinue = a_OnLine(m_Pending.data(), m_Pending.size());
+			m_Pending.clear();  // Keeps the capacity for the next incomplete line
+			if (!shouldContinue)
+			{
+				return;
+			}
+			start = lineEnd + 1;
+		}
+
+		// Hand out all the complete lines directly from the data:
+		while (start < end)
+		{
+			auto lineEnd = static_cast<const char *>(memchr(start, '\n', static_cast<size_t>(end - start)));
+			if (lineEnd == nullptr)
+			{
+				break;
+			}
+			m_NumLines += 1;
+			if (!a_OnLine(start, static_cast<size_t>(lineEnd - start)))
+			{
+				return;
+			}
+			start = lineEnd + 1;
+		}
+
+		// Keep the incomplete line for the next data:
+		appendPending(start, static_cast<size_t>(end - start));
+	}
+
+	/** Drops any incomplete line that is buffered. */
+	void reset(void) { m_Pending.clear(); }
+
+	/** Returns the number of complete lines processed so far. */
+	UInt64 getNumLines(void) const { return m_NumLines; }
+
+	/** Returns the number of bytes that have been copied into the internal buffer so far. */
+	UInt64 getNumBytesCopied(void) const { return m_NumBytesCopied; }
+
+protected:
+	/** The incomplete line at the end of the last processed data. */
+	AString m_Pending;
+
+	/** Statistics: the number of complete lines processed. */
+	UInt64 m_NumLines;
+
+	/** Statistics: the number of bytes copied into m_Pending. */
+	UInt64 m_NumBytesCopied;
+
+
+	/** Appends the data to m_Pending, updating the statistics. */
+	void appendPending(const char * a_Data, size_t a_Length)
+	{
+		m_Pending.append(a_Data, a_Length);
+		m_NumBytesCopied += a_Length;
+	}
+};
+
+
+
+
@@ -5,6 +5,7 @@
 
 #include "Globals.h"
 #include "Logger.h"
+#include <cctype>
 
 
 
@@ -15,6 +16,7 @@ static const char ldkDataIn  = 4;
 static const char ldkDataOut = 5;
 static const char ldkAILog   = 6;
 static const char ldkComment = 7;
+static const char ldkLatency = 8;
 
 // Header of the binary log file:
 char g_VersionHeader[] = "EBWLog\x00\x02";
@@ -34,7 +36,7 @@ Logger::Logger(void):
 
 
 
-bool Logger::init(bool a_ShouldLogComm, bool a_ShouldShowComm)
+bool Logger::init(bool a_ShouldLogComm, bool a_ShouldShowComm, const AString & a_LoginNick)
 {
 	// Create the folder for the logs, if not already present:
 	#ifdef _WIN32
@@ -45,7 +47,8 @@ bool Logger::init(bool a_ShouldLogComm, bool a_ShouldShowComm)
 
 	// Open the comm log file, if requested:
 	m_CommLogBeginTime = std::chrono::high_resolution_clock::now();
-	AString fileNameBase = getLogFileNameBase();
+	AString fileNameBase = getLogFileNameBase(a_LoginNick);
+	m_FileNameBase = fileNameBase;
 	if (a_ShouldLogComm)
 	{
 		AString logName = fileNameBase + ".txt";
@@ -72,24 +75,29 @@ bool Logger::init(bool a_ShouldLogComm, bool a_ShouldShowComm)
 
 
 
-void Logger::commLog(bool a_IsIncoming, const AString & a_Data)
+void Logger::commLog(bool a_IsIncoming, const char * a_Data, size_t a_Length)
 {
 	UInt64 microSecOffset = static_cast<UInt64>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - m_CommLogBeginTime).count());
-	double timeOffset = static_cast<double>(microSecOffset) / 1000;
-	AString msg = Printf("%9.3f %s: %s", timeOffset, a_IsIncoming ? " IN" : "OUT", a_Data.c_str());
 
-	// Show on stdout, if requested:
-	if (m_ShouldShowComm)
-	{
-		printf("%s", msg.c_str());
-	}
-
-	// Output to file, if requested:
+	// Format the text message only if it is going to be output:
 	cCSLock Lock(m_CSCommLog);
-	if (m_CommLogFile != nullptr)
+	if (m_ShouldShowComm || (m_CommLogFile != nullptr))
 	{
-		fprintf(m_CommLogFile, "%s", msg.c_str());
-		fflush(m_CommLogFile);
+		double timeOffset = static_cast<double>(microSecOffset) / 1000;
+		AString msg = Printf("%9.3f %s: %.*s", timeOffset, a_IsIncoming ? " IN" : "OUT", static_cast<int>(a_Length), a_Data);
+
+		// Show on stdout, if requested:
+		if (m_ShouldShowComm)
+		{
+			printf("%s", msg.c_str());
+		}
+
+		// Output to file, if requested:
+		if (m_CommLogFile != nullptr)
+		{
+			fprintf(m_CommLogFile, "%s", msg.c_str());
+			fflush(m_CommLogFile);
+		}
 	}
 
 	// Always write a binary log:
@@ -101,9 +109,9 @@ void Logger::commLog(bool a_IsIncoming, const AString & a_Data)
 		fwrite(&timeLow, 4, 1, m_BinCommLogFile);
 		char kind = a_IsIncoming ? ldkDataIn : ldkDataOut;
 		fwrite(&kind, 1, 1, m_BinCommLogFile);
-		UInt32 len = htonl(static_cast<UInt32>(a_Data.size()));
+		UInt32 len = htonl(static_cast<UInt32>(a_Length));
 		fwrite(&len, 4, 1, m_BinCommLogFile);
-		fwrite(a_Data.data(), a_Data.size(), 1, m_BinCommLogFile);
+		fwrite(a_Data, a_Length, 1, m_BinCommLogFile);
 	}
 }
 
@@ -191,7 +199,39 @@ void Logger::commentLog(const AString & a_Msg)
 
 
 
-AString Logger::getLogFileNameBase(void)
+void Logger::latencyLog(const AString & a_Stats)
+{
+	UInt64 microSecOffset = static_cast<UInt64>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - m_CommLogBeginTime).count());
+	double timeOffset = static_cast<double>(microSecOffset) / 1000;
+
+	// Output to file, if requested (not shown on stdout, the app logs a human-readable summary instead):
+	cCSLock Lock(m_CSCommLog);
+	if (m_CommLogFile != nullptr)
+	{
+		fprintf(m_CommLogFile, "%9.3f LAT: %s\n", timeOffset, a_Stats.c_str());
+		fflush(m_CommLogFile);
+	}
+
+	// Always write a binary log:
+	if (m_BinCommLogFile != nullptr)
+	{
+		UInt32 timeLow  = htonl(static_cast<UInt32>(microSecOffset));
+		UInt32 timeHigh = htonl(static_cast<UInt32>(microSecOffset >> 32));
+		fwrite(&timeHigh, 4, 1, m_BinCommLogFile);
+		fwrite(&timeLow, 4, 1, m_BinCommLogFile);
+		char kind = ldkLatency;
+		fwrite(&kind, 1, 1, m_BinCommLogFile);
+		UInt32 len = htonl(static_cast<UInt32>(a_Stats.size()));
+		fwrite(&len, 4, 1, m_BinCommLogFile);
+		fwrite(a_Stats.data(), a_Stats.size(), 1, m_BinCommLogFile);
+	}
+}
+
+
+
+
+
+AString Logger::getLogFileNameBase(const AString & a_LoginNick)
 {
 	// Compose the log file name from the current time:
 	time_t rawtime;
@@ -204,9 +244,21 @@ AString Logger::getLogFileNameBase(void)
 	#else
 		timeinfo = localtime(&rawtime);
 	#endif
-	return Printf("CommLogs/%02d-%02d-%02d-%02d-%02d-%02d", 
+
+	// The nick comes from the login file, replace anything that isn't safe in a filename (path separators, drive colons etc.):
+	AString nick(a_LoginNick);
+	for (auto & ch: nick)
+	{
+		if (!isalnum(static_cast<unsigned char>(ch)) && (ch != '-') && (ch != '_'))
+		{
+			ch = '_';
+		}
+	}
+
+	return Printf("CommLogs/%02d-%02d-%02d-%02d-%02d-%02d-%s", 
 		(timeinfo->tm_year + 1900), (timeinfo->tm_mon + 1), timeinfo->tm_mday,
-		timeinfo->tm_hour, timeinfo->tm_min, timeinfo->tm_sec
+		timeinfo->tm_hour, timeinfo->tm_min, timeinfo->tm_sec,
+		nick.c_str()
 	);
 }
 
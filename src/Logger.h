@@ -20,10 +20,11 @@ class Logger
 public:
 	Logger(void);
 
-	bool init(bool a_ShouldLogComm, bool a_ShouldShowComm);
+	/** Opens the log files. a_LoginNick is made part of the log file names, so that multiple sessions use separate logs. */
+	bool init(bool a_ShouldLogComm, bool a_ShouldShowComm, const AString & a_LoginNick);
 
 	/** Logs communication data. */
-	void commLog(bool a_IsIncoming, const AString & a_Data);
+	void commLog(bool a_IsIncoming, const char * a_Data, size_t a_Length);
 
 	/** Logs custom data pertaining to a specific bot. */
 	void aiLog(int a_BotID, const AString & a_Message);
@@ -31,6 +32,12 @@ public:
 	/** Output a generic comment into the log. */
 	void commentLog(const AString & a_Message);
 
+	/** Outputs the tick latency statistics (Json-serialized) into the log. */
+	void latencyLog(const AString & a_Stats);
+
+	/** Returns the filename base (without the extension) of the log files, so that other output files can be named alike. */
+	const AString & getFileNameBase(void) const { return m_FileNameBase; }
+
 protected:
 	/** If true, all the communication with the server is sent to stdout. */
 	bool m_ShouldShowComm;
@@ -45,12 +52,16 @@ protected:
 	/** Mutex protecting m_CommLogFile against multithreaded writes. */
 	cCriticalSection m_CSCommLog;
 
+	/** The filename base (without the extension) of the log files, set in init(). */
+	AString m_FileNameBase;
+
 	/** The timestamp of the commlogfile creation. Used to output relative time offsets in the commlog file */
 	std::chrono::high_resolution_clock::time_point m_CommLogBeginTime;
 
 
-	/** Creates the filename base for log files (binary and text). */
-	static AString getLogFileNameBase(void);
+	/** Creates the filename base for log files (binary and text) for the specified login.
+	The characters of the nick that aren't safe in a filename are replaced with underscores. */
+	static AString getLogFileNameBase(const AString & a_LoginNick);
 };
 
 
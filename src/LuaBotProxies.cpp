@@ -0,0 +1,193 @@
+
+// LuaBotProxies.cpp
+
+// Implements the LuaBotProxies class that provides the Lua userdata proxies reading the bots' state directly from the C++ side
+
+#include "Globals.h"
+#include "LuaBotProxies.h"
+
+
+
+
+
+/** The name of the proxies' metatable in the Lua registry. */
+static const char PROXY_METATABLE_NAME[] = "__EsetBotWarz_BotProxy";
+
+
+
+
+
+LuaBotProxies::LuaBotProxies(void):
+	m_Bots(nullptr),
+	m_DyingBot(nullptr)
+{
+}
+
+
+
+
+
+void LuaBotProxies::registerMetatable(lua_State * a_LuaState)
+{
+	luaL_newmetatable(a_LuaState, PROXY_METATABLE_NAME);   // Stack: [mt]
+	lua_pushlightuserdata(a_LuaState, this);               // Stack: [mt] [this]
+	lua_pushcclosure(a_LuaState, &luaIndex, 1);            // Stack: [mt] [__index]
+	lua_setfield(a_LuaState, -2, "__index");               // Stack: [mt]
+	lua_pushcfunction(a_LuaState, &luaNewIndex);           // Stack: [mt] [__newindex]
+	lua_setfield(a_LuaState, -2, "__newindex");            // Stack: [mt]
+	lua_pushcfunction(a_LuaState, &luaToString);           // Stack: [mt] [__tostring]
+	lua_setfield(a_LuaState, -2, "__tostring");            // Stack: [mt]
+	lua_pop(a_LuaState, 1);
+}
+
+
+
+
+
+void LuaBotProxies::pushProxy(lua_State * a_LuaState, const Bot & a_Bot, size_t a_Index)
+{
+	auto proxy = reinterpret_cast<Proxy *>(lua_newuserdata(a_LuaState, sizeof(Proxy)));  // Stack: [proxy]
+	proxy->m_ID = a_Bot.m_ID;
+	proxy->m_IsEnemy = a_Bot.m_IsEnemy;
+	proxy->m_IndexHint = a_Index;
+	luaL_getmetatable(a_LuaState, PROXY_METATABLE_NAME);  // Stack: [proxy] [mt]
+	ASSERT(lua_istable(a_LuaState, -1));  // registerMetatable() not called?
+	lua_setmetatable(a_LuaState, -2);                     // Stack: [proxy]
+	lua_newtable(a_LuaState);                             // Stack: [proxy] [env]
+	lua_setfenv(a_LuaState, -2);                          // Stack: [proxy]
+}
+
+
+
+
+
+const Bot * LuaBotProxies::findBot(Proxy & a_Proxy) const
+{
+	if ((m_DyingBot != nullptr) && (m_DyingBot->m_ID == a_Proxy.m_ID))
+	{
+		return m_DyingBot;
+	}
+	if ((m_Bots == nullptr) || m_Bots->empty())
+	{
+		return nullptr;
+	}
+
+	// The bots keep their order and the dead ones are removed, so in a newer snapshot a bot can only move towards the start:
+	auto & bots = *m_Bots;
+	size_t hint = std::min(a_Proxy.m_IndexHint, bots.size() - 1);
+	for (size_t i = hint + 1; i > 0; i--)
+	{
+		if (bots[i - 1].m_ID == a_Proxy.m_ID)
+		{
+			a_Proxy.m_IndexHint = i - 1;
+			return &bots[i - 1];
+		}
+	}
+
+	// The bound snapshot may be older than the one that has set the hint (such as when the controller runs in several threads),
+	// the bot may then be further towards the end:
+	for (size_t i = hint + 1; i < bots.size(); i++)
+	{
+		if (bots[i].m_ID == a_Proxy.m_ID)
+		{
+			a_Proxy.m_IndexHint = i;
+			return &bots[i];
+		}
+	}
+	return nullptr;
+}
+
+
+
+
+
+int LuaBotProxies::luaIndex(lua_State * a_LuaState)
+{
+	auto self = reinterpret_cast<const LuaBotProxies *>(lua_touserdata(a_LuaState, lua_upvalueindex(1)));
+	auto proxy = reinterpret_cast<Proxy *>(lua_touserdata(a_LuaState, 1));
+
+	// The bot's own fields:
+	if (lua_type(a_LuaState, 2) == LUA_TSTRING)
+	{
+		const char * key = lua_tostring(a_LuaState, 2);
+		if (strcmp(key, "id") == 0)
+		{
+			lua_pushnumber(a_LuaState, proxy->m_ID);
+			return 1;
+		}
+		if (strcmp(key, "isEnemy") == 0)
+		{
+			lua_pushboolean(a_LuaState, proxy->m_IsEnemy);
+			return 1;
+		}
+		const double Bot::* field = nullptr;
+		switch (key[0])
+		{
+			case 'x': field = (key[1] == 0) ? &Bot::m_X : nullptr; break;
+			case 'y': field = (key[1] == 0) ? &Bot::m_Y : nullptr; break;
+			case 's': field = (strcmp(key, "speed") == 0) ? &Bot::m_Speed : nullptr; break;
+			case 'a':
+			{
+				if (strcmp(key, "angle") == 0)
+				{
+					field = &Bot::m_Angle;
+				}
+				else if (strcmp(key, "angularVelocity") == 0)
+				{
+					field = &Bot::m_AngularVelocity;
+				}
+				else if (strcmp(key, "acceleration") == 0)
+				{
+					field = &Bot::m_Acceleration;
+				}
+				break;
+			}
+		}
+		if (field != nullptr)
+		{
+			auto bot = self->findBot(*proxy);
+			if (bot == nullptr)
+			{
+				lua_pushnil(a_LuaState);
+			}
+			else
+			{
+				lua_pushnumber(a_LuaState, bot->*field);
+			}
+			return 1;
+		}
+	}
+
+	// Any other field stored by the script:
+	lua_getfenv(a_LuaState, 1);        // Stack: [proxy] [key] [env]
+	lua_pushvalue(a_LuaState, 2);      // Stack: [proxy] [key] [env] [key]
+	lua_rawget(a_LuaState, -2);        // Stack: [proxy] [key] [env] [value]
+	return 1;
+}
+
+
+
+
+
+int LuaBotProxies::luaNewIndex(lua_State * a_LuaState)
+{
+	lua_getfenv(a_LuaState, 1);        // Stack: [proxy] [key] [value] [env]
+	lua_insert(a_LuaState, 2);         // Stack: [proxy] [env] [key] [value]
+	lua_rawset(a_LuaState, 2);         // Stack: [proxy] [env]
+	return 0;
+}
+
+
+
+
+
+int LuaBotProxies::luaToString(lua_State * a_LuaState)
+{
+	auto proxy = reinterpret_cast<const Proxy *>(lua_touserdata(a_LuaState, 1));
+	lua_pushfstring(a_LuaState, "bot %d", proxy->m_ID);
+	return 1;
+}
+
+
+
+
@@ -0,0 +1,105 @@
+
+// LuaBotProxies.h
+
+// Declares the LuaBotProxies class that provides the Lua userdata proxies reading the bots' state directly from the C++ side
+
+
+
+
+
+#pragma once
+
+#include "LuaState.h"
+#include "Bot.h"
+
+
+
+
+
+/** Provides the Lua userdata proxies for the bots, used in place of the bot tables in allBots.
+Reading a bot's field through a proxy (bot.x, bot.isEnemy, ...) reads the value directly from the bots set by setBots(),
+so the bots' state doesn't need to be written into the Lua tables on each update. Any other fields the script stores
+in a proxy are kept in the proxy's own environment table, so the proxies can be used the same way as the tables.
+The bot's state fields are read-only, values stored into them are ignored. Once a bot is no longer present in the bots,
+its state fields read as nil, unless it is the dying bot passed to setBots().
+Not thread-safe, only used while the owner holds its Lua state's lock. */
+class LuaBotProxies
+{
+public:
+	/** Sets the bots for the proxies for the lifetime of the object, such as for the duration of a single Lua callback. */
+	class Binding
+	{
+	public:
+		Binding(LuaBotProxies & a_Proxies, const Bots & a_Bots, const Bot * a_DyingBot = nullptr):
+			m_Proxies(a_Proxies)
+		{
+			a_Proxies.setBots(&a_Bots, a_DyingBot);
+		}
+
+		~Binding()
+		{
+			m_Proxies.setBots(nullptr);
+		}
+
+	protected:
+		LuaBotProxies & m_Proxies;
+	};
+
+
+	LuaBotProxies(void);
+
+	/** Creates the proxies' metatable in the specified Lua state, bound to this object.
+	Must be called before any proxies are pushed into the state; the object must outlive the state. */
+	void registerMetatable(lua_State * a_LuaState);
+
+	/** Pushes a new proxy for the specified bot onto the Lua stack.
+	a_Index is the bot's index in the bots that the proxies will read, the search for the bot starts there. */
+	void pushProxy(lua_State * a_LuaState, const Bot & a_Bot, size_t a_Index);
+
+	/** Sets the bots that the proxies read from; nullptr makes all the state fields read as nil.
+	a_DyingBot, if not nullptr, is the last state of a bot that has died, read by its proxy even if it is no longer in a_Bots.
+	The bots must stay valid and unchanged until the next call. */
+	void setBots(const Bots * a_Bots, const Bot * a_DyingBot = nullptr)
+	{
+		m_Bots = a_Bots;
+		m_DyingBot = a_DyingBot;
+	}
+
+protected:
+	/** The contents of a single proxy userdata. */
+	struct Proxy
+	{
+		/** The ID of the bot. */
+		int m_ID;
+
+		/** True if the bot is the enemy's; stored in the proxy, because it doesn't change during the game. */
+		bool m_IsEnemy;
+
+		/** The index into m_Bots where the bot was found the last time. */
+		size_t m_IndexHint;
+	};
+
+
+	/** The bots from which the proxies read. */
+	const Bots * m_Bots;
+
+	/** The last state of the bot that has died, read in preference to m_Bots during its onBotDied callback; nullptr if none. */
+	const Bot * m_DyingBot;
+
+
+	/** Returns the bot represented by the proxy, or nullptr if it is not present in m_Bots. */
+	const Bot * findBot(Proxy & a_Proxy) const;
+
+	/** The __index metamethod: the bot's state fields are read from m_Bots, anything else from the proxy's environment table. */
+	static int luaIndex(lua_State * a_LuaState);
+
+	/** The __newindex metamethod: stores the value into the proxy's environment table. */
+	static int luaNewIndex(lua_State * a_LuaState);
+
+	/** The __tostring metamethod, for the debugging output. */
+	static int luaToString(lua_State * a_LuaState);
+};
+
+
+
+
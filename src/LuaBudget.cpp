@@ -0,0 +1,308 @@
+
+// LuaBudget.cpp
+
+// Implements the LuaBudget class that limits how long a single Lua callback may run
+
+#include "Globals.h"
+#include "LuaBudget.h"
+#include "LuaProfiler.h"
+
+
+
+
+
+/** The name of the Lua registry field in which the budget of the current callback is stored for the hook. */
+static const char LUA_REGISTRY_BUDGET_FIELD_NAME[] = "__EsetBotWarz_LuaBudget";
+
+/** The max number of instructions between two checks of the limits. */
+static const int MAX_HOOK_STEP = 500;
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// LuaBudget::Guard:
+
+LuaBudget::Guard::Guard(LuaBudget & a_Budget, lua_State * a_LuaState, const char * a_CallbackName):
+	m_Budget(a_Budget),
+	m_LuaState(a_LuaState)
+{
+	m_Budget.m_NumInstructions = 0;
+	m_Budget.m_HasOverrun = false;
+	m_Budget.m_CallbackName = a_CallbackName;
+	m_Budget.m_StartTime = Clock::now();
+	if (
+		(m_Budget.m_MaxInstructions > 0) ||
+		(m_Budget.m_MaxDuration > Clock::duration::zero()) ||
+		(m_Budget.m_Profiler != nullptr)
+	)
+	{
+		lua_pushlightuserdata(m_LuaState, &m_Budget);
+		lua_setfield(m_LuaState, LUA_REGISTRYINDEX, LUA_REGISTRY_BUDGET_FIELD_NAME);
+		lua_sethook(m_LuaState, &LuaBudget::hook, LUA_MASKCOUNT, m_Budget.m_HookStep);
+	}
+}
+
+
+
+
+
+LuaBudget::Guard::~Guard()
+{
+	lua_sethook(m_LuaState, nullptr, 0, 0);
+
+	// The coroutines created during the callback keep the hook; without the budget in the registry, it does nothing:
+	lua_pushnil(m_LuaState);
+	lua_setfield(m_LuaState, LUA_REGISTRYINDEX, LUA_REGISTRY_BUDGET_FIELD_NAME);
+
+	// Update the stats:
+	auto duration = Clock::now() - m_Budget.m_StartTime;
+	m_Budget.m_NumCallbacks += 1;
+	if (m_Budget.m_HasOverrun)
+	{
+		m_Budget.m_NumOverruns += 1;
+	}
+	if (duration > m_Budget.m_MaxCallbackDuration)
+	{
+		m_Budget.m_MaxCallbackDuration = duration;
+	}
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// LuaBudget:
+
+LuaBudget::LuaBudget(void):
+	m_MaxInstructions(0),
+	m_MaxDuration(Clock::duration::zero()),
+	m_HookStep(MAX_HOOK_STEP),
+	m_Profiler(nullptr),
+	m_CallbackName(""),
+	m_NumInstructions(0),
+	m_HasOverrun(false)
+{
+	clearStats();
+}
+
+
+
+
+
+void LuaBudget::wrapCoroutineFunctions(lua_State * a_LuaState)
+{
+	lua_getfield(a_LuaState, LUA_GLOBALSINDEX, "coroutine");  // Stack: [coroutine]
+	if (!lua_istable(a_LuaState, -1))
+	{
+		lua_pop(a_LuaState, 1);
+		return;
+	}
+	lua_getfield(a_LuaState, -1, "resume");                   // Stack: [coroutine] [resume]
+	lua_pushcclosure(a_LuaState, &luaResume, 1);              // Stack: [coroutine] [luaResume]
+	lua_pushvalue(a_LuaState, -1);                            // Stack: [coroutine] [luaResume] [luaResume]
+	lua_setfield(a_LuaState, -3, "resume");                   // Stack: [coroutine] [luaResume]
+	lua_getfield(a_LuaState, -2, "create");                   // Stack: [coroutine] [luaResume] [create]
+	lua_pushcclosure(a_LuaState, &luaWrap, 2);                // Stack: [coroutine] [luaWrap]
+	lua_setfield(a_LuaState, -2, "wrap");                     // Stack: [coroutine]
+	lua_pop(a_LuaState, 1);
+}
+
+
+
+
+
+void LuaBudget::setLimits(int a_MaxInstructions, int a_MaxMSec)
+{
+	m_MaxInstructions = std::max(a_MaxInstructions, 0);
+	m_MaxDuration = std::chrono::milliseconds(std::max(a_MaxMSec, 0));
+
+	// Check often enough to stop exactly at a small instruction limit:
+	m_HookStep = MAX_HOOK_STEP;
+	if ((m_MaxInstructions > 0) && (m_MaxInstructions < MAX_HOOK_STEP))
+	{
+		m_HookStep = static_cast<int>(m_MaxInstructions);
+	}
+}
+
+
+
+
+
+void LuaBudget::clearStats(void)
+{
+	m_NumCallbacks = 0;
+	m_NumOverruns = 0;
+	m_MaxCallbackDuration = Clock::duration::zero();
+}
+
+
+
+
+
+AString LuaBudget::getStatsString(void) const
+{
+	AString limits;
+	if (m_MaxInstructions > 0)
+	{
+		AppendPrintf(limits, "%lld instructions", m_MaxInstructions);
+	}
+	if (m_MaxDuration > Clock::duration::zero())
+	{
+		AppendPrintf(limits, "%s%lld msec", limits.empty() ? "" : ", ",
+			static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(m_MaxDuration).count())
+		);
+	}
+	if (limits.empty())
+	{
+		limits = "unlimited";
+	}
+	return Printf("Lua callback budget (%s): %d callbacks, %d aborted over budget, longest %.1f msec",
+		limits.c_str(), m_NumCallbacks, m_NumOverruns,
+		std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(m_MaxCallbackDuration).count()
+	);
+}
+
+
+
+
+
+LuaBudget * LuaBudget::getCurrent(lua_State * a_LuaState)
+{
+	lua_getfield(a_LuaState, LUA_REGISTRYINDEX, LUA_REGISTRY_BUDGET_FIELD_NAME);
+	auto res = reinterpret_cast<LuaBudget *>(lua_touserdata(a_LuaState, -1));
+	lua_pop(a_LuaState, 1);
+	return res;
+}
+
+
+
+
+
+void LuaBudget::hook(lua_State * a_LuaState, lua_Debug * a_Debug)
+{
+	UNUSED(a_Debug);
+
+	// Get the budget of the current callback:
+	auto budget = getCurrent(a_LuaState);
+	if (budget == nullptr)
+	{
+		return;
+	}
+
+	if (budget->m_Profiler != nullptr)
+	{
+		budget->m_Profiler->sample(a_LuaState, budget->m_CallbackName, budget->m_HookStep);
+	}
+
+	// Check the limits:
+	if (!budget->m_HasOverrun)
+	{
+		budget->m_NumInstructions += budget->m_HookStep;
+		if ((budget->m_MaxInstructions > 0) && (budget->m_NumInstructions >= budget->m_MaxInstructions))
+		{
+			budget->m_HasOverrun = true;
+		}
+		else if (
+			(budget->m_MaxDuration > Clock::duration::zero()) &&
+			(Clock::now() - budget->m_StartTime >= budget->m_MaxDuration)
+		)
+		{
+			budget->m_HasOverrun = true;
+		}
+	}
+
+	// Abort the callback; raised on each check once over budget, so that the script's own pcall() doesn't let it continue.
+	// Lua's own formatting doesn't support the 64-bit and precision specifiers, format the message here.
+	// lua_error() longjmps out of this function, so the message must not be in an object with a destructor:
+	if (budget->m_HasOverrun)
+	{
+		char msg[200];
+		snprintf(msg, sizeof(msg), "The callback has exceeded its budget (%lld instructions, %.1f msec), aborting",
+			budget->m_NumInstructions,
+			std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(Clock::now() - budget->m_StartTime).count()
+		);
+		luaL_where(a_LuaState, 1);
+		lua_pushstring(a_LuaState, msg);
+		lua_concat(a_LuaState, 2);
+		lua_error(a_LuaState);
+	}
+}
+
+
+
+
+
+int LuaBudget::luaResume(lua_State * a_LuaState)
+{
+	// Install the hook on the coroutine, if a budget is being enforced; leave the arguments' checking to the original:
+	auto coroutine = lua_tothread(a_LuaState, 1);
+	auto budget = getCurrent(a_LuaState);
+	if ((coroutine == nullptr) || (budget == nullptr))
+	{
+		lua_pushvalue(a_LuaState, lua_upvalueindex(1));  // Stack: [args] [resume]
+		lua_insert(a_LuaState, 1);                       // Stack: [resume] [args]
+		lua_call(a_LuaState, lua_gettop(a_LuaState) - 1, LUA_MULTRET);
+		return lua_gettop(a_LuaState);
+	}
+	auto prevHook = lua_gethook(coroutine);
+	int prevMask = lua_gethookmask(coroutine);
+	int prevCount = lua_gethookcount(coroutine);
+	lua_sethook(coroutine, &hook, LUA_MASKCOUNT, budget->m_HookStep);
+
+	// Resume; the original reports the coroutine's errors, including the budget overrun, as its return values:
+	lua_pushvalue(a_LuaState, lua_upvalueindex(1));  // Stack: [args] [resume]
+	lua_insert(a_LuaState, 1);                       // Stack: [resume] [args]
+	lua_call(a_LuaState, lua_gettop(a_LuaState) - 1, LUA_MULTRET);
+
+	// Restore the coroutine's own hook, such as the one inherited from a planner:
+	lua_sethook(coroutine, prevHook, prevMask, prevCount);
+	return lua_gettop(a_LuaState);
+}
+
+
+
+
+
+int LuaBudget::luaWrap(lua_State * a_LuaState)
+{
+	lua_pushvalue(a_LuaState, lua_upvalueindex(2));  // Stack: [fn] [create]
+	lua_insert(a_LuaState, 1);                       // Stack: [create] [fn]
+	lua_call(a_LuaState, lua_gettop(a_LuaState) - 1, 1);  // Stack: [coroutine]
+	lua_pushvalue(a_LuaState, lua_upvalueindex(1));  // Stack: [coroutine] [luaResume]
+	lua_insert(a_LuaState, -2);                      // Stack: [luaResume] [coroutine]
+	lua_pushcclosure(a_LuaState, &luaWrapped, 2);    // Stack: [luaWrapped]
+	return 1;
+}
+
+
+
+
+
+int LuaBudget::luaWrapped(lua_State * a_LuaState)
+{
+	lua_pushvalue(a_LuaState, lua_upvalueindex(1));  // Stack: [args] [luaResume]
+	lua_insert(a_LuaState, 1);                       // Stack: [luaResume] [args]
+	lua_pushvalue(a_LuaState, lua_upvalueindex(2));  // Stack: [luaResume] [args] [coroutine]
+	lua_insert(a_LuaState, 2);                       // Stack: [luaResume] [coroutine] [args]
+	lua_call(a_LuaState, lua_gettop(a_LuaState) - 1, LUA_MULTRET);  // Stack: [ok] [values]
+	if (lua_toboolean(a_LuaState, 1))
+	{
+		return lua_gettop(a_LuaState) - 1;
+	}
+
+	// Propagate the error, with the position of the call added, same as the original:
+	if (lua_isstring(a_LuaState, -1))
+	{
+		luaL_where(a_LuaState, 1);
+		lua_insert(a_LuaState, -2);
+		lua_concat(a_LuaState, 2);
+	}
+	return lua_error(a_LuaState);
+}
+
+
+
+
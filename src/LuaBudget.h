@@ -0,0 +1,140 @@
+
+// LuaBudget.h
+
+// Declares the LuaBudget class that limits how long a single Lua callback may run
+
+
+
+
+
+#pragma once
+
+#include "LuaState.h"
+
+
+
+
+
+// fwd:
+class LuaProfiler;
+
+
+
+
+
+/** Limits the number of Lua instructions and the wall-clock time that a single Lua callback may use.
+A Guard instance is created around each callback; while it exists, a Lua count hook checks the limits every few
+hundred instructions and raises a Lua error once either is exceeded, so that the callback is aborted through the
+normal error handling of its lua_pcall(). Once the budget is exceeded, the error is raised again on each further
+hook call, so that the script cannot continue for long after swallowing it with its own pcall().
+Native code (the API functions) is not interrupted, only the Lua code between the calls.
+A Lua coroutine only inherits the hook of the thread that creates it, so the coroutines created outside of the budgeted
+callbacks would run unchecked; therefore coroutine.resume() and coroutine.wrap() are replaced by versions that install
+the hook on the coroutine for the duration of each resume, while a budget is being enforced.
+Also keeps statistics of the callbacks' durations and of the overruns.
+If a profiler is set, the same hook feeds it the samples of the call stack, so the profiler needs no hook of its own. */
+class LuaBudget
+{
+public:
+	/** Enforces the budget on a single Lua callback for as long as the instance exists. */
+	class Guard
+	{
+	public:
+		/** Starts enforcing the budget on the callback a_CallbackName, which is also used as the root of the profiler's samples.
+		a_CallbackName needs to stay valid for the lifetime of the Guard. */
+		Guard(LuaBudget & a_Budget, lua_State * a_LuaState, const char * a_CallbackName);
+		~Guard();
+
+		/** Returns true if the callback has exceeded the budget and has been aborted. */
+		bool hasOverrun(void) const { return m_Budget.m_HasOverrun; }
+
+	protected:
+		LuaBudget & m_Budget;
+		lua_State * m_LuaState;
+	};
+
+
+	LuaBudget(void);
+
+	/** Replaces coroutine.resume() and coroutine.wrap() in the specified Lua state with the versions that enforce the budget
+	on the coroutines as well. Should be called before any script is loaded into the state, so that the script cannot keep the originals. */
+	static void wrapCoroutineFunctions(lua_State * a_LuaState);
+
+	/** Sets the limits for the callbacks. A non-positive value means that the limit is not used. */
+	void setLimits(int a_MaxInstructions, int a_MaxMSec);
+
+	/** Sets the profiler to be fed with the samples of the callbacks' call stacks; nullptr to disable profiling. */
+	void setProfiler(LuaProfiler * a_Profiler) { m_Profiler = a_Profiler; }
+
+	/** Resets the statistics, used when a new game starts. */
+	void clearStats(void);
+
+	/** Returns the number of callbacks that have run under the budget since the last clearStats(). */
+	int getNumCallbacks(void) const { return m_NumCallbacks; }
+
+	/** Returns the number of callbacks that have been aborted since the last clearStats(). */
+	int getNumOverruns(void) const { return m_NumOverruns; }
+
+	/** Returns a single-line human-readable description of the limits and the statistics. */
+	AString getStatsString(void) const;
+
+protected:
+	typedef std::chrono::steady_clock Clock;
+
+	/** The max number of Lua instructions per callback, zero if not limited. */
+	Int64 m_MaxInstructions;
+
+	/** The max wall-clock duration of a callback, zero if not limited. */
+	Clock::duration m_MaxDuration;
+
+	/** The number of instructions between two checks of the limits. */
+	int m_HookStep;
+
+	/** The profiler fed with the samples of the call stacks, nullptr if not profiling. */
+	LuaProfiler * m_Profiler;
+
+	/** The name of the callback currently being run. */
+	const char * m_CallbackName;
+
+	/** The number of instructions executed by the current callback, in m_HookStep increments. */
+	Int64 m_NumInstructions;
+
+	/** The time when the current callback started. */
+	Clock::time_point m_StartTime;
+
+	/** Set to true once the current callback exceeds the budget. */
+	bool m_HasOverrun;
+
+	/** The number of callbacks since the last clearStats(). */
+	int m_NumCallbacks;
+
+	/** The number of aborted callbacks since the last clearStats(). */
+	int m_NumOverruns;
+
+	/** The longest callback since the last clearStats(). */
+	Clock::duration m_MaxCallbackDuration;
+
+
+	/** Returns the budget currently being enforced in the specified Lua state (stored in its registry by Guard),
+	nullptr if there's none. */
+	static LuaBudget * getCurrent(lua_State * a_LuaState);
+
+	/** The Lua count hook that checks the limits of the budget stored in the Lua registry. */
+	static void hook(lua_State * a_LuaState, lua_Debug * a_Debug);
+
+	/** The replacement of coroutine.resume(). Installs the hook on the coroutine for the duration of the resume, if a budget
+	is being enforced, and calls the original coroutine.resume() (upvalue 1). */
+	static int luaResume(lua_State * a_LuaState);
+
+	/** The replacement of coroutine.wrap(). Creates the coroutine using the original coroutine.create() (upvalue 2)
+	and returns a function that resumes it through luaResume() (upvalue 1). */
+	static int luaWrap(lua_State * a_LuaState);
+
+	/** The function returned by luaWrap(). Resumes the coroutine (upvalue 2) through luaResume() (upvalue 1),
+	returns the values passed by the coroutine or propagates its error, same as the functions returned by the original coroutine.wrap(). */
+	static int luaWrapped(lua_State * a_LuaState);
+};
+
+
+
+
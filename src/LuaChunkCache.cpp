@@ -0,0 +1,313 @@
+
+// LuaChunkCache.cpp
+
+// Implements the LuaChunkCache class that keeps the compiled Lua chunks on disk, so that the scripts needn't be compiled on each start
+
+#include "Globals.h"
+#include "LuaChunkCache.h"
+#include "sha1.h"
+
+
+
+
+
+LuaChunkCache::LuaChunkCache(void)
+{
+	clearStats();
+}
+
+
+
+
+
+void LuaChunkCache::setFolder(const AString & a_Folder)
+{
+	m_Folder = a_Folder;
+	if (m_Folder.empty())
+	{
+		return;
+	}
+
+	// Create the folder, if not already present:
+	#ifdef _WIN32
+		CreateDirectoryA(m_Folder.c_str(), nullptr);
+	#else
+		mkdir(m_Folder.c_str(), S_IRWXU | S_IRWXG | S_IRWXO);
+	#endif
+	if ((m_Folder.back() != '/') && (m_Folder.back() != '\\'))
+	{
+		m_Folder.push_back('/');
+	}
+}
+
+
+
+
+
+int LuaChunkCache::loadFile(lua_State * a_LuaState, const AString & a_FileName)
+{
+	auto startTime = std::chrono::steady_clock::now();
+	if (!isEnabled())
+	{
+		int res = luaL_loadfile(a_LuaState, a_FileName.c_str());
+		m_NumMisses += 1;
+		m_LoadDuration += std::chrono::steady_clock::now() - startTime;
+		return res;
+	}
+
+	AString contents;
+	if (!readFile(a_FileName, contents))
+	{
+		lua_pushfstring(a_LuaState, "cannot open %s", a_FileName.c_str());
+		return LUA_ERRFILE;
+	}
+
+	// Skip the first line if it starts with a '#', same as luaL_loadfile(); keep its LF so that the line numbers stay the same:
+	if (!contents.empty() && (contents[0] == '#'))
+	{
+		contents.erase(0, contents.find('\n'));
+	}
+	AString chunkName = "@" + a_FileName;
+
+	// Load the compiled chunk from the cache, if present:
+	auto cacheFileName = getCacheFileName(a_FileName, contents);
+	AString chunk;
+	if (readFile(cacheFileName, chunk))
+	{
+		if (luaL_loadbuffer(a_LuaState, chunk.data(), chunk.size(), chunkName.c_str()) == 0)
+		{
+			m_NumHits += 1;
+			m_LoadDuration += std::chrono::steady_clock::now() - startTime;
+			return 0;
+		}
+		LOGWARNING("Cannot load the cached chunk %s of file %s, compiling the source instead: %s",
+			cacheFileName.c_str(), a_FileName.c_str(), lua_tostring(a_LuaState, -1)
+		);
+		lua_pop(a_LuaState, 1);
+	}
+
+	// Compile the source and store the chunk:
+	int res = luaL_loadbuffer(a_LuaState, contents.data(), contents.size(), chunkName.c_str());
+	m_NumMisses += 1;
+	if ((res == 0) && !storeChunk(a_LuaState, a_FileName, cacheFileName))
+	{
+		m_NumStoreFailures += 1;
+	}
+	m_LoadDuration += std::chrono::steady_clock::now() - startTime;
+	return res;
+}
+
+
+
+
+
+void LuaChunkCache::installLoader(lua_State * a_LuaState)
+{
+	if (!isEnabled())
+	{
+		return;
+	}
+
+	lua_getfield(a_LuaState, LUA_GLOBALSINDEX, "package");  // Stack: [package]
+	if (!lua_istable(a_LuaState, -1))
+	{
+		LOGWARNING("%s: The package library is not available, the modules will not be cached.", __FUNCTION__);
+		lua_pop(a_LuaState, 1);
+		return;
+	}
+	lua_getfield(a_LuaState, -1, "loaders");  // Stack: [package] [loaders]
+	if (!lua_istable(a_LuaState, -1))
+	{
+		LOGWARNING("%s: The package.loaders table is not available, the modules will not be cached.", __FUNCTION__);
+		lua_pop(a_LuaState, 2);
+		return;
+	}
+
+	// Make room for the loader in front of Lua's own source file loader, which is the second one (after the preload one):
+	int numLoaders = static_cast<int>(lua_objlen(a_LuaState, -1));
+	for (int i = numLoaders; i >= 2; i--)
+	{
+		lua_rawgeti(a_LuaState, -1, i);       // Stack: [package] [loaders] [loader]
+		lua_rawseti(a_LuaState, -2, i + 1);   // Stack: [package] [loaders]
+	}
+	lua_pushlightuserdata(a_LuaState, this);  // Stack: [package] [loaders] [this]
+	lua_pushcclosure(a_LuaState, &loader, 1);  // Stack: [package] [loaders] [loader]
+	lua_rawseti(a_LuaState, -2, 2);           // Stack: [package] [loaders]
+	lua_pop(a_LuaState, 2);
+}
+
+
+
+
+
+void LuaChunkCache::clearStats(void)
+{
+	m_NumHits = 0;
+	m_NumMisses = 0;
+	m_NumStoreFailures = 0;
+	m_LoadDuration = std::chrono::steady_clock::duration::zero();
+}
+
+
+
+
+
+AString LuaChunkCache::getStatsString(void) const
+{
+	auto loadMSec = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(m_LoadDuration).count();
+	if (!isEnabled())
+	{
+		return Printf("Lua chunk cache disabled: %d chunks compiled from the source in %.1f msec", m_NumMisses, loadMSec);
+	}
+	return Printf("Lua chunk cache (%s): %d chunks loaded from the cache, %d compiled from the source (%d could not be stored), %.1f msec in total",
+		m_Folder.c_str(), m_NumHits, m_NumMisses, m_NumStoreFailures, loadMSec
+	);
+}
+
+
+
+
+
+AString LuaChunkCache::getCacheFileName(const AString & a_FileName, const AString & a_Contents) const
+{
+	// The bytecode contains the chunk name and depends on the Lua version, include both in the hash:
+	AString toHash = LUA_RELEASE "\n" + a_FileName + "\n" + a_Contents;
+	unsigned char hash[20];
+	sha1(reinterpret_cast<const unsigned char *>(toHash.data()), toHash.size(), hash);
+
+	AString res = m_Folder;
+	for (auto b: hash)
+	{
+		AppendPrintf(res, "%02x", static_cast<unsigned>(b));
+	}
+	res.append(".luac");
+	return res;
+}
+
+
+
+
+
+bool LuaChunkCache::storeChunk(lua_State * a_LuaState, const AString & a_FileName, const AString & a_CacheFileName)
+{
+	AString chunk;
+	if (lua_dump(a_LuaState, &writeToString, &chunk) != 0)
+	{
+		LOGWARNING("Cannot compile file %s for the Lua chunk cache", a_FileName.c_str());
+		return false;
+	}
+
+	// Write into a temporary file first and then rename it, so that another session never reads a partially written chunk:
+	AString tempFileName = Printf("%s.%p.tmp", a_CacheFileName.c_str(), static_cast<const void *>(this));
+	FILE * f = fopen(tempFileName.c_str(), "wb");
+	if (f == nullptr)
+	{
+		LOGWARNING("Cannot write the Lua chunk cache file %s", tempFileName.c_str());
+		return false;
+	}
+	bool isWritten = (fwrite(chunk.data(), 1, chunk.size(), f) == chunk.size());
+	isWritten = (fclose(f) == 0) && isWritten;
+	remove(a_CacheFileName.c_str());  // Only present if it was invalid, rename() would fail on Windows
+	if (!isWritten || (rename(tempFileName.c_str(), a_CacheFileName.c_str()) != 0))
+	{
+		LOGWARNING("Cannot write the Lua chunk cache file %s", a_CacheFileName.c_str());
+		remove(tempFileName.c_str());
+		return false;
+	}
+	return true;
+}
+
+
+
+
+
+int LuaChunkCache::loader(lua_State * a_LuaState)
+{
+	auto cache = reinterpret_cast<LuaChunkCache *>(lua_touserdata(a_LuaState, lua_upvalueindex(1)));
+	const char * moduleName = luaL_checkstring(a_LuaState, 1);
+
+	// lua_error() longjmps out of this function, so any objects with a destructor need to be in this scope:
+	{
+		// Get the search path:
+		lua_getfield(a_LuaState, LUA_GLOBALSINDEX, "package");  // Stack: [name] [package]
+		lua_getfield(a_LuaState, -1, "path");                   // Stack: [name] [package] [path]
+		const char * searchPath = lua_tostring(a_LuaState, -1);
+		if (searchPath == nullptr)
+		{
+			// Leave the error reporting to Lua's own loader:
+			return 0;
+		}
+		AString templates(searchPath);
+		lua_pop(a_LuaState, 2);                                 // Stack: [name]
+
+		// Find the module file the same way as Lua's own loader (package.path templates with the module's dots turned into folders):
+		AString modulePath = ReplaceAllCharOccurrences(moduleName, '.', '/');
+		AString fileName;
+		for (const auto & tmpl: StringSplit(templates, ";"))
+		{
+			AString candidate(tmpl);
+			for (auto pos = candidate.find('?'); pos != AString::npos; pos = candidate.find('?', pos + modulePath.size()))
+			{
+				candidate.replace(pos, 1, modulePath);
+			}
+			FILE * f = fopen(candidate.c_str(), "r");
+			if (f != nullptr)
+			{
+				fclose(f);
+				fileName = candidate;
+				break;
+			}
+		}
+		if (fileName.empty())
+		{
+			// Not found, let the other loaders try (and report the paths searched):
+			return 0;
+		}
+
+		// Load the module through the cache:
+		if (cache->loadFile(a_LuaState, fileName) == 0)
+		{
+			return 1;
+		}
+		lua_pushfstring(a_LuaState, "error loading module '%s' from file '%s':\n\t%s", moduleName, fileName.c_str(), lua_tostring(a_LuaState, -1));
+	}
+	return lua_error(a_LuaState);
+}
+
+
+
+
+
+int LuaChunkCache::writeToString(lua_State * a_LuaState, const void * a_Data, size_t a_Size, void * a_UserData)
+{
+	UNUSED(a_LuaState);
+	reinterpret_cast<AString *>(a_UserData)->append(reinterpret_cast<const char *>(a_Data), a_Size);
+	return 0;
+}
+
+
+
+
+
+bool LuaChunkCache::readFile(const AString & a_FileName, AString & a_Contents)
+{
+	FILE * f = fopen(a_FileName.c_str(), "rb");
+	if (f == nullptr)
+	{
+		return false;
+	}
+	a_Contents.clear();
+	char buf[16384];
+	size_t numRead;
+	while ((numRead = fread(buf, 1, sizeof(buf), f)) > 0)
+	{
+		a_Contents.append(buf, numRead);
+	}
+	bool res = (ferror(f) == 0);
+	fclose(f);
+	return res;
+}
+
+
+
+
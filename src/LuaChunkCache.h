@@ -0,0 +1,93 @@
+
+// LuaChunkCache.h
+
+// Declares the LuaChunkCache class that keeps the compiled Lua chunks on disk, so that the scripts needn't be compiled on each start
+
+
+
+
+
+#pragma once
+
+#include "LuaState.h"
+
+
+
+
+
+/** Caches the compiled (lua_dump()-ed) chunks of the Lua source files in a folder on disk, keyed by the SHA-1 hash
+of the file's name and contents, so that an unchanged file is loaded as bytecode instead of being parsed and compiled again.
+A changed file gets a new hash, so it is compiled and stored anew; the stale entries are never used again and are left
+for the user to clean up. The bytecode is only ever loaded from the cache; if it cannot be loaded (such as when written
+by a different Lua version), the source is compiled again and the entry is rewritten.
+Besides the main file loaded by LuaState::loadFile(), the cache serves the modules loaded by require(), through a loader
+installed into package.loaders in front of Lua's own source file loader.
+The object is not thread-safe, it is expected to be used only under the same lock as the Lua state it serves;
+it must outlive the Lua states into which its loader is installed. */
+class LuaChunkCache
+{
+public:
+	LuaChunkCache(void);
+
+	/** Sets the folder in which the compiled chunks are stored, and creates it if not present.
+	An empty folder name disables the cache, all the files are then compiled from the source. */
+	void setFolder(const AString & a_Folder);
+
+	/** Returns true if the cache is enabled. */
+	bool isEnabled(void) const { return !m_Folder.empty(); }
+
+	/** Loads the specified Lua file as a function onto the stack of a_LuaState, the same way as luaL_loadfile(),
+	but from the cache if it contains the file's compiled chunk; otherwise compiles the source and stores the chunk.
+	Returns 0 on success, or one of the LUA_ERR* codes with the error message on the stack. */
+	int loadFile(lua_State * a_LuaState, const AString & a_FileName);
+
+	/** Installs the cache's loader into package.loaders of a_LuaState, so that the modules loaded by require() are cached too.
+	Does nothing if the cache is disabled. */
+	void installLoader(lua_State * a_LuaState);
+
+	/** Resets the statistics. */
+	void clearStats(void);
+
+	/** Returns the number of chunks loaded from the cache since the last clearStats(). */
+	int getNumHits(void) const { return m_NumHits; }
+
+	/** Returns the number of chunks compiled from the source since the last clearStats(). */
+	int getNumMisses(void) const { return m_NumMisses; }
+
+	/** Returns a single-line human-readable description of the statistics. */
+	AString getStatsString(void) const;
+
+	/** Returns the name of the cache file for the chunk of the specified source file with the specified contents
+	(after skipping the initial '#' line, if any). */
+	AString getCacheFileName(const AString & a_FileName, const AString & a_Contents) const;
+
+protected:
+	/** The folder in which the compiled chunks are stored, with the trailing path separator; empty if disabled. */
+	AString m_Folder;
+
+	// Statistics since the last clearStats():
+	int m_NumHits;
+	int m_NumMisses;
+	int m_NumStoreFailures;
+	std::chrono::steady_clock::duration m_LoadDuration;
+
+
+	/** Stores the function at the top of a_LuaState's stack, compiled from a_FileName, into the specified cache file.
+	Returns true on success. */
+	bool storeChunk(lua_State * a_LuaState, const AString & a_FileName, const AString & a_CacheFileName);
+
+	/** The loader function installed into package.loaders. The LuaChunkCache instance is its upvalue.
+	Searches package.path for the module the same way Lua's own loader does, and loads the file found through the cache;
+	returns nothing if the module is not found, so that the next loaders are tried. */
+	static int loader(lua_State * a_LuaState);
+
+	/** The lua_Writer function for lua_dump(), appending the data to the AString passed as the userdata. */
+	static int writeToString(lua_State * a_LuaState, const void * a_Data, size_t a_Size, void * a_UserData);
+
+	/** Reads the entire file into a_Contents. Returns true on success. */
+	static bool readFile(const AString & a_FileName, AString & a_Contents);
+};
+
+
+
+
@@ -4,12 +4,24 @@
 // Implements the LuaController class representing the AI controller implemented in Lua
 
 #include "Globals.h"
+#include <unordered_map>
 #include "json/value.h"
 #include "lib/Network/CriticalSection.h"
 #include "Controller.h"
+#include "AsyncController.h"
+#include "LuaController.h"
 #include "LuaState.h"
 #include "Board.h"
 #include "BotWarzApp.h"
+#include "BotPredictor.h"
+#include "ApproachMatrix.h"
+#include "LuaBotProxies.h"
+#include "LuaBudget.h"
+#include "LuaProfiler.h"
+#include "LuaMemory.h"
+#include "LuaChunkCache.h"
+#include "LuaPlanners.h"
+#include "Steering.h"
 
 
 
@@ -17,6 +29,26 @@
 
 static const char LUA_GLOBAL_LUACONTROLLER_FIELD_NAME[] = "__EsetBotWarz_luaController";
 
+/** The kinds of the commands set by the setCommand() API function, exported to Lua as the CMD_* global constants. */
+enum
+{
+	cmdNone = 0,
+	cmdAccelerate,
+	cmdBrake,
+	cmdSteer,
+
+	cmdCount,
+};
+
+/** The protocol names of the command kinds, indexed by the kind. */
+static const char * const g_CommandNames[cmdCount] =
+{
+	"",
+	"accelerate",
+	"brake",
+	"steer",
+};
+
 
 
 
@@ -27,17 +59,40 @@ class LuaController :
 	typedef Controller Super;
 
 public:
-	LuaController(BotWarzApp & a_App, const AString & a_FileName, bool a_ShouldDebugZBS):
+	LuaController(BotWarzApp & a_App, const AString & a_FileName, bool a_ShouldDebugZBS, const LuaControllerSettings & a_Settings):
 		Super(a_App),
-		m_LuaState(Printf("LuaController: %s", a_FileName.c_str()))
+		m_LuaState(Printf("LuaController: %s", a_FileName.c_str())),
+		m_UseBotProxies(false),
+		m_Snapshot(nullptr),
+		m_NumProfiledGames(0),
+		m_GCSlack(std::chrono::milliseconds(std::max(a_Settings.m_GCSlackMSec, 0))),
+		m_NumNativeCommands(0)
 	{
-		m_LuaState.create();
+		m_Budget.setLimits(a_Settings.m_MaxCallbackInstructions, a_Settings.m_MaxCallbackMSec);
+		m_Planners.setLimits(a_Settings.m_PlannerMaxInstructions, a_Settings.m_PlannerMaxMSec);
+		if (a_Settings.m_ShouldProfile)
+		{
+			m_Budget.setProfiler(&m_Profiler);
+		}
+		m_LuaState.create(&LuaMemory::alloc, &m_Memory);
 		lua_atpanic(m_LuaState, luaPanic);
+		LuaBudget::wrapCoroutineFunctions(m_LuaState);
+		m_BotProxies.registerMetatable(m_LuaState);
+		m_ChunkCache.setFolder(a_Settings.m_ChunkCacheFolder);
+		m_ChunkCache.installLoader(m_LuaState);
 		if (a_ShouldDebugZBS)
 		{
 			m_LuaState.execCode("require([[mobdebug]]).start()");
 		}
-		m_IsValid = m_LuaState.loadFile(a_FileName);
+
+		// Load the script, report how long it took, with or without the compiled chunks in the cache:
+		auto startTime = std::chrono::steady_clock::now();
+		m_IsValid = m_LuaState.loadFile(a_FileName, &m_ChunkCache);
+		auto loadMSec = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(std::chrono::steady_clock::now() - startTime).count();
+		bool isWarm = (m_ChunkCache.getNumHits() > 0) && (m_ChunkCache.getNumMisses() == 0);
+		LOG("%s: Lua controller %s loaded in %.1f msec (%s start). %s",
+			a_App.getLoginNick().c_str(), a_FileName.c_str(), loadMSec, isWarm ? "warm" : "cold", m_ChunkCache.getStatsString().c_str()
+		);
 	}
 
 
@@ -59,32 +114,61 @@ public:
 	The board needs to stay valid until the game is finished via the onGameFinished() call. */
 	virtual void onGameStarted(Board & a_Board) override
 	{
-		// Create a table representing the board in the Lua state
+		startGame(a_Board, "onGameStarted");
+	}
+
+
+
+
+
+	/** Called instead of onGameStarted() when the controller has been reloaded and takes over in the middle of a game.
+	Builds the gameboard table from the current board, the same way as at the game start, and calls the script's
+	onGameResumed(), or its onGameStarted() if it doesn't define onGameResumed(). */
+	virtual void onGameResumed(Board & a_Board) override
+	{
 		cCSLock Lock(m_CSLuaState);
-		if (m_LuaState == nullptr)
+		startGame(a_Board, m_LuaState.hasFunction("onGameResumed") ? "onGameResumed" : "onGameStarted");
+	}
+
+
+
+
+
+	/** Called when the controller is about to be replaced by its reloaded version.
+	Returns the string returned by the script's onReloading(), if defined. */
+	virtual AString saveState(void) override
+	{
+		cCSLock Lock(m_CSLuaState);
+		AString res;
+		if (!m_LuaState.hasFunction("onReloading"))
 		{
-			return;
+			return res;
 		}
-		lua_newtable(m_LuaState);  // Stack: [GBT]
-		m_GameBoardTable.refStack(m_LuaState, -1);  // Stack: [GBT]
 		if (!m_GameBoardTable.isValid())
 		{
-			LOGWARNING("%s: Cannot create gameboard table reference.", __FUNCTION__);
-			return;
+			// Between games:
+			callWithBudget("onReloading", LuaState::Return, res);
+			return res;
 		}
 
-		// Store the board:
-		m_Board = &a_Board;
+		// In the middle of a game, the script may still read its bots:
+		SnapshotBinding snapshot(*this);
+		callWithBudget("onReloading", LuaState::Return, res);
+		return res;
+	}
+
 
-		// Fill the table with members:
-		createSpeedLevelsTable();
-		createWorldTable();
-		createEmptySubTable("botCommands");
-		createAllBotTable();
-		createAPIFunctions();
-		updateGameBoardTime();
 
-		m_LuaState.call("onGameStarted", &m_GameBoardTable);
+
+
+	/** Called on the reloaded version before it takes over; passes the state saved by the previous version to the script's onReloaded(), if defined. */
+	virtual void restoreState(const AString & a_State) override
+	{
+		cCSLock Lock(m_CSLuaState);
+		if (m_LuaState.hasFunction("onReloaded"))
+		{
+			callWithBudget("onReloaded", a_State);
+		}
 	}
 
 
@@ -94,15 +178,21 @@ public:
 	/** Called when a game update has been received. */
 	virtual void onGameUpdate(void) override
 	{
-		// Update the bots in the board representation table:
 		cCSLock Lock(m_CSLuaState);
 		updateGameBoardTime();
+		SnapshotBinding snapshot(*this);
+		if (m_UseBotProxies)
+		{
+			// The proxies read the bots directly from the snapshot, there's nothing to update:
+			callWithBudget("onGameUpdate", &m_GameBoardTable);
+			return;
+		}
+
+		// Update the bots in the board representation table:
 		lua_rawgeti(m_LuaState, LUA_REGISTRYINDEX, m_GameBoardTable);  // Stack: [GBT]
 		lua_getfield(m_LuaState, -1, "allBots");                       // Stack: [GBT] [allBots]
-		auto bots = m_Board->getAllBotsCopy();
-		for (auto & bot: bots)
+		for (auto & b: snapshot->m_AllBots)
 		{
-			auto & b = *(bot.second);
 			lua_rawgeti(m_LuaState, -1, b.m_ID);    // Stack: [GBT] [allBots] [bot]
 			lua_pushnumber(m_LuaState, b.m_X);      // Stack: [GBT] [allBots] [bot] [x]
 			lua_setfield(m_LuaState, -2, "x");      // Stack: [GBT] [allBots] [bot]
@@ -112,11 +202,15 @@ public:
 			lua_setfield(m_LuaState, -2, "angle");  // Stack: [GBT] [allBots] [bot]
 			lua_pushnumber(m_LuaState, b.m_Speed);  // Stack: [GBT] [allBots] [bot] [speed]
 			lua_setfield(m_LuaState, -2, "speed");  // Stack: [GBT] [allBots] [bot]
+			lua_pushnumber(m_LuaState, b.m_AngularVelocity);  // Stack: [GBT] [allBots] [bot] [angularVelocity]
+			lua_setfield(m_LuaState, -2, "angularVelocity");  // Stack: [GBT] [allBots] [bot]
+			lua_pushnumber(m_LuaState, b.m_Acceleration);     // Stack: [GBT] [allBots] [bot] [acceleration]
+			lua_setfield(m_LuaState, -2, "acceleration");     // Stack: [GBT] [allBots] [bot]
 			lua_pop(m_LuaState, 1);                 // Stack: [GBT] [allBots]
-		}  // for bot - bots[]
+		}  // for b - snapshot->m_AllBots[]
 		lua_pop(m_LuaState, 2);
 
-		m_LuaState.call("onGameUpdate", &m_GameBoardTable);
+		callWithBudget("onGameUpdate", &m_GameBoardTable);
 	}
 
 
@@ -130,21 +224,43 @@ public:
 	{
 		cCSLock Lock(m_CSLuaState);
 		updateGameBoardTime();
-		m_LuaState.call("onGameFinished", &m_GameBoardTable);
-		m_GameBoardTable.unRef();
+		{
+			// Not limited by the budget, the game has already finished and the script may take its time to evaluate it:
+			SnapshotBinding snapshot(*this);
+			m_LuaState.call("onGameFinished", &m_GameBoardTable);
+		}
+		endGame();
 	}
 
 
 
 
 
+	/** Called when the reloaded version has taken over in the middle of the game.
+	The script isn't notified, the game goes on; only the statistics of the game so far are reported. */
+	virtual void onRetired(void) override
+	{
+		cCSLock Lock(m_CSLuaState);
+		if (m_GameBoardTable.isValid())
+		{
+			endGame();
+		}
+	}
+
+
+
+
 
 	virtual void onBotDied(const Bot & a_Bot) override
 	{
-		// Call the callback:
+		// Call the callback; the bot's proxy reads its last state, because when running in the AsyncController's thread,
+		// the latest snapshot is already the one from the update in which the bot has died:
 		cCSLock Lock(m_CSLuaState);
 		updateGameBoardTime();
-		m_LuaState.call("onBotDied", &m_GameBoardTable, a_Bot.m_ID);
+		{
+			SnapshotBinding snapshot(*this, &a_Bot);
+			callWithBudget("onBotDied", &m_GameBoardTable, a_Bot.m_ID);
+		}
 
 		// Remove the bot from the Lua tables:
 		lua_rawgeti(m_LuaState, LUA_REGISTRYINDEX, m_GameBoardTable);  // Stack: [GBT]
@@ -158,39 +274,76 @@ public:
 
 
 
-	/** Returns the current set of commands for the bots that should be sent to the server.
+	/** Fills a_Commands with the current set of commands for the bots that should be sent to the server.
 	Also clears the commands, so that they aren't sent the next time this is called. */
-	virtual Json::Value getBotCommands(void) override
+	virtual void getBotCommands(BotCommands & a_Commands) override
 	{
-		Json::Value res(Json::arrayValue);
-
-		// Get the bots before locking the Lua State (to avoid deadlocks):
-		auto myBots = m_Board->getMyBotsCopy();
+		a_Commands.clear();
 
 		// Check that the Lua state is valid:
 		cCSLock Lock(m_CSLuaState);
 		if (!m_GameBoardTable.isValid())
 		{
-			return res;
+			return;
 		}
 		updateGameBoardTime();
 
-		// Call the pre-getCommands callback:
-		m_LuaState.call("onSendingCommands", &m_GameBoardTable);
+		// Get the bots (lock-free); only once locked, so that no other callback can bind a newer snapshot meanwhile:
+		SnapshotBinding snapshot(*this);
+
+		// Call the pre-getCommands callback.
+		// If it is aborted over budget, the commands that the script has stored so far (such as those from the last onGameUpdate) are sent,
+		// the rest of the bots get no command and continue along their predicted paths:
+		callWithBudget("onSendingCommands", &m_GameBoardTable);
 
 		// Get the botCommands table:
 		lua_rawgeti(m_LuaState, LUA_REGISTRYINDEX, m_GameBoardTable);
 		lua_getfield(m_LuaState, -1, "botCommands");
-		if (lua_isnil(m_LuaState, -1))
+		if (!lua_istable(m_LuaState, -1))
 		{
 			LOGWARNING("The botCommands table is not present in the Lua game state. Returning no commands.");
-			return res;
+			lua_pop(m_LuaState, 2);
+			return;
 		}
 
-		// For each of my currently alive bots, get its command:
-		for (auto & bot : myBots)
+		// The scripts using setCommand() leave the table empty, skip it altogether then:
+		lua_pushnil(m_LuaState);                   // Stack: [GBT] [botCommands] [nil]
+		bool hasTableCommands = (lua_next(m_LuaState, -2) != 0);
+		if (hasTableCommands)
 		{
-			lua_rawgeti(m_LuaState, -1, bot->m_ID);  // Stack: [GBT] [botCommands] [bot]
+			lua_pop(m_LuaState, 2);                  // Stack: [GBT] [botCommands]
+		}
+		bool hasNativeCommands = (m_NumNativeCommands > 0);
+
+		// For each of my currently alive bots, get its command; the one set by setCommand() takes precedence over the table:
+		for (auto & bot : snapshot->m_MyBots)
+		{
+			if (hasNativeCommands)
+			{
+				auto itr = m_NativeCommandIndex.find(bot.m_ID);
+				if ((itr != m_NativeCommandIndex.end()) && (m_NativeCommands[itr->second].m_Kind != cmdNone))
+				{
+					auto & nativeCmd = m_NativeCommands[itr->second];
+					a_Commands.emplace_back(bot.m_ID);
+					auto & cmd = a_Commands.back();
+					cmd.m_Cmd.assign(g_CommandNames[nativeCmd.m_Kind]);
+					cmd.m_HasAngle = (nativeCmd.m_Kind == cmdSteer);
+					cmd.m_Angle = nativeCmd.m_Angle;
+					if (hasTableCommands)
+					{
+						// Discard the table command, if any:
+						lua_pushnil(m_LuaState);               // Stack: [GBT] [botCommands] [nil]
+						lua_rawseti(m_LuaState, -2, bot.m_ID); // Stack: [GBT] [botCommands]
+					}
+					continue;
+				}
+			}
+			if (!hasTableCommands)
+			{
+				continue;
+			}
+
+			lua_rawgeti(m_LuaState, -1, bot.m_ID);  // Stack: [GBT] [botCommands] [bot]
 			if (!lua_istable(m_LuaState, -1))
 			{
 				// The entry isn't a table, nothing to query
@@ -198,39 +351,72 @@ public:
 				continue;
 			}
 			lua_getfield(m_LuaState, -1, "cmd");     // Stack: [GBT] [botCommands] [bot] [.cmd]
-			AString cmd;
-			m_LuaState.getStackValue(-1, cmd);
-			Json::Value val;
-			val["cmd"] = cmd;
+			a_Commands.emplace_back(bot.m_ID);
+			auto & cmd = a_Commands.back();
+			m_LuaState.getStackValue(-1, cmd.m_Cmd);
 			int toPop = 2;
-			if (cmd == "steer")
+			if (cmd.m_Cmd == "steer")
 			{
-				lua_Number angle;
 				lua_getfield(m_LuaState, -2, "angle");  // Stack: [GBT] [botCommands] [bot] [.cmd] [.angle]
-				m_LuaState.getStackValue(-1, angle);
-				val["angle"] = angle;
+				m_LuaState.getStackValue(-1, cmd.m_Angle);
+				cmd.m_HasAngle = true;
 				toPop = 3;
 			}
 			lua_pop(m_LuaState, toPop);              // Stack: [GBT] [botCommands]
-			val["id"] = bot->m_ID;
-			res.append(val);
 
 			// Clear the command:
 			lua_pushnil(m_LuaState);                 // Stack: [GBT] [botCommands] [nil]
-			lua_rawseti(m_LuaState, -2, bot->m_ID);  // Stack: [GBT] [botCommands]
-		}  // for bot - myBots[]
+			lua_rawseti(m_LuaState, -2, bot.m_ID);   // Stack: [GBT] [botCommands]
+		}  // for bot - snapshot->m_MyBots[]
 		lua_pop(m_LuaState, 2);
 
+		// Clear the native commands, including those of the bots that have died meanwhile:
+		if (hasNativeCommands)
+		{
+			for (auto & nativeCmd: m_NativeCommands)
+			{
+				nativeCmd.m_Kind = cmdNone;
+			}
+			m_NumNativeCommands = 0;
+		}
+
 		// Let the Lua script know that we've sent the commands:
-		m_LuaState.call("onCommandsSent", &m_GameBoardTable);
+		callWithBudget("onCommandsSent", &m_GameBoardTable);
+	}
 
-		return res;
+
+
+
+
+	/** Called after the commands have been sent to the server.
+	Resumes the script's planners and collects the Lua garbage in the slack until the next game update,
+	if the collector has been stopped for the game. */
+	virtual void onCommandsSent(void) override
+	{
+		cCSLock Lock(m_CSLuaState);
+		if ((m_Planners.getNumPlanners() > 0) && m_GameBoardTable.isValid())
+		{
+			SnapshotBinding snapshot(*this);
+			m_Planners.resumeAll(m_LuaState, m_GameBoardTable);
+		}
+		if (m_Memory.isCollectorStopped())
+		{
+			m_Memory.collectInSlack(m_LuaState, m_GCSlack);
+		}
 	}
 
 
 
 
 protected:
+	/** The allocator and the garbage collection policy of m_LuaState. Must be declared before m_LuaState, so that it outlives it.
+	Protected by m_CSLuaState. */
+	LuaMemory m_Memory;
+
+	/** The cache of the compiled chunks of the script and the modules it requires. Must be declared before m_LuaState,
+	whose module loader refers to it. Protected by m_CSLuaState. */
+	LuaChunkCache m_ChunkCache;
+
 	/** The Lua engine used for the AI.
 	Protected against multithreaded access by m_CSLuaState. */
 	LuaState m_LuaState;
@@ -248,6 +434,255 @@ protected:
 	/** Protects m_BotCommands against multithreaded access. */
 	cCriticalSection m_CSLuaState;
 
+	/** The predictor used by the predictBots() API function. Kept as a member so that its memory is reused.
+	Protected by m_CSLuaState. */
+	BotPredictor m_Predictor;
+
+	/** The bot IDs returned by the spatial queries. Kept as a member so that its memory is reused.
+	Protected by m_CSLuaState. */
+	std::vector<int> m_QueryIDs;
+
+	/** If true, the bots in allBots are userdata proxies reading directly from the board snapshots, instead of tables
+	that are rewritten on each update. Selected by the script's useBotProxies global variable at each game start. */
+	bool m_UseBotProxies;
+
+	/** The provider of the bot proxies, bound to the latest snapshot during each Lua callback.
+	Protected by m_CSLuaState. */
+	LuaBotProxies m_BotProxies;
+
+	/** The snapshot bound by the Lua callback currently running, see SnapshotBinding; nullptr outside of the callbacks.
+	Protected by m_CSLuaState. */
+	const BoardSnapshot * m_Snapshot;
+
+	/** The (ID, bot) pairs of the snapshot used by the batch steering functions, sorted by the ID. Kept as a member so that its memory is reused.
+	Only valid during a single API function call. Protected by m_CSLuaState. */
+	std::vector<std::pair<int, const Bot *>> m_BotsByID;
+
+	/** The pairwise approaches computed by the computeApproaches() API function, queried by getApproach().
+	Protected by m_CSLuaState. */
+	ApproachMatrix m_Approaches;
+
+	/** The limits of the callbacks called on each game tick, and their statistics.
+	Protected by m_CSLuaState. */
+	LuaBudget m_Budget;
+
+	/** The profiler of the callbacks called on each game tick, fed by m_Budget's hook if profiling is enabled.
+	Protected by m_CSLuaState. */
+	LuaProfiler m_Profiler;
+
+	/** The number of games whose profile has been written, used for numbering the profile files. */
+	int m_NumProfiledGames;
+
+	/** The max time spent collecting the Lua garbage after each batch of commands is sent.
+	If zero, the garbage collector runs automatically instead. */
+	std::chrono::steady_clock::duration m_GCSlack;
+
+	/** A command set by the setCommand() API function. */
+	struct NativeCommand
+	{
+		/** One of the cmd* kinds, cmdNone if no command is set. */
+		int m_Kind;
+
+		/** The angle parameter, used by cmdSteer. */
+		double m_Angle;
+	};
+
+	/** The commands set by the setCommand() API function, one slot for each of my bots at the game start, so that setting
+	a command doesn't allocate anything. Read and cleared by getBotCommands(). Protected by m_CSLuaState. */
+	std::vector<NativeCommand> m_NativeCommands;
+
+	/** Maps the IDs of my bots to their slots in m_NativeCommands. Built at the game start. Protected by m_CSLuaState. */
+	std::unordered_map<int, size_t> m_NativeCommandIndex;
+
+	/** The number of slots in m_NativeCommands that have a command set. Protected by m_CSLuaState. */
+	size_t m_NumNativeCommands;
+
+	/** The planners registered by the script, resumed in the slack after each batch of commands is sent.
+	Protected by m_CSLuaState. */
+	LuaPlanners m_Planners;
+
+
+
+
+
+	/** Binds the latest board snapshot for the duration of a single Lua callback: the bot proxies read from it
+	and the API functions called by the callback use it, so that the callback sees a single state of the board
+	and its thread holds a single snapshot at a time.
+	a_DyingBot, if not nullptr, is the last state of the bot that has died, readable through its proxy during onBotDied. */
+	class SnapshotBinding
+	{
+	public:
+		SnapshotBinding(LuaController & a_Controller, const Bot * a_DyingBot = nullptr):
+			m_Controller(a_Controller),
+			m_Snapshot(a_Controller.m_Board->getSnapshot()),
+			m_ProxiesBinding(a_Controller.m_BotProxies, m_Snapshot->m_AllBots, a_DyingBot)
+		{
+			ASSERT(a_Controller.m_CSLuaState.IsLockedByCurrentThread());
+			ASSERT(a_Controller.m_Snapshot == nullptr);  // The callbacks don't nest
+			a_Controller.m_Snapshot = &(*m_Snapshot);
+		}
+
+		~SnapshotBinding()
+		{
+			m_Controller.m_Snapshot = nullptr;
+		}
+
+		const BoardSnapshot & operator *(void) const { return *m_Snapshot; }
+		const BoardSnapshot * operator ->(void) const { return &(*m_Snapshot); }
+
+	protected:
+		LuaController & m_Controller;
+		BoardSnapshots::ReadRef m_Snapshot;
+		LuaBotProxies::Binding m_ProxiesBinding;
+	};
+
+
+
+
+
+	/** Returns the snapshot bound by the Lua callback currently running, for the API functions.
+	Logs a warning with the Lua stack trace and returns nullptr if there's none, when called outside of the game callbacks. */
+	const BoardSnapshot * getBoundSnapshot(lua_State * a_LuaState, const char * a_FunctionName)
+	{
+		ASSERT(m_CSLuaState.IsLockedByCurrentThread());  // Called from a Lua callback
+		if (m_Snapshot == nullptr)
+		{
+			LOGWARNING("%s: Can only be called from the game callbacks", a_FunctionName);
+			LuaState L(a_LuaState);
+			L.logStackTrace();
+		}
+		return m_Snapshot;
+	}
+
+
+
+
+
+	/** Calls the specified Lua callback limited by m_Budget, so that a runaway script cannot hold m_CSLuaState and block
+	the sending of the commands. An overrun is logged, both to the console and to the comm log.
+	Returns true if the callback ran to completion. */
+	template <typename... Args>
+	bool callWithBudget(const char * a_FunctionName, Args &&... a_Args)
+	{
+		ASSERT(m_CSLuaState.IsLockedByCurrentThread());
+
+		bool res, hasOverrun;
+		{
+			LuaBudget::Guard guard(m_Budget, m_LuaState, a_FunctionName);
+			res = m_LuaState.call(a_FunctionName, std::forward<Args>(a_Args)...);
+			hasOverrun = guard.hasOverrun();
+		}
+		if (hasOverrun)
+		{
+			auto msg = Printf("Lua callback %s() exceeded its budget and was aborted (%d overruns in this game)",
+				a_FunctionName, m_Budget.getNumOverruns()
+			);
+			LOGWARNING("%s: %s", m_App.getLoginNick().c_str(), msg.c_str());
+			m_App.commentLog(msg);
+		}
+		return res;
+	}
+
+
+
+
+
+	/** Creates the gameboard table for the specified board and calls the specified script callback with it.
+	Used both at the game start and when the reloaded version takes over in the middle of a game. */
+	void startGame(Board & a_Board, const char * a_CallbackName)
+	{
+		// Create a table representing the board in the Lua state
+		cCSLock Lock(m_CSLuaState);
+		if (m_LuaState == nullptr)
+		{
+			return;
+		}
+		lua_newtable(m_LuaState);  // Stack: [GBT]
+		m_GameBoardTable.refStack(m_LuaState, -1);  // Stack: [GBT]
+		if (!m_GameBoardTable.isValid())
+		{
+			LOGWARNING("%s: Cannot create gameboard table reference.", __FUNCTION__);
+			return;
+		}
+
+		// Store the board, build the table and call the script from a single snapshot:
+		m_Board = &a_Board;
+		SnapshotBinding snapshot(*this);
+
+		// The script opts in to the bot proxies by setting a global variable:
+		lua_getfield(m_LuaState, LUA_GLOBALSINDEX, "useBotProxies");  // Stack: [GBT] [useBotProxies]
+		m_UseBotProxies = (lua_toboolean(m_LuaState, -1) != 0);
+		lua_pop(m_LuaState, 1);                                        // Stack: [GBT]
+
+		// Fill the table with members:
+		createSpeedLevelsTable();
+		createWorldTable();
+		createEmptySubTable("botCommands");
+		createAllBotTable(*snapshot);
+		createAPIFunctions();
+		updateGameBoardTime();
+
+		// The game start isn't time-critical, the script may take its time to set up:
+		m_Budget.clearStats();
+		m_Planners.clearStats();
+		m_Profiler.clear();
+		m_Memory.clearStats();
+		prepareNativeCommands(*snapshot);
+		m_LuaState.call(a_CallbackName, &m_GameBoardTable);
+
+		// Collect the garbage left over from the setup, then keep the collector out of the latency-critical callbacks:
+		if (m_GCSlack > std::chrono::steady_clock::duration::zero())
+		{
+			lua_gc(m_LuaState, LUA_GCCOLLECT, 0);
+			m_Memory.stopCollector(m_LuaState);
+		}
+	}
+
+
+
+
+
+	/** Releases the game's Lua state and reports the statistics of the game.
+	Used at the game finish, and when the controller is retired in the middle of a game. */
+	void endGame(void)
+	{
+		ASSERT(m_CSLuaState.IsLockedByCurrentThread());
+
+		m_GameBoardTable.unRef();
+		bool hasPlanners = (m_Planners.getNumResumes() > 0);
+		m_Planners.stopAll(m_LuaState);
+		if (m_Memory.isCollectorStopped())
+		{
+			m_Memory.restartCollector(m_LuaState);
+		}
+
+		// Report the budget overruns and the memory use:
+		auto budgetStats = m_Budget.getStatsString();
+		LOG("%s: %s", m_App.getLoginNick().c_str(), budgetStats.c_str());
+		m_App.commentLog(budgetStats);
+		auto memoryStats = m_Memory.getStatsString();
+		LOG("%s: %s", m_App.getLoginNick().c_str(), memoryStats.c_str());
+		m_App.commentLog(memoryStats);
+		if (hasPlanners)
+		{
+			auto plannerStats = m_Planners.getStatsString();
+			LOG("%s: %s", m_App.getLoginNick().c_str(), plannerStats.c_str());
+			m_App.commentLog(plannerStats);
+		}
+
+		// Write the profile, if profiling:
+		if (m_Profiler.getNumSamples() > 0)
+		{
+			m_NumProfiledGames += 1;
+			auto fileName = Printf("%s-game%d.folded", m_App.getLogger().getFileNameBase().c_str(), m_NumProfiledGames);
+			if (m_Profiler.writeCollapsed(fileName))
+			{
+				LOG("%s: Lua profile with %d samples written to %s", m_App.getLoginNick().c_str(), m_Profiler.getNumSamples(), fileName.c_str());
+			}
+			m_Profiler.clear();
+		}
+	}
+
 
 
 
@@ -317,15 +752,19 @@ protected:
 
 
 
-	/** Stores all the bots in an "allBots" table inside the GBT.
+	/** Stores all the bots of the snapshot in an "allBots" table inside the GBT, either as tables or as proxies (m_UseBotProxies).
 	Assumes that the GBT is at the top of the Lua stack, and leaves it there. */
-	void createAllBotTable(void)
+	void createAllBotTable(const BoardSnapshot & a_Snapshot)
 	{
 		lua_newtable(m_LuaState);                    // Stack: [GBT] [allBots]
-		auto allBots = m_Board->getAllBotsCopy();
-		for (auto & bot: allBots)
+		for (auto & b: a_Snapshot.m_AllBots)
 		{
-			auto & b = *(bot.second);
+			if (m_UseBotProxies)
+			{
+				m_BotProxies.pushProxy(m_LuaState, b, static_cast<size_t>(&b - a_Snapshot.m_AllBots.data()));  // Stack: [GBT] [allBots] [proxy]
+				lua_rawseti(m_LuaState, -2, b.m_ID);    // Stack: [GBT] [allBots]
+				continue;
+			}
 			lua_newtable(m_LuaState);                  // Stack: [GBT] [allBots] [bot]
 			lua_pushnumber(m_LuaState, b.m_ID);        // Stack: [GBT] [allBots] [bot] [id]
 			lua_setfield(m_LuaState, -2, "id");        // Stack: [GBT] [allBots] [bot]
@@ -339,8 +778,12 @@ protected:
 			lua_setfield(m_LuaState, -2, "angle");     // Stack: [GBT] [allBots] [bot]
 			lua_pushboolean(m_LuaState, b.m_IsEnemy);  // Stack: [GBT] [allBots] [bot] [isEnemy]
 			lua_setfield(m_LuaState, -2, "isEnemy");   // Stack: [GBT] [allBots] [bot]
+			lua_pushnumber(m_LuaState, b.m_AngularVelocity);  // Stack: [GBT] [allBots] [bot] [angularVelocity]
+			lua_setfield(m_LuaState, -2, "angularVelocity");  // Stack: [GBT] [allBots] [bot]
+			lua_pushnumber(m_LuaState, b.m_Acceleration);     // Stack: [GBT] [allBots] [bot] [acceleration]
+			lua_setfield(m_LuaState, -2, "acceleration");     // Stack: [GBT] [allBots] [bot]
 			lua_rawseti(m_LuaState, -2, b.m_ID);       // Stack: [GBT] [allBots]
-		}  // for bot - allBots[]
+		}  // for b - a_Snapshot.m_AllBots[]
 		lua_setfield(m_LuaState, -2, "allBots");
 	}
 
@@ -363,6 +806,28 @@ protected:
 
 
 
+	/** Returns the LuaController instance stored in the specified Lua state by createAPIFunctions().
+	Logs a warning with the Lua stack trace and returns nullptr if there's none. */
+	static LuaController * getInstance(lua_State * a_LuaState)
+	{
+		lua_getfield(a_LuaState, LUA_GLOBALSINDEX, LUA_GLOBAL_LUACONTROLLER_FIELD_NAME);
+		if (!lua_islightuserdata(a_LuaState, -1))
+		{
+			lua_pop(a_LuaState, 1);
+			LOGWARNING("%s: Cannot find my instance in the Lua state", __FUNCTION__);
+			LuaState L(a_LuaState);
+			L.logStackTrace();
+			return nullptr;
+		}
+		auto res = reinterpret_cast<LuaController *>(lua_touserdata(a_LuaState, -1));
+		lua_pop(a_LuaState, 1);
+		return res;
+	}
+
+
+
+
+
 	/** OBSOLETE binding for the commLog() function. Convert into commentLog. */
 	static int commLog(lua_State * a_LuaState)
 	{
@@ -381,15 +846,11 @@ protected:
 		}
 
 		// Get the luaController instance from the state:
-		lua_getfield(a_LuaState, LUA_GLOBALSINDEX, LUA_GLOBAL_LUACONTROLLER_FIELD_NAME);
-		if (!lua_islightuserdata(a_LuaState, -1))
+		auto luaController = getInstance(a_LuaState);
+		if (luaController == nullptr)
 		{
-			LOGWARNING("%s: Cannot find my instance in the Lua state", __FUNCTION__);
-			L.logStackTrace();
 			return 0;
 		}
-		LuaController * luaController = reinterpret_cast<LuaController *>(lua_touserdata(a_LuaState, -1));
-		lua_pop(a_LuaState, 1);
 
 		// Log:
 		AString msg;
@@ -416,15 +877,11 @@ protected:
 		}
 
 		// Get the luaController instance from the state:
-		lua_getfield(a_LuaState, LUA_GLOBALSINDEX, LUA_GLOBAL_LUACONTROLLER_FIELD_NAME);
-		if (!lua_islightuserdata(a_LuaState, -1))
+		auto luaController = getInstance(a_LuaState);
+		if (luaController == nullptr)
 		{
-			LOGWARNING("%s: Cannot find my instance in the Lua state", __FUNCTION__);
-			L.logStackTrace();
 			return 0;
 		}
-		LuaController * luaController = reinterpret_cast<LuaController *>(lua_touserdata(a_LuaState, -1));
-		lua_pop(a_LuaState, 1);
 
 		// Log:
 		AString msg;
@@ -452,15 +909,11 @@ protected:
 		}
 
 		// Get the luaController instance from the state:
-		lua_getfield(a_LuaState, LUA_GLOBALSINDEX, LUA_GLOBAL_LUACONTROLLER_FIELD_NAME);
-		if (!lua_islightuserdata(a_LuaState, -1))
+		auto luaController = getInstance(a_LuaState);
+		if (luaController == nullptr)
 		{
-			LOGWARNING("%s: Cannot find my instance in the Lua state", __FUNCTION__);
-			L.logStackTrace();
 			return 0;
 		}
-		LuaController * luaController = reinterpret_cast<LuaController *>(lua_touserdata(a_LuaState, -1));
-		lua_pop(a_LuaState, 1);
 
 		// Log:
 		int botID = 0;
@@ -487,24 +940,989 @@ protected:
 		lua_setfield(m_LuaState, LUA_GLOBALSINDEX, "commLog");  // OBSOLETE, but still available in the API
 		lua_pushcfunction(m_LuaState, &aiLog);
 		lua_setfield(m_LuaState, LUA_GLOBALSINDEX, "aiLog");
+		lua_pushcfunction(m_LuaState, &getBotHistory);
+		lua_setfield(m_LuaState, LUA_GLOBALSINDEX, "getBotHistory");
+		lua_pushcfunction(m_LuaState, &predictBots);
+		lua_setfield(m_LuaState, LUA_GLOBALSINDEX, "predictBots");
+		lua_pushcfunction(m_LuaState, &findNearestEnemy);
+		lua_setfield(m_LuaState, LUA_GLOBALSINDEX, "findNearestEnemy");
+		lua_pushcfunction(m_LuaState, &findNearestBots);
+		lua_setfield(m_LuaState, LUA_GLOBALSINDEX, "findNearestBots");
+		lua_pushcfunction(m_LuaState, &findBotsInRadius);
+		lua_setfield(m_LuaState, LUA_GLOBALSINDEX, "findBotsInRadius");
+		lua_pushcfunction(m_LuaState, &normalizeAngle);
+		lua_setfield(m_LuaState, LUA_GLOBALSINDEX, "normalizeAngle");
+		lua_pushcfunction(m_LuaState, &angleTo);
+		lua_setfield(m_LuaState, LUA_GLOBALSINDEX, "angleTo");
+		lua_pushcfunction(m_LuaState, &steerAngle);
+		lua_setfield(m_LuaState, LUA_GLOBALSINDEX, "steerAngle");
+		lua_pushcfunction(m_LuaState, &interceptPoint);
+		lua_setfield(m_LuaState, LUA_GLOBALSINDEX, "interceptPoint");
+		lua_pushcfunction(m_LuaState, &steerBotsToPoints);
+		lua_setfield(m_LuaState, LUA_GLOBALSINDEX, "steerBotsToPoints");
+		lua_pushcfunction(m_LuaState, &interceptBots);
+		lua_setfield(m_LuaState, LUA_GLOBALSINDEX, "interceptBots");
+		lua_pushcfunction(m_LuaState, &getServerTimeEstimate);
+		lua_setfield(m_LuaState, LUA_GLOBALSINDEX, "getServerTimeEstimate");
+		lua_pushcfunction(m_LuaState, &computeApproaches);
+		lua_setfield(m_LuaState, LUA_GLOBALSINDEX, "computeApproaches");
+		lua_pushcfunction(m_LuaState, &getApproach);
+		lua_setfield(m_LuaState, LUA_GLOBALSINDEX, "getApproach");
+		lua_pushcfunction(m_LuaState, &setCommand);
+		lua_setfield(m_LuaState, LUA_GLOBALSINDEX, "setCommand");
+		lua_pushcfunction(m_LuaState, &startPlanner);
+		lua_setfield(m_LuaState, LUA_GLOBALSINDEX, "startPlanner");
+		lua_pushcfunction(m_LuaState, &stopPlanner);
+		lua_setfield(m_LuaState, LUA_GLOBALSINDEX, "stopPlanner");
+		lua_pushcfunction(m_LuaState, &getPlannerResult);
+		lua_setfield(m_LuaState, LUA_GLOBALSINDEX, "getPlannerResult");
+		lua_pushcfunction(m_LuaState, &getPlannerStatus);
+		lua_setfield(m_LuaState, LUA_GLOBALSINDEX, "getPlannerStatus");
+
+		// Push the command kinds for setCommand():
+		lua_pushnumber(m_LuaState, cmdAccelerate);
+		lua_setfield(m_LuaState, LUA_GLOBALSINDEX, "CMD_ACCELERATE");
+		lua_pushnumber(m_LuaState, cmdBrake);
+		lua_setfield(m_LuaState, LUA_GLOBALSINDEX, "CMD_BRAKE");
+		lua_pushnumber(m_LuaState, cmdSteer);
+		lua_setfield(m_LuaState, LUA_GLOBALSINDEX, "CMD_STEER");
 	}
 
 
 
 
 
-	/** Updates the local and server time stored in the GameBoard table. */
-	void updateGameBoardTime(void)
+	/** Prepares the slots for the commands set by setCommand(), one for each of my bots in the snapshot. */
+	void prepareNativeCommands(const BoardSnapshot & a_Snapshot)
 	{
 		ASSERT(m_CSLuaState.IsLockedByCurrentThread());
 
-		lua_rawgeti(m_LuaState, LUA_REGISTRYINDEX, m_GameBoardTable);
-		lua_pushnumber(m_LuaState, m_Board->getServerTime());
-		lua_setfield(m_LuaState, -2, "serverTime");
-		auto localTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - m_Board->getLocalGameStartTime()).count();
-		lua_pushnumber(m_LuaState, static_cast<lua_Number>(localTime));
-		lua_setfield(m_LuaState, -2, "localTime");
-		lua_pop(m_LuaState, 1);
+		m_NativeCommands.clear();
+		m_NativeCommandIndex.clear();
+		for (auto & bot: a_Snapshot.m_MyBots)
+		{
+			m_NativeCommandIndex[bot.m_ID] = m_NativeCommands.size();
+			m_NativeCommands.push_back({cmdNone, 0});
+		}
+		m_NumNativeCommands = 0;
+	}
+
+
+
+
+
+	/** Binding for the getBotHistory() function.
+	Returns the serverTime, x, y, speed and angle of the bot in the specified past update (0 = latest) as multiple values,
+	or nil if not available. Doesn't create any Lua tables. */
+	static int getBotHistory(lua_State * a_LuaState)
+	{
+		// Check the params:
+		LuaState L(a_LuaState);
+		if (
+			!L.checkParamNumber(1, 2) ||
+			!L.checkParamEnd(3)
+		)
+		{
+			return 0;
+		}
+
+		// Get the luaController instance from the state:
+		auto luaController = getInstance(a_LuaState);
+		if (luaController == nullptr)
+		{
+			return 0;
+		}
+
+		// Get the sample:
+		int botID = 0;
+		int age = 0;
+		L.getStackValues(1, botID, age);
+		int serverTime;
+		Bot bot(botID, false, 0, 0, 0, 0);
+		if ((age < 0) || !luaController->m_Board->getHistory().getSample(botID, static_cast<size_t>(age), serverTime, bot))
+		{
+			lua_pushnil(a_LuaState);
+			return 1;
+		}
+		lua_pushnumber(a_LuaState, serverTime);
+		lua_pushnumber(a_LuaState, bot.m_X);
+		lua_pushnumber(a_LuaState, bot.m_Y);
+		lua_pushnumber(a_LuaState, bot.m_Speed);
+		lua_pushnumber(a_LuaState, bot.m_Angle);
+		return 5;
+	}
+
+
+
+
+
+	/** Binding for the predictBots() function.
+	Extrapolates all the bots from the latest update to the current (estimated server) time plus the optional number of msec,
+	and stores the results as the predictedX, predictedY and predictedAngle members of the bots' tables in allBots.
+	Returns the number of msec the bots have been extrapolated by. */
+	static int predictBots(lua_State * a_LuaState)
+	{
+		// Check the params:
+		LuaState L(a_LuaState);
+		double aheadMSec = 0;
+		if (!lua_isnoneornil(a_LuaState, 1))
+		{
+			if (!L.checkParamNumber(1))
+			{
+				return 0;
+			}
+			L.getStackValue(1, aheadMSec);
+		}
+		if (!L.checkParamEnd(2))
+		{
+			return 0;
+		}
+
+		// Get the luaController instance from the state:
+		auto luaController = getInstance(a_LuaState);
+		if (luaController == nullptr)
+		{
+			return 0;
+		}
+		auto snapshot = luaController->getBoundSnapshot(a_LuaState, __FUNCTION__);
+		if (snapshot == nullptr)
+		{
+			return 0;
+		}
+
+		// Extrapolate:
+		auto & board = *(luaController->m_Board);
+		auto & predictor = luaController->m_Predictor;
+		predictor.setBots(snapshot->m_AllBots, board, board.getHistory().getUpdateInterval());
+		auto now = std::chrono::steady_clock::now();
+		auto & clockSync = luaController->m_App.getClockSync();
+		double deltaMSec = clockSync.isSynced() ?
+			clockSync.getServerTime(now) - snapshot->m_ServerTime + aheadMSec :  // On the server's timeline
+			std::chrono::duration_cast<std::chrono::microseconds>(now - snapshot->m_PublishedTime).count() / 1000.0 + aheadMSec;
+		predictor.predict(deltaMSec / 1000);
+
+		// Store the results in the bots' tables:
+		lua_rawgeti(a_LuaState, LUA_REGISTRYINDEX, luaController->m_GameBoardTable);  // Stack: [GBT]
+		lua_getfield(a_LuaState, -1, "allBots");                                      // Stack: [GBT] [allBots]
+		for (size_t i = 0, count = predictor.size(); i < count; i++)
+		{
+			lua_rawgeti(a_LuaState, -1, predictor.getID(i));  // Stack: [GBT] [allBots] [bot]
+			if (!lua_istable(a_LuaState, -1) && !lua_isuserdata(a_LuaState, -1))
+			{
+				lua_pop(a_LuaState, 1);
+				continue;
+			}
+			lua_pushnumber(a_LuaState, predictor.getPredictedX(i));      // Stack: [GBT] [allBots] [bot] [x]
+			lua_setfield(a_LuaState, -2, "predictedX");                  // Stack: [GBT] [allBots] [bot]
+			lua_pushnumber(a_LuaState, predictor.getPredictedY(i));      // Stack: [GBT] [allBots] [bot] [y]
+			lua_setfield(a_LuaState, -2, "predictedY");                  // Stack: [GBT] [allBots] [bot]
+			lua_pushnumber(a_LuaState, predictor.getPredictedAngle(i));  // Stack: [GBT] [allBots] [bot] [angle]
+			lua_setfield(a_LuaState, -2, "predictedAngle");              // Stack: [GBT] [allBots] [bot]
+			lua_pop(a_LuaState, 1);                                      // Stack: [GBT] [allBots]
+		}
+		lua_pop(a_LuaState, 2);
+
+		lua_pushnumber(a_LuaState, deltaMSec);
+		return 1;
+	}
+
+
+
+
+
+	/** Reads the optional filter parameter of the spatial queries ("mine", "enemies" or "all", the default) into a_Filter.
+	Returns false and logs a warning if the parameter is invalid. */
+	static bool getQueryFilter(LuaState & L, int a_StackPos, SpatialIndex::Filter & a_Filter)
+	{
+		a_Filter = SpatialIndex::fAll;
+		if (lua_isnoneornil(L, a_StackPos))
+		{
+			return true;
+		}
+		if (!L.checkParamString(a_StackPos))
+		{
+			return false;
+		}
+		AString filter;
+		L.getStackValue(a_StackPos, filter);
+		if (NoCaseCompare(filter, "mine") == 0)
+		{
+			a_Filter = SpatialIndex::fMine;
+		}
+		else if (NoCaseCompare(filter, "enemies") == 0)
+		{
+			a_Filter = SpatialIndex::fEnemies;
+		}
+		else if (NoCaseCompare(filter, "all") != 0)
+		{
+			LOGWARNING("Unknown bot filter \"%s\", expected \"mine\", \"enemies\" or \"all\"", filter.c_str());
+			L.logStackTrace();
+			return false;
+		}
+		return true;
+	}
+
+
+
+
+
+	/** Pushes the IDs in a_IDs onto the Lua stack, as the return values of an API function. Returns the number of values pushed. */
+	static int pushBotIDs(lua_State * a_LuaState, const std::vector<int> & a_IDs)
+	{
+		if (!lua_checkstack(a_LuaState, static_cast<int>(a_IDs.size())))
+		{
+			LOGWARNING("%s: Too many bots to return (%u)", __FUNCTION__, static_cast<unsigned>(a_IDs.size()));
+			return 0;
+		}
+		for (auto id: a_IDs)
+		{
+			lua_pushnumber(a_LuaState, id);
+		}
+		return static_cast<int>(a_IDs.size());
+	}
+
+
+
+
+
+	/** Binding for the findNearestEnemy() function.
+	Returns the ID of the nearest alive bot of the other team than the specified bot, or nil if there's none. */
+	static int findNearestEnemy(lua_State * a_LuaState)
+	{
+		// Check the params:
+		LuaState L(a_LuaState);
+		if (
+			!L.checkParamNumber(1) ||
+			!L.checkParamEnd(2)
+		)
+		{
+			return 0;
+		}
+
+		// Get the luaController instance from the state:
+		auto luaController = getInstance(a_LuaState);
+		if (luaController == nullptr)
+		{
+			return 0;
+		}
+
+		// Query:
+		int botID = 0;
+		L.getStackValue(1, botID);
+		auto & index = luaController->m_Board->getSpatialIndex();
+		double x, y;
+		bool isEnemy;
+		int nearestID = -1;
+		if (index.getBot(botID, x, y, isEnemy))
+		{
+			nearestID = index.findNearest(x, y, isEnemy ? SpatialIndex::fMine : SpatialIndex::fEnemies, botID);
+		}
+		if (nearestID < 0)
+		{
+			lua_pushnil(a_LuaState);
+		}
+		else
+		{
+			lua_pushnumber(a_LuaState, nearestID);
+		}
+		return 1;
+	}
+
+
+
+
+
+	/** Binding for the findNearestBots() function.
+	Returns the IDs of the (up to) k bots nearest to the specified point, nearest first, as multiple values. */
+	static int findNearestBots(lua_State * a_LuaState)
+	{
+		// Check the params:
+		LuaState L(a_LuaState);
+		SpatialIndex::Filter filter;
+		if (
+			!L.checkParamNumber(1, 3) ||
+			!getQueryFilter(L, 4, filter) ||
+			!L.checkParamEnd(5)
+		)
+		{
+			return 0;
+		}
+
+		// Get the luaController instance from the state:
+		auto luaController = getInstance(a_LuaState);
+		if (luaController == nullptr)
+		{
+			return 0;
+		}
+
+		// Query:
+		double x = 0, y = 0;
+		int count = 0;
+		L.getStackValues(1, x, y, count);
+		ASSERT(luaController->m_CSLuaState.IsLockedByCurrentThread());  // Called from a Lua callback
+		luaController->m_Board->getSpatialIndex().findKNearest(x, y, static_cast<size_t>(std::max(count, 0)), filter, -1, luaController->m_QueryIDs);
+		return pushBotIDs(a_LuaState, luaController->m_QueryIDs);
+	}
+
+
+
+
+
+	/** Binding for the findBotsInRadius() function.
+	Returns the IDs of all the bots within the specified distance from the specified point, nearest first, as multiple values. */
+	static int findBotsInRadius(lua_State * a_LuaState)
+	{
+		// Check the params:
+		LuaState L(a_LuaState);
+		SpatialIndex::Filter filter;
+		if (
+			!L.checkParamNumber(1, 3) ||
+			!getQueryFilter(L, 4, filter) ||
+			!L.checkParamEnd(5)
+		)
+		{
+			return 0;
+		}
+
+		// Get the luaController instance from the state:
+		auto luaController = getInstance(a_LuaState);
+		if (luaController == nullptr)
+		{
+			return 0;
+		}
+
+		// Query:
+		double x = 0, y = 0, radius = 0;
+		L.getStackValues(1, x, y, radius);
+		ASSERT(luaController->m_CSLuaState.IsLockedByCurrentThread());  // Called from a Lua callback
+		luaController->m_Board->getSpatialIndex().findWithinRadius(x, y, radius, filter, -1, luaController->m_QueryIDs);
+		return pushBotIDs(a_LuaState, luaController->m_QueryIDs);
+	}
+
+
+
+
+
+
+	/** Binding for the normalizeAngle() function.
+	Returns the angle normalized into the range (-180, 180]. */
+	static int normalizeAngle(lua_State * a_LuaState)
+	{
+		LuaState L(a_LuaState);
+		if (
+			!L.checkParamNumber(1) ||
+			!L.checkParamEnd(2)
+		)
+		{
+			return 0;
+		}
+		lua_pushnumber(a_LuaState, Steering::normalizeAngle(lua_tonumber(a_LuaState, 1)));
+		return 1;
+	}
+
+
+
+
+
+	/** Binding for the angleTo() function.
+	Returns the direction from the first point to the second one, in the range [0, 360). */
+	static int angleTo(lua_State * a_LuaState)
+	{
+		LuaState L(a_LuaState);
+		if (
+			!L.checkParamNumber(1, 4) ||
+			!L.checkParamEnd(5)
+		)
+		{
+			return 0;
+		}
+		lua_pushnumber(a_LuaState, Steering::angleTo(
+			lua_tonumber(a_LuaState, 1), lua_tonumber(a_LuaState, 2), lua_tonumber(a_LuaState, 3), lua_tonumber(a_LuaState, 4)
+		));
+		return 1;
+	}
+
+
+
+
+
+	/** Binding for the steerAngle() function.
+	Returns the relative angle to steer by from the current angle towards the target angle, limited to +/- maxSteerAngle. */
+	static int steerAngle(lua_State * a_LuaState)
+	{
+		LuaState L(a_LuaState);
+		if (
+			!L.checkParamNumber(1, 3) ||
+			!L.checkParamEnd(4)
+		)
+		{
+			return 0;
+		}
+		lua_pushnumber(a_LuaState, Steering::steerAngle(lua_tonumber(a_LuaState, 1), lua_tonumber(a_LuaState, 2), lua_tonumber(a_LuaState, 3)));
+		return 1;
+	}
+
+
+
+
+
+	/** Binding for the interceptPoint() function.
+	Params: x, y, speed of the pursuer, x, y, speed, angle of the target.
+	Returns the x, y and time of the earliest meeting as multiple values, or nil if the pursuer cannot reach the target. */
+	static int interceptPoint(lua_State * a_LuaState)
+	{
+		LuaState L(a_LuaState);
+		if (
+			!L.checkParamNumber(1, 7) ||
+			!L.checkParamEnd(8)
+		)
+		{
+			return 0;
+		}
+		double x, y, time;
+		if (!Steering::interceptPoint(
+			lua_tonumber(a_LuaState, 1), lua_tonumber(a_LuaState, 2), lua_tonumber(a_LuaState, 3),
+			lua_tonumber(a_LuaState, 4), lua_tonumber(a_LuaState, 5), lua_tonumber(a_LuaState, 6), lua_tonumber(a_LuaState, 7),
+			x, y, time
+		))
+		{
+			lua_pushnil(a_LuaState);
+			return 1;
+		}
+		lua_pushnumber(a_LuaState, x);
+		lua_pushnumber(a_LuaState, y);
+		lua_pushnumber(a_LuaState, time);
+		return 3;
+	}
+
+
+
+
+
+	/** Checks the params of the batch steering functions: the input array and the optional result array.
+	Pushes the result array (the given one, or a new one) onto the stack and returns true; logs and returns false on error. */
+	static bool checkBatchParams(LuaState & L)
+	{
+		bool hasResult = !lua_isnoneornil(L, 2);
+		if (
+			!L.checkParamTable(1) ||
+			(hasResult && !L.checkParamTable(2)) ||
+			!L.checkParamEnd(3)
+		)
+		{
+			return false;
+		}
+		if (hasResult)
+		{
+			lua_pushvalue(L, 2);
+		}
+		else
+		{
+			lua_newtable(L);
+		}
+		return true;
+	}
+
+
+
+
+
+	/** Removes the values after the first a_Count items of the array at the top of the stack, left over from a reused result array. */
+	static void trimBatchResult(lua_State * a_LuaState, int a_Count)
+	{
+		for (int i = static_cast<int>(lua_objlen(a_LuaState, -1)); i > a_Count; i--)
+		{
+			lua_pushnil(a_LuaState);
+			lua_rawseti(a_LuaState, -2, i);
+		}
+	}
+
+
+
+
+
+	/** Indexes the bots of the snapshot in m_BotsByID, for the batch steering functions. */
+	void indexBots(const BoardSnapshot & a_Snapshot)
+	{
+		m_BotsByID.clear();
+		for (auto & bot: a_Snapshot.m_AllBots)
+		{
+			m_BotsByID.emplace_back(bot.m_ID, &bot);
+		}
+		std::sort(m_BotsByID.begin(), m_BotsByID.end(),
+			[](const std::pair<int, const Bot *> & a_Item1, const std::pair<int, const Bot *> & a_Item2)
+			{
+				return (a_Item1.first < a_Item2.first);
+			}
+		);
+	}
+
+
+
+
+
+	/** Returns the bot with the specified ID from the bots indexed by indexBots(), or nullptr if not alive. */
+	const Bot * findIndexedBot(int a_BotID) const
+	{
+		auto itr = std::lower_bound(m_BotsByID.begin(), m_BotsByID.end(), a_BotID,
+			[](const std::pair<int, const Bot *> & a_Item, int a_ID)
+			{
+				return (a_Item.first < a_ID);
+			}
+		);
+		if ((itr == m_BotsByID.end()) || (itr->first != a_BotID))
+		{
+			return nullptr;
+		}
+		return itr->second;
+	}
+
+
+
+
+
+	/** Binding for the steerBotsToPoints() function.
+	The input is a flat array of botID, targetX, targetY triplets. Returns a flat array with the relative steer angle for each bot,
+	towards its target and limited by the bot's speed level; 0 for the bots not alive.
+	The optional second param is a table to reuse for the result, so that no garbage is created on each call. */
+	static int steerBotsToPoints(lua_State * a_LuaState)
+	{
+		// Check the params:
+		LuaState L(a_LuaState);
+		if (!checkBatchParams(L))
+		{
+			return 0;
+		}
+
+		// Get the luaController instance from the state:
+		auto luaController = getInstance(a_LuaState);
+		if (luaController == nullptr)
+		{
+			return 0;
+		}
+		auto snapshot = luaController->getBoundSnapshot(a_LuaState, __FUNCTION__);
+		if (snapshot == nullptr)
+		{
+			return 0;
+		}
+
+		// Steer each bot:
+		luaController->indexBots(*snapshot);
+		auto & speedLevels = luaController->m_Board->getSpeedLevels();
+		int count = static_cast<int>(lua_objlen(a_LuaState, 1)) / 3;
+		for (int i = 0; i < count; i++)
+		{
+			lua_rawgeti(a_LuaState, 1, 3 * i + 1);  // Stack: [...] [result] [botID]
+			lua_rawgeti(a_LuaState, 1, 3 * i + 2);  // Stack: [...] [result] [botID] [targetX]
+			lua_rawgeti(a_LuaState, 1, 3 * i + 3);  // Stack: [...] [result] [botID] [targetX] [targetY]
+			auto bot = luaController->findIndexedBot(static_cast<int>(lua_tonumber(a_LuaState, -3)));
+			double steer = 0;
+			if (bot != nullptr)
+			{
+				double targetAngle = Steering::angleTo(bot->m_X, bot->m_Y, lua_tonumber(a_LuaState, -2), lua_tonumber(a_LuaState, -1));
+				steer = Steering::steerAngle(bot->m_Angle, targetAngle, Steering::getMaxSteerAngle(speedLevels, bot->m_Speed));
+			}
+			lua_pop(a_LuaState, 3);                 // Stack: [...] [result]
+			lua_pushnumber(a_LuaState, steer);      // Stack: [...] [result] [steer]
+			lua_rawseti(a_LuaState, -2, i + 1);     // Stack: [...] [result]
+		}
+		trimBatchResult(a_LuaState, count);
+		return 1;
+	}
+
+
+
+
+
+	/** Binding for the interceptBots() function.
+	The input is a flat array of botID, targetBotID pairs. Returns a flat array of x, y, time triplets, the earliest point
+	where each bot, keeping its speed, can meet its target, which keeps its speed and heading. If the target cannot be
+	reached, or either bot is not alive, the time is -1 and the point is the target's current position (0, 0 if not alive).
+	The optional second param is a table to reuse for the result, so that no garbage is created on each call. */
+	static int interceptBots(lua_State * a_LuaState)
+	{
+		// Check the params:
+		LuaState L(a_LuaState);
+		if (!checkBatchParams(L))
+		{
+			return 0;
+		}
+
+		// Get the luaController instance from the state:
+		auto luaController = getInstance(a_LuaState);
+		if (luaController == nullptr)
+		{
+			return 0;
+		}
+		auto snapshot = luaController->getBoundSnapshot(a_LuaState, __FUNCTION__);
+		if (snapshot == nullptr)
+		{
+			return 0;
+		}
+
+		// Intercept each target:
+		luaController->indexBots(*snapshot);
+		int count = static_cast<int>(lua_objlen(a_LuaState, 1)) / 2;
+		for (int i = 0; i < count; i++)
+		{
+			lua_rawgeti(a_LuaState, 1, 2 * i + 1);  // Stack: [...] [result] [botID]
+			lua_rawgeti(a_LuaState, 1, 2 * i + 2);  // Stack: [...] [result] [botID] [targetBotID]
+			auto bot = luaController->findIndexedBot(static_cast<int>(lua_tonumber(a_LuaState, -2)));
+			auto target = luaController->findIndexedBot(static_cast<int>(lua_tonumber(a_LuaState, -1)));
+			lua_pop(a_LuaState, 2);                 // Stack: [...] [result]
+			double x = 0, y = 0, time = -1;
+			if (target != nullptr)
+			{
+				x = target->m_X;
+				y = target->m_Y;
+				if (
+					(bot != nullptr) &&
+					!Steering::interceptPoint(
+						bot->m_X, bot->m_Y, bot->m_Speed, target->m_X, target->m_Y, target->m_Speed, target->m_Angle, x, y, time
+					)
+				)
+				{
+					time = -1;
+				}
+			}
+			lua_pushnumber(a_LuaState, x);
+			lua_rawseti(a_LuaState, -2, 3 * i + 1);
+			lua_pushnumber(a_LuaState, y);
+			lua_rawseti(a_LuaState, -2, 3 * i + 2);
+			lua_pushnumber(a_LuaState, time);
+			lua_rawseti(a_LuaState, -2, 3 * i + 3);
+		}
+		trimBatchResult(a_LuaState, 3 * count);
+		return 1;
+	}
+
+
+
+
+
+	/** Binding for the getServerTimeEstimate() function.
+	Returns the estimated current server time and its uncertainty, both in msec, as two values,
+	or nil if there haven't been enough game updates yet for the estimate. */
+	static int getServerTimeEstimate(lua_State * a_LuaState)
+	{
+		// Check the params:
+		LuaState L(a_LuaState);
+		if (!L.checkParamEnd(1))
+		{
+			return 0;
+		}
+
+		// Get the luaController instance from the state:
+		auto luaController = getInstance(a_LuaState);
+		if (luaController == nullptr)
+		{
+			return 0;
+		}
+
+		// Estimate:
+		auto & clockSync = luaController->m_App.getClockSync();
+		if (!clockSync.isSynced())
+		{
+			lua_pushnil(a_LuaState);
+			return 1;
+		}
+		lua_pushnumber(a_LuaState, clockSync.getServerTime(std::chrono::steady_clock::now()));
+		lua_pushnumber(a_LuaState, clockSync.getUncertainty());
+		return 2;
+	}
+
+
+
+
+
+	/** Binding for the computeApproaches() function.
+	Computes the time to the closest approach and the minimum distance for all pairs of the bots in the latest update,
+	to be queried by getApproach(). Returns the number of bots included. */
+	static int computeApproaches(lua_State * a_LuaState)
+	{
+		// Check the params:
+		LuaState L(a_LuaState);
+		if (!L.checkParamEnd(1))
+		{
+			return 0;
+		}
+
+		// Get the luaController instance from the state:
+		auto luaController = getInstance(a_LuaState);
+		if (luaController == nullptr)
+		{
+			return 0;
+		}
+		auto snapshot = luaController->getBoundSnapshot(a_LuaState, __FUNCTION__);
+		if (snapshot == nullptr)
+		{
+			return 0;
+		}
+
+		// Compute:
+		auto & approaches = luaController->m_Approaches;
+		approaches.setBots(snapshot->m_AllBots);
+		approaches.compute();
+		lua_pushnumber(a_LuaState, static_cast<lua_Number>(approaches.size()));
+		return 1;
+	}
+
+
+
+
+
+	/** Binding for the getApproach() function.
+	Returns the time (in seconds) until the two bots are closest to each other and their distance at that time, as two values,
+	as computed by the last computeApproaches() call. Returns nil if either bot wasn't included. */
+	static int getApproach(lua_State * a_LuaState)
+	{
+		// Check the params:
+		LuaState L(a_LuaState);
+		if (
+			!L.checkParamNumber(1, 2) ||
+			!L.checkParamEnd(3)
+		)
+		{
+			return 0;
+		}
+
+		// Get the luaController instance from the state:
+		auto luaController = getInstance(a_LuaState);
+		if (luaController == nullptr)
+		{
+			return 0;
+		}
+
+		// Look up the pair:
+		int botID1 = 0, botID2 = 0;
+		L.getStackValues(1, botID1, botID2);
+		ASSERT(luaController->m_CSLuaState.IsLockedByCurrentThread());  // Called from a Lua callback
+		auto & approaches = luaController->m_Approaches;
+		int idx1 = approaches.findIndex(botID1);
+		int idx2 = approaches.findIndex(botID2);
+		if ((idx1 < 0) || (idx2 < 0))
+		{
+			lua_pushnil(a_LuaState);
+			return 1;
+		}
+		lua_pushnumber(a_LuaState, approaches.getTimeToClosest(static_cast<size_t>(idx1), static_cast<size_t>(idx2)));
+		lua_pushnumber(a_LuaState, approaches.getMinDistance(static_cast<size_t>(idx1), static_cast<size_t>(idx2)));
+		return 2;
+	}
+
+
+
+
+
+	/** Binding for the setCommand() function.
+	Sets the command for one of my bots, to be sent with the next batch of commands; an alternative to storing a table
+	in botCommands, which doesn't create any garbage. The params are the bot ID, the command kind (CMD_ACCELERATE, CMD_BRAKE
+	or CMD_STEER) and, for CMD_STEER, the angle. Replaces any command set earlier for the bot.
+	Returns true if the command was set, false if the bot is not one of mine. */
+	static int setCommand(lua_State * a_LuaState)
+	{
+		// Check the params:
+		LuaState L(a_LuaState);
+		if (
+			!L.checkParamNumber(1, 2) ||
+			!L.checkParamEnd(4)
+		)
+		{
+			return 0;
+		}
+		int botID = 0, kind = 0;
+		L.getStackValues(1, botID, kind);
+		if ((kind <= cmdNone) || (kind >= cmdCount))
+		{
+			LOGWARNING("%s: Invalid command kind: %d", __FUNCTION__, kind);
+			L.logStackTrace();
+			return 0;
+		}
+		if ((kind == cmdSteer) && !lua_isnumber(a_LuaState, 3))
+		{
+			LOGWARNING("%s: The steer command needs a numeric angle parameter", __FUNCTION__);
+			L.logStackTrace();
+			return 0;
+		}
+
+		// Get the luaController instance from the state:
+		auto luaController = getInstance(a_LuaState);
+		if (luaController == nullptr)
+		{
+			return 0;
+		}
+		ASSERT(luaController->m_CSLuaState.IsLockedByCurrentThread());  // Called from a Lua callback
+
+		// Store the command into the bot's slot:
+		auto itr = luaController->m_NativeCommandIndex.find(botID);
+		if (itr == luaController->m_NativeCommandIndex.end())
+		{
+			lua_pushboolean(a_LuaState, 0);
+			return 1;
+		}
+		auto & cmd = luaController->m_NativeCommands[itr->second];
+		if (cmd.m_Kind == cmdNone)
+		{
+			luaController->m_NumNativeCommands += 1;
+		}
+		cmd.m_Kind = kind;
+		cmd.m_Angle = (kind == cmdSteer) ? lua_tonumber(a_LuaState, 3) : 0;
+		lua_pushboolean(a_LuaState, 1);
+		return 1;
+	}
+
+
+
+
+
+	/** Registers a planner, a function run as a coroutine in the slack between the game ticks. Replaces a planner of the same name.
+	Lua: startPlanner(name, fn) */
+	static int startPlanner(lua_State * a_LuaState)
+	{
+		// Check the params:
+		LuaState L(a_LuaState);
+		if (
+			!L.checkParamString(1) ||
+			!L.checkParamFunction(2) ||
+			!L.checkParamEnd(3)
+		)
+		{
+			return 0;
+		}
+		AString name;
+		L.getStackValue(1, name);
+
+		// Get the luaController instance from the state:
+		auto luaController = getInstance(a_LuaState);
+		if (luaController == nullptr)
+		{
+			return 0;
+		}
+		ASSERT(luaController->m_CSLuaState.IsLockedByCurrentThread());  // Called from a Lua callback
+
+		luaController->m_Planners.start(a_LuaState, name, 2);
+		return 0;
+	}
+
+
+
+
+
+	/** Removes the specified planner. Returns true if it existed.
+	Lua: stopPlanner(name) */
+	static int stopPlanner(lua_State * a_LuaState)
+	{
+		// Check the params:
+		LuaState L(a_LuaState);
+		if (
+			!L.checkParamString(1) ||
+			!L.checkParamEnd(2)
+		)
+		{
+			return 0;
+		}
+		AString name;
+		L.getStackValue(1, name);
+
+		// Get the luaController instance from the state:
+		auto luaController = getInstance(a_LuaState);
+		if (luaController == nullptr)
+		{
+			return 0;
+		}
+		ASSERT(luaController->m_CSLuaState.IsLockedByCurrentThread());  // Called from a Lua callback
+
+		lua_pushboolean(a_LuaState, luaController->m_Planners.stop(a_LuaState, name) ? 1 : 0);
+		return 1;
+	}
+
+
+
+
+
+	/** Returns the values last yielded (or returned) by the specified planner; nothing if it hasn't published any yet.
+	Lua: getPlannerResult(name) */
+	static int getPlannerResult(lua_State * a_LuaState)
+	{
+		// Check the params:
+		LuaState L(a_LuaState);
+		if (
+			!L.checkParamString(1) ||
+			!L.checkParamEnd(2)
+		)
+		{
+			return 0;
+		}
+		AString name;
+		L.getStackValue(1, name);
+
+		// Get the luaController instance from the state:
+		auto luaController = getInstance(a_LuaState);
+		if (luaController == nullptr)
+		{
+			return 0;
+		}
+		ASSERT(luaController->m_CSLuaState.IsLockedByCurrentThread());  // Called from a Lua callback
+
+		return luaController->m_Planners.pushResult(a_LuaState, name);
+	}
+
+
+
+
+
+	/** Returns the status of the specified planner ("running", "finished" or "failed"), or nil if there's no such planner.
+	Lua: getPlannerStatus(name) */
+	static int getPlannerStatus(lua_State * a_LuaState)
+	{
+		// Check the params:
+		LuaState L(a_LuaState);
+		if (
+			!L.checkParamString(1) ||
+			!L.checkParamEnd(2)
+		)
+		{
+			return 0;
+		}
+		AString name;
+		L.getStackValue(1, name);
+
+		// Get the luaController instance from the state:
+		auto luaController = getInstance(a_LuaState);
+		if (luaController == nullptr)
+		{
+			return 0;
+		}
+		ASSERT(luaController->m_CSLuaState.IsLockedByCurrentThread());  // Called from a Lua callback
+
+		auto status = luaController->m_Planners.getStatus(name);
+		if (status == nullptr)
+		{
+			lua_pushnil(a_LuaState);
+		}
+		else
+		{
+			lua_pushstring(a_LuaState, status);
+		}
+		return 1;
+	}
+
+
+
+
+
+	/** Updates the local and server time stored in the GameBoard table. */
+	void updateGameBoardTime(void)
+	{
+		ASSERT(m_CSLuaState.IsLockedByCurrentThread());
+
+		lua_rawgeti(m_LuaState, LUA_REGISTRYINDEX, m_GameBoardTable);
+		lua_pushnumber(m_LuaState, m_Board->getServerTime());
+		lua_setfield(m_LuaState, -2, "serverTime");
+		auto localTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_Board->getLocalGameStartTime()).count();
+		lua_pushnumber(m_LuaState, static_cast<lua_Number>(localTime));
+		lua_setfield(m_LuaState, -2, "localTime");
+		lua_pop(m_LuaState, 1);
 	}
 };
 
@@ -513,9 +1931,33 @@ protected:
 
 
 
-SharedPtr<Controller> createLuaController(BotWarzApp & a_App, const AString & a_FileName, bool a_ShouldDebugZBS)
+LuaControllerSettings::LuaControllerSettings(void):
+	m_MaxCallbackInstructions(0),
+	m_MaxCallbackMSec(50),
+	m_GCSlackMSec(2),
+	m_ShouldProfile(false),
+	m_ShouldRunAsync(true),
+	m_ChunkCacheFolder("LuaCache"),
+	m_PlannerMaxInstructions(0),
+	m_PlannerMaxMSec(20),
+	m_ReloadPollMSec(500)
+{
+}
+
+
+
+
+
+SharedPtr<Controller> createLuaController(
+	BotWarzApp & a_App, const AString & a_FileName, bool a_ShouldDebugZBS, const LuaControllerSettings & a_Settings
+)
 {
-	return std::make_shared<LuaController>(a_App, a_FileName, a_ShouldDebugZBS);
+	auto res = std::make_shared<LuaController>(a_App, a_FileName, a_ShouldDebugZBS, a_Settings);
+	if (a_Settings.m_ShouldRunAsync)
+	{
+		return std::make_shared<AsyncController>(a_App, res);
+	}
+	return res;
 }
 
 
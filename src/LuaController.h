@@ -21,7 +21,51 @@ class Controller;
 
 
 
-extern SharedPtr<Controller> createLuaController(BotWarzApp & a_App, const AString & a_FileName, bool a_ShouldDebugZBS);
+/** The settings of the Lua controller, specified on the command line. */
+struct LuaControllerSettings
+{
+	/** The max number of Lua instructions that a single tick callback may execute before it is aborted; not limited if non-positive. */
+	int m_MaxCallbackInstructions;
+
+	/** The max wall-clock time, in msec, that a single tick callback may run before it is aborted; not limited if non-positive. */
+	int m_MaxCallbackMSec;
+
+	/** The max time, in msec, spent collecting the Lua garbage after each batch of commands is sent.
+	If positive, the garbage collector is stopped during the game and runs only in this slack; if non-positive, it runs automatically. */
+	int m_GCSlackMSec;
+
+	/** If true, the tick callbacks are profiled and the collapsed stacks are written into a file at the end of each game. */
+	bool m_ShouldProfile;
+
+	/** If true, the controller runs in its own worker thread (AsyncController), otherwise it is called directly
+	in the thread processing the server messages and in the command sender thread. */
+	bool m_ShouldRunAsync;
+
+	/** The folder in which the compiled chunks of the script and its modules are cached; empty to disable the cache. */
+	AString m_ChunkCacheFolder;
+
+	/** The max number of Lua instructions that a single resume of a planner may execute before it is suspended; not limited if non-positive. */
+	int m_PlannerMaxInstructions;
+
+	/** The max wall-clock time, in msec, that a single resume of a planner may run before it is suspended; not limited if non-positive. */
+	int m_PlannerMaxMSec;
+
+	/** The interval, in msec, in which the script file is checked for changes; a changed script is reloaded during the session.
+	The file isn't watched if non-positive. */
+	int m_ReloadPollMSec;
+
+	/** Creates the default settings. */
+	LuaControllerSettings(void);
+};
+
+
+
+
+
+/** Creates a new LuaController running the specified script; wrapped in an AsyncController if the settings say so. */
+extern SharedPtr<Controller> createLuaController(
+	BotWarzApp & a_App, const AString & a_FileName, bool a_ShouldDebugZBS, const LuaControllerSettings & a_Settings
+);
 
 
 
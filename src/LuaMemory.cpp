@@ -0,0 +1,342 @@
+
+// LuaMemory.cpp
+
+// Implements the LuaMemory class that provides the pooled allocator and the garbage collection policy for a Lua state
+
+#include "Globals.h"
+#include "LuaMemory.h"
+
+
+
+
+
+LuaMemory::LuaMemory(void):
+	m_ChunkCur(nullptr),
+	m_ChunkEnd(nullptr),
+	m_BytesInUse(0),
+	m_BytesAfterCycle(0),
+	m_LiveBytes(0),
+	m_IsCollectorStopped(false),
+	m_IsInCycle(false),
+	m_GCDebt(0)
+{
+	for (auto & freeList: m_FreeLists)
+	{
+		freeList = nullptr;
+	}
+	clearStats();
+}
+
+
+
+
+
+LuaMemory::~LuaMemory()
+{
+	for (auto chunk: m_Chunks)
+	{
+		free(chunk);
+	}
+}
+
+
+
+
+
+void * LuaMemory::alloc(void * a_UserData, void * a_Ptr, size_t a_OldSize, size_t a_NewSize)
+{
+	return reinterpret_cast<LuaMemory *>(a_UserData)->realloc(a_Ptr, a_OldSize, a_NewSize);
+}
+
+
+
+
+
+void LuaMemory::stopCollector(lua_State * a_LuaState)
+{
+	lua_gc(a_LuaState, LUA_GCSTOP, 0);
+	m_IsCollectorStopped = true;
+	m_IsInCycle = false;
+	m_GCDebt = 0;
+	m_BytesAfterCycle = m_BytesInUse;
+	m_LiveBytes = m_BytesInUse;
+}
+
+
+
+
+
+void LuaMemory::restartCollector(lua_State * a_LuaState)
+{
+	lua_gc(a_LuaState, LUA_GCRESTART, 0);
+	m_IsCollectorStopped = false;
+}
+
+
+
+
+
+void LuaMemory::collectInSlack(lua_State * a_LuaState, std::chrono::steady_clock::duration a_MaxDuration)
+{
+	ASSERT(m_IsCollectorStopped);
+
+	auto start = std::chrono::steady_clock::now();
+	auto deadline = start + a_MaxDuration;
+
+	if (m_BytesInUse > MAX_GROWTH * m_LiveBytes)
+	{
+		// The incremental steps haven't kept up with the garbage, collect all of it now:
+		lua_gc(a_LuaState, LUA_GCCOLLECT, 0);
+		m_NumFullCollections += 1;
+		m_IsInCycle = false;
+		m_GCDebt = 0;
+		m_BytesAfterCycle = m_BytesInUse;
+		m_LiveBytes = m_BytesInUse;
+	}
+	else if (!m_IsInCycle && (m_BytesInUse < 2 * m_BytesAfterCycle))
+	{
+		// Same as Lua's default pause, don't start a new cycle until the memory in use doubles:
+		m_GCDebt = 0;
+	}
+	else
+	{
+		m_IsInCycle = true;
+	}
+
+	while (m_IsInCycle && (m_GCDebt > 0))
+	{
+		// Each step does the amount of work that Lua's automatic collector does for each GC_STEP_BYTES allocated:
+		if (lua_gc(a_LuaState, LUA_GCSTEP, 0) != 0)
+		{
+			// The cycle has finished, pause until the memory grows again:
+			m_NumFinishedCycles += 1;
+			m_IsInCycle = false;
+			m_GCDebt = 0;
+			m_BytesAfterCycle = m_BytesInUse;
+			break;
+		}
+		m_GCDebt = (m_GCDebt > GC_STEP_BYTES) ? (m_GCDebt - GC_STEP_BYTES) : 0;
+		if (std::chrono::steady_clock::now() >= deadline)
+		{
+			break;
+		}
+	}
+
+	// Stepping the collector re-arms its automatic threshold, stop it again:
+	lua_gc(a_LuaState, LUA_GCSTOP, 0);
+
+	auto duration = std::chrono::steady_clock::now() - start;
+	m_NumSlackCollections += 1;
+	m_SlackDuration += duration;
+	if (duration > m_MaxSlackDuration)
+	{
+		m_MaxSlackDuration = duration;
+	}
+}
+
+
+
+
+
+void LuaMemory::clearStats(void)
+{
+	m_PeakBytesInUse = m_BytesInUse;
+	m_NumAllocs = 0;
+	m_NumPooledAllocs = 0;
+	m_NumFrees = 0;
+	m_NumReallocs = 0;
+	m_NumSlackCollections = 0;
+	m_NumFinishedCycles = 0;
+	m_NumFullCollections = 0;
+	m_SlackDuration = std::chrono::steady_clock::duration::zero();
+	m_MaxSlackDuration = std::chrono::steady_clock::duration::zero();
+}
+
+
+
+
+
+AString LuaMemory::getStatsString(void) const
+{
+	typedef std::chrono::duration<double, std::milli> MSec;
+	AString res = Printf("Lua memory: %.1f KiB in use, peak %.1f KiB, %.1f KiB in pool chunks; %lld allocs (%.1f %% pooled), %lld reallocs, %lld frees; ",
+		static_cast<double>(m_BytesInUse) / 1024, static_cast<double>(m_PeakBytesInUse) / 1024,
+		static_cast<double>(m_Chunks.size() * CHUNK_SIZE) / 1024,
+		m_NumAllocs, (m_NumAllocs > 0) ? (100.0 * static_cast<double>(m_NumPooledAllocs) / static_cast<double>(m_NumAllocs)) : 0.0,
+		m_NumReallocs, m_NumFrees
+	);
+	if (m_NumSlackCollections == 0)
+	{
+		res.append("GC automatic");
+		return res;
+	}
+	AppendPrintf(res, "GC in slack: %d collections, avg %.3f msec, max %.3f msec, %d cycles finished, %d full collections over %d x the live data",
+		m_NumSlackCollections,
+		std::chrono::duration_cast<MSec>(m_SlackDuration).count() / m_NumSlackCollections,
+		std::chrono::duration_cast<MSec>(m_MaxSlackDuration).count(),
+		m_NumFinishedCycles, m_NumFullCollections, static_cast<int>(MAX_GROWTH)
+	);
+	return res;
+}
+
+
+
+
+
+void * LuaMemory::allocPooled(size_t a_Class)
+{
+	ASSERT(a_Class < NUM_CLASSES);
+
+	// Reuse a free block, if available:
+	auto block = m_FreeLists[a_Class];
+	if (block != nullptr)
+	{
+		m_FreeLists[a_Class] = block->m_Next;
+		return block;
+	}
+
+	// Carve a new block from the current chunk, start a new chunk if there's not enough space left:
+	size_t size = (a_Class + 1) * CLASS_GRANULARITY;
+	if (static_cast<size_t>(m_ChunkEnd - m_ChunkCur) < size)
+	{
+		auto chunk = reinterpret_cast<char *>(malloc(CHUNK_SIZE));
+		if (chunk == nullptr)
+		{
+			return nullptr;
+		}
+		m_Chunks.push_back(chunk);
+
+		// Don't waste the rest of the old chunk, give it to the free list of its size (it is a multiple of the granularity):
+		auto rest = static_cast<size_t>(m_ChunkEnd - m_ChunkCur);
+		if (rest >= CLASS_GRANULARITY)
+		{
+			freePooled(m_ChunkCur, sizeClass(rest));
+		}
+		m_ChunkCur = chunk;
+		m_ChunkEnd = chunk + CHUNK_SIZE;
+	}
+	auto res = m_ChunkCur;
+	m_ChunkCur += size;
+	return res;
+}
+
+
+
+
+
+void * LuaMemory::realloc(void * a_Ptr, size_t a_OldSize, size_t a_NewSize)
+{
+	// Lua 5.1 passes a zero a_OldSize whenever a_Ptr is nullptr
+
+	// Free:
+	if (a_NewSize == 0)
+	{
+		if (a_Ptr != nullptr)
+		{
+			m_NumFrees += 1;
+			m_BytesInUse -= a_OldSize;
+			auto oldClass = sizeClass(a_OldSize);
+			if (oldClass < NUM_CLASSES)
+			{
+				freePooled(a_Ptr, oldClass);
+			}
+			else
+			{
+				free(a_Ptr);
+			}
+		}
+		return nullptr;
+	}
+
+	auto newClass = sizeClass(a_NewSize);
+	void * res;
+	if (a_Ptr == nullptr)
+	{
+		// Allocate:
+		m_NumAllocs += 1;
+		if (newClass < NUM_CLASSES)
+		{
+			m_NumPooledAllocs += 1;
+			res = allocPooled(newClass);
+		}
+		else
+		{
+			res = malloc(a_NewSize);
+		}
+		if (res == nullptr)
+		{
+			return nullptr;
+		}
+	}
+	else
+	{
+		// Reallocate:
+		m_NumReallocs += 1;
+		auto oldClass = sizeClass(a_OldSize);
+		if (newClass == oldClass)
+		{
+			if (newClass < NUM_CLASSES)
+			{
+				// The block is large enough already:
+				res = a_Ptr;
+			}
+			else
+			{
+				res = ::realloc(a_Ptr, a_NewSize);
+				if (res == nullptr)
+				{
+					if (a_NewSize > a_OldSize)
+					{
+						return nullptr;
+					}
+
+					// Lua expects shrinking to never fail, keep the old block then:
+					res = a_Ptr;
+				}
+			}
+		}
+		else
+		{
+			// Move the data into a block of another size class, or between the pools and the C runtime:
+			res = (newClass < NUM_CLASSES) ? allocPooled(newClass) : malloc(a_NewSize);
+			if (res == nullptr)
+			{
+				if (a_NewSize > a_OldSize)
+				{
+					return nullptr;
+				}
+
+				// Lua expects shrinking to never fail, keep the old block then. Should this happen to a non-pooled block,
+				// it will be freed into a pool later on, which is safe, only it is never returned to the C runtime:
+				res = a_Ptr;
+			}
+			else
+			{
+				memcpy(res, a_Ptr, std::min(a_OldSize, a_NewSize));
+				if (oldClass < NUM_CLASSES)
+				{
+					freePooled(a_Ptr, oldClass);
+				}
+				else
+				{
+					free(a_Ptr);
+				}
+			}
+		}
+	}
+
+	if (a_NewSize > a_OldSize)
+	{
+		m_GCDebt += a_NewSize - a_OldSize;
+	}
+	m_BytesInUse = m_BytesInUse - a_OldSize + a_NewSize;
+	if (m_BytesInUse > m_PeakBytesInUse)
+	{
+		m_PeakBytesInUse = m_BytesInUse;
+	}
+	return res;
+}
+
+
+
+
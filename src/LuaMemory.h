@@ -0,0 +1,156 @@
+
+// LuaMemory.h
+
+// Declares the LuaMemory class that provides the pooled allocator and the garbage collection policy for a Lua state
+
+
+
+
+
+#pragma once
+
+#include "LuaState.h"
+
+
+
+
+
+/** Manages the memory of a single Lua state: provides the allocator function for lua_newstate(), and decides when the
+garbage collector runs.
+The small blocks, which make up most of Lua's allocations (tables, closures, short strings, small arrays), are served
+from per-size-class free lists carved out of large chunks, so that allocating and freeing them is a couple of pointer
+operations; the chunks are only released when the LuaMemory is destroyed. Larger blocks go to the C runtime.
+The collector can be switched into the manual mode, in which it doesn't run on its own at all (so that it doesn't interrupt
+the latency-critical callbacks), and is instead stepped incrementally by collectInSlack(), called when there's time to spare.
+The object is not thread-safe, it is expected to be used only under the same lock as the Lua state it serves.
+The LuaMemory instance must outlive the Lua state. */
+class LuaMemory
+{
+public:
+	LuaMemory(void);
+	~LuaMemory();
+
+	/** The lua_Alloc function to be passed to lua_newstate(), with the LuaMemory instance as the userdata. */
+	static void * alloc(void * a_UserData, void * a_Ptr, size_t a_OldSize, size_t a_NewSize);
+
+	/** Stops the garbage collector of the specified state, from now on it runs only within collectInSlack().
+	The caller should run a full collection first, the memory in use is then taken as the size of the live data. */
+	void stopCollector(lua_State * a_LuaState);
+
+	/** Restarts the garbage collector of the specified state in Lua's own automatic mode. */
+	void restartCollector(lua_State * a_LuaState);
+
+	/** Returns true if the collector has been stopped by stopCollector(). */
+	bool isCollectorStopped(void) const { return m_IsCollectorStopped; }
+
+	/** Runs the incremental steps of the stopped garbage collector, paced the same way as Lua's own automatic collector
+	(a new cycle starts once the memory in use doubles since the last finished cycle, then the collector does work
+	proportional to the memory allocated), except that all the work is deferred until this call.
+	Stops when the work is done, the cycle finishes, or a_MaxDuration elapses; the unfinished work carries over to the next call.
+	If the memory in use has grown to more than MAX_GROWTH times the size of the live data (as of the last full collection),
+	a full collection is run instead, regardless of the time limit, so that the memory doesn't grow without bounds
+	if the script produces garbage faster than the slack allows to collect. */
+	void collectInSlack(lua_State * a_LuaState, std::chrono::steady_clock::duration a_MaxDuration);
+
+	/** Returns the number of bytes currently allocated by the Lua state. */
+	size_t getBytesInUse(void) const { return m_BytesInUse; }
+
+	/** Returns the max number of bytes allocated by the Lua state since the last clearStats(). */
+	size_t getPeakBytesInUse(void) const { return m_PeakBytesInUse; }
+
+	/** Resets the statistics, used when a new game starts. */
+	void clearStats(void);
+
+	/** Returns a single-line human-readable description of the allocation and collection statistics. */
+	AString getStatsString(void) const;
+
+protected:
+	/** A free block in a size class's free list; the link is stored in the block itself. */
+	struct FreeBlock
+	{
+		FreeBlock * m_Next;
+	};
+
+
+	/** The granularity of the size classes; the blocks are aligned to this as well. */
+	static const size_t CLASS_GRANULARITY = 16;
+
+	/** The number of size classes; blocks larger than CLASS_GRANULARITY * NUM_CLASSES are not pooled. */
+	static const size_t NUM_CLASSES = 32;
+
+	/** The size of the chunks from which the pooled blocks are carved. */
+	static const size_t CHUNK_SIZE = 64 * 1024;
+
+	/** The number of allocated bytes that each incremental step of the collector pays for (Lua's GCSTEPSIZE). */
+	static const size_t GC_STEP_BYTES = 1024;
+
+	/** The growth of the memory in use, relative to the live data, above which a full collection is run in the slack. */
+	static const size_t MAX_GROWTH = 4;
+
+
+	/** The free lists of the individual size classes. */
+	FreeBlock * m_FreeLists[NUM_CLASSES];
+
+	/** All the chunks allocated for the pools, released in the destructor. */
+	std::vector<char *> m_Chunks;
+
+	/** The unused rest of the current chunk, from which new blocks are carved when their free list is empty. */
+	char * m_ChunkCur;
+	char * m_ChunkEnd;
+
+	/** The number of bytes currently allocated by the Lua state (as requested, not including the rounding to the size class). */
+	size_t m_BytesInUse;
+
+	/** The number of bytes in use right after the last finished collection cycle, including the garbage produced during the cycle. */
+	size_t m_BytesAfterCycle;
+
+	/** The number of bytes in use right after the last full collection, the size of the live data. */
+	size_t m_LiveBytes;
+
+	/** Set to true by stopCollector(), false by restartCollector(). */
+	bool m_IsCollectorStopped;
+
+	/** Set to true while a collection cycle is in progress in the manual mode, false when paused between the cycles. */
+	bool m_IsInCycle;
+
+	/** The number of bytes allocated by the Lua state that the manual collector hasn't paid for by its steps yet. */
+	size_t m_GCDebt;
+
+	// Statistics since the last clearStats():
+	size_t m_PeakBytesInUse;
+	Int64 m_NumAllocs;
+	Int64 m_NumPooledAllocs;
+	Int64 m_NumFrees;
+	Int64 m_NumReallocs;
+	int m_NumSlackCollections;
+	int m_NumFinishedCycles;
+	int m_NumFullCollections;
+	std::chrono::steady_clock::duration m_SlackDuration;
+	std::chrono::steady_clock::duration m_MaxSlackDuration;
+
+
+	/** Returns the index of the size class serving blocks of the specified size, or NUM_CLASSES if the size is not pooled. */
+	static size_t sizeClass(size_t a_Size)
+	{
+		return (a_Size <= CLASS_GRANULARITY * NUM_CLASSES) ? ((a_Size + CLASS_GRANULARITY - 1) / CLASS_GRANULARITY - 1) : NUM_CLASSES;
+	}
+
+	/** Allocates a block of the specified size class, from its free list or from the current chunk.
+	Returns nullptr if the memory cannot be allocated. */
+	void * allocPooled(size_t a_Class);
+
+	/** Returns a block of the specified size class to its free list. */
+	void freePooled(void * a_Ptr, size_t a_Class)
+	{
+		auto block = reinterpret_cast<FreeBlock *>(a_Ptr);
+		block->m_Next = m_FreeLists[a_Class];
+		m_FreeLists[a_Class] = block;
+	}
+
+	/** Implements alloc() for this instance. */
+	void * realloc(void * a_Ptr, size_t a_OldSize, size_t a_NewSize);
+};
+
+
+
+
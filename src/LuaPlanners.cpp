@@ -0,0 +1,470 @@
+
+// LuaPlanners.cpp
+
+// Implements the LuaPlanners class that runs the long-running Lua planners (coroutines) in the slack between the game ticks
+
+#include "Globals.h"
+#include "LuaPlanners.h"
+
+// The hook needs to check whether the coroutine can be suspended, which only the Lua state internals tell:
+extern "C"
+{
+	#include "lib/lua/src/lstate.h"
+}
+
+
+
+
+
+/** The name of the Lua registry field in which the LuaPlanners instance is stored for the hook. */
+static const char LUA_REGISTRY_PLANNERS_FIELD_NAME[] = "__EsetBotWarz_LuaPlanners";
+
+/** The max number of instructions between two checks of the budget. */
+static const int MAX_HOOK_STEP = 500;
+
+
+
+
+
+LuaPlanners::LuaPlanners(void):
+	m_MaxInstructions(0),
+	m_MaxDuration(Clock::duration::zero()),
+	m_HookStep(MAX_HOOK_STEP),
+	m_IsResuming(false),
+	m_CurrentThread(nullptr),
+	m_NumInstructions(0)
+{
+	clearStats();
+}
+
+
+
+
+
+void LuaPlanners::setLimits(int a_MaxInstructions, int a_MaxMSec)
+{
+	m_MaxInstructions = std::max(a_MaxInstructions, 0);
+	m_MaxDuration = std::chrono::milliseconds(std::max(a_MaxMSec, 0));
+
+	// Check often enough to stop exactly at a small instruction limit:
+	m_HookStep = MAX_HOOK_STEP;
+	if ((m_MaxInstructions > 0) && (m_MaxInstructions < MAX_HOOK_STEP))
+	{
+		m_HookStep = static_cast<int>(m_MaxInstructions);
+	}
+}
+
+
+
+
+
+void LuaPlanners::start(lua_State * a_LuaState, const AString & a_Name, int a_FnStackPos)
+{
+	ASSERT(lua_isfunction(a_LuaState, a_FnStackPos));
+	stop(a_LuaState, a_Name);
+
+	// Create the coroutine with the function on its stack, ready for the first resume:
+	Planner planner;
+	planner.m_Name = a_Name;
+	planner.m_Thread = lua_newthread(a_LuaState);             // Stack: [thread]
+	lua_sethook(planner.m_Thread, nullptr, 0, 0);             // Don't inherit the hook of the callback's budget
+	lua_pushvalue(a_LuaState, a_FnStackPos);                  // Stack: [thread] [fn]
+	lua_xmove(a_LuaState, planner.m_Thread, 1);               // Stack: [thread]
+	planner.m_ThreadRef = luaL_ref(a_LuaState, LUA_REGISTRYINDEX);  // Stack: -
+	planner.m_ResultRef = LUA_NOREF;
+	planner.m_NumResumes = 0;
+	planner.m_IsFinished = false;
+	planner.m_HasFailed = false;
+	planner.m_IsStopped = false;
+	m_Planners.push_back(planner);
+}
+
+
+
+
+
+bool LuaPlanners::stop(lua_State * a_LuaState, const AString & a_Name)
+{
+	auto planner = findPlanner(a_Name);
+	if (planner == nullptr)
+	{
+		return false;
+	}
+	planner->m_IsStopped = true;
+	if (!m_IsResuming)
+	{
+		removeStopped(a_LuaState);
+	}
+	return true;
+}
+
+
+
+
+
+void LuaPlanners::stopAll(lua_State * a_LuaState)
+{
+	ASSERT(!m_IsResuming);
+	for (auto & planner: m_Planners)
+	{
+		release(a_LuaState, planner);
+	}
+	m_Planners.clear();
+}
+
+
+
+
+
+void LuaPlanners::resumeAll(lua_State * a_LuaState, int a_GameBoardTableRef)
+{
+	if (m_Planners.empty())
+	{
+		return;
+	}
+
+	lua_pushlightuserdata(a_LuaState, this);
+	lua_setfield(a_LuaState, LUA_REGISTRYINDEX, LUA_REGISTRY_PLANNERS_FIELD_NAME);
+	m_IsResuming = true;
+
+	// The planners registered meanwhile by the ones being resumed wait for the next slack:
+	auto numPlanners = m_Planners.size();
+	for (size_t i = 0; i < numPlanners; i++)
+	{
+		if (!m_Planners[i].m_IsFinished && !m_Planners[i].m_IsStopped)
+		{
+			resume(a_LuaState, i, a_GameBoardTableRef);
+		}
+	}
+
+	m_IsResuming = false;
+	lua_pushnil(a_LuaState);
+	lua_setfield(a_LuaState, LUA_REGISTRYINDEX, LUA_REGISTRY_PLANNERS_FIELD_NAME);
+	removeStopped(a_LuaState);
+}
+
+
+
+
+
+int LuaPlanners::pushResult(lua_State * a_LuaState, const AString & a_Name)
+{
+	auto planner = findPlanner(a_Name);
+	if ((planner == nullptr) || (planner->m_ResultRef == LUA_NOREF))
+	{
+		return 0;
+	}
+
+	lua_rawgeti(a_LuaState, LUA_REGISTRYINDEX, planner->m_ResultRef);  // Stack: [result]
+	lua_getfield(a_LuaState, -1, "n");                                 // Stack: [result] [n]
+	int numValues = static_cast<int>(lua_tointeger(a_LuaState, -1));
+	lua_pop(a_LuaState, 1);                                            // Stack: [result]
+	luaL_checkstack(a_LuaState, numValues, "too many results from the planner");
+	for (int i = 1; i <= numValues; i++)
+	{
+		lua_rawgeti(a_LuaState, -i, i);                                  // Stack: [result] [values...]
+	}
+	lua_remove(a_LuaState, -numValues - 1);                            // Stack: [values...]
+	return numValues;
+}
+
+
+
+
+
+const char * LuaPlanners::getStatus(const AString & a_Name) const
+{
+	auto planner = findPlanner(a_Name);
+	if (planner == nullptr)
+	{
+		return nullptr;
+	}
+	if (planner->m_HasFailed)
+	{
+		return "failed";
+	}
+	return planner->m_IsFinished ? "finished" : "running";
+}
+
+
+
+
+
+void LuaPlanners::clearStats(void)
+{
+	m_NumResumes = 0;
+	m_NumSuspended = 0;
+	m_NumResults = 0;
+	m_NumFailed = 0;
+	m_TotalDuration = Clock::duration::zero();
+	m_MaxResumeDuration = Clock::duration::zero();
+}
+
+
+
+
+
+AString LuaPlanners::getStatsString(void) const
+{
+	AString limits;
+	if (m_MaxInstructions > 0)
+	{
+		AppendPrintf(limits, "%lld instructions", m_MaxInstructions);
+	}
+	if (m_MaxDuration > Clock::duration::zero())
+	{
+		AppendPrintf(limits, "%s%lld msec", limits.empty() ? "" : ", ",
+			static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(m_MaxDuration).count())
+		);
+	}
+	if (limits.empty())
+	{
+		limits = "unlimited";
+	}
+	return Printf("Lua planners (%s per resume): %d resumes, %d suspended at the budget, %d results published, %d failed; %.1f msec in total, longest resume %.1f msec",
+		limits.c_str(), m_NumResumes, m_NumSuspended, m_NumResults, m_NumFailed,
+		std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(m_TotalDuration).count(),
+		std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(m_MaxResumeDuration).count()
+	);
+}
+
+
+
+
+
+void LuaPlanners::resume(lua_State * a_LuaState, size_t a_Index, int a_GameBoardTableRef)
+{
+	// Keep the coroutine alive even if the planner is stopped while running:
+	lua_rawgeti(a_LuaState, LUA_REGISTRYINDEX, m_Planners[a_Index].m_ThreadRef);  // Stack: [thread]
+	auto thread = m_Planners[a_Index].m_Thread;
+	int numArgs = 0;
+	if (m_Planners[a_Index].m_NumResumes == 0)
+	{
+		lua_rawgeti(thread, LUA_REGISTRYINDEX, a_GameBoardTableRef);
+		numArgs = 1;
+	}
+	m_Planners[a_Index].m_NumResumes += 1;
+
+	// Resume within the budget:
+	m_CurrentThread = thread;
+	m_NumInstructions = 0;
+	m_StartTime = Clock::now();
+	if ((m_MaxInstructions > 0) || (m_MaxDuration > Clock::duration::zero()))
+	{
+		lua_sethook(thread, &LuaPlanners::hook, LUA_MASKCOUNT, m_HookStep);
+	}
+	int status = lua_resume(thread, numArgs);
+	lua_sethook(thread, nullptr, 0, 0);
+	m_CurrentThread = nullptr;
+	auto duration = Clock::now() - m_StartTime;
+	m_NumResumes += 1;
+	m_TotalDuration += duration;
+	m_MaxResumeDuration = std::max(m_MaxResumeDuration, duration);
+
+	// The script may have registered new planners meanwhile, re-get the planner:
+	auto & planner = m_Planners[a_Index];
+	switch (status)
+	{
+		case LUA_YIELD:
+		{
+			// Either yielded by the planner, possibly with a result, or suspended by the hook at the budget (with no values):
+			int numValues = lua_gettop(thread);
+			if (numValues > 0)
+			{
+				storeResult(planner, numValues);
+			}
+			else if (isOverBudget(1))
+			{
+				m_NumSuspended += 1;
+			}
+			break;
+		}
+		case 0:
+		{
+			// The planner's function has returned, its return values are the final result:
+			int numValues = lua_gettop(thread);
+			if (numValues > 0)
+			{
+				storeResult(planner, numValues);
+			}
+			planner.m_IsFinished = true;
+			break;
+		}
+		default:
+		{
+			LOGWARNING("Lua planner %s has failed: %s", planner.m_Name.c_str(), lua_tostring(thread, -1));
+			LuaState::logStackTrace(thread);
+			lua_settop(thread, 0);
+			planner.m_IsFinished = true;
+			planner.m_HasFailed = true;
+			m_NumFailed += 1;
+			break;
+		}
+	}
+	lua_pop(a_LuaState, 1);
+}
+
+
+
+
+
+void LuaPlanners::storeResult(Planner & a_Planner, int a_NumValues)
+{
+	auto thread = a_Planner.m_Thread;
+	lua_createtable(thread, a_NumValues, 1);  // Stack: [values...] [result]
+	lua_insert(thread, -a_NumValues - 1);     // Stack: [result] [values...]
+	for (int i = a_NumValues; i >= 1; i--)
+	{
+		lua_rawseti(thread, -i - 1, i);         // Stack: [result] [values...]
+	}
+	lua_pushinteger(thread, a_NumValues);     // Stack: [result] [n]
+	lua_setfield(thread, -2, "n");            // Stack: [result]
+	luaL_unref(thread, LUA_REGISTRYINDEX, a_Planner.m_ResultRef);
+	a_Planner.m_ResultRef = luaL_ref(thread, LUA_REGISTRYINDEX);  // Stack: -
+	m_NumResults += 1;
+}
+
+
+
+
+
+void LuaPlanners::release(lua_State * a_LuaState, Planner & a_Planner)
+{
+	luaL_unref(a_LuaState, LUA_REGISTRYINDEX, a_Planner.m_ResultRef);
+	luaL_unref(a_LuaState, LUA_REGISTRYINDEX, a_Planner.m_ThreadRef);
+	a_Planner.m_ResultRef = LUA_NOREF;
+	a_Planner.m_ThreadRef = LUA_NOREF;
+	a_Planner.m_Thread = nullptr;
+}
+
+
+
+
+
+void LuaPlanners::removeStopped(lua_State * a_LuaState)
+{
+	for (auto itr = m_Planners.begin(); itr != m_Planners.end();)
+	{
+		if (itr->m_IsStopped)
+		{
+			release(a_LuaState, *itr);
+			itr = m_Planners.erase(itr);
+		}
+		else
+		{
+			++itr;
+		}
+	}
+}
+
+
+
+
+
+LuaPlanners::Planner * LuaPlanners::findPlanner(const AString & a_Name)
+{
+	for (auto & planner: m_Planners)
+	{
+		if (!planner.m_IsStopped && (planner.m_Name == a_Name))
+		{
+			return &planner;
+		}
+	}
+	return nullptr;
+}
+
+
+
+
+
+const LuaPlanners::Planner * LuaPlanners::findPlanner(const AString & a_Name) const
+{
+	for (const auto & planner: m_Planners)
+	{
+		if (!planner.m_IsStopped && (planner.m_Name == a_Name))
+		{
+			return &planner;
+		}
+	}
+	return nullptr;
+}
+
+
+
+
+
+bool LuaPlanners::isOverBudget(Int64 a_Multiplier) const
+{
+	if ((m_MaxInstructions > 0) && (m_NumInstructions >= m_MaxInstructions * a_Multiplier))
+	{
+		return true;
+	}
+	return (
+		(m_MaxDuration > Clock::duration::zero()) &&
+		(Clock::now() - m_StartTime >= m_MaxDuration * a_Multiplier)
+	);
+}
+
+
+
+
+
+void LuaPlanners::hook(lua_State * a_LuaState, lua_Debug * a_Debug)
+{
+	UNUSED(a_Debug);
+
+	// Get the planners whose resume is in progress:
+	lua_getfield(a_LuaState, LUA_REGISTRYINDEX, LUA_REGISTRY_PLANNERS_FIELD_NAME);
+	auto planners = reinterpret_cast<LuaPlanners *>(lua_touserdata(a_LuaState, -1));
+	lua_pop(a_LuaState, 1);
+	if (planners == nullptr)
+	{
+		return;
+	}
+
+	planners->m_NumInstructions += planners->m_HookStep;
+	if (!planners->isOverBudget(1))
+	{
+		return;
+	}
+
+	// Suspend the planner, if Lua can do that here; the VM returns from lua_resume() right after the hook.
+	// The coroutines resumed by the planner itself inherit the hook, but suspending them would look like their own yield to the planner:
+	if ((a_LuaState == planners->m_CurrentThread) && canSuspend(a_LuaState))
+	{
+		lua_yield(a_LuaState, 0);
+		return;
+	}
+
+	// Cannot suspend inside a native call or a metamethod, let the planner get out of it, up to twice its budget.
+	// lua_error() longjmps out of this function, so the message must not be in an object with a destructor:
+	if (planners->isOverBudget(2))
+	{
+		char msg[200];
+		snprintf(msg, sizeof(msg), "The planner cannot be suspended and has exceeded twice its budget (%lld instructions, %.1f msec), aborting",
+			planners->m_NumInstructions,
+			std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(Clock::now() - planners->m_StartTime).count()
+		);
+		luaL_where(a_LuaState, 1);
+		lua_pushstring(a_LuaState, msg);
+		lua_concat(a_LuaState, 2);
+		lua_error(a_LuaState);
+	}
+}
+
+
+
+
+
+bool LuaPlanners::canSuspend(lua_State * a_LuaState)
+{
+	// Lua can only yield from a hook if no function on the coroutine's stack has been called through luaD_call(),
+	// that is, from the native code (a pcall(), a library function calling back, a metamethod or a generic-for iterator).
+	// Each such call is counted in nCcalls, lua_resume() sets baseCcalls; this is the check done by lua_yield() itself.
+	// Walking the call stack via lua_getstack() instead would be inexact, and slow for the long chains of tail calls:
+	return (a_LuaState->nCcalls == a_LuaState->baseCcalls);
+}
+
+
+
+
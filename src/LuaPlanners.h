@@ -0,0 +1,162 @@
+
+// LuaPlanners.h
+
+// Declares the LuaPlanners class that runs the long-running Lua planners (coroutines) in the slack between the game ticks
+
+
+
+
+
+#pragma once
+
+#include "LuaState.h"
+
+
+
+
+
+/** Keeps the planners registered by the script - Lua coroutines doing work that doesn't fit into a single tick callback -
+and resumes each of them once in each slack between the game ticks. Each resume is limited by an instruction and a time
+budget, enforced by a Lua count hook on the coroutine: once the budget is used up, the hook suspends the coroutine
+(lua_yield() from the hook), and the planner continues where it left off in the next slack.
+A planner publishes its result by yielding (or returning) values; the latest values are kept and returned to the script
+by pushResult(), such as in onSendingCommands(). A planner that yields no values (a voluntary pause) keeps its previous result.
+Lua cannot suspend a coroutine inside a metamethod, a pcall() or any other function called from the native code; there,
+the planner runs over its budget until it returns into its own Lua code. If it doesn't do so before it has used up twice
+its budget, it is aborted with a Lua error, so that a planner cannot hold up the controller.
+The coroutines and their results are kept in the Lua registry; the object needs to be used under the same lock as the Lua state. */
+class LuaPlanners
+{
+public:
+	LuaPlanners(void);
+
+	/** Sets the budget of a single resume. A non-positive value means that the limit is not used;
+	with neither limit set, each planner runs until it yields on its own. */
+	void setLimits(int a_MaxInstructions, int a_MaxMSec);
+
+	/** Registers a new planner named a_Name, running the function at a_FnStackPos in a_LuaState as a new coroutine.
+	A planner of the same name is replaced. The function is first resumed in the next slack, with the gameboard table as its parameter. */
+	void start(lua_State * a_LuaState, const AString & a_Name, int a_FnStackPos);
+
+	/** Removes the planner of the specified name. Returns false if there's no such planner. */
+	bool stop(lua_State * a_LuaState, const AString & a_Name);
+
+	/** Removes all the planners, used when the game finishes. */
+	void stopAll(lua_State * a_LuaState);
+
+	/** Resumes each of the planners once, within its budget.
+	a_GameBoardTableRef is the registry reference of the gameboard table, passed to each planner's first resume. */
+	void resumeAll(lua_State * a_LuaState, int a_GameBoardTableRef);
+
+	/** Pushes the latest values published by the specified planner onto the stack of a_LuaState.
+	Returns the number of values pushed; zero if the planner doesn't exist or hasn't published anything yet. */
+	int pushResult(lua_State * a_LuaState, const AString & a_Name);
+
+	/** Returns the status of the specified planner: "running", "finished" or "failed"; nullptr if there's no such planner. */
+	const char * getStatus(const AString & a_Name) const;
+
+	/** Returns the number of the planners currently registered. */
+	size_t getNumPlanners(void) const { return m_Planners.size(); }
+
+	/** Returns the number of resumes since the last clearStats(). */
+	int getNumResumes(void) const { return m_NumResumes; }
+
+	/** Resets the statistics, used when a new game starts. */
+	void clearStats(void);
+
+	/** Returns a single-line human-readable description of the budget and the statistics. */
+	AString getStatsString(void) const;
+
+protected:
+	typedef std::chrono::steady_clock Clock;
+
+	/** A single planner registered by the script. */
+	struct Planner
+	{
+		/** The name under which the script has registered the planner. */
+		AString m_Name;
+
+		/** The coroutine running the planner. Owned by the Lua state, kept alive by m_ThreadRef. */
+		lua_State * m_Thread;
+
+		/** The registry reference to the coroutine. */
+		int m_ThreadRef;
+
+		/** The registry reference to the table holding the latest published values (and their count in "n"), LUA_NOREF if none yet. */
+		int m_ResultRef;
+
+		/** The number of times the planner has been resumed. */
+		int m_NumResumes;
+
+		/** Set once the planner's function has returned (or failed); it is then no longer resumed, but its result is kept. */
+		bool m_IsFinished;
+
+		/** Set if the planner has failed with an error. */
+		bool m_HasFailed;
+
+		/** Set when the planner has been stopped (or replaced) while running; removed once its resume returns. */
+		bool m_IsStopped;
+	};
+
+
+	/** The max number of Lua instructions per resume, zero if not limited. */
+	Int64 m_MaxInstructions;
+
+	/** The max wall-clock duration of a resume, zero if not limited. */
+	Clock::duration m_MaxDuration;
+
+	/** The number of instructions between two checks of the budget. */
+	int m_HookStep;
+
+	/** The registered planners, in the order of their registration, which is the order in which they are resumed. */
+	std::vector<Planner> m_Planners;
+
+	/** Set while resumeAll() is resuming the planners, so that the planners stopped meanwhile are only marked, not removed. */
+	bool m_IsResuming;
+
+	// The state of the resume in progress, checked by the hook:
+	lua_State * m_CurrentThread;
+	Int64 m_NumInstructions;
+	Clock::time_point m_StartTime;
+
+	// Statistics since the last clearStats():
+	int m_NumResumes;
+	int m_NumSuspended;
+	int m_NumResults;
+	int m_NumFailed;
+	Clock::duration m_TotalDuration;
+	Clock::duration m_MaxResumeDuration;
+
+
+	/** Resumes the planner at the specified index within its budget and processes the outcome.
+	The planner is referred to by its index, because the script may register new planners while it is running. */
+	void resume(lua_State * a_LuaState, size_t a_Index, int a_GameBoardTableRef);
+
+	/** Stores the values at the top of the planner's stack as its latest result, and pops them. */
+	void storeResult(Planner & a_Planner, int a_NumValues);
+
+	/** Releases the planner's registry references. */
+	void release(lua_State * a_LuaState, Planner & a_Planner);
+
+	/** Removes the planners that have been stopped while running. */
+	void removeStopped(lua_State * a_LuaState);
+
+	/** Returns the planner of the specified name, nullptr if there's none. Stopped planners are skipped. */
+	Planner * findPlanner(const AString & a_Name);
+	const Planner * findPlanner(const AString & a_Name) const;
+
+	/** Returns true if the budget of the current resume has been used up. */
+	bool isOverBudget(Int64 a_Multiplier) const;
+
+	/** The Lua count hook that suspends the planner once its budget has been used up. */
+	static void hook(lua_State * a_LuaState, lua_Debug * a_Debug);
+
+	/** Returns true if the coroutine can be suspended from a hook at its current instruction, that is, all of its call stack
+	consists of Lua functions called from Lua code, with no native function, metamethod or generic-for iterator call in between.
+	Uses the Lua state internals, the same check as lua_yield() does. */
+	static bool canSuspend(lua_State * a_LuaState);
+};
+
+
+
+
@@ -0,0 +1,129 @@
+
+// LuaProfiler.cpp
+
+// Implements the LuaProfiler class that samples the Lua call stacks of the controller and outputs them as collapsed stacks
+
+#include "Globals.h"
+#include "LuaProfiler.h"
+#include <algorithm>
+
+
+
+
+
+/** The max number of frames recorded for a single sample; the outermost frames of deeper stacks are left out. */
+static const int MAX_STACK_DEPTH = 64;
+
+
+
+
+
+LuaProfiler::LuaProfiler(void):
+	m_NumSamples(0)
+{
+}
+
+
+
+
+
+void LuaProfiler::sample(lua_State * a_LuaState, const char * a_RootName, int a_NumInstructions)
+{
+	// Collect the frames, from the innermost one (the function being run when the hook fired):
+	m_Frames.clear();
+	lua_Debug entry;
+	for (int depth = 0; (depth < MAX_STACK_DEPTH) && lua_getstack(a_LuaState, depth, &entry); depth++)
+	{
+		lua_getinfo(a_LuaState, "Sn", &entry);
+		m_Frames.push_back(entry);
+	}
+
+	// Compose the collapsed stack, from the outermost frame:
+	m_StackText.assign(a_RootName);
+	for (auto itr = m_Frames.crbegin(), end = m_Frames.crend(); itr != end; ++itr)
+	{
+		m_StackText.push_back(';');
+		appendFrameName(m_StackText, *itr);
+	}
+	m_Stacks[m_StackText] += a_NumInstructions;
+	m_NumSamples += 1;
+}
+
+
+
+
+
+void LuaProfiler::clear(void)
+{
+	m_Stacks.clear();
+	m_NumSamples = 0;
+}
+
+
+
+
+
+bool LuaProfiler::writeCollapsed(const AString & a_FileName) const
+{
+	FILE * f = fopen(a_FileName.c_str(), "w");
+	if (f == nullptr)
+	{
+		LOGWARNING("Cannot open the Lua profile file %s for writing", a_FileName.c_str());
+		return false;
+	}
+
+	// Sort the stacks, so that the output is stable and the related stacks are together:
+	std::vector<const std::pair<const AString, Int64> *> stacks;
+	stacks.reserve(m_Stacks.size());
+	for (const auto & s: m_Stacks)
+	{
+		stacks.push_back(&s);
+	}
+	std::sort(stacks.begin(), stacks.end(),
+		[](const std::pair<const AString, Int64> * a_First, const std::pair<const AString, Int64> * a_Second)
+		{
+			return (a_First->first < a_Second->first);
+		}
+	);
+
+	for (const auto s: stacks)
+	{
+		fprintf(f, "%s %lld\n", s->first.c_str(), s->second);
+	}
+	fclose(f);
+	return true;
+}
+
+
+
+
+
+void LuaProfiler::appendFrameName(AString & a_Dest, const lua_Debug & a_Entry)
+{
+	auto start = a_Dest.size();
+	if (a_Entry.what[0] == 'C')
+	{
+		AppendPrintf(a_Dest, "[C] %s", (a_Entry.name != nullptr) ? a_Entry.name : "?");
+	}
+	else if (a_Entry.what[0] == 'm')
+	{
+		AppendPrintf(a_Dest, "(main chunk) %s", a_Entry.short_src);
+	}
+	else
+	{
+		AppendPrintf(a_Dest, "%s %s:%d", (a_Entry.name != nullptr) ? a_Entry.name : "?", a_Entry.short_src, a_Entry.linedefined);
+	}
+
+	// The semicolons separate the frames and the newlines the stacks, replace them within the name:
+	for (auto i = start, len = a_Dest.size(); i < len; i++)
+	{
+		if ((a_Dest[i] == ';') || (a_Dest[i] == '\n'))
+		{
+			a_Dest[i] = '_';
+		}
+	}
+}
+
+
+
+
@@ -0,0 +1,65 @@
+
+// LuaProfiler.h
+
+// Declares the LuaProfiler class that samples the Lua call stacks of the controller and outputs them as collapsed stacks
+
+
+
+
+
+#pragma once
+
+#include <unordered_map>
+#include "LuaState.h"
+
+
+
+
+
+/** Collects samples of the Lua call stack, as taken by the LuaBudget count hook every few hundred instructions.
+Each sample stands for the number of Lua instructions executed since the previous one, and is attributed to the stack
+of function names rooted in the name of the callback being run (onGameUpdate, onSendingCommands etc.).
+The collected samples are output in the collapsed-stack format ("root;caller;callee count" per line)
+understood by the flamegraph tools, such as flamegraph.pl or speedscope.
+The time spent in the native API functions is not included, only the Lua instructions are counted. */
+class LuaProfiler
+{
+public:
+	LuaProfiler(void);
+
+	/** Records a sample of the current call stack in a_LuaState, standing for a_NumInstructions instructions,
+	with a_RootName as the outermost frame. Called from the Lua hook. */
+	void sample(lua_State * a_LuaState, const char * a_RootName, int a_NumInstructions);
+
+	/** Removes all the samples collected so far. */
+	void clear(void);
+
+	/** Returns the number of samples collected since the last clear(). */
+	int getNumSamples(void) const { return m_NumSamples; }
+
+	/** Writes the collected samples into the specified file, in the collapsed-stack format, sorted by the stack.
+	Returns true on success, false (and logs a warning) on failure. */
+	bool writeCollapsed(const AString & a_FileName) const;
+
+protected:
+	/** The number of instructions sampled for each distinct stack, keyed by the collapsed stack text. */
+	std::unordered_map<AString, Int64> m_Stacks;
+
+	/** The number of samples since the last clear(). */
+	int m_NumSamples;
+
+	/** The text of the stack being sampled. Kept as a member so that its memory is reused. */
+	AString m_StackText;
+
+	/** The individual frames of the stack being sampled, from the innermost. Kept as a member so that its memory is reused. */
+	std::vector<lua_Debug> m_Frames;
+
+
+	/** Appends the name of the frame described by a_Entry (as filled by lua_getinfo() with "Sn") to a_Dest.
+	The characters with a special meaning in the collapsed-stack format are replaced. */
+	static void appendFrameName(AString & a_Dest, const lua_Debug & a_Entry);
+};
+
+
+
+
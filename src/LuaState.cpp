@@ -5,6 +5,7 @@
 
 #include "Globals.h"
 #include "LuaState.h"
+#include "LuaChunkCache.h"
 
 extern "C"
 {
@@ -85,6 +86,27 @@ void LuaState::create(void)
 
 
 
+void LuaState::create(lua_Alloc a_Alloc, void * a_AllocUserData)
+{
+	if (m_LuaState != nullptr)
+	{
+		LOGWARNING("%s: Trying to create an already-existing LuaState, ignoring.", __FUNCTION__);
+		return;
+	}
+	m_LuaState = lua_newstate(a_Alloc, a_AllocUserData);
+	if (m_LuaState == nullptr)
+	{
+		LOGWARNING("%s: Cannot create the Lua state, out of memory.", __FUNCTION__);
+		return;
+	}
+	luaL_openlibs(m_LuaState);
+	m_IsOwned = true;
+}
+
+
+
+
+
 void LuaState::close(void)
 {
 	if (m_LuaState == nullptr)
@@ -190,12 +212,12 @@ void LuaState::execCode(const char * a_LuaCode)
 
 
 
-bool LuaState::loadFile(const AString & a_FileName)
+bool LuaState::loadFile(const AString & a_FileName, LuaChunkCache * a_ChunkCache)
 {
 	ASSERT(isValid());
 	
 	// Load the file:
-	int s = luaL_loadfile(m_LuaState, a_FileName.c_str());
+	int s = (a_ChunkCache != nullptr) ? a_ChunkCache->loadFile(m_LuaState, a_FileName) : luaL_loadfile(m_LuaState, a_FileName.c_str());
 	if (reportErrors(s))
 	{
 		LOGWARNING("Can't load %s because of an error in file %s", m_SubsystemName.c_str(), a_FileName.c_str());
@@ -724,6 +746,18 @@ void LuaState::logStackTrace(lua_State * a_LuaState, int a_StartingDepth)
 	while (lua_getstack(a_LuaState, depth, &entry))
 	{
 		lua_getinfo(a_LuaState, "Sln", &entry);
+		if (strcmp(entry.what, "tail") == 0)
+		{
+			// Lua reports each of the calls lost by a tail call as a separate level, a tail-recursive loop has millions of them:
+			int numTailCalls = 1;
+			while (lua_getstack(a_LuaState, depth + numTailCalls, &entry) && lua_getinfo(a_LuaState, "S", &entry) && (strcmp(entry.what, "tail") == 0))
+			{
+				numTailCalls++;
+			}
+			LOGWARNING("  (%d tail calls)", numTailCalls);
+			depth += numTailCalls;
+			continue;
+		}
 		LOGWARNING("  %s(%d): %s", entry.short_src, entry.currentline, entry.name ? entry.name : "(no name)");
 		depth++;
 	}
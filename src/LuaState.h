@@ -33,6 +33,13 @@ extern "C"
 
 
 
+// fwd:
+class LuaChunkCache;
+
+
+
+
+
 /** Encapsulates a Lua state and provides some syntactic sugar for common operations */
 class LuaState
 {
@@ -117,6 +124,11 @@ public:
 	/** Creates the m_LuaState, if not created / attached already. This state will be automatically closed in the destructor.
 	The regular Lua libs are registered. */
 	void create(void);
+
+	/** Creates the m_LuaState using the specified allocator function, if not created / attached already.
+	This state will be automatically closed in the destructor. The regular Lua libs are registered.
+	The allocator (and its a_AllocUserData) needs to stay valid until the state is closed. */
+	void create(lua_Alloc a_Alloc, void * a_AllocUserData);
 	
 	/** Closes the m_LuaState, if not closed already.
 	Doesn't close a state that has been attached. */
@@ -138,10 +150,11 @@ public:
 	void execCode(const char * a_LuaCode);
 
 	/** Loads the specified file
+	If a_ChunkCache is given, the file's compiled chunk is loaded from it (or compiled and stored into it).
 	Returns false and logs a warning to the console if not successful (but the LuaState is kept open).
 	m_SubsystemName is displayed in the warning log message.
 	*/
-	bool loadFile(const AString & a_FileName);
+	bool loadFile(const AString & a_FileName, LuaChunkCache * a_ChunkCache = nullptr);
 	
 	/** Returns true if a_FunctionName is a valid Lua function that can be called */
 	bool hasFunction(const char * a_FunctionName);
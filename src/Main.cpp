@@ -5,6 +5,67 @@
 #include <iostream>
 #include "lib/Network/NetworkSingleton.h"
 #include "BotWarzApp.h"
+#include "WorkerPool.h"
+
+
+
+
+
+/** Runs a separate app instance (session) for each of the logins, all in parallel, sharing the network event loop
+and a pool of a_NumWorkers threads (default if not positive) for processing the server messages and running the controllers.
+Returns the value that the process should return upon exit: zero if all the sessions ran successfully,
+otherwise the value of the first failed session. */
+static int runSessions(
+	const std::vector<std::pair<AString, AString>> & a_Logins, int a_NumWorkers,
+	bool a_ShouldLogComm, bool a_ShouldShowComm, const AString & a_ControllerFileName, bool a_ShouldDebugZBS, int a_NumGamesToPlay,
+	const AString & a_ServerHost, UInt16 a_ServerPort, const CommandScheduler::Settings & a_SchedulerSettings,
+	const LuaControllerSettings & a_LuaSettings
+)
+{
+	// By default, use a worker for each session, up to the number of CPU cores:
+	if (a_NumWorkers <= 0)
+	{
+		int numCores = static_cast<int>(std::thread::hardware_concurrency());
+		a_NumWorkers = std::min(static_cast<int>(a_Logins.size()), std::max(numCores, 1));
+	}
+	LOG("Running %d sessions using %d worker threads", static_cast<int>(a_Logins.size()), a_NumWorkers);
+	WorkerPool workerPool(a_NumWorkers);
+
+	// Start all the sessions:
+	std::vector<UniquePtr<BotWarzApp>> apps;
+	std::vector<int> results;
+	for (const auto & login: a_Logins)
+	{
+		apps.emplace_back(new BotWarzApp(login.first, login.second, &workerPool));
+		results.push_back(apps.back()->start(
+			a_ShouldLogComm, a_ShouldShowComm, a_ControllerFileName, a_ShouldDebugZBS, a_NumGamesToPlay,
+			a_ServerHost, a_ServerPort, a_SchedulerSettings, a_LuaSettings
+		));
+		if (results.back() != 0)
+		{
+			LOGERROR("Session %s failed to start, continuing with the rest.", login.second.c_str());
+		}
+	}
+
+	// Wait for all the started sessions to terminate, then stop all of them:
+	for (size_t i = 0; i < apps.size(); i++)
+	{
+		if (results[i] == 0)
+		{
+			apps[i]->waitForTermination();
+		}
+	}
+	int res = 0;
+	for (size_t i = 0; i < apps.size(); i++)
+	{
+		apps[i]->stop();
+		if ((res == 0) && (results[i] != 0))
+		{
+			res = results[i];
+		}
+	}
+	return res;
+}
 
 
 
@@ -20,7 +81,12 @@ int run(int argc, char ** argv)
 	bool shouldDebugZBS = false;
 	bool shouldPauseOnExit = false;
 	int numGamesToPlay = -1;  // no limit
+	int numWorkers = 0;  // default
+	AString serverHost = "botwarz.eset.com";
+	UInt16 serverPort = 8080;
 	AString controllerFileName;
+	CommandScheduler::Settings schedulerSettings;
+	LuaControllerSettings luaSettings;
 	for (int i = 1; i < argc; i++)
 	{
 		AString Arg(argv[i]);
@@ -32,6 +98,14 @@ int run(int argc, char ** argv)
 		{
 			shouldShowComm = true;
 		}
+		else if (NoCaseCompare(Arg, "/luaprofile") == 0)
+		{
+			luaSettings.m_ShouldProfile = true;
+		}
+		else if (NoCaseCompare(Arg, "/luasync") == 0)
+		{
+			luaSettings.m_ShouldRunAsync = false;
+		}
 		else if (NoCaseCompare(Arg, "/zbsdebug") == 0)
 		{
 			shouldDebugZBS = true;
@@ -48,6 +122,113 @@ int run(int argc, char ** argv)
 		{
 			setvbuf(stdout, nullptr, _IONBF, 0);
 		}
+		else if (NoCaseCompare(Arg.substr(0, 8), "/server=") == 0)
+		{
+			// Parse the "host:port" or "host" server specification:
+			AString server = Arg.substr(8);
+			auto colonPos = server.rfind(':');
+			if (colonPos != AString::npos)
+			{
+				if (!StringToInteger(server.substr(colonPos + 1), serverPort))
+				{
+					LOGERROR("Invalid server port specification: %s", Arg.c_str());
+					return 2;
+				}
+				server.erase(colonPos);
+			}
+			if (!server.empty())
+			{
+				serverHost = server;
+			}
+		}
+		else if (NoCaseCompare(Arg.substr(0, 12), "/ratewindow=") == 0)
+		{
+			if (!StringToInteger(Arg.substr(12), schedulerSettings.m_RateWindowMSec))
+			{
+				LOGERROR("Invalid rate window specification: %s", Arg.c_str());
+				return 2;
+			}
+		}
+		else if (NoCaseCompare(Arg.substr(0, 12), "/ratemargin=") == 0)
+		{
+			if (!StringToInteger(Arg.substr(12), schedulerSettings.m_RateMarginMSec))
+			{
+				LOGERROR("Invalid rate margin specification: %s", Arg.c_str());
+				return 2;
+			}
+		}
+		else if (NoCaseCompare(Arg.substr(0, 12), "/tickmargin=") == 0)
+		{
+			if (!StringToInteger(Arg.substr(12), schedulerSettings.m_TickMarginMSec))
+			{
+				LOGERROR("Invalid tick margin specification: %s", Arg.c_str());
+				return 2;
+			}
+		}
+		else if (NoCaseCompare(Arg, "/legacysched") == 0)
+		{
+			schedulerSettings.m_IsJustInTime = false;
+		}
+		else if (NoCaseCompare(Arg.substr(0, 13), "/luamaxinstr=") == 0)
+		{
+			if (!StringToInteger(Arg.substr(13), luaSettings.m_MaxCallbackInstructions))
+			{
+				LOGERROR("Invalid Lua instruction limit: %s", Arg.c_str());
+				return 2;
+			}
+		}
+		else if (NoCaseCompare(Arg.substr(0, 12), "/luamaxmsec=") == 0)
+		{
+			if (!StringToInteger(Arg.substr(12), luaSettings.m_MaxCallbackMSec))
+			{
+				LOGERROR("Invalid Lua time limit: %s", Arg.c_str());
+				return 2;
+			}
+		}
+		else if (NoCaseCompare(Arg.substr(0, 12), "/luagcslack=") == 0)
+		{
+			if (!StringToInteger(Arg.substr(12), luaSettings.m_GCSlackMSec))
+			{
+				LOGERROR("Invalid Lua GC slack specification: %s", Arg.c_str());
+				return 2;
+			}
+		}
+		else if (NoCaseCompare(Arg.substr(0, 10), "/luacache=") == 0)
+		{
+			luaSettings.m_ChunkCacheFolder = Arg.substr(10);
+		}
+		else if (NoCaseCompare(Arg.substr(0, 13), "/luaplanmsec=") == 0)
+		{
+			if (!StringToInteger(Arg.substr(13), luaSettings.m_PlannerMaxMSec))
+			{
+				LOGERROR("Invalid Lua planner time limit: %s", Arg.c_str());
+				return 2;
+			}
+		}
+		else if (NoCaseCompare(Arg.substr(0, 14), "/luaplaninstr=") == 0)
+		{
+			if (!StringToInteger(Arg.substr(14), luaSettings.m_PlannerMaxInstructions))
+			{
+				LOGERROR("Invalid Lua planner instruction limit: %s", Arg.c_str());
+				return 2;
+			}
+		}
+		else if (NoCaseCompare(Arg.substr(0, 11), "/luareload=") == 0)
+		{
+			if (!StringToInteger(Arg.substr(11), luaSettings.m_ReloadPollMSec))
+			{
+				LOGERROR("Invalid Lua reload poll interval: %s", Arg.c_str());
+				return 2;
+			}
+		}
+		else if (NoCaseCompare(Arg.substr(0, 9), "/workers=") == 0)
+		{
+			if (!StringToInteger(Arg.substr(9), numWorkers) || (numWorkers <= 0))
+			{
+				LOGERROR("Invalid number of workers: %s", Arg.c_str());
+				return 2;
+			}
+		}
 		else
 		{
 			controllerFileName = Arg;
@@ -55,32 +236,48 @@ int run(int argc, char ** argv)
 	}  // for i - argv[]
 	if (controllerFileName.empty())
 	{
-		LOGERROR("You have not specified the controller file name. Run this program with the lua file name parameter to execute the file as the AI controller.");
+		LOGERROR("You have not specified the controller file name. Run this program with the lua file name parameter to execute the file as the AI controller, or with the name of a native controller plugin (.so / .dll).");
 		return 2;
 	}
 
-	// Read the login information from a file:
-	AString loginToken;
-	AString loginNick;
+	// Read the login information from a file, a token and a nick for each account:
+	std::vector<std::pair<AString, AString>> logins;
 	{
 		std::ifstream loginFile("login.txt");
-		loginFile >> loginToken;
-		loginFile >> loginNick;
+		AString loginToken;
+		AString loginNick;
+		while (loginFile >> loginToken)
+		{
+			loginNick.clear();
+			loginFile >> loginNick;
+			logins.emplace_back(loginToken, loginNick);
+		}
 	}
-	if (loginToken.empty())
+	if (logins.empty())
 	{
 		LOGERROR("The login token is empty, please provide a valid token in file login.txt");
 		return 1;
 	}
-	if (loginNick.empty())
+	if (logins.back().second.empty())
 	{
 		LOGERROR("The login nick is empty, please provide a valid nick in file login.txt");
 		return 1;
 	}
 
 	// Run the app:
-	BotWarzApp app(loginToken, loginNick);
-	int res = app.run(shouldLogComm, shouldShowComm, controllerFileName, shouldDebugZBS, numGamesToPlay);
+	int res;
+	if (logins.size() == 1)
+	{
+		BotWarzApp app(logins[0].first, logins[0].second, nullptr);
+		res = app.run(shouldLogComm, shouldShowComm, controllerFileName, shouldDebugZBS, numGamesToPlay, serverHost, serverPort, schedulerSettings, luaSettings);
+	}
+	else
+	{
+		res = runSessions(
+			logins, numWorkers, shouldLogComm, shouldShowComm, controllerFileName, shouldDebugZBS, numGamesToPlay,
+			serverHost, serverPort, schedulerSettings, luaSettings
+		);
+	}
 
 	if (shouldPauseOnExit)
 	{
@@ -0,0 +1,538 @@
+
+// PlayParser.cpp
+
+// Implements the PlayParser class that parses the server's "play" message without building a Json DOM
+
+#include "Globals.h"
+#include "PlayParser.h"
+
+
+
+
+
+/** The maximum nesting level of objects and arrays in skipped values, to avoid stack exhaustion on malicious data. */
+static const int MAX_NESTING_LEVEL = 64;
+
+/** Powers of ten that are represented exactly in a double. */
+static const double g_ExactPowersOf10[] =
+{
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+
+
+
+
+PlayParser::PlayParser(const char * a_Data, size_t a_Length, Callbacks & a_Callbacks):
+	m_Pos(a_Data),
+	m_End(a_Data + a_Length),
+	m_Callbacks(a_Callbacks)
+{
+}
+
+
+
+
+
+bool PlayParser::isPlayMessage(const char * a_Data, size_t a_Length)
+{
+	// Skip the whitespace and the opening brace:
+	const char * end = a_Data + a_Length;
+	const char * pos = a_Data;
+	while ((pos < end) && ((*pos == ' ') || (*pos == '\t') || (*pos == '\r') || (*pos == '\n')))
+	{
+		++pos;
+	}
+	if ((pos >= end) || (*pos != '{'))
+	{
+		return false;
+	}
+	++pos;
+	while ((pos < end) && ((*pos == ' ') || (*pos == '\t') || (*pos == '\r') || (*pos == '\n')))
+	{
+		++pos;
+	}
+
+	// Compare the first key:
+	static const char playKey[] = "\"play\"";
+	return ((static_cast<size_t>(end - pos) >= sizeof(playKey) - 1) && (memcmp(pos, playKey, sizeof(playKey) - 1) == 0));
+}
+
+
+
+
+
+bool PlayParser::parse(const char * a_Data, size_t a_Length, Callbacks & a_Callbacks)
+{
+	PlayParser parser(a_Data, a_Length, a_Callbacks);
+	return parser.parseMessage();
+}
+
+
+
+
+
+bool PlayParser::parseMessage(void)
+{
+	bool hasPlay = false;
+	bool isValid = parseObject([this, &hasPlay](const char * a_Key, size_t a_KeyLength)
+		{
+			if (isKey(a_Key, a_KeyLength, "play"))
+			{
+				hasPlay = true;
+				return parsePlay();
+			}
+			return skipValue();
+		}
+	);
+
+	// Only whitespace is allowed after the top-level object:
+	skipWhitespace();
+	return (isValid && hasPlay && (m_Pos == m_End));
+}
+
+
+
+
+
+bool PlayParser::parsePlay(void)
+{
+	return parseObject([this](const char * a_Key, size_t a_KeyLength)
+		{
+			if (isKey(a_Key, a_KeyLength, "time"))
+			{
+				int time;
+				if (!parseInt(time))
+				{
+					return false;
+				}
+				m_Callbacks.onTime(time);
+				return true;
+			}
+			if (isKey(a_Key, a_KeyLength, "lastCmdId"))
+			{
+				int lastCmdId;
+				if (!parseInt(lastCmdId))
+				{
+					return false;
+				}
+				m_Callbacks.onLastCmdId(lastCmdId);
+				return true;
+			}
+			if (isKey(a_Key, a_KeyLength, "players"))
+			{
+				return parsePlayers();
+			}
+			return skipValue();
+		}
+	);
+}
+
+
+
+
+
+bool PlayParser::parsePlayers(void)
+{
+	return parseArray([this]()
+		{
+			return parsePlayer();
+		}
+	);
+}
+
+
+
+
+
+bool PlayParser::parsePlayer(void)
+{
+	return parseObject([this](const char * a_Key, size_t a_KeyLength)
+		{
+			if (isKey(a_Key, a_KeyLength, "bots"))
+			{
+				return parseBots();
+			}
+			return skipValue();
+		}
+	);
+}
+
+
+
+
+
+bool PlayParser::parseBots(void)
+{
+	return parseArray([this]()
+		{
+			return parseBot();
+		}
+	);
+}
+
+
+
+
+
+bool PlayParser::parseBot(void)
+{
+	// The keys may come in any order (the id is not necessarily the first one), collect all the values first:
+	int id = 0;
+	double x = 0, y = 0, speed = 0, angle = 0;
+	bool hasID = false;
+	bool isValid = parseObject([&](const char * a_Key, size_t a_KeyLength)
+		{
+			if (a_KeyLength == 1)
+			{
+				switch (*a_Key)
+				{
+					case 'x': return parseNumber(x);
+					case 'y': return parseNumber(y);
+				}
+			}
+			else if (isKey(a_Key, a_KeyLength, "id"))
+			{
+				hasID = true;
+				return parseInt(id);
+			}
+			else if (isKey(a_Key, a_KeyLength, "speed"))
+			{
+				return parseNumber(speed);
+			}
+			else if (isKey(a_Key, a_KeyLength, "angle"))
+			{
+				return parseNumber(angle);
+			}
+			return skipValue();
+		}
+	);
+	if (!isValid || !hasID)
+	{
+		return false;
+	}
+	m_Callbacks.onBot(id, x, y, speed, angle);
+	return true;
+}
+
+
+
+
+
+template <typename ParseValue>
+bool PlayParser::parseObject(ParseValue a_ParseValue)
+{
+	if (!expect('{'))
+	{
+		return false;
+	}
+	skipWhitespace();
+	if ((m_Pos < m_End) && (*m_Pos == '}'))
+	{
+		++m_Pos;
+		return true;
+	}
+	for (;;)
+	{
+		const char * key;
+		size_t keyLength;
+		if (
+			!parseRawString(key, keyLength) ||
+			!expect(':') ||
+			!a_ParseValue(key, keyLength)
+		)
+		{
+			return false;
+		}
+		skipWhitespace();
+		if (m_Pos >= m_End)
+		{
+			return false;
+		}
+		switch (*m_Pos++)
+		{
+			case ',': continue;
+			case '}': return true;
+			default:  return false;
+		}
+	}
+}
+
+
+
+
+
+template <typename ParseItem>
+bool PlayParser::parseArray(ParseItem a_ParseItem)
+{
+	if (!expect('['))
+	{
+		return false;
+	}
+	skipWhitespace();
+	if ((m_Pos < m_End) && (*m_Pos == ']'))
+	{
+		++m_Pos;
+		return true;
+	}
+	for (;;)
+	{
+		if (!a_ParseItem())
+		{
+			return false;
+		}
+		skipWhitespace();
+		if (m_Pos >= m_End)
+		{
+			return false;
+		}
+		switch (*m_Pos++)
+		{
+			case ',': continue;
+			case ']': return true;
+			default:  return false;
+		}
+	}
+}
+
+
+
+
+
+bool PlayParser::parseRawString(const char *& a_Value, size_t & a_Length)
+{
+	if (!expect('"'))
+	{
+		return false;
+	}
+	const char * start = m_Pos;
+	while (m_Pos < m_End)
+	{
+		switch (*m_Pos)
+		{
+			case '"':
+			{
+				a_Value = start;
+				a_Length = static_cast<size_t>(m_Pos - start);
+				++m_Pos;
+				return true;
+			}
+			case '\\':
+			{
+				// Skip the escaped char; the longer \uXXXX escapes contain no special chars, so they're skipped as regular chars
+				if (m_Pos + 1 >= m_End)
+				{
+					return false;
+				}
+				m_Pos += 2;
+				break;
+			}
+			default:
+			{
+				++m_Pos;
+				break;
+			}
+		}
+	}
+	return false;
+}
+
+
+
+
+
+bool PlayParser::parseNumber(double & a_Value)
+{
+	skipWhitespace();
+	const char * start = m_Pos;
+
+	// Parse the number's parts, accumulating up to 19 significant digits into an integer:
+	bool isNegative = false;
+	if ((m_Pos < m_End) && (*m_Pos == '-'))
+	{
+		isNegative = true;
+		++m_Pos;
+	}
+	UInt64 mantissa = 0;
+	int numDigits = 0;
+	int exponent = 0;
+	bool isExact = true;
+	const char * digitsStart = m_Pos;
+	while ((m_Pos < m_End) && (*m_Pos >= '0') && (*m_Pos <= '9'))
+	{
+		if (numDigits < 19)
+		{
+			mantissa = mantissa * 10 + static_cast<UInt64>(*m_Pos - '0');
+			numDigits += (mantissa > 0) ? 1 : 0;
+		}
+		else
+		{
+			isExact = false;
+		}
+		++m_Pos;
+	}
+	if (m_Pos == digitsStart)
+	{
+		return false;
+	}
+	if ((m_Pos < m_End) && (*m_Pos == '.'))
+	{
+		++m_Pos;
+		const char * fractionStart = m_Pos;
+		while ((m_Pos < m_End) && (*m_Pos >= '0') && (*m_Pos <= '9'))
+		{
+			if (numDigits < 19)
+			{
+				mantissa = mantissa * 10 + static_cast<UInt64>(*m_Pos - '0');
+				numDigits += (mantissa > 0) ? 1 : 0;
+				exponent -= 1;
+			}
+			else
+			{
+				isExact = false;
+			}
+			++m_Pos;
+		}
+		if (m_Pos == fractionStart)
+		{
+			return false;
+		}
+	}
+	if ((m_Pos < m_End) && ((*m_Pos == 'e') || (*m_Pos == 'E')))
+	{
+		++m_Pos;
+		bool isExpNegative = false;
+		if ((m_Pos < m_End) && ((*m_Pos == '+') || (*m_Pos == '-')))
+		{
+			isExpNegative = (*m_Pos == '-');
+			++m_Pos;
+		}
+		const char * expStart = m_Pos;
+		int exp = 0;
+		while ((m_Pos < m_End) && (*m_Pos >= '0') && (*m_Pos <= '9'))
+		{
+			exp = std::min(exp * 10 + (*m_Pos - '0'), 10000);
+			++m_Pos;
+		}
+		if (m_Pos == expStart)
+		{
+			return false;
+		}
+		exponent += isExpNegative ? -exp : exp;
+	}
+
+	// If the mantissa and the power of ten are both exact in a double, the result of a single operation is correctly rounded:
+	if (isExact && (mantissa <= (1ULL << 53)) && (exponent >= -22) && (exponent <= 22))
+	{
+		double value = static_cast<double>(mantissa);
+		value = (exponent < 0) ? (value / g_ExactPowersOf10[-exponent]) : (value * g_ExactPowersOf10[exponent]);
+		a_Value = isNegative ? -value : value;
+		return true;
+	}
+
+	// Otherwise let the runtime library do the correct rounding, from a zero-terminated copy on the stack:
+	char buf[64];
+	size_t length = static_cast<size_t>(m_Pos - start);
+	if (length >= sizeof(buf))
+	{
+		return false;
+	}
+	memcpy(buf, start, length);
+	buf[length] = 0;
+	a_Value = strtod(buf, nullptr);
+	return true;
+}
+
+
+
+
+
+bool PlayParser::parseInt(int & a_Value)
+{
+	double value;
+	if (!parseNumber(value))
+	{
+		return false;
+	}
+
+	// Reject the values that don't fit an int (including NaN, which fails both comparisons), the cast would be undefined:
+	if (
+		!(value >= static_cast<double>(std::numeric_limits<int>::min())) ||
+		!(value <= static_cast<double>(std::numeric_limits<int>::max()))
+	)
+	{
+		return false;
+	}
+	a_Value = static_cast<int>(value);
+	return true;
+}
+
+
+
+
+
+bool PlayParser::skipValue(int a_NestingLevel)
+{
+	if (a_NestingLevel > MAX_NESTING_LEVEL)
+	{
+		return false;
+	}
+	skipWhitespace();
+	if (m_Pos >= m_End)
+	{
+		return false;
+	}
+	switch (*m_Pos)
+	{
+		case '{':
+		{
+			return parseObject([this, a_NestingLevel](const char * a_Key, size_t a_KeyLength)
+				{
+					UNUSED(a_Key);
+					UNUSED(a_KeyLength);
+					return skipValue(a_NestingLevel + 1);
+				}
+			);
+		}
+		case '[':
+		{
+			return parseArray([this, a_NestingLevel]()
+				{
+					return skipValue(a_NestingLevel + 1);
+				}
+			);
+		}
+		case '"':
+		{
+			const char * value;
+			size_t length;
+			return parseRawString(value, length);
+		}
+		case 't':
+		case 'f':
+		case 'n':
+		{
+			static const char * literals[] = {"true", "false", "null"};
+			for (auto literal: literals)
+			{
+				size_t length = strlen(literal);
+				if ((static_cast<size_t>(m_End - m_Pos) >= length) && (memcmp(m_Pos, literal, length) == 0))
+				{
+					m_Pos += length;
+					return true;
+				}
+			}
+			return false;
+		}
+		default:
+		{
+			double value;
+			return parseNumber(value);
+		}
+	}
+}
+
+
+
+
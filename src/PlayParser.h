@@ -0,0 +1,134 @@
+
+// PlayParser.h
+
+// Declares the PlayParser class that parses the server's "play" message without building a Json DOM
+
+
+
+
+
+#pragma once
+
+
+
+
+
+/** A streaming parser specialized for the server's "play" message, the most frequent and largest message in a game.
+Instead of building a Json::Value tree, it reports the values that the board needs directly to the callbacks,
+without any memory allocations. Values of unknown keys are skipped, so additional fields sent by the server don't break it.
+The parser is strict about the Json syntax; if it fails, the caller should fall back to the generic jsoncpp parser. */
+class PlayParser
+{
+public:
+	/** The interface through which the parsed values are reported. */
+	class Callbacks
+	{
+	public:
+		// Force a virtual destructor in descendants:
+		virtual ~Callbacks() {}
+
+		/** Called when the "time" value is parsed. */
+		virtual void onTime(int a_Time) = 0;
+
+		/** Called when the "lastCmdId" value is parsed. */
+		virtual void onLastCmdId(int a_LastCmdId) = 0;
+
+		/** Called for each bot in the "players[].bots[]" arrays, once all its values have been parsed.
+		Values missing in the message are reported as zero. */
+		virtual void onBot(int a_ID, double a_X, double a_Y, double a_Speed, double a_Angle) = 0;
+	};
+
+
+	/** Returns true if the message in a_Data is a "play" message, judging by the first key of the top-level object. */
+	static bool isPlayMessage(const char * a_Data, size_t a_Length);
+
+	/** Parses the entire "play" message (including the top-level object with the "play" key) in a_Data.
+	Returns true on success, false on a syntax error or if there's no "play" object.
+	Note that the callbacks may have been called for a part of the message even if the parsing fails. */
+	static bool parse(const char * a_Data, size_t a_Length, Callbacks & a_Callbacks);
+
+protected:
+	/** The current parsing position. */
+	const char * m_Pos;
+
+	/** The end of the data being parsed. */
+	const char * m_End;
+
+	/** The callbacks to report the values to. */
+	Callbacks & m_Callbacks;
+
+
+	PlayParser(const char * a_Data, size_t a_Length, Callbacks & a_Callbacks);
+
+	/** Parses the top-level object, looking for the "play" key. */
+	bool parseMessage(void);
+
+	/** Parses the object that is the value of the "play" key. */
+	bool parsePlay(void);
+
+	/** Parses the "players" array. */
+	bool parsePlayers(void);
+
+	/** Parses a single item of the "players" array. */
+	bool parsePlayer(void);
+
+	/** Parses the "bots" array of a single player. */
+	bool parseBots(void);
+
+	/** Parses a single bot object and reports it to the callbacks. */
+	bool parseBot(void);
+
+	/** Parses an object, calling a_ParseValue(a_Key, a_KeyLength) to parse the value of each key.
+	a_ParseValue returns false on a parsing error. */
+	template <typename ParseValue>
+	bool parseObject(ParseValue a_ParseValue);
+
+	/** Parses an array, calling a_ParseItem() to parse each item.
+	a_ParseItem returns false on a parsing error. */
+	template <typename ParseItem>
+	bool parseArray(ParseItem a_ParseItem);
+
+	/** Parses a string, without processing any escapes. a_Value is set to point to the raw string contents. */
+	bool parseRawString(const char *& a_Value, size_t & a_Length);
+
+	/** Parses a number. */
+	bool parseNumber(double & a_Value);
+
+	/** Parses a number that is expected to be an integer. Fails if the number is not finite or out of the int range. */
+	bool parseInt(int & a_Value);
+
+	/** Skips any value, including nested objects and arrays. */
+	bool skipValue(int a_NestingLevel = 0);
+
+	/** Skips over any whitespace. */
+	void skipWhitespace(void)
+	{
+		while ((m_Pos < m_End) && ((*m_Pos == ' ') || (*m_Pos == '\t') || (*m_Pos == '\r') || (*m_Pos == '\n')))
+		{
+			++m_Pos;
+		}
+	}
+
+	/** Skips whitespace, then checks that the next character is a_Char and skips it. Returns false if not. */
+	bool expect(char a_Char)
+	{
+		skipWhitespace();
+		if ((m_Pos >= m_End) || (*m_Pos != a_Char))
+		{
+			return false;
+		}
+		++m_Pos;
+		return true;
+	}
+
+	/** Returns true if the key (as returned from parseRawString()) equals the specified string literal. */
+	template <size_t N>
+	static bool isKey(const char * a_Key, size_t a_KeyLength, const char (& a_Literal)[N])
+	{
+		return ((a_KeyLength == N - 1) && (memcmp(a_Key, a_Literal, N - 1) == 0));
+	}
+};
+
+
+
+
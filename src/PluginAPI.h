@@ -0,0 +1,184 @@
+
+// PluginAPI.h
+
+// Declares the C interface between the app and the native controller plugins (shared libraries)
+
+/*
+This header is shared by the app and the plugins, it must stay plain C and must not depend on any other header of the app.
+The interface is versioned by EBW_PLUGIN_API_VERSION; any change to the structures or the function signatures below
+needs to increment the version, the app refuses to load a plugin built against a different version.
+
+A plugin exports a single function, ebwGetPlugin(), that returns a pointer to its EbwPlugin structure.
+For each session, the app creates a plugin instance by calling create() and passes it to all the other functions.
+The app never calls the functions of a single instance concurrently, so the plugin needn't be thread-safe;
+the calls may come from different threads, though.
+The board view passed to the functions, and everything it points to, is only valid for the duration of the call.
+*/
+
+
+
+
+
+#pragma once
+
+
+
+
+
+/** The version of the plugin interface declared in this file. */
+#define EBW_PLUGIN_API_VERSION 1
+
+/** The name of the function that each plugin exports. */
+#define EBW_PLUGIN_ENTRY_POINT "ebwGetPlugin"
+
+/** Marks the plugin's exported entry point. */
+#ifdef _WIN32
+	#define EBW_PLUGIN_EXPORT __declspec(dllexport)
+#else
+	#define EBW_PLUGIN_EXPORT __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+
+
+
+
+/** The kinds of the commands returned by the plugin, as in the BotWarz protocol. */
+enum
+{
+	ebwCmdNone = 0,  // No command for the bot, the command is ignored
+	ebwCmdAccelerate,
+	ebwCmdBrake,
+	ebwCmdSteer,
+};
+
+
+
+
+
+/** The state of a single bot. */
+typedef struct EbwBot
+{
+	int id;
+	int isEnemy;  // Nonzero for the enemy's bots
+	double x;
+	double y;
+	double speed;
+	double angle;            // The heading, in degrees
+	double angularVelocity;  // The estimated rate of change of the angle, in degrees per second
+	double acceleration;     // The estimated rate of change of the speed, in speed units per second
+} EbwBot;
+
+
+
+
+
+/** A single level of speed that the bots can use. */
+typedef struct EbwSpeedLevel
+{
+	double linearSpeed;
+	double maxAngularSpeed;  // The max angle, in degrees, by which a single "steer" command can turn the bot at this level
+} EbwSpeedLevel;
+
+
+
+
+
+/** The read-only view of the game board. */
+typedef struct EbwBoard
+{
+	double worldWidth;
+	double worldHeight;
+	double botRadius;
+
+	const EbwSpeedLevel * speedLevels;
+	int numSpeedLevels;
+
+	/** The server time of the latest update, in msec since the game start. */
+	int serverTime;
+
+	/** All the bots alive on the board, both mine and the enemy's. */
+	const EbwBot * allBots;
+	int numAllBots;
+
+	/** My bots alive on the board, in the order in which they were listed at the game start. */
+	const EbwBot * myBots;
+	int numMyBots;
+} EbwBoard;
+
+
+
+
+
+/** A single command for a single bot, returned by the plugin. */
+typedef struct EbwCommand
+{
+	int botID;
+	int kind;      // One of the ebwCmd* constants
+	double angle;  // The relative angle to steer by, in degrees; only used for ebwCmdSteer
+} EbwCommand;
+
+
+
+
+
+/** The functions implemented by the plugin. The functions marked as optional may be NULL. */
+typedef struct EbwPlugin
+{
+	/** The EBW_PLUGIN_API_VERSION that the plugin has been built against. */
+	int apiVersion;
+
+	/** The human-readable name of the plugin, for the log. */
+	const char * name;
+
+	/** Creates a new instance of the controller, for a single session. Returns NULL on failure. */
+	void * (* create)(void);
+
+	/** Destroys an instance created by create(). */
+	void (* destroy)(void * a_Instance);
+
+	/** Called when a new game has started. */
+	void (* onGameStarted)(void * a_Instance, const EbwBoard * a_Board);
+
+	/** Called when a game update has been received. */
+	void (* onGameUpdate)(void * a_Instance, const EbwBoard * a_Board);
+
+	/** Called before onGameUpdate() for each bot whose death has been detected in the update.
+	a_Bot is the last known state of the bot. a_Board is the latest board; when the plugin runs in its own thread,
+	it may already be the state after the update, without the dead bot. */
+	void (* onBotDied)(void * a_Instance, const EbwBoard * a_Board, const EbwBot * a_Bot);
+
+	/** Fills a_Commands with the commands to be sent to the server for my bots, at most a_MaxCommands (the number of my bots).
+	Returns the number of commands filled in. The commands should be cleared, so that they aren't sent again the next time. */
+	int (* getBotCommands)(void * a_Instance, const EbwBoard * a_Board, EbwCommand * a_Commands, int a_MaxCommands);
+
+	/** Optional. Called after the commands have been sent; the time until the next update is the controller's slack. */
+	void (* onCommandsSent)(void * a_Instance, const EbwBoard * a_Board);
+
+	/** Optional. Called when the current game has finished. */
+	void (* onGameFinished)(void * a_Instance, const EbwBoard * a_Board);
+} EbwPlugin;
+
+
+
+
+
+/** The signature of the plugin's exported entry point.
+a_HostApiVersion is the EBW_PLUGIN_API_VERSION of the app; the plugin may return NULL if it doesn't support it. */
+typedef const EbwPlugin * (* EbwGetPluginFn)(int a_HostApiVersion);
+
+
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+
+
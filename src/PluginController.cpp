@@ -0,0 +1,439 @@
+
+// PluginController.cpp
+
+// Implements the PluginController class representing the AI controller implemented by a native plugin (shared library)
+
+#include "Globals.h"
+#include "lib/Network/CriticalSection.h"
+#include "Controller.h"
+#include "AsyncController.h"
+#include "PluginController.h"
+#include "PluginAPI.h"
+#include "Board.h"
+#include "BotWarzApp.h"
+
+#ifndef _WIN32
+	#include <dlfcn.h>
+#endif
+
+
+
+
+
+/** The protocol names of the plugin's command kinds, indexed by the kind. */
+static const char * const g_CommandNames[] =
+{
+	"",
+	"accelerate",
+	"brake",
+	"steer",
+};
+
+/** The file name extensions of the shared libraries, recognized as plugins. */
+static const char * const g_PluginExtensions[] =
+{
+	".so",
+	".dll",
+	".dylib",
+};
+
+
+
+
+
+class PluginController :
+	public Controller
+{
+	typedef Controller Super;
+
+public:
+	PluginController(BotWarzApp & a_App, const AString & a_FileName):
+		Super(a_App),
+		m_FileName(a_FileName),
+		m_Library(nullptr),
+		m_Plugin(nullptr),
+		m_Instance(nullptr),
+		m_Board(nullptr)
+	{
+		memset(&m_View, 0, sizeof(m_View));
+		auto startTime = std::chrono::steady_clock::now();
+		if (!load())
+		{
+			return;
+		}
+		auto loadMSec = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(std::chrono::steady_clock::now() - startTime).count();
+		LOG("%s: Plugin controller %s (%s) loaded in %.1f msec.",
+			a_App.getLoginNick().c_str(), a_FileName.c_str(), (m_Plugin->name != nullptr) ? m_Plugin->name : "unnamed", loadMSec
+		);
+	}
+
+
+
+
+
+	virtual ~PluginController() override
+	{
+		if (m_Instance != nullptr)
+		{
+			m_Plugin->destroy(m_Instance);
+		}
+		if (m_Library != nullptr)
+		{
+			#ifdef _WIN32
+				FreeLibrary(reinterpret_cast<HMODULE>(m_Library));
+			#else
+				dlclose(m_Library);
+			#endif
+		}
+	}
+
+
+
+
+
+	/** Called upon startup to query whether the controller has initialized properly; the app will terminate if not. */
+	virtual bool isValid(void) const override
+	{
+		return (m_Instance != nullptr);
+	}
+
+
+
+
+
+	/** Called when the game has just started.
+	a_Board points to the game board that represents the game state.
+	The board needs to stay valid until the game is finished via the onGameFinished() call. */
+	virtual void onGameStarted(Board & a_Board) override
+	{
+		cCSLock Lock(m_CS);
+		m_Board = &a_Board;
+
+		// The speed levels don't change during the game:
+		auto & speedLevels = a_Board.getSpeedLevels();
+		m_SpeedLevels.clear();
+		for (auto & sl: speedLevels)
+		{
+			EbwSpeedLevel level;
+			level.linearSpeed = sl.m_LinearSpeed;
+			level.maxAngularSpeed = sl.m_MaxAngularSpeed;
+			m_SpeedLevels.push_back(level);
+		}
+		m_View.worldWidth = a_Board.getWorldWidth();
+		m_View.worldHeight = a_Board.getWorldHeight();
+		m_View.botRadius = a_Board.getBotRadius();
+		m_View.speedLevels = m_SpeedLevels.data();
+		m_View.numSpeedLevels = static_cast<int>(m_SpeedLevels.size());
+
+		auto snapshot = m_Board->getSnapshot();
+		updateView(*snapshot);
+		m_Plugin->onGameStarted(m_Instance, &m_View);
+	}
+
+
+
+
+
+	/** Called when a game update has been received. */
+	virtual void onGameUpdate(void) override
+	{
+		cCSLock Lock(m_CS);
+		if (m_Board == nullptr)
+		{
+			return;
+		}
+		auto snapshot = m_Board->getSnapshot();
+		updateView(*snapshot);
+		m_Plugin->onGameUpdate(m_Instance, &m_View);
+	}
+
+
+
+
+
+	/** Called when the current game has finished.
+	The board that has represented this game can be released after this call returns. */
+	virtual void onGameFinished(void) override
+	{
+		cCSLock Lock(m_CS);
+		if (m_Board == nullptr)
+		{
+			return;
+		}
+		if (m_Plugin->onGameFinished != nullptr)
+		{
+			auto snapshot = m_Board->getSnapshot();
+			updateView(*snapshot);
+			m_Plugin->onGameFinished(m_Instance, &m_View);
+		}
+		m_Board = nullptr;
+	}
+
+
+
+
+
+	/** Called when a bot death is detected as part of the game update, before the actual onGameUpdate() call is made.
+	The plugin gets the latest published snapshot; when running through AsyncController, that may already be
+	the one after the update, so the dying bot is passed separately in its last known state. */
+	virtual void onBotDied(const Bot & a_Bot) override
+	{
+		cCSLock Lock(m_CS);
+		if (m_Board == nullptr)
+		{
+			return;
+		}
+		auto snapshot = m_Board->getSnapshot();
+		updateView(*snapshot);
+		EbwBot bot;
+		toEbwBot(a_Bot, bot);
+		m_Plugin->onBotDied(m_Instance, &m_View, &bot);
+	}
+
+
+
+
+
+	/** Fills a_Commands with the commands returned by the plugin for my bots. */
+	virtual void getBotCommands(BotCommands & a_Commands) override
+	{
+		a_Commands.clear();
+		cCSLock Lock(m_CS);
+		if (m_Board == nullptr)
+		{
+			return;
+		}
+		auto snapshot = m_Board->getSnapshot();
+		updateView(*snapshot);
+
+		// Let the plugin fill the preallocated commands, then convert them:
+		int maxCommands = m_View.numMyBots;
+		if (maxCommands == 0)
+		{
+			return;
+		}
+		m_Commands.resize(static_cast<size_t>(maxCommands));
+		int numCommands = m_Plugin->getBotCommands(m_Instance, &m_View, m_Commands.data(), maxCommands);
+		numCommands = std::min(std::max(numCommands, 0), maxCommands);
+		for (int i = 0; i < numCommands; i++)
+		{
+			auto & cmd = m_Commands[static_cast<size_t>(i)];
+			if ((cmd.kind <= ebwCmdNone) || (cmd.kind > ebwCmdSteer))
+			{
+				// Not a valid command, ignore it the same way the server would:
+				continue;
+			}
+			a_Commands.emplace_back(cmd.botID);
+			auto & botCmd = a_Commands.back();
+			botCmd.m_Cmd.assign(g_CommandNames[cmd.kind]);
+			botCmd.m_HasAngle = (cmd.kind == ebwCmdSteer);
+			botCmd.m_Angle = cmd.angle;
+		}
+	}
+
+
+
+
+
+	/** Called after the commands have been sent to the server. */
+	virtual void onCommandsSent(void) override
+	{
+		cCSLock Lock(m_CS);
+		if ((m_Board == nullptr) || (m_Plugin->onCommandsSent == nullptr))
+		{
+			return;
+		}
+		auto snapshot = m_Board->getSnapshot();
+		updateView(*snapshot);
+		m_Plugin->onCommandsSent(m_Instance, &m_View);
+	}
+
+protected:
+
+	/** The plugin's file name, as given on the command line. */
+	AString m_FileName;
+
+	/** The handle of the loaded shared library; nullptr if not loaded. */
+	void * m_Library;
+
+	/** The plugin's functions, as returned by its entry point; nullptr if not loaded. */
+	const EbwPlugin * m_Plugin;
+
+	/** The plugin's instance for this controller; nullptr if the plugin failed to load or to create it. */
+	void * m_Instance;
+
+	/** Serializes the calls into the plugin, so that the plugin needn't be thread-safe, and protects the members below. */
+	cCriticalSection m_CS;
+
+	/** The board of the current game; nullptr when not in a game. Protected by m_CS. */
+	Board * m_Board;
+
+	/** The speed levels of the current game, pointed to by m_View. Protected by m_CS. */
+	std::vector<EbwSpeedLevel> m_SpeedLevels;
+
+	/** The bots from the latest snapshot, pointed to by m_View. Protected by m_CS. */
+	std::vector<EbwBot> m_AllBots;
+	std::vector<EbwBot> m_MyBots;
+
+	/** The board view passed to the plugin, rebuilt from the latest snapshot for each call. Protected by m_CS. */
+	EbwBoard m_View;
+
+	/** The buffer for the commands filled in by the plugin, reused across the calls. Protected by m_CS. */
+	std::vector<EbwCommand> m_Commands;
+
+
+
+
+	/** Loads the shared library, checks its interface version and creates the plugin instance.
+	Returns true on success, logs the reason and returns false on failure. */
+	bool load(void)
+	{
+		// A name without a path would be searched for in the system library paths only, make it relative to the current folder:
+		AString fileName = m_FileName;
+		if (fileName.find_first_of("/\\") == AString::npos)
+		{
+			fileName = "./" + fileName;
+		}
+
+		// Load the library and get its entry point:
+		#ifdef _WIN32
+			auto library = LoadLibraryA(fileName.c_str());
+			m_Library = reinterpret_cast<void *>(library);
+			if (library == nullptr)
+			{
+				LOGERROR("Cannot load the plugin %s: error %u", m_FileName.c_str(), static_cast<unsigned>(GetLastError()));
+				return false;
+			}
+			auto getPlugin = reinterpret_cast<EbwGetPluginFn>(GetProcAddress(library, EBW_PLUGIN_ENTRY_POINT));
+		#else
+			m_Library = dlopen(fileName.c_str(), RTLD_NOW | RTLD_LOCAL);
+			if (m_Library == nullptr)
+			{
+				LOGERROR("Cannot load the plugin %s: %s", m_FileName.c_str(), dlerror());
+				return false;
+			}
+			auto getPlugin = reinterpret_cast<EbwGetPluginFn>(dlsym(m_Library, EBW_PLUGIN_ENTRY_POINT));
+		#endif
+		if (getPlugin == nullptr)
+		{
+			LOGERROR("The plugin %s doesn't export the %s() function.", m_FileName.c_str(), EBW_PLUGIN_ENTRY_POINT);
+			return false;
+		}
+
+		// Check the interface:
+		m_Plugin = getPlugin(EBW_PLUGIN_API_VERSION);
+		if (m_Plugin == nullptr)
+		{
+			LOGERROR("The plugin %s doesn't support the plugin interface version %d.", m_FileName.c_str(), EBW_PLUGIN_API_VERSION);
+			return false;
+		}
+		if (m_Plugin->apiVersion != EBW_PLUGIN_API_VERSION)
+		{
+			LOGERROR("The plugin %s has been built for the plugin interface version %d, this program requires version %d.",
+				m_FileName.c_str(), m_Plugin->apiVersion, EBW_PLUGIN_API_VERSION
+			);
+			m_Plugin = nullptr;
+			return false;
+		}
+		if (
+			(m_Plugin->create == nullptr) ||
+			(m_Plugin->destroy == nullptr) ||
+			(m_Plugin->onGameStarted == nullptr) ||
+			(m_Plugin->onGameUpdate == nullptr) ||
+			(m_Plugin->onBotDied == nullptr) ||
+			(m_Plugin->getBotCommands == nullptr)
+		)
+		{
+			LOGERROR("The plugin %s doesn't implement all the required functions.", m_FileName.c_str());
+			m_Plugin = nullptr;
+			return false;
+		}
+
+		// Create the instance:
+		m_Instance = m_Plugin->create();
+		if (m_Instance == nullptr)
+		{
+			LOGERROR("The plugin %s has failed to create its instance.", m_FileName.c_str());
+			return false;
+		}
+		return true;
+	}
+
+
+
+
+
+	/** Rebuilds the bots in m_View from the specified snapshot. */
+	void updateView(const BoardSnapshot & a_Snapshot)
+	{
+		ASSERT(m_CS.IsLockedByCurrentThread());
+
+		m_AllBots.resize(a_Snapshot.m_AllBots.size());
+		for (size_t i = 0; i < m_AllBots.size(); i++)
+		{
+			toEbwBot(a_Snapshot.m_AllBots[i], m_AllBots[i]);
+		}
+		m_MyBots.resize(a_Snapshot.m_MyBots.size());
+		for (size_t i = 0; i < m_MyBots.size(); i++)
+		{
+			toEbwBot(a_Snapshot.m_MyBots[i], m_MyBots[i]);
+		}
+		m_View.serverTime = a_Snapshot.m_ServerTime;
+		m_View.allBots = m_AllBots.data();
+		m_View.numAllBots = static_cast<int>(m_AllBots.size());
+		m_View.myBots = m_MyBots.data();
+		m_View.numMyBots = static_cast<int>(m_MyBots.size());
+	}
+
+
+
+
+
+	/** Converts the bot into its representation in the plugin interface. */
+	static void toEbwBot(const Bot & a_Bot, EbwBot & a_Dest)
+	{
+		a_Dest.id = a_Bot.m_ID;
+		a_Dest.isEnemy = a_Bot.m_IsEnemy ? 1 : 0;
+		a_Dest.x = a_Bot.m_X;
+		a_Dest.y = a_Bot.m_Y;
+		a_Dest.speed = a_Bot.m_Speed;
+		a_Dest.angle = a_Bot.m_Angle;
+		a_Dest.angularVelocity = a_Bot.m_AngularVelocity;
+		a_Dest.acceleration = a_Bot.m_Acceleration;
+	}
+};
+
+
+
+
+
+bool isPluginFileName(const AString & a_FileName)
+{
+	for (auto ext: g_PluginExtensions)
+	{
+		size_t extLen = strlen(ext);
+		if ((a_FileName.size() > extLen) && (NoCaseCompare(a_FileName.substr(a_FileName.size() - extLen), ext) == 0))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+
+
+
+
+SharedPtr<Controller> createPluginController(BotWarzApp & a_App, const AString & a_FileName, bool a_ShouldRunAsync)
+{
+	auto res = std::make_shared<PluginController>(a_App, a_FileName);
+	if (a_ShouldRunAsync)
+	{
+		return std::make_shared<AsyncController>(a_App, res);
+	}
+	return res;
+}
+
+
+
+
@@ -0,0 +1,35 @@
+
+// PluginController.h
+
+// Declares the createPluginController() function that returns a new controller implemented by a native plugin (shared library)
+
+
+
+
+
+#pragma once
+
+
+
+
+
+// fwd:
+class BotWarzApp;
+class Controller;
+
+
+
+
+
+/** Returns true if the specified controller file is a native plugin (a shared library), rather than a Lua script.
+Decided by the file's extension. */
+extern bool isPluginFileName(const AString & a_FileName);
+
+/** Creates a new controller implemented by the specified plugin, see PluginAPI.h for the interface that the plugin implements.
+Wrapped in an AsyncController if a_ShouldRunAsync is true.
+Returns a controller that isn't valid if the plugin cannot be loaded. */
+extern SharedPtr<Controller> createPluginController(BotWarzApp & a_App, const AString & a_FileName, bool a_ShouldRunAsync);
+
+
+
+
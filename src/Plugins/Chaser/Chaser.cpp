@@ -0,0 +1,226 @@
+
+// Chaser.cpp
+
+// Implements the Chaser plugin, an example native controller: each bot chases the nearest enemy bot
+// The same logic is implemented in Lua in out/Controllers/Chaser/Main.lua, the "plugin" benchmark compares the two.
+
+#define _USE_MATH_DEFINES  // M_PI in MSVC's <cmath>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include "PluginAPI.h"
+
+
+
+
+
+/** The controller's state for a single session. */
+class Chaser
+{
+public:
+	/** Computes the commands for all my bots from the current board. */
+	void update(const EbwBoard & a_Board)
+	{
+		m_Commands.clear();
+		for (int i = 0; i < a_Board.numMyBots; i++)
+		{
+			auto & bot = a_Board.myBots[i];
+			auto enemy = findNearestEnemy(a_Board, bot);
+			if (enemy == nullptr)
+			{
+				continue;
+			}
+
+			// Steer towards the enemy, as much as the bot's speed level allows; once heading at it, speed up:
+			EbwCommand cmd;
+			cmd.botID = bot.id;
+			double targetAngle = atan2(enemy->y - bot.y, enemy->x - bot.x) / (M_PI / 180.0);
+			double relAngle = normalizeAngle(targetAngle - bot.angle);
+			if (std::abs(relAngle) < 1)
+			{
+				cmd.kind = ebwCmdAccelerate;
+				cmd.angle = 0;
+			}
+			else
+			{
+				double maxAngle = getMaxAngle(a_Board, bot.speed);
+				cmd.kind = ebwCmdSteer;
+				cmd.angle = std::max(-maxAngle, std::min(maxAngle, relAngle));
+			}
+			m_Commands.push_back(cmd);
+		}  // for i - myBots[]
+	}
+
+
+	/** Moves the commands computed by the last update() into a_Commands, up to a_MaxCommands. Returns the number of commands. */
+	int takeCommands(EbwCommand * a_Commands, int a_MaxCommands)
+	{
+		int res = std::min(static_cast<int>(m_Commands.size()), a_MaxCommands);
+		std::copy(m_Commands.begin(), m_Commands.begin() + res, a_Commands);
+		m_Commands.clear();
+		return res;
+	}
+
+
+	/** Forgets the commands, used when a new game starts. */
+	void clear(void)
+	{
+		m_Commands.clear();
+	}
+
+protected:
+	/** The commands computed by the last update(), not yet sent. */
+	std::vector<EbwCommand> m_Commands;
+
+
+	/** Returns the enemy bot nearest to a_Bot, nullptr if there's none. */
+	static const EbwBot * findNearestEnemy(const EbwBoard & a_Board, const EbwBot & a_Bot)
+	{
+		const EbwBot * res = nullptr;
+		double minDist = 0;
+		for (int i = 0; i < a_Board.numAllBots; i++)
+		{
+			auto & other = a_Board.allBots[i];
+			if (!other.isEnemy)
+			{
+				continue;
+			}
+			double dx = other.x - a_Bot.x;
+			double dy = other.y - a_Bot.y;
+			double dist = dx * dx + dy * dy;
+			if ((res == nullptr) || (dist < minDist))
+			{
+				res = &other;
+				minDist = dist;
+			}
+		}
+		return res;
+	}
+
+
+	/** Returns the max steering angle at the speed level nearest to the specified speed. */
+	static double getMaxAngle(const EbwBoard & a_Board, double a_Speed)
+	{
+		if (a_Board.numSpeedLevels == 0)
+		{
+			return 0;
+		}
+		auto level = &a_Board.speedLevels[0];
+		double minDiff = std::abs(level->linearSpeed - a_Speed);
+		for (int i = 1; i < a_Board.numSpeedLevels; i++)
+		{
+			double diff = std::abs(a_Board.speedLevels[i].linearSpeed - a_Speed);
+			if (diff < minDiff)
+			{
+				level = &a_Board.speedLevels[i];
+				minDiff = diff;
+			}
+		}
+		return level->maxAngularSpeed;
+	}
+
+
+	/** Returns the angle in the range (-180, 180]; computed the same way as Lua's modulo, so that the results match the Lua controller exactly. */
+	static double normalizeAngle(double a_Angle)
+	{
+		double res = a_Angle - floor(a_Angle / 360) * 360;
+		return (res > 180) ? (res - 360) : res;
+	}
+};
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// The plugin interface:
+
+static void * create(void)
+{
+	return new Chaser;
+}
+
+
+
+
+
+static void destroy(void * a_Instance)
+{
+	delete static_cast<Chaser *>(a_Instance);
+}
+
+
+
+
+
+static void onGameStarted(void * a_Instance, const EbwBoard * a_Board)
+{
+	(void)a_Board;
+	static_cast<Chaser *>(a_Instance)->clear();
+}
+
+
+
+
+
+static void onGameUpdate(void * a_Instance, const EbwBoard * a_Board)
+{
+	static_cast<Chaser *>(a_Instance)->update(*a_Board);
+}
+
+
+
+
+
+static void onBotDied(void * a_Instance, const EbwBoard * a_Board, const EbwBot * a_Bot)
+{
+	// Nothing needed, the next update won't contain the bot:
+	(void)a_Instance;
+	(void)a_Board;
+	(void)a_Bot;
+}
+
+
+
+
+
+static int getBotCommands(void * a_Instance, const EbwBoard * a_Board, EbwCommand * a_Commands, int a_MaxCommands)
+{
+	(void)a_Board;
+	return static_cast<Chaser *>(a_Instance)->takeCommands(a_Commands, a_MaxCommands);
+}
+
+
+
+
+
+static const EbwPlugin g_Plugin =
+{
+	EBW_PLUGIN_API_VERSION,
+	"Chaser",
+	&create,
+	&destroy,
+	&onGameStarted,
+	&onGameUpdate,
+	&onBotDied,
+	&getBotCommands,
+	nullptr,  // onCommandsSent
+	nullptr,  // onGameFinished
+};
+
+
+
+
+
+extern "C" EBW_PLUGIN_EXPORT const EbwPlugin * ebwGetPlugin(int a_HostApiVersion)
+{
+	if (a_HostApiVersion != EBW_PLUGIN_API_VERSION)
+	{
+		return nullptr;
+	}
+	return &g_Plugin;
+}
+
+
+
+
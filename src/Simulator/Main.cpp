@@ -0,0 +1,148 @@
+
+// Main.cpp
+
+// Implements the main entrypoint of the BotWarz server simulator
+
+#include "Globals.h"  // NOTE: MSVC stupidness requires this to be the same across all modules
+
+#include <csignal>
+#include <thread>
+#include "lib/Network/NetworkSingleton.h"
+#include "Simulator.h"
+
+
+
+
+
+/** Set by the signal handler when the simulator should terminate. */
+static volatile sig_atomic_t g_ShouldTerminate = 0;
+
+
+
+
+
+static void onSignal(int a_Signal)
+{
+	g_ShouldTerminate = 1;
+}
+
+
+
+
+
+/** If a_Arg starts with a_Prefix, parses the rest as an integer into a_Value and returns true.
+Returns false if the prefix doesn't match. Logs an error and terminates if the number cannot be parsed. */
+template <typename T>
+static bool parseIntArg(const AString & a_Arg, const char * a_Prefix, T & a_Value)
+{
+	size_t prefixLen = strlen(a_Prefix);
+	if (NoCaseCompare(a_Arg.substr(0, prefixLen), a_Prefix) != 0)
+	{
+		return false;
+	}
+	if (!StringToInteger(a_Arg.substr(prefixLen), a_Value))
+	{
+		LOGERROR("Invalid number in parameter %s", a_Arg.c_str());
+		exit(2);
+	}
+	return true;
+}
+
+
+
+
+
+/** Initializes and runs the simulator.
+Returns the value that the process should return upon exit. */
+int run(int argc, char ** argv)
+{
+	// Process the command line:
+	Simulator::Settings settings;
+	int gameLengthSec = settings.m_Game.m_GameLengthMSec / 1000;
+	int width = static_cast<int>(settings.m_Game.m_Width);
+	int height = static_cast<int>(settings.m_Game.m_Height);
+	int radius = static_cast<int>(settings.m_Game.m_BotRadius);
+	for (int i = 1; i < argc; i++)
+	{
+		AString Arg(argv[i]);
+		if (
+			parseIntArg(Arg, "/port=",       settings.m_Port) ||
+			parseIntArg(Arg, "/tick=",       settings.m_TickMSec) ||
+			parseIntArg(Arg, "/ratewindow=", settings.m_RateWindowMSec) ||
+			parseIntArg(Arg, "/gamepause=",  settings.m_GamePauseMSec) ||
+			parseIntArg(Arg, "/games=",      settings.m_NumGamesPerClient) ||
+			parseIntArg(Arg, "/seed=",       settings.m_Seed) ||
+			parseIntArg(Arg, "/bots=",       settings.m_Game.m_NumBotsPerPlayer) ||
+			parseIntArg(Arg, "/gamelength=", gameLengthSec) ||
+			parseIntArg(Arg, "/width=",      width) ||
+			parseIntArg(Arg, "/height=",     height) ||
+			parseIntArg(Arg, "/radius=",     radius)
+		)
+		{
+			continue;
+		}
+		else if (NoCaseCompare(Arg.substr(0, 7), "/token=") == 0)
+		{
+			settings.m_LoginToken = Arg.substr(7);
+		}
+		else if (NoCaseCompare(Arg, "/nooutbuf") == 0)
+		{
+			setvbuf(stdout, nullptr, _IONBF, 0);
+		}
+		else
+		{
+			LOGERROR("Unknown parameter: %s", Arg.c_str());
+			return 2;
+		}
+	}  // for i - argv[]
+	settings.m_Game.m_GameLengthMSec = gameLengthSec * 1000;
+	settings.m_Game.m_Width = width;
+	settings.m_Game.m_Height = height;
+	settings.m_Game.m_BotRadius = radius;
+	if ((settings.m_TickMSec <= 0) || (settings.m_Game.m_NumBotsPerPlayer <= 0))
+	{
+		LOGERROR("The tick length and the number of bots must be positive.");
+		return 2;
+	}
+
+	// Run the simulator until terminated by a signal:
+	auto simulator = std::make_shared<Simulator>(settings);
+	if (!simulator->start())
+	{
+		return 1;
+	}
+	signal(SIGINT, onSignal);
+	signal(SIGTERM, onSignal);
+	while (g_ShouldTerminate == 0)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+	LOG("Terminating the simulator.");
+	simulator->stop();
+	simulator->logStats();
+	return 0;
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// main:
+
+int main(int argc, char ** argv)
+{
+	// Initialize LibEvent:
+	cNetworkSingleton::Get();
+
+	int res = run(argc, argv);
+
+	// Shutdown all of LibEvent:
+	cNetworkSingleton::Get().Terminate();
+
+	return res;
+}
+
+
+
+
@@ -0,0 +1,391 @@
+
+// SimGame.cpp
+
+// Implements the SimGame class representing a single simulated BotWarz game, including the bot physics
+
+#include "Globals.h"
+#include "SimGame.h"
+#include "json/json.h"
+
+
+
+
+
+const char * SimGame::OPPONENT_NICK = "SimOpponent";
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// SimGame::Settings:
+
+SimGame::Settings::Settings(void):
+	m_Width(1280),
+	m_Height(720),
+	m_BotRadius(20),
+	m_NumBotsPerPlayer(5),
+	m_GameLengthMSec(60000)
+{
+	m_SpeedLevels.emplace_back(10, 20);
+	m_SpeedLevels.emplace_back(20, 15);
+	m_SpeedLevels.emplace_back(40, 10);
+	m_SpeedLevels.emplace_back(60, 5);
+	m_SpeedLevels.emplace_back(80, 3);
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// SimGame:
+
+SimGame::SimGame(const Settings & a_Settings, const AString & a_PlayerNick, UInt32 a_Seed):
+	m_Settings(a_Settings),
+	m_Time(0),
+	m_Random(a_Seed)
+{
+	m_Nicks[0] = a_PlayerNick;
+	m_Nicks[1] = OPPONENT_NICK;
+
+	// Place the bots in two columns facing each other:
+	int id = 1;
+	for (int player = 0; player < 2; player++)
+	{
+		double x = (player == 0) ? (m_Settings.m_Width / 6) : (m_Settings.m_Width * 5 / 6);
+		double spacing = m_Settings.m_Height / (m_Settings.m_NumBotsPerPlayer + 1);
+		for (int i = 0; i < m_Settings.m_NumBotsPerPlayer; i++)
+		{
+			SimBot bot;
+			bot.m_ID = id++;
+			bot.m_PlayerIdx = player;
+			bot.m_X = x;
+			bot.m_Y = spacing * (i + 1);
+			bot.m_Angle = (player == 0) ? 0 : 180;
+			bot.m_SpeedLevel = 0;
+			bot.m_IsAlive = true;
+			bot.m_PendingCmd = SimBot::pcNone;
+			bot.m_PendingAngle = 0;
+			m_Bots.push_back(bot);
+		}
+	}
+}
+
+
+
+
+
+Json::Value SimGame::getGameJson(void) const
+{
+	Json::Value res;
+	res["time"] = m_Time;
+	res["world"]["width"] = m_Settings.m_Width;
+	res["world"]["height"] = m_Settings.m_Height;
+	res["botRadius"] = m_Settings.m_BotRadius;
+	Json::Value & speedLevels = res["speedLevels"];
+	speedLevels = Json::Value(Json::arrayValue);
+	for (auto & sl: m_Settings.m_SpeedLevels)
+	{
+		Json::Value level;
+		level["speed"] = sl.m_LinearSpeed;
+		level["maxAngle"] = sl.m_MaxAngle;
+		speedLevels.append(level);
+	}
+	res["players"] = getPlayersJson();
+	return res;
+}
+
+
+
+
+
+Json::Value SimGame::getPlayJson(int a_LastCmdId) const
+{
+	Json::Value res;
+	res["time"] = m_Time;
+	res["lastCmdId"] = a_LastCmdId;
+	res["players"] = getPlayersJson();
+	return res;
+}
+
+
+
+
+
+Json::Value SimGame::getResultJson(void) const
+{
+	Json::Value res;
+	res["time"] = m_Time;
+	int numBots0 = getNumAliveBots(0);
+	int numBots1 = getNumAliveBots(1);
+	if (numBots0 != numBots1)
+	{
+		res["winner"]["nickname"] = m_Nicks[(numBots0 > numBots1) ? 0 : 1];
+	}
+	return res;
+}
+
+
+
+
+
+void SimGame::queueCommands(const Json::Value & a_Bots)
+{
+	for (auto itr = a_Bots.begin(), end = a_Bots.end(); itr != end; ++itr)
+	{
+		auto & cmd = *itr;
+		int id = cmd["id"].asInt();
+		if ((id < 1) || (static_cast<size_t>(id) > m_Bots.size()))
+		{
+			continue;
+		}
+		auto & bot = m_Bots[static_cast<size_t>(id - 1)];
+		if (!bot.m_IsAlive || (bot.m_PlayerIdx != 0))
+		{
+			continue;
+		}
+		AString cmdName = cmd["cmd"].asString();
+		if (cmdName == "accelerate")
+		{
+			bot.m_PendingCmd = SimBot::pcAccelerate;
+		}
+		else if (cmdName == "brake")
+		{
+			bot.m_PendingCmd = SimBot::pcBrake;
+		}
+		else if (cmdName == "steer")
+		{
+			bot.m_PendingCmd = SimBot::pcSteer;
+			bot.m_PendingAngle = cmd["angle"].asDouble();
+		}
+	}  // for itr - a_Bots[]
+}
+
+
+
+
+
+void SimGame::tick(int a_DeltaMSec)
+{
+	m_Time += a_DeltaMSec;
+
+	// Apply the commands:
+	decideOpponentCommands();
+	for (auto & bot: m_Bots)
+	{
+		if (bot.m_IsAlive)
+		{
+			applyPendingCommand(bot);
+		}
+	}
+
+	// Move the bots, bouncing off the world edges:
+	double dt = static_cast<double>(a_DeltaMSec) / 1000;
+	double radius = m_Settings.m_BotRadius;
+	for (auto & bot: m_Bots)
+	{
+		if (!bot.m_IsAlive)
+		{
+			continue;
+		}
+		double dist = getSpeed(bot) * dt;
+		double rad = bot.m_Angle * M_PI / 180;
+		bot.m_X += dist * cos(rad);
+		bot.m_Y += dist * sin(rad);
+		if ((bot.m_X < radius) || (bot.m_X > m_Settings.m_Width - radius))
+		{
+			bot.m_X = std::min(std::max(bot.m_X, radius), m_Settings.m_Width - radius);
+			bot.m_Angle = 180 - bot.m_Angle;
+		}
+		if ((bot.m_Y < radius) || (bot.m_Y > m_Settings.m_Height - radius))
+		{
+			bot.m_Y = std::min(std::max(bot.m_Y, radius), m_Settings.m_Height - radius);
+			bot.m_Angle = -bot.m_Angle;
+		}
+		bot.m_Angle = fmod(bot.m_Angle + 360, 360);
+	}  // for bot - m_Bots[]
+
+	resolveCollisions();
+}
+
+
+
+
+
+bool SimGame::isFinished(void) const
+{
+	return (
+		(m_Time >= m_Settings.m_GameLengthMSec) ||
+		(getNumAliveBots(0) == 0) ||
+		(getNumAliveBots(1) == 0)
+	);
+}
+
+
+
+
+
+int SimGame::getNumAliveBots(int a_PlayerIdx) const
+{
+	int res = 0;
+	for (auto & bot: m_Bots)
+	{
+		if (bot.m_IsAlive && (bot.m_PlayerIdx == a_PlayerIdx))
+		{
+			res += 1;
+		}
+	}
+	return res;
+}
+
+
+
+
+
+void SimGame::decideOpponentCommands(void)
+{
+	// The opponent wanders around randomly, each bot changes its mind about once a second on average:
+	std::uniform_int_distribution<int> chance(0, 9);
+	std::uniform_real_distribution<double> steer(-1, 1);
+	for (auto & bot: m_Bots)
+	{
+		if (!bot.m_IsAlive || (bot.m_PlayerIdx != 1) || (chance(m_Random) != 0))
+		{
+			continue;
+		}
+		switch (chance(m_Random) % 3)
+		{
+			case 0: bot.m_PendingCmd = SimBot::pcAccelerate; break;
+			case 1: bot.m_PendingCmd = SimBot::pcBrake;      break;
+			default:
+			{
+				bot.m_PendingCmd = SimBot::pcSteer;
+				bot.m_PendingAngle = steer(m_Random) * m_Settings.m_SpeedLevels[bot.m_SpeedLevel].m_MaxAngle;
+				break;
+			}
+		}
+	}  // for bot - m_Bots[]
+}
+
+
+
+
+
+void SimGame::applyPendingCommand(SimBot & a_Bot)
+{
+	switch (a_Bot.m_PendingCmd)
+	{
+		case SimBot::pcNone:
+		{
+			break;
+		}
+		case SimBot::pcAccelerate:
+		{
+			if (a_Bot.m_SpeedLevel + 1 < m_Settings.m_SpeedLevels.size())
+			{
+				a_Bot.m_SpeedLevel += 1;
+			}
+			break;
+		}
+		case SimBot::pcBrake:
+		{
+			if (a_Bot.m_SpeedLevel > 0)
+			{
+				a_Bot.m_SpeedLevel -= 1;
+			}
+			break;
+		}
+		case SimBot::pcSteer:
+		{
+			double maxAngle = m_Settings.m_SpeedLevels[a_Bot.m_SpeedLevel].m_MaxAngle;
+			a_Bot.m_Angle += std::min(std::max(a_Bot.m_PendingAngle, -maxAngle), maxAngle);
+			break;
+		}
+	}
+	a_Bot.m_PendingCmd = SimBot::pcNone;
+}
+
+
+
+
+
+void SimGame::resolveCollisions(void)
+{
+	double minDistSq = 4 * m_Settings.m_BotRadius * m_Settings.m_BotRadius;
+	std::vector<size_t> toKill;
+	for (size_t i = 0, numBots = m_Bots.size(); i < numBots; i++)
+	{
+		auto & bot1 = m_Bots[i];
+		if (!bot1.m_IsAlive || (bot1.m_PlayerIdx != 0))
+		{
+			continue;
+		}
+		for (size_t j = 0; j < numBots; j++)
+		{
+			auto & bot2 = m_Bots[j];
+			if (!bot2.m_IsAlive || (bot2.m_PlayerIdx != 1))
+			{
+				continue;
+			}
+			double dx = bot1.m_X - bot2.m_X;
+			double dy = bot1.m_Y - bot2.m_Y;
+			if (dx * dx + dy * dy > minDistSq)
+			{
+				continue;
+			}
+			double speed1 = getSpeed(bot1);
+			double speed2 = getSpeed(bot2);
+			if (speed1 <= speed2)
+			{
+				toKill.push_back(i);
+			}
+			if (speed2 <= speed1)
+			{
+				toKill.push_back(j);
+			}
+		}  // for j - m_Bots[]
+	}  // for i - m_Bots[]
+
+	// Kill the bots only after all the pairs have been checked, so that the result doesn't depend on the order:
+	for (auto idx: toKill)
+	{
+		m_Bots[idx].m_IsAlive = false;
+	}
+}
+
+
+
+
+
+Json::Value SimGame::getPlayersJson(void) const
+{
+	Json::Value res(Json::arrayValue);
+	for (int player = 0; player < 2; player++)
+	{
+		Json::Value p;
+		p["nickname"] = m_Nicks[player];
+		Json::Value & bots = p["bots"];
+		bots = Json::Value(Json::arrayValue);
+		for (auto & bot: m_Bots)
+		{
+			if (!bot.m_IsAlive || (bot.m_PlayerIdx != player))
+			{
+				continue;
+			}
+			Json::Value b;
+			b["id"] = bot.m_ID;
+			b["x"] = bot.m_X;
+			b["y"] = bot.m_Y;
+			b["angle"] = bot.m_Angle;
+			b["speed"] = getSpeed(bot);
+			bots.append(b);
+		}
+		res.append(p);
+	}
+	return res;
+}
+
+
+
+
@@ -0,0 +1,171 @@
+
+// SimGame.h
+
+// Declares the SimGame class representing a single simulated BotWarz game, including the bot physics
+
+
+
+
+
+#pragma once
+
+#include <random>
+
+
+
+
+
+// fwd:
+namespace Json
+{
+	class Value;
+}
+
+
+
+
+
+class SimGame
+{
+public:
+	/** Defines a single level of speed that the bots can use, same as the server's "speedLevels" item. */
+	struct SpeedLevel
+	{
+		/** The linear speed at which the bot moves in this level, in world units per second. */
+		double m_LinearSpeed;
+
+		/** The maximum angle (in degrees) that a single "steer" command can turn the bot in this level. */
+		double m_MaxAngle;
+
+		SpeedLevel(double a_LinearSpeed, double a_MaxAngle):
+			m_LinearSpeed(a_LinearSpeed),
+			m_MaxAngle(a_MaxAngle)
+		{
+		}
+	};
+
+	typedef std::vector<SpeedLevel> SpeedLevels;
+
+
+	/** The parameters of the simulated games. Shared by all games in a simulator. */
+	struct Settings
+	{
+		/** World width (X coord). */
+		double m_Width;
+
+		/** World height (Y coord). */
+		double m_Height;
+
+		/** Radius of each individual bot. */
+		double m_BotRadius;
+
+		/** The number of bots that each player starts with. */
+		int m_NumBotsPerPlayer;
+
+		/** The maximum length of a game, in msec of game time. The game is decided by the number of living bots after that. */
+		int m_GameLengthMSec;
+
+		/** The available speed levels. */
+		SpeedLevels m_SpeedLevels;
+
+		/** Creates the default settings, resembling the live server. */
+		Settings(void);
+	};
+
+
+	/** The nickname used for the simulated opponent. */
+	static const char * OPPONENT_NICK;
+
+
+	/** Creates a new game between a_PlayerNick and the built-in opponent.
+	a_Seed is used for the opponent's decisions, so that games are repeatable. */
+	SimGame(const Settings & a_Settings, const AString & a_PlayerNick, UInt32 a_Seed);
+
+	/** Returns the contents of the "game" message sent to the client upon game start. */
+	Json::Value getGameJson(void) const;
+
+	/** Returns the contents of the "play" message sent to the client after each tick. */
+	Json::Value getPlayJson(int a_LastCmdId) const;
+
+	/** Returns the contents of the "result" message sent to the client once the game is finished. */
+	Json::Value getResultJson(void) const;
+
+	/** Queues the commands received from the client, to be applied in the next tick.
+	a_Bots is the contents of the "bots" array of the client's message.
+	Commands for unknown, dead or enemy bots are silently ignored, same as on the live server. */
+	void queueCommands(const Json::Value & a_Bots);
+
+	/** Advances the game by the specified amount of game time.
+	Applies the queued commands, moves the bots and resolves collisions. */
+	void tick(int a_DeltaMSec);
+
+	/** Returns true if the game has been decided (one side has no bots left, or the time has run out). */
+	bool isFinished(void) const;
+
+	/** Returns the current game time, in msec since the game start. */
+	int getTime(void) const { return m_Time; }
+
+protected:
+	/** Representation of a single simulated bot. */
+	struct SimBot
+	{
+		int m_ID;
+		int m_PlayerIdx;  ///< 0 = the connected client, 1 = the built-in opponent
+		double m_X;
+		double m_Y;
+		double m_Angle;  ///< In degrees
+		size_t m_SpeedLevel;  ///< Index into m_Settings.m_SpeedLevels
+		bool m_IsAlive;
+
+		/** The command to apply in the next tick. */
+		enum
+		{
+			pcNone,
+			pcAccelerate,
+			pcBrake,
+			pcSteer,
+		} m_PendingCmd;
+
+		/** The angle for the pending steer command. */
+		double m_PendingAngle;
+	};
+
+
+	/** The settings used for this game. */
+	const Settings & m_Settings;
+
+	/** The nicknames of the two players. */
+	AString m_Nicks[2];
+
+	/** All the bots in the game, including dead ones (so that IDs map to indices). */
+	std::vector<SimBot> m_Bots;
+
+	/** The current game time, in msec. */
+	int m_Time;
+
+	/** The RNG driving the built-in opponent. */
+	std::mt19937 m_Random;
+
+
+	/** Returns the linear speed of the specified bot. */
+	double getSpeed(const SimBot & a_Bot) const { return m_Settings.m_SpeedLevels[a_Bot.m_SpeedLevel].m_LinearSpeed; }
+
+	/** Returns the number of alive bots for the specified player. */
+	int getNumAliveBots(int a_PlayerIdx) const;
+
+	/** Sets the pending commands for the built-in opponent's bots. */
+	void decideOpponentCommands(void);
+
+	/** Applies the pending command of the specified bot. */
+	void applyPendingCommand(SimBot & a_Bot);
+
+	/** Kills bots that collide with an enemy bot; the slower of the two dies, equal speeds kill both. */
+	void resolveCollisions(void);
+
+	/** Returns the "players" array with the current state of all living bots. */
+	Json::Value getPlayersJson(void) const;
+};
+
+
+
+
@@ -0,0 +1,520 @@
+
+// Simulator.cpp
+
+// Implements the Simulator class representing a local stand-in for the BotWarz server, and the SimSession class representing a single client connection to it
+
+#include "Globals.h"
+#include "Simulator.h"
+#include <iomanip>
+#include <sstream>
+#include "json/json.h"
+#include "sha1.h"
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// SimSession:
+
+SimSession::SimSession(Simulator & a_Simulator, UInt32 a_Seed):
+	m_Simulator(a_Simulator),
+	m_Status(ssWaitingForLogin),
+	m_Random(a_Seed),
+	m_NumGamesPlayed(0),
+	m_TicksUntilNextGame(0),
+	m_LastCmdId(0),
+	m_NumCmdsAccepted(0),
+	m_NumCmdsRejected(0)
+{
+}
+
+
+
+
+
+void SimSession::tick(void)
+{
+	// Prepare the outgoing data while locked, but send it only after unlocking.
+	// The network thread holds the link's internal lock while waiting for m_CS in OnReceivedData(), sending while locked would deadlock.
+	cTCPLinkPtr link;
+	AString outgoing;
+	bool shouldShutdown;
+	{
+		cCSLock Lock(m_CS);
+		shouldShutdown = tickLocked();
+		link = m_Link;
+		std::swap(outgoing, m_OutgoingData);
+	}
+	if (link == nullptr)
+	{
+		return;
+	}
+	if (!outgoing.empty())
+	{
+		link->Send(outgoing);
+	}
+	if (shouldShutdown)
+	{
+		link->Shutdown();
+	}
+}
+
+
+
+
+
+bool SimSession::tickLocked(void)
+{
+	ASSERT(m_CS.IsLockedByCurrentThread());
+	switch (m_Status)
+	{
+		case ssWaitingForLogin:
+		case ssFinished:
+		{
+			return false;
+		}
+
+		case ssIdle:
+		{
+			// Start a new game, if it's time:
+			if (m_TicksUntilNextGame > 0)
+			{
+				m_TicksUntilNextGame -= 1;
+				return false;
+			}
+			m_Game.reset(new SimGame(m_Simulator.getSettings().m_Game, m_Nick, m_Random()));
+			m_Status = ssGame;
+			Json::Value msg;
+			msg["game"] = m_Game->getGameJson();
+			send(msg);
+			return false;
+		}
+
+		case ssGame:
+		{
+			// Step the game and send the update:
+			m_Game->tick(m_Simulator.getSettings().m_TickMSec);
+			Json::Value msg;
+			msg["play"] = m_Game->getPlayJson(m_LastCmdId);
+			send(msg);
+			if (!m_Game->isFinished())
+			{
+				return false;
+			}
+
+			// The game has finished, send the result:
+			Json::Value res;
+			res["result"] = m_Game->getResultJson();
+			send(res);
+			m_Simulator.gameFinished(res["result"]["winner"]["nickname"].asString(), m_Game->getTime());
+			LOG("Game #%d with %s finished; commands accepted: %d, rejected: %d",
+				m_NumGamesPlayed + 1, m_Nick.c_str(), m_NumCmdsAccepted, m_NumCmdsRejected
+			);
+			m_Game.reset();
+			m_NumGamesPlayed += 1;
+			m_NumCmdsAccepted = 0;
+			m_NumCmdsRejected = 0;
+
+			// Wait before starting another game, or disconnect if enough games have been played:
+			auto & settings = m_Simulator.getSettings();
+			if ((settings.m_NumGamesPerClient > 0) && (m_NumGamesPlayed >= settings.m_NumGamesPerClient))
+			{
+				m_Status = ssFinished;
+				return true;
+			}
+			m_Status = ssIdle;
+			m_TicksUntilNextGame = settings.m_GamePauseMSec / std::max(settings.m_TickMSec, 1);
+			return false;
+		}
+	}
+	return false;
+}
+
+
+
+
+
+void SimSession::OnLinkCreated(cTCPLinkPtr a_Link)
+{
+	cCSLock Lock(m_CS);
+	m_Link = a_Link;
+	a_Link->EnableNoDelay();
+
+	// Generate the random nonce and send it to the client:
+	std::uniform_int_distribution<int> hexDigit(0, 15);
+	for (int i = 0; i < 16; i++)
+	{
+		m_Nonce.push_back("0123456789abcdef"[hexDigit(m_Random)]);
+	}
+	Json::Value msg;
+	msg["status"] = "socket_connected";
+	msg["random"] = m_Nonce;
+	send(msg);
+	flush();
+}
+
+
+
+
+
+void SimSession::OnReceivedData(const char * a_Data, size_t a_Length)
+{
+	cCSLock Lock(m_CS);
+
+	// Process the data, linewise:
+	m_QueuedData.append(a_Data, a_Length);
+	size_t lineStart = 0;
+	for (;;)
+	{
+		auto lineEnd = m_QueuedData.find('\n', lineStart);
+		if (lineEnd == AString::npos)
+		{
+			break;
+		}
+		processLine(m_QueuedData.substr(lineStart, lineEnd - lineStart));
+		lineStart = lineEnd + 1;
+	}
+	m_QueuedData.erase(0, lineStart);
+	flush();
+}
+
+
+
+
+
+void SimSession::OnRemoteClosed(void)
+{
+	cCSLock Lock(m_CS);
+	LOG("Client %s disconnected after %d games.", m_Nick.c_str(), m_NumGamesPlayed);
+	m_Link.reset();
+	m_Game.reset();
+	m_Status = ssFinished;
+}
+
+
+
+
+
+void SimSession::OnError(int a_ErrorCode, const AString & a_ErrorMsg)
+{
+	cCSLock Lock(m_CS);
+	LOGWARNING("Error on the link to client %s: %d (%s)", m_Nick.c_str(), a_ErrorCode, a_ErrorMsg.c_str());
+	m_Link.reset();
+	m_Game.reset();
+	m_Status = ssFinished;
+}
+
+
+
+
+
+void SimSession::processLine(const AString & a_Line)
+{
+	Json::Value root;
+	Json::Reader reader;
+	if (!reader.parse(a_Line, root, false))
+	{
+		LOGWARNING("%s: Cannot parse incoming Json: %s", __FUNCTION__, reader.getFormattedErrorMessages().c_str());
+		return;
+	}
+
+	if (root.isMember("login"))
+	{
+		processLogin(root["login"]);
+		return;
+	}
+	if (root.isMember("cmdId"))
+	{
+		processCommands(root);
+		return;
+	}
+	LOGWARNING("%s: Received an unknown message: %s", __FUNCTION__, a_Line.c_str());
+}
+
+
+
+
+
+void SimSession::processLogin(const Json::Value & a_Login)
+{
+	if (m_Status != ssWaitingForLogin)
+	{
+		LOGWARNING("%s: Received a login while already logged in, ignoring.", __FUNCTION__);
+		return;
+	}
+	m_Nick = a_Login["nickname"].asString();
+
+	// Verify the hash, if a token is configured:
+	auto & token = m_Simulator.getSettings().m_LoginToken;
+	if (!token.empty())
+	{
+		AString toHash = m_Nonce + token;
+		unsigned char shaChecksum[20];
+		sha1(reinterpret_cast<const unsigned char *>(toHash.data()), toHash.size(), shaChecksum);
+		std::stringstream shaHash;
+		shaHash << std::hex << std::setfill('0') << std::nouppercase;
+		for (size_t i = 0; i < ARRAYCOUNT(shaChecksum); i++)
+		{
+			shaHash << std::setw(2) << static_cast<unsigned>(shaChecksum[i]);
+		}
+		if (a_Login["hash"].asString() != shaHash.str())
+		{
+			LOGWARNING("Client %s failed to log in: bad hash", m_Nick.c_str());
+			Json::Value msg;
+			msg["status"] = "login_failed";
+			msg["msg"] = "Invalid login hash";
+			send(msg);
+			close();
+			return;
+		}
+	}
+
+	LOG("Client %s logged in.", m_Nick.c_str());
+	Json::Value msg;
+	msg["status"] = "login_ok";
+	send(msg);
+	m_Status = ssIdle;
+	m_TicksUntilNextGame = 0;
+}
+
+
+
+
+
+void SimSession::processCommands(const Json::Value & a_Commands)
+{
+	if (m_Status != ssGame)
+	{
+		// Commands outside of a game are ignored
+		return;
+	}
+
+	// Enforce the rate window:
+	auto now = std::chrono::steady_clock::now();
+	auto sinceLast = std::chrono::duration_cast<std::chrono::milliseconds>(now - m_LastCmdTime).count();
+	if ((m_NumCmdsAccepted > 0) && (sinceLast < m_Simulator.getSettings().m_RateWindowMSec))
+	{
+		m_NumCmdsRejected += 1;
+		return;
+	}
+	m_LastCmdTime = now;
+	m_LastCmdId = a_Commands["cmdId"].asInt();
+	m_NumCmdsAccepted += 1;
+	m_Game->queueCommands(a_Commands["bots"]);
+}
+
+
+
+
+
+void SimSession::send(const Json::Value & a_Data)
+{
+	ASSERT(m_CS.IsLockedByCurrentThread());
+	Json::StreamWriterBuilder wr;
+	wr.settings_["indentation"] = "";
+	wr.settings_["commentStyle"] = "None";
+	m_OutgoingData.append(Json::writeString(wr, a_Data));
+	m_OutgoingData.push_back('\n');
+}
+
+
+
+
+
+void SimSession::flush(void)
+{
+	ASSERT(m_CS.IsLockedByCurrentThread());
+	if ((m_Link != nullptr) && !m_OutgoingData.empty())
+	{
+		m_Link->Send(m_OutgoingData);
+	}
+	m_OutgoingData.clear();
+}
+
+
+
+
+
+void SimSession::close(void)
+{
+	flush();
+	if (m_Link != nullptr)
+	{
+		m_Link->Shutdown();
+	}
+	m_Game.reset();
+	m_Status = ssFinished;
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Simulator::Settings:
+
+Simulator::Settings::Settings(void):
+	m_Port(8080),
+	m_TickMSec(100),
+	m_RateWindowMSec(200),
+	m_GamePauseMSec(1000),
+	m_NumGamesPerClient(0),
+	m_Seed(0)
+{
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Simulator:
+
+Simulator::Simulator(const Settings & a_Settings):
+	m_Settings(a_Settings),
+	m_ShouldTerminate(false),
+	m_NumSessionsCreated(0),
+	m_NumGamesFinished(0),
+	m_NumGamesWonByClient(0),
+	m_NumGamesWonByOpponent(0),
+	m_TotalGameTime(0)
+{
+}
+
+
+
+
+
+bool Simulator::start(void)
+{
+	m_Server = cNetwork::Listen(m_Settings.m_Port, shared_from_this());
+	if (!m_Server->IsListening())
+	{
+		LOGERROR("Cannot listen on port %u", static_cast<unsigned>(m_Settings.m_Port));
+		return false;
+	}
+	m_TickThread = std::thread(&Simulator::tickThread, this);
+	LOG("Simulator listening on port %u; tick %d msec, rate window %d msec, %d bots per player",
+		static_cast<unsigned>(m_Settings.m_Port), m_Settings.m_TickMSec, m_Settings.m_RateWindowMSec, m_Settings.m_Game.m_NumBotsPerPlayer
+	);
+	return true;
+}
+
+
+
+
+
+void Simulator::stop(void)
+{
+	// Stop listening; release the server handle, it holds a reference to this object:
+	m_Server->Close();
+	m_Server.reset();
+
+	// Stop ticking and drop all the sessions:
+	m_ShouldTerminate = true;
+	if (m_TickThread.joinable())
+	{
+		m_TickThread.join();
+	}
+	cCSLock Lock(m_CSSessions);
+	m_Sessions.clear();
+}
+
+
+
+
+
+void Simulator::gameFinished(const AString & a_Winner, int a_GameTime)
+{
+	cCSLock Lock(m_CSSessions);
+	m_NumGamesFinished += 1;
+	m_TotalGameTime += a_GameTime;
+	if (a_Winner == SimGame::OPPONENT_NICK)
+	{
+		m_NumGamesWonByOpponent += 1;
+	}
+	else if (!a_Winner.empty())
+	{
+		m_NumGamesWonByClient += 1;
+	}
+}
+
+
+
+
+
+void Simulator::logStats(void)
+{
+	cCSLock Lock(m_CSSessions);
+	LOG("Games finished: %d; won by clients: %d, won by the opponent: %d, draws: %d; average game length %.1f sec",
+		m_NumGamesFinished, m_NumGamesWonByClient, m_NumGamesWonByOpponent,
+		m_NumGamesFinished - m_NumGamesWonByClient - m_NumGamesWonByOpponent,
+		(m_NumGamesFinished > 0) ? static_cast<double>(m_TotalGameTime) / m_NumGamesFinished / 1000 : 0.0
+	);
+}
+
+
+
+
+
+cTCPLink::cCallbacksPtr Simulator::OnIncomingConnection(const AString & a_RemoteIPAddress, UInt16 a_RemotePort)
+{
+	cCSLock Lock(m_CSSessions);
+	auto session = std::make_shared<SimSession>(*this, m_Settings.m_Seed + m_NumSessionsCreated);
+	m_NumSessionsCreated += 1;
+	m_Sessions.push_back(session);
+	return session;
+}
+
+
+
+
+
+void Simulator::OnAccepted(cTCPLink & a_Link)
+{
+	LOG("Accepted a client connection from %s:%u", a_Link.GetRemoteIP().c_str(), static_cast<unsigned>(a_Link.GetRemotePort()));
+}
+
+
+
+
+
+void Simulator::OnError(int a_ErrorCode, const AString & a_ErrorMsg)
+{
+	LOGERROR("Simulator server socket error: %d (%s)", a_ErrorCode, a_ErrorMsg.c_str());
+}
+
+
+
+
+
+void Simulator::tickThread(void)
+{
+	auto tickLength = std::chrono::milliseconds(m_Settings.m_TickMSec);
+	auto nextTick = std::chrono::steady_clock::now() + tickLength;
+	while (!m_ShouldTerminate)
+	{
+		std::this_thread::sleep_until(nextTick);
+		nextTick += tickLength;
+
+		// Tick all the sessions, remove those that have finished:
+		SimSessionPtrs sessions;
+		{
+			cCSLock Lock(m_CSSessions);
+			m_Sessions.erase(
+				std::remove_if(m_Sessions.begin(), m_Sessions.end(), [](const SimSessionPtr & a_Session) { return a_Session->isFinished(); }),
+				m_Sessions.end()
+			);
+			sessions = m_Sessions;
+		}
+		for (auto & session: sessions)
+		{
+			session->tick();
+		}
+	}  // while (!m_ShouldTerminate)
+}
+
+
+
+
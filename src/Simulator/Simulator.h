@@ -0,0 +1,234 @@
+
+// Simulator.h
+
+// Declares the Simulator class representing a local stand-in for the BotWarz server, and the SimSession class representing a single client connection to it
+
+
+
+
+
+#pragma once
+
+#include <thread>
+#include "lib/Network/Network.h"
+#include "lib/Network/CriticalSection.h"
+#include "SimGame.h"
+
+
+
+
+
+// fwd:
+class Simulator;
+
+
+
+
+
+/** A single client connected to the simulator.
+Handles the protocol (handshake, commands) and drives the games played by this client. */
+class SimSession:
+	public cTCPLink::cCallbacks
+{
+public:
+	SimSession(Simulator & a_Simulator, UInt32 a_Seed);
+
+	/** Advances the session by one tick: steps the current game and sends the update, or starts a new game when due.
+	Called periodically from the simulator's tick thread. */
+	void tick(void);
+
+	/** Returns true if the session has ended (client disconnected or all games played) and can be removed. */
+	bool isFinished(void) const { return (m_Status == ssFinished); }
+
+protected:
+	/** The state of the session's protocol. */
+	enum Status
+	{
+		ssWaitingForLogin,  ///< "socket_connected" sent, waiting for the client's login
+		ssIdle,             ///< Logged in, waiting for the next game to start
+		ssGame,             ///< A game is in progress
+		ssFinished,         ///< The link has been closed, the session is to be removed
+	};
+
+	/** The simulator that owns this session. */
+	Simulator & m_Simulator;
+
+	/** The link to the client. */
+	cTCPLinkPtr m_Link;
+
+	/** Protects all the members against concurrent access from the network thread and the tick thread. */
+	cCriticalSection m_CS;
+
+	/** The current protocol state. */
+	Status m_Status;
+
+	/** Partial data that has been received from the client but not yet processed (incomplete line). */
+	AString m_QueuedData;
+
+	/** Data queued by send(), to be sent to the client once m_CS is no longer needed. */
+	AString m_OutgoingData;
+
+	/** The random string sent to the client in the "socket_connected" message, used to verify the login hash. */
+	AString m_Nonce;
+
+	/** The nickname that the client has logged in with. */
+	AString m_Nick;
+
+	/** The game currently being played, nullptr if none. */
+	UniquePtr<SimGame> m_Game;
+
+	/** The RNG used for the nonce and for seeding individual games. */
+	std::mt19937 m_Random;
+
+	/** The number of games played in this session so far. */
+	int m_NumGamesPlayed;
+
+	/** The number of ticks remaining until the next game starts, while in ssIdle. */
+	int m_TicksUntilNextGame;
+
+	/** The cmdId of the last command accepted from the client. */
+	int m_LastCmdId;
+
+	/** The time when the last command was accepted. */
+	std::chrono::steady_clock::time_point m_LastCmdTime;
+
+	/** Number of command messages that were accepted / rejected because of the rate limit. */
+	int m_NumCmdsAccepted;
+	int m_NumCmdsRejected;
+
+
+	// cTCPLink::cCallbacks overrides:
+	virtual void OnLinkCreated(cTCPLinkPtr a_Link) override;
+	virtual void OnReceivedData(const char * a_Data, size_t a_Length) override;
+	virtual void OnRemoteClosed(void) override;
+	virtual void OnError(int a_ErrorCode, const AString & a_ErrorMsg) override;
+
+	/** Implements tick() while m_CS is held; the messages are only queued into m_OutgoingData.
+	Returns true if the link should be shut down after sending the queued data. */
+	bool tickLocked(void);
+
+	/** Processes one line of incoming data. */
+	void processLine(const AString & a_Line);
+
+	/** Processes the client's "login" message. */
+	void processLogin(const Json::Value & a_Login);
+
+	/** Processes the client's command message. */
+	void processCommands(const Json::Value & a_Commands);
+
+	/** Queues the json data to be sent to the client, as a single line. */
+	void send(const Json::Value & a_Data);
+
+	/** Sends all the queued outgoing data to the client.
+	Only to be called from the network thread, see tick() for the reason. */
+	void flush(void);
+
+	/** Closes the link and marks the session as finished. */
+	void close(void);
+};
+
+typedef SharedPtr<SimSession> SimSessionPtr;
+typedef std::vector<SimSessionPtr> SimSessionPtrs;
+
+
+
+
+
+class Simulator:
+	public cNetwork::cListenCallbacks,
+	public std::enable_shared_from_this<Simulator>
+{
+public:
+	/** The settings of the simulator, as given on the command line. */
+	struct Settings
+	{
+		/** The parameters of the individual games. */
+		SimGame::Settings m_Game;
+
+		/** The TCP port to listen on. */
+		UInt16 m_Port;
+
+		/** The interval between two "play" updates, in msec of both game and wall-clock time. */
+		int m_TickMSec;
+
+		/** The minimum interval between two accepted commands, in msec. Commands received sooner are ignored. */
+		int m_RateWindowMSec;
+
+		/** The pause between two consecutive games of a single client, in msec. */
+		int m_GamePauseMSec;
+
+		/** The number of games to play with each client before disconnecting it; no limit if not positive. */
+		int m_NumGamesPerClient;
+
+		/** The login token to verify the clients' login hash against; any login is accepted if empty. */
+		AString m_LoginToken;
+
+		/** The base seed for all the randomness, so that runs are repeatable. */
+		UInt32 m_Seed;
+
+		/** Creates the default settings, resembling the live server. */
+		Settings(void);
+	};
+
+
+	Simulator(const Settings & a_Settings);
+
+	/** Starts listening and ticking.
+	The simulator must be owned by a SharedPtr, because the network API keeps a reference to it as the listen callbacks.
+	Returns true on success, logs the reason and returns false on failure. */
+	bool start(void);
+
+	/** Stops listening, disconnects all clients and stops the tick thread. */
+	void stop(void);
+
+	const Settings & getSettings(void) const { return m_Settings; }
+
+	/** Called by the sessions when a game has finished, to update the statistics. */
+	void gameFinished(const AString & a_Winner, int a_GameTime);
+
+	/** Logs the overall statistics of the simulator's run. */
+	void logStats(void);
+
+protected:
+	/** The settings for the simulator. */
+	Settings m_Settings;
+
+	/** The handle to the listening server socket. */
+	cServerHandlePtr m_Server;
+
+	/** All the currently connected sessions. Protected by m_CSSessions. */
+	SimSessionPtrs m_Sessions;
+
+	/** Protects m_Sessions and the statistics against multithreaded access. */
+	cCriticalSection m_CSSessions;
+
+	/** The thread that ticks all the sessions. */
+	std::thread m_TickThread;
+
+	/** Flag that tells the tick thread to terminate. */
+	volatile bool m_ShouldTerminate;
+
+	/** The number of sessions created so far, used for seeding each session differently. */
+	UInt32 m_NumSessionsCreated;
+
+	/** Statistics: the number of games finished, won by the client and won by the opponent. */
+	int m_NumGamesFinished;
+	int m_NumGamesWonByClient;
+	int m_NumGamesWonByOpponent;
+
+	/** Statistics: the sum of the game time of all the finished games, in msec. */
+	Int64 m_TotalGameTime;
+
+
+	// cNetwork::cListenCallbacks overrides:
+	virtual cTCPLink::cCallbacksPtr OnIncomingConnection(const AString & a_RemoteIPAddress, UInt16 a_RemotePort) override;
+	virtual void OnAccepted(cTCPLink & a_Link) override;
+	virtual void OnError(int a_ErrorCode, const AString & a_ErrorMsg) override;
+
+	/** Runs the thread that ticks all the sessions, in regular intervals. */
+	void tickThread(void);
+};
+
+
+
+
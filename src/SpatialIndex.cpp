@@ -0,0 +1,322 @@
+
+// SpatialIndex.cpp
+
+// Implements the SpatialIndex class providing the proximity queries over the bots, using a uniform grid
+
+#include "Globals.h"
+#include "SpatialIndex.h"
+#include "BotTable.h"
+
+
+
+
+
+/** The cell size, in multiples of the bot radius. Two bot diameters make the typical queries examine only a few cells. */
+static const double CELL_SIZE_IN_RADII = 4;
+
+
+
+
+
+SpatialIndex::SpatialIndex(void):
+	m_CellSize(1),
+	m_NumCellsX(1),
+	m_NumCellsY(1),
+	m_Cells(1),
+	m_NumRelocations(0)
+{
+}
+
+
+
+
+
+void SpatialIndex::initialize(double a_WorldWidth, double a_WorldHeight, double a_BotRadius)
+{
+	cCSLock Lock(m_CS);
+
+	// Pick the cell size, enlarging it if the grid would have too many cells:
+	double width = std::max(a_WorldWidth, 1.0);
+	double height = std::max(a_WorldHeight, 1.0);
+	m_CellSize = std::max(a_BotRadius * CELL_SIZE_IN_RADII, 1.0);
+	while (ceil(width / m_CellSize) * ceil(height / m_CellSize) > MAX_CELLS)
+	{
+		m_CellSize *= 2;
+	}
+	m_NumCellsX = static_cast<int>(ceil(width / m_CellSize));
+	m_NumCellsY = static_cast<int>(ceil(height / m_CellSize));
+
+	m_Cells.clear();
+	m_Cells.resize(static_cast<size_t>(m_NumCellsX * m_NumCellsY));
+	m_Entries.clear();
+	m_SlotByID.clear();
+	m_NumRelocations = 0;
+}
+
+
+
+
+
+void SpatialIndex::update(const BotTable & a_Bots)
+{
+	cCSLock Lock(m_CS);
+	size_t numSlots = a_Bots.getNumSlots();
+
+	// If the slots have changed (the bots are only added at the game start), start over:
+	if (m_Entries.size() != numSlots)
+	{
+		for (auto & cell: m_Cells)
+		{
+			cell.clear();
+		}
+		m_Entries.clear();
+		m_SlotByID.clear();
+		for (size_t slot = 0; slot < numSlots; slot++)
+		{
+			auto bot = a_Bots.getBot(slot);
+			m_Entries.push_back({bot.m_ID, bot.m_IsEnemy, bot.m_X, bot.m_Y, -1, 0});
+			m_SlotByID[bot.m_ID] = slot;
+		}
+	}
+
+	// Relocate the bots that have moved to another cell, remove the dead ones:
+	for (size_t slot = 0; slot < numSlots; slot++)
+	{
+		auto & entry = m_Entries[slot];
+		if (!a_Bots.isAlive(slot))
+		{
+			if (entry.m_Cell >= 0)
+			{
+				removeFromCell(slot);
+			}
+			continue;
+		}
+		auto bot = a_Bots.getBot(slot);
+		entry.m_X = bot.m_X;
+		entry.m_Y = bot.m_Y;
+		int cell = getCellCoord(bot.m_X, m_NumCellsX) + getCellCoord(bot.m_Y, m_NumCellsY) * m_NumCellsX;
+		if (cell == entry.m_Cell)
+		{
+			continue;
+		}
+		if (entry.m_Cell >= 0)
+		{
+			removeFromCell(slot);
+			m_NumRelocations += 1;
+		}
+		auto & cellSlots = m_Cells[static_cast<size_t>(cell)];
+		entry.m_Cell = cell;
+		entry.m_PosInCell = cellSlots.size();
+		cellSlots.push_back(slot);
+	}
+}
+
+
+
+
+
+bool SpatialIndex::getBot(int a_BotID, double & a_X, double & a_Y, bool & a_IsEnemy) const
+{
+	cCSLock Lock(m_CS);
+	auto itr = m_SlotByID.find(a_BotID);
+	if (itr == m_SlotByID.end())
+	{
+		return false;
+	}
+	auto & entry = m_Entries[itr->second];
+	if (entry.m_Cell < 0)
+	{
+		return false;
+	}
+	a_X = entry.m_X;
+	a_Y = entry.m_Y;
+	a_IsEnemy = entry.m_IsEnemy;
+	return true;
+}
+
+
+
+
+
+int SpatialIndex::findNearest(double a_X, double a_Y, Filter a_Filter, int a_ExcludeID) const
+{
+	std::vector<Candidate> candidates;
+	candidates.reserve(1);
+	cCSLock Lock(m_CS);
+	findNearestCandidates(a_X, a_Y, 1, a_Filter, a_ExcludeID, candidates);
+	return candidates.empty() ? -1 : candidates[0].second;
+}
+
+
+
+
+
+void SpatialIndex::findKNearest(double a_X, double a_Y, size_t a_Count, Filter a_Filter, int a_ExcludeID, std::vector<int> & a_IDs) const
+{
+	a_IDs.clear();
+	if (a_Count == 0)
+	{
+		return;
+	}
+	std::vector<Candidate> candidates;
+	cCSLock Lock(m_CS);
+	candidates.reserve(std::min(a_Count, m_Entries.size()));
+	findNearestCandidates(a_X, a_Y, a_Count, a_Filter, a_ExcludeID, candidates);
+	for (auto & cand: candidates)
+	{
+		a_IDs.push_back(cand.second);
+	}
+}
+
+
+
+
+
+void SpatialIndex::findWithinRadius(double a_X, double a_Y, double a_Radius, Filter a_Filter, int a_ExcludeID, std::vector<int> & a_IDs) const
+{
+	a_IDs.clear();
+	if (a_Radius < 0)
+	{
+		return;
+	}
+	std::vector<Candidate> candidates;
+	double radiusSq = a_Radius * a_Radius;
+
+	// Check all the cells overlapping the circle's bounding box:
+	cCSLock Lock(m_CS);
+	int minX = getCellCoord(a_X - a_Radius, m_NumCellsX);
+	int maxX = getCellCoord(a_X + a_Radius, m_NumCellsX);
+	int minY = getCellCoord(a_Y - a_Radius, m_NumCellsY);
+	int maxY = getCellCoord(a_Y + a_Radius, m_NumCellsY);
+	for (int y = minY; y <= maxY; y++)
+	{
+		for (int x = minX; x <= maxX; x++)
+		{
+			for (auto slot: m_Cells[static_cast<size_t>(x + y * m_NumCellsX)])
+			{
+				auto & entry = m_Entries[slot];
+				if (!matches(entry, a_Filter, a_ExcludeID))
+				{
+					continue;
+				}
+				double dx = entry.m_X - a_X;
+				double dy = entry.m_Y - a_Y;
+				double distSq = dx * dx + dy * dy;
+				if (distSq <= radiusSq)
+				{
+					candidates.emplace_back(distSq, entry.m_ID);
+				}
+			}  // for slot - cell[]
+		}  // for x
+	}  // for y
+
+	std::sort(candidates.begin(), candidates.end());
+	for (auto & cand: candidates)
+	{
+		a_IDs.push_back(cand.second);
+	}
+}
+
+
+
+
+
+int SpatialIndex::getCellCoord(double a_Coord, int a_NumCells) const
+{
+	double cell = floor(a_Coord / m_CellSize);
+	if (!(cell >= 0))  // Also catches NaN
+	{
+		return 0;
+	}
+	return (cell >= a_NumCells) ? a_NumCells - 1 : static_cast<int>(cell);
+}
+
+
+
+
+
+void SpatialIndex::removeFromCell(size_t a_Slot)
+{
+	auto & entry = m_Entries[a_Slot];
+	ASSERT(entry.m_Cell >= 0);
+	auto & cellSlots = m_Cells[static_cast<size_t>(entry.m_Cell)];
+	ASSERT(cellSlots[entry.m_PosInCell] == a_Slot);
+
+	// Move the last bot in the cell into the removed bot's position:
+	size_t lastSlot = cellSlots.back();
+	cellSlots[entry.m_PosInCell] = lastSlot;
+	m_Entries[lastSlot].m_PosInCell = entry.m_PosInCell;
+	cellSlots.pop_back();
+	entry.m_Cell = -1;
+}
+
+
+
+
+
+void SpatialIndex::findNearestCandidates(
+	double a_X, double a_Y, size_t a_Count, Filter a_Filter, int a_ExcludeID, std::vector<Candidate> & a_Candidates
+) const
+{
+	ASSERT(m_CS.IsLockedByCurrentThread());
+	ASSERT(a_Count > 0);
+
+	int centerX = getCellCoord(a_X, m_NumCellsX);
+	int centerY = getCellCoord(a_Y, m_NumCellsY);
+	int maxRing = std::max(std::max(centerX, m_NumCellsX - 1 - centerX), std::max(centerY, m_NumCellsY - 1 - centerY));
+	for (int ring = 0; ring <= maxRing; ring++)
+	{
+		// Check all the cells in the ring:
+		for (int dy = -ring; dy <= ring; dy++)
+		{
+			int y = centerY + dy;
+			if ((y < 0) || (y >= m_NumCellsY))
+			{
+				continue;
+			}
+			bool isFullRow = ((dy == -ring) || (dy == ring));
+			int stepX = isFullRow ? 1 : std::max(2 * ring, 1);
+			for (int dx = -ring; dx <= ring; dx += stepX)
+			{
+				int x = centerX + dx;
+				if ((x < 0) || (x >= m_NumCellsX))
+				{
+					continue;
+				}
+				for (auto slot: m_Cells[static_cast<size_t>(x + y * m_NumCellsX)])
+				{
+					auto & entry = m_Entries[slot];
+					if (!matches(entry, a_Filter, a_ExcludeID))
+					{
+						continue;
+					}
+					double distX = entry.m_X - a_X;
+					double distY = entry.m_Y - a_Y;
+					Candidate cand(distX * distX + distY * distY, entry.m_ID);
+					if ((a_Candidates.size() == a_Count) && !(cand < a_Candidates.back()))
+					{
+						continue;
+					}
+
+					// Insert the candidate, keeping the list sorted and at most a_Count long:
+					if (a_Candidates.size() == a_Count)
+					{
+						a_Candidates.pop_back();
+					}
+					a_Candidates.insert(std::upper_bound(a_Candidates.begin(), a_Candidates.end(), cand), cand);
+				}  // for slot - cell[]
+			}  // for dx
+		}  // for dy
+
+		// The cells in the further rings are at least this far away, if the candidates are all closer, the search is done:
+		double minDistFurther = ring * m_CellSize;
+		if ((a_Candidates.size() == a_Count) && (a_Candidates.back().first <= minDistFurther * minDistFurther))
+		{
+			return;
+		}
+	}  // for ring
+}
+
+
+
+
@@ -0,0 +1,146 @@
+
+// SpatialIndex.h
+
+// Declares the SpatialIndex class providing the proximity queries over the bots, using a uniform grid
+
+
+
+
+
+#pragma once
+
+#include "lib/Network/CriticalSection.h"
+
+
+
+
+
+// fwd:
+class BotTable;
+
+
+
+
+
+/** Indexes the bots' positions in a uniform grid over the world, so that the proximity queries only need to examine
+the bots in the nearby cells instead of all the bots.
+The cell size is derived from the bot radius, enlarged if needed to keep the number of cells reasonable.
+The index is kept per BotTable slot and updated incrementally: after each board update, only the bots that have moved
+to another cell (or died) are relocated.
+The updating is done by the thread processing the server messages, the queries can be made from any thread. */
+class SpatialIndex
+{
+public:
+	/** Specifies which bots the queries consider. */
+	enum Filter
+	{
+		fAll,      ///< All the bots
+		fMine,     ///< Only my bots
+		fEnemies,  ///< Only the enemy bots
+	};
+
+
+	SpatialIndex(void);
+
+	/** Sets up the grid for the specified world and removes all the bots. Called when a new game starts. */
+	void initialize(double a_WorldWidth, double a_WorldHeight, double a_BotRadius);
+
+	/** Updates the index with the current positions of the bots in the table. */
+	void update(const BotTable & a_Bots);
+
+	/** Returns the position of the specified bot and whether it is an enemy.
+	Returns false if there's no such bot alive. */
+	bool getBot(int a_BotID, double & a_X, double & a_Y, bool & a_IsEnemy) const;
+
+	/** Returns the ID of the bot nearest to the specified point, or -1 if there's none.
+	a_ExcludeID is a bot ID to skip (the querying bot itself), use -1 for none.
+	Ties are broken by the lower ID. */
+	int findNearest(double a_X, double a_Y, Filter a_Filter, int a_ExcludeID) const;
+
+	/** Fills a_IDs with the IDs of the (up to) a_Count bots nearest to the specified point, nearest first.
+	a_ExcludeID is a bot ID to skip (the querying bot itself), use -1 for none. */
+	void findKNearest(double a_X, double a_Y, size_t a_Count, Filter a_Filter, int a_ExcludeID, std::vector<int> & a_IDs) const;
+
+	/** Fills a_IDs with the IDs of all the bots whose centers are within the specified distance from the point, nearest first.
+	a_ExcludeID is a bot ID to skip (the querying bot itself), use -1 for none. */
+	void findWithinRadius(double a_X, double a_Y, double a_Radius, Filter a_Filter, int a_ExcludeID, std::vector<int> & a_IDs) const;
+
+	/** Returns the number of bots relocated to another cell since the game start, for the statistics. */
+	size_t getNumRelocations(void) const { return m_NumRelocations; }
+
+protected:
+	/** The maximum number of cells in the grid. */
+	static const int MAX_CELLS = 1 << 16;
+
+	/** The indexed state of a single bot (a single BotTable slot). */
+	struct Entry
+	{
+		int m_ID;
+		bool m_IsEnemy;
+		double m_X;
+		double m_Y;
+
+		/** The index of the cell the bot is in, or -1 if the bot is not in the grid (dead). */
+		int m_Cell;
+
+		/** The position of the bot's slot within its cell's list. */
+		size_t m_PosInCell;
+	};
+
+	/** A candidate found by a query: squared distance and the bot ID. Ordered by the distance, then by the ID. */
+	typedef std::pair<double, int> Candidate;
+
+
+	/** Protects all the members against multithreaded access. */
+	mutable cCriticalSection m_CS;
+
+	/** The size of a single cell's side. */
+	double m_CellSize;
+
+	/** The number of cells in each direction. */
+	int m_NumCellsX;
+	int m_NumCellsY;
+
+	/** The slots of the bots in each cell. */
+	std::vector<std::vector<size_t>> m_Cells;
+
+	/** The indexed bots, by their BotTable slot. */
+	std::vector<Entry> m_Entries;
+
+	/** The BotTable slot for each bot ID. Rebuilt when the table's slots change (at the game start). */
+	std::map<int, size_t> m_SlotByID;
+
+	/** The number of bots relocated to another cell since the game start. */
+	size_t m_NumRelocations;
+
+
+	/** Returns the cell coord for the specified world coord, clamped to the grid. */
+	int getCellCoord(double a_Coord, int a_NumCells) const;
+
+	/** Removes the bot in the specified slot from its cell. */
+	void removeFromCell(size_t a_Slot);
+
+	/** Returns true if the bot in the specified slot passes the filter and isn't excluded. */
+	bool matches(const Entry & a_Entry, Filter a_Filter, int a_ExcludeID) const
+	{
+		if (a_Entry.m_ID == a_ExcludeID)
+		{
+			return false;
+		}
+		switch (a_Filter)
+		{
+			case fAll:     return true;
+			case fMine:    return !a_Entry.m_IsEnemy;
+			case fEnemies: return a_Entry.m_IsEnemy;
+		}
+		return false;
+	}
+
+	/** Collects the a_Count nearest matching bots into a_Candidates (sorted, nearest first),
+	searching the cells in growing rings around the point until no closer bot can be found. */
+	void findNearestCandidates(double a_X, double a_Y, size_t a_Count, Filter a_Filter, int a_ExcludeID, std::vector<Candidate> & a_Candidates) const;
+};
+
+
+
+
@@ -0,0 +1,135 @@
+
+// Steering.cpp
+
+// Implements the Steering class providing the 2D geometry and steering calculations for the bots
+
+#include "Globals.h"
+#include "Steering.h"
+
+
+
+
+
+static const double DEG_TO_RAD = M_PI / 180;
+static const double RAD_TO_DEG = 180 / M_PI;
+
+
+
+
+
+double Steering::normalizeAngle(double a_Angle)
+{
+	double res = fmod(a_Angle, 360);  // (-360, 360)
+	if (res > 180)
+	{
+		res -= 360;
+	}
+	else if (res <= -180)
+	{
+		res += 360;
+	}
+	return res;
+}
+
+
+
+
+
+double Steering::angleTo(double a_FromX, double a_FromY, double a_ToX, double a_ToY)
+{
+	double res = atan2(a_ToY - a_FromY, a_ToX - a_FromX) * RAD_TO_DEG;  // [-180, 180]
+	return (res < 0) ? res + 360 : res;
+}
+
+
+
+
+
+double Steering::steerAngle(double a_Angle, double a_TargetAngle, double a_MaxSteerAngle)
+{
+	double diff = normalizeAngle(a_TargetAngle - a_Angle);
+	return std::min(std::max(diff, -a_MaxSteerAngle), a_MaxSteerAngle);
+}
+
+
+
+
+
+double Steering::getMaxSteerAngle(const Board::SpeedLevels & a_SpeedLevels, double a_Speed)
+{
+	if (a_SpeedLevels.empty())
+	{
+		return 0;
+	}
+	auto level = a_SpeedLevels.begin();
+	for (auto itr = a_SpeedLevels.begin(), end = a_SpeedLevels.end(); itr != end; ++itr)
+	{
+		if (std::abs(itr->m_LinearSpeed - a_Speed) < std::abs(level->m_LinearSpeed - a_Speed))
+		{
+			level = itr;
+		}
+	}
+	return level->m_MaxAngularSpeed;
+}
+
+
+
+
+
+bool Steering::interceptPoint(
+	double a_X, double a_Y, double a_Speed,
+	double a_TargetX, double a_TargetY, double a_TargetSpeed, double a_TargetAngle,
+	double & a_InterceptX, double & a_InterceptY, double & a_Time
+)
+{
+	// The meeting time t solves |d + v * t| = speed * t, d being the target's relative position and v its velocity:
+	// (v.v - speed^2) * t^2 + 2 * (d.v) * t + d.d = 0
+	double dx = a_TargetX - a_X;
+	double dy = a_TargetY - a_Y;
+	double vx = a_TargetSpeed * cos(a_TargetAngle * DEG_TO_RAD);
+	double vy = a_TargetSpeed * sin(a_TargetAngle * DEG_TO_RAD);
+	double a = vx * vx + vy * vy - a_Speed * a_Speed;
+	double b = 2 * (dx * vx + dy * vy);
+	double c = dx * dx + dy * dy;
+	double t = -1;
+	if (c == 0)
+	{
+		t = 0;
+	}
+	else if (std::abs(a) < 1e-9 * std::max(c, 1.0))
+	{
+		// Same speeds, the equation is linear; only reachable if the target is approaching:
+		if (b < 0)
+		{
+			t = -c / b;
+		}
+	}
+	else
+	{
+		double disc = b * b - 4 * a * c;
+		if (disc >= 0)
+		{
+			// Pick the earliest non-negative root:
+			double sqrtDisc = sqrt(disc);
+			double t1 = (-b - sqrtDisc) / (2 * a);
+			double t2 = (-b + sqrtDisc) / (2 * a);
+			if (t1 > t2)
+			{
+				std::swap(t1, t2);
+			}
+			t = (t1 >= 0) ? t1 : t2;
+		}
+	}
+	if (t < 0)
+	{
+		return false;
+	}
+	a_Time = t;
+	a_InterceptX = a_TargetX + vx * t;
+	a_InterceptY = a_TargetY + vy * t;
+	return true;
+}
+
+
+
+
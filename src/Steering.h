@@ -0,0 +1,52 @@
+
+// Steering.h
+
+// Declares the Steering class providing the 2D geometry and steering calculations for the bots
+
+
+
+
+
+#pragma once
+
+#include "Board.h"
+
+
+
+
+
+/** The 2D geometry and steering calculations commonly needed by the controllers.
+The angles are in degrees, 0 pointing along the X axis and increasing towards the Y axis, same as the bots' angles.
+The "steer" command turns the bot by a relative angle, limited by the maxAngularSpeed of the bot's speed level. */
+class Steering
+{
+public:
+	/** Returns the angle normalized into the range (-180, 180]. */
+	static double normalizeAngle(double a_Angle);
+
+	/** Returns the direction from the first point to the second one, in the range [0, 360).
+	Returns 0 if the points are the same. */
+	static double angleTo(double a_FromX, double a_FromY, double a_ToX, double a_ToY);
+
+	/** Returns the relative angle by which a bot heading at a_Angle should steer to head at a_TargetAngle,
+	taking the shorter way around and limited to +/- a_MaxSteerAngle. */
+	static double steerAngle(double a_Angle, double a_TargetAngle, double a_MaxSteerAngle);
+
+	/** Returns the maximum steer angle for a bot moving at the specified speed: the maxAngularSpeed of the speed level
+	closest to the speed. Returns 0 if there are no speed levels. */
+	static double getMaxSteerAngle(const Board::SpeedLevels & a_SpeedLevels, double a_Speed);
+
+	/** Calculates where a pursuer starting at the specified point and moving at the specified speed in a straight line
+	can meet the target, which keeps its current speed and heading (angle).
+	Returns true and fills in the meeting point and the time (in seconds, the speeds being in units per second)
+	of the earliest meeting. Returns false if the pursuer cannot reach the target. */
+	static bool interceptPoint(
+		double a_X, double a_Y, double a_Speed,
+		double a_TargetX, double a_TargetY, double a_TargetSpeed, double a_TargetAngle,
+		double & a_InterceptX, double & a_InterceptY, double & a_Time
+	);
+};
+
+
+
+
@@ -0,0 +1,296 @@
+
+// TickLatency.cpp
+
+// Implements the TickLatency class that measures how long each stage of processing a game tick takes, and the LatencyHistogram helper class
+
+#include "Globals.h"
+#include "TickLatency.h"
+#include "json/json.h"
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// LatencyHistogram:
+
+LatencyHistogram::LatencyHistogram(void)
+{
+	clear();
+}
+
+
+
+
+
+void LatencyHistogram::clear(void)
+{
+	std::fill(m_Buckets, m_Buckets + NUM_BUCKETS, 0);
+	m_Count = 0;
+	m_Sum = 0;
+	m_Max = 0;
+}
+
+
+
+
+
+void LatencyHistogram::add(double a_USec)
+{
+	m_Buckets[getBucketIndex(a_USec)] += 1;
+	m_Count += 1;
+	m_Sum += a_USec;
+	m_Max = std::max(m_Max, a_USec);
+}
+
+
+
+
+
+double LatencyHistogram::getPercentile(double a_Fraction) const
+{
+	// Find the bucket containing the requested sample:
+	int rank = static_cast<int>(ceil(a_Fraction * m_Count));
+	int numSoFar = 0;
+	for (int i = 0; i < NUM_BUCKETS; i++)
+	{
+		numSoFar += m_Buckets[i];
+		if ((numSoFar >= rank) && (numSoFar > 0))
+		{
+			// The bucket's upper bound may be above the largest sample, report the sample then:
+			return std::min(getBucketUpperBound(i), m_Max);
+		}
+	}
+	return m_Max;
+}
+
+
+
+
+
+AString LatencyHistogram::getSummary(void) const
+{
+	return Printf("%6d samples, avg %9.1f, p50 %9.1f, p90 %9.1f, p99 %9.1f, max %9.1f usec",
+		m_Count, getAverage(), getPercentile(0.5), getPercentile(0.9), getPercentile(0.99), m_Max
+	);
+}
+
+
+
+
+
+Json::Value LatencyHistogram::toJson(void) const
+{
+	Json::Value res;
+	res["count"] = m_Count;
+	res["avgUsec"] = getAverage();
+	res["p50Usec"] = getPercentile(0.5);
+	res["p90Usec"] = getPercentile(0.9);
+	res["p99Usec"] = getPercentile(0.99);
+	res["maxUsec"] = m_Max;
+
+	// Output the non-empty buckets as [upperBound, count] pairs; the overflow bucket has a negative upper bound:
+	Json::Value buckets(Json::arrayValue);
+	for (int i = 0; i < NUM_BUCKETS; i++)
+	{
+		if (m_Buckets[i] == 0)
+		{
+			continue;
+		}
+		Json::Value bucket(Json::arrayValue);
+		bucket.append((i < NUM_BUCKETS - 1) ? getBucketUpperBound(i) : -1.0);
+		bucket.append(m_Buckets[i]);
+		buckets.append(bucket);
+	}
+	res["buckets"] = buckets;
+	return res;
+}
+
+
+
+
+
+int LatencyHistogram::getBucketIndex(double a_USec)
+{
+	if (a_USec < 1)
+	{
+		return 0;
+	}
+
+	// Split the value into the octave (exponent) and the position within the octave (mantissa in the range [0.5, 1)):
+	int exponent;
+	double mantissa = frexp(a_USec, &exponent);
+	int octave = exponent - 1;
+	if (octave >= NUM_OCTAVES)
+	{
+		return NUM_BUCKETS - 1;
+	}
+	int subBucket = static_cast<int>((mantissa * 2 - 1) * NUM_SUB_BUCKETS);
+	return 1 + octave * NUM_SUB_BUCKETS + std::min(subBucket, NUM_SUB_BUCKETS - 1);
+}
+
+
+
+
+
+double LatencyHistogram::getBucketUpperBound(int a_Index)
+{
+	if (a_Index == 0)
+	{
+		return 1;
+	}
+	if (a_Index >= NUM_BUCKETS - 1)
+	{
+		return std::numeric_limits<double>::infinity();
+	}
+	int octave = (a_Index - 1) / NUM_SUB_BUCKETS;
+	int subBucket = (a_Index - 1) % NUM_SUB_BUCKETS;
+	return ldexp(1 + static_cast<double>(subBucket + 1) / NUM_SUB_BUCKETS, octave);
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// TickLatency:
+
+TickLatency::TickLatency(void)
+{
+	clear();
+}
+
+
+
+
+
+void TickLatency::clear(void)
+{
+	cCSLock Lock(m_CS);
+	m_LastUpdateStage = -1;
+	m_LastSendStage = -1;
+	m_HasUpdate = false;
+	for (auto & stage: m_Stages)
+	{
+		stage.clear();
+	}
+	m_UpdateTotal.clear();
+	m_UpdateAgeAtSend.clear();
+}
+
+
+
+
+
+void TickLatency::mark(Stage a_Stage, TimePoint a_Time)
+{
+	ASSERT((a_Stage >= 0) && (a_Stage < stCount));
+
+	cCSLock Lock(m_CS);
+	bool isSendChain = (a_Stage >= stSendStarted);
+	int & lastStage = isSendChain ? m_LastSendStage : m_LastUpdateStage;
+	m_StageTimes[a_Stage] = a_Time;
+
+	// The first stage of a chain only starts the measurement:
+	if ((a_Stage == stReceived) || (a_Stage == stSendStarted))
+	{
+		lastStage = a_Stage;
+		return;
+	}
+
+	// If the previous stage has been skipped, the measurement is not valid:
+	if (lastStage != a_Stage - 1)
+	{
+		lastStage = -1;
+		return;
+	}
+	lastStage = a_Stage;
+	m_Stages[a_Stage].add(std::chrono::duration_cast<std::chrono::nanoseconds>(a_Time - m_StageTimes[a_Stage - 1]).count() / 1000.0);
+
+	// Measure the totals:
+	if (a_Stage == stControllerUpdated)
+	{
+		m_UpdateTotal.add(std::chrono::duration_cast<std::chrono::nanoseconds>(a_Time - m_StageTimes[stReceived]).count() / 1000.0);
+		m_HasUpdate = true;
+		m_LastUpdateReceivedTime = m_StageTimes[stReceived];
+	}
+	else if ((a_Stage == stSent) && m_HasUpdate)
+	{
+		m_UpdateAgeAtSend.add(std::chrono::duration_cast<std::chrono::nanoseconds>(a_Time - m_LastUpdateReceivedTime).count() / 1000.0);
+	}
+}
+
+
+
+
+
+AStringVector TickLatency::getSummary(void) const
+{
+	cCSLock Lock(m_CS);
+	AStringVector res;
+	res.push_back("Tick latency per stage:");
+	for (int i = 0; i < stCount; i++)
+	{
+		if ((i == stReceived) || (i == stSendStarted))
+		{
+			continue;
+		}
+		AString name = Printf("%s:", getStageName(static_cast<Stage>(i)));
+		res.push_back(Printf("  %-22s %s", name.c_str(), m_Stages[i].getSummary().c_str()));
+	}
+	res.push_back(Printf("  %-22s %s", "update total:", m_UpdateTotal.getSummary().c_str()));
+	res.push_back(Printf("  %-22s %s", "update age at send:", m_UpdateAgeAtSend.getSummary().c_str()));
+	return res;
+}
+
+
+
+
+
+AString TickLatency::getStatsJson(void) const
+{
+	cCSLock Lock(m_CS);
+	Json::Value stages;
+	for (int i = 0; i < stCount; i++)
+	{
+		if ((i == stReceived) || (i == stSendStarted))
+		{
+			continue;
+		}
+		stages[getStageName(static_cast<Stage>(i))] = m_Stages[i].toJson();
+	}
+	Json::Value root;
+	root["stages"] = stages;
+	root["updateTotal"] = m_UpdateTotal.toJson();
+	root["updateAgeAtSend"] = m_UpdateAgeAtSend.toJson();
+
+	Json::StreamWriterBuilder wr;
+	wr.settings_["indentation"] = "";
+	wr.settings_["commentStyle"] = "None";
+	return Json::writeString(wr, root);
+}
+
+
+
+
+
+const char * TickLatency::getStageName(Stage a_Stage)
+{
+	switch (a_Stage)
+	{
+		case stReceived:          return "received";
+		case stParsed:            return "parse";
+		case stBoardUpdated:      return "boardUpdate";
+		case stControllerUpdated: return "onGameUpdate";
+		case stSendStarted:       return "sendStarted";
+		case stCommandsRetrieved: return "getBotCommands";
+		case stSent:              return "send";
+		case stCount:             break;
+	}
+	ASSERT(!"Unknown stage");
+	return "unknown";
+}
+
+
+
+
@@ -0,0 +1,175 @@
+
+// TickLatency.h
+
+// Declares the TickLatency class that measures how long each stage of processing a game tick takes, and the LatencyHistogram helper class
+
+
+
+
+
+#pragma once
+
+#include "lib/Network/CriticalSection.h"
+
+
+
+
+
+// fwd:
+namespace Json
+{
+	class Value;
+}
+
+
+
+
+
+/** A histogram of latency samples, with logarithmic buckets (four per octave) from 1 usec up to about 16 sec.
+The percentiles are reported as the upper bound of the bucket containing them, so they are at most 25 % above the real value.
+Not thread-safe, the owner is expected to provide the locking. */
+class LatencyHistogram
+{
+public:
+	LatencyHistogram(void);
+
+	/** Removes all the samples. */
+	void clear(void);
+
+	/** Adds a single sample, in usec. */
+	void add(double a_USec);
+
+	/** Returns the number of samples. */
+	int getCount(void) const { return m_Count; }
+
+	/** Returns the average of the samples, in usec. Returns zero if there are no samples. */
+	double getAverage(void) const { return (m_Count > 0) ? m_Sum / m_Count : 0; }
+
+	/** Returns the largest sample, in usec. */
+	double getMax(void) const { return m_Max; }
+
+	/** Returns the value below which the specified fraction of the samples lie, in usec. */
+	double getPercentile(double a_Fraction) const;
+
+	/** Returns a one-line human-readable summary of the samples. */
+	AString getSummary(void) const;
+
+	/** Returns the histogram as a Json object, with the summary values and the non-empty buckets. */
+	Json::Value toJson(void) const;
+
+protected:
+	/** The number of buckets in each octave. */
+	static const int NUM_SUB_BUCKETS = 4;
+
+	/** The number of octaves covered by the buckets; larger values go to the last bucket. */
+	static const int NUM_OCTAVES = 24;
+
+	/** The total number of buckets: one for values below 1 usec, NUM_SUB_BUCKETS for each octave, one for the overflow. */
+	static const int NUM_BUCKETS = NUM_OCTAVES * NUM_SUB_BUCKETS + 2;
+
+	/** The number of samples in each bucket. */
+	int m_Buckets[NUM_BUCKETS];
+
+	/** The total number of samples. */
+	int m_Count;
+
+	/** The sum of all the samples, in usec. */
+	double m_Sum;
+
+	/** The largest sample, in usec. */
+	double m_Max;
+
+
+	/** Returns the index of the bucket into which the specified value belongs. */
+	static int getBucketIndex(double a_USec);
+
+	/** Returns the upper bound of the values in the specified bucket, in usec. */
+	static double getBucketUpperBound(int a_Index);
+};
+
+
+
+
+
+/** Measures the latency of the individual stages of processing a game tick.
+A game update goes through the stages stReceived to stControllerUpdated in the network thread (the last one in the controller's
+own thread, if it runs in one), the commands go through
+the stages stSendStarted to stSent in the command sender thread. Each stage's duration is measured from the previous stage
+of the same chain; if a stage is skipped (such as when the message fails to parse), the measurement is dropped until the chain
+starts again. Additionally, the total time to process an update and the age of the latest update at the moment the commands
+based on it are sent is measured.
+The object is thread-safe. */
+class TickLatency
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+	typedef Clock::time_point TimePoint;
+
+	/** The individual stages, in the order in which they happen. */
+	enum Stage
+	{
+		stReceived,           ///< The data of the game update has arrived from the network (cTCPLink's OnReceivedData)
+		stParsed,             ///< The game update has been parsed (Comm::processLine)
+		stBoardUpdated,       ///< The board has been updated with the game update
+		stControllerUpdated,  ///< The controller has processed the game update (Controller::onGameUpdate; in the controller's own thread, if it runs in one, including publishing its commands)
+		stSendStarted,        ///< The command sender has started sending a batch of commands
+		stCommandsRetrieved,  ///< The controller has returned the commands (Controller::getBotCommands)
+		stSent,               ///< The commands have been queued for sending (cTCPLink::Send)
+
+		stCount,
+	};
+
+
+	TickLatency(void);
+
+	/** Removes all the measurements. Called when a new game starts. */
+	void clear(void);
+
+	/** Records that the specified stage has been reached at the specified time. */
+	void mark(Stage a_Stage, TimePoint a_Time);
+
+	/** Records that the specified stage has been reached right now. */
+	void mark(Stage a_Stage) { mark(a_Stage, Clock::now()); }
+
+	/** Returns a human-readable summary of the measurements, one line per stage. */
+	AStringVector getSummary(void) const;
+
+	/** Returns the measurements serialized into a Json string, used for the binary log. */
+	AString getStatsJson(void) const;
+
+protected:
+	/** Protects all the members against multithreaded access. */
+	mutable cCriticalSection m_CS;
+
+	/** The time when each stage was last reached. */
+	TimePoint m_StageTimes[stCount];
+
+	/** The last stage reached in the update chain (stReceived to stControllerUpdated), or -1 if the chain has been broken. */
+	int m_LastUpdateStage;
+
+	/** The last stage reached in the send chain (stSendStarted to stSent), or -1 if the chain has been broken. */
+	int m_LastSendStage;
+
+	/** True if at least one game update has been fully processed. */
+	bool m_HasUpdate;
+
+	/** The time when the data of the last fully processed game update arrived. */
+	TimePoint m_LastUpdateReceivedTime;
+
+	/** The durations of the individual stages, since the previous stage; unused for the first stage in each chain. */
+	LatencyHistogram m_Stages[stCount];
+
+	/** The total time from receiving a game update until the controller has processed it. */
+	LatencyHistogram m_UpdateTotal;
+
+	/** The age of the last fully processed game update at the time when the commands are sent. */
+	LatencyHistogram m_UpdateAgeAtSend;
+
+
+	/** Returns the name of the stage, as used in the reports. */
+	static const char * getStageName(Stage a_Stage);
+};
+
+
+
+
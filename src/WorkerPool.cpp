@@ -0,0 +1,163 @@
+
+// WorkerPool.cpp
+
+// Implements the WorkerPool class representing a fixed set of threads executing tasks, shared by multiple sessions
+
+#include "Globals.h"
+#include "WorkerPool.h"
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// WorkerPool::SerialQueue:
+
+WorkerPool::SerialQueue::SerialQueue(WorkerPool & a_Pool):
+	m_Pool(a_Pool),
+	m_IsRunning(false)
+{
+}
+
+
+
+
+
+WorkerPool::SerialQueue::~SerialQueue()
+{
+	drain();
+}
+
+
+
+
+
+void WorkerPool::SerialQueue::post(Task a_Task)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_Tasks.push_back(std::move(a_Task));
+		if (m_IsRunning)
+		{
+			// The task already running in the pool will pick it up
+			return;
+		}
+		m_IsRunning = true;
+	}
+	m_Pool.post(std::bind(&SerialQueue::run, this));
+}
+
+
+
+
+
+void WorkerPool::SerialQueue::drain(void)
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	while (m_IsRunning)
+	{
+		m_CondIdle.wait(lock);
+	}
+}
+
+
+
+
+
+void WorkerPool::SerialQueue::run(void)
+{
+	while (true)
+	{
+		Task task;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			if (m_Tasks.empty())
+			{
+				m_IsRunning = false;
+				m_CondIdle.notify_all();
+				return;
+			}
+			task = std::move(m_Tasks.front());
+			m_Tasks.pop_front();
+		}
+		task();
+	}
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// WorkerPool:
+
+WorkerPool::WorkerPool(int a_NumThreads):
+	m_ShouldTerminate(false)
+{
+	ASSERT(a_NumThreads > 0);
+	for (int i = 0; i < a_NumThreads; i++)
+	{
+		m_Threads.emplace_back(&WorkerPool::workerThread, this);
+	}
+}
+
+
+
+
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_ShouldTerminate = true;
+	}
+	m_CondTask.notify_all();
+	for (auto & thr: m_Threads)
+	{
+		thr.join();
+	}
+}
+
+
+
+
+
+void WorkerPool::post(Task a_Task)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_Tasks.push_back(std::move(a_Task));
+	}
+	m_CondTask.notify_one();
+}
+
+
+
+
+
+void WorkerPool::workerThread(void)
+{
+	while (true)
+	{
+		Task task;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			while (m_Tasks.empty() && !m_ShouldTerminate)
+			{
+				m_CondTask.wait(lock);
+			}
+			if (m_Tasks.empty())
+			{
+				// Terminating and all the tasks have been executed
+				return;
+			}
+			task = std::move(m_Tasks.front());
+			m_Tasks.pop_front();
+		}
+		task();
+	}
+}
+
+
+
+
@@ -0,0 +1,104 @@
+
+// WorkerPool.h
+
+// Declares the WorkerPool class representing a fixed set of threads executing tasks, shared by multiple sessions
+
+
+
+
+
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+
+
+
+
+/** A fixed set of worker threads that execute the posted tasks.
+Tasks that must not run concurrently with each other (such as the processing of a single session's messages) are posted
+through a SerialQueue, which executes them one at a time, in order, on any of the worker threads. */
+class WorkerPool
+{
+public:
+	typedef std::function<void(void)> Task;
+
+
+	/** Executes the tasks posted to it one at a time and in order, using the threads of the parent pool.
+	Only one pool thread is occupied by a single queue at any time, so a queue with slow tasks doesn't hold up other queues
+	as long as there are more threads in the pool. */
+	class SerialQueue
+	{
+	public:
+		SerialQueue(WorkerPool & a_Pool);
+
+		/** Waits for all the posted tasks to finish. */
+		~SerialQueue();
+
+		/** Queues the task for execution after all the previously posted tasks. */
+		void post(Task a_Task);
+
+		/** Waits until all the tasks posted so far have been executed. */
+		void drain(void);
+
+	protected:
+		/** The pool whose threads execute the tasks. */
+		WorkerPool & m_Pool;
+
+		/** Protects the members against multithreaded access. */
+		std::mutex m_Mutex;
+
+		/** Notified when the queue becomes idle. */
+		std::condition_variable m_CondIdle;
+
+		/** The tasks waiting for execution. */
+		std::deque<Task> m_Tasks;
+
+		/** True if the queue has a task in the pool that is executing m_Tasks (or is about to). */
+		bool m_IsRunning;
+
+
+		/** Executes the queued tasks until the queue is empty. Runs on a pool thread. */
+		void run(void);
+	};
+
+
+	/** Creates a pool with the specified number of threads. */
+	WorkerPool(int a_NumThreads);
+
+	/** Executes all the tasks still in the queue and stops all the threads. */
+	~WorkerPool();
+
+	/** Queues the task for execution on any of the threads. */
+	void post(Task a_Task);
+
+	/** Returns the number of threads in the pool. */
+	size_t getNumThreads(void) const { return m_Threads.size(); }
+
+protected:
+	/** Protects the members against multithreaded access. */
+	std::mutex m_Mutex;
+
+	/** Notified when a task is queued or the pool is terminating. */
+	std::condition_variable m_CondTask;
+
+	/** The tasks waiting for execution. */
+	std::deque<Task> m_Tasks;
+
+	/** Set to true when the pool is being destroyed. */
+	bool m_ShouldTerminate;
+
+	/** The worker threads. */
+	std::vector<std::thread> m_Threads;
+
+
+	/** The body of each of the worker threads. */
+	void workerThread(void);
+};
+
+
+
+